@@ -0,0 +1,101 @@
+// C++ includes
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "sfm/parse_bundler.hh"
+#include "sfm/localization_model.hh"
+
+// stopwatch
+#include "timer.hh"
+
+////
+// The resident memory of the process in kB (VmRSS or VmHWM of /proc/self/status), 0 if unknown.
+uint64_t get_resident_memory( const std::string &field )
+{
+  std::ifstream ifs( "/proc/self/status" );
+  std::string line;
+  while ( std::getline( ifs, line ) )
+  {
+    if ( line.compare( 0, field.size() + 1, field + ":" ) == 0 )
+    {
+      std::istringstream iss( line.substr( field.size() + 1 ) );
+      uint64_t kb = 0;
+      iss >> kb;
+      return kb;
+    }
+  }
+  return 0;
+}
+
+int main (int argc, char **argv)
+{
+  if ( argc < 3 )
+  {
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " -    Measures the memory of the points of a model in the localizer: loads a .info file either with  - " << std::endl;
+    std::cout << " -    parse_bundler (a feature_3D_info per point) or into the slim localization_model and reports    - " << std::endl;
+    std::cout << " -    the growth of the resident memory of the process. Run it once per store.                       - " << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " - usage: benchmark_localization_model bundle store                                                  - " << std::endl;
+    std::cout << " - Parameters:                                                                                       - " << std::endl;
+    std::cout << " -  argv[1]: The .info file (format 1, with camera information)                                      - " << std::endl;
+    std::cout << " -  argv[2]: The store: bundler, slim or slim_details (slim with the scales and orientations of the  - " << std::endl;
+    std::cout << " -           views, as loaded by the localizer with --consistency_filter)                            - " << std::endl;
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    return -1;
+  }
+
+  std::string bundle_file( argv[1] );
+  std::string store( argv[2] );
+  if ( store != "bundler" && store != "slim" && store != "slim_details" )
+  {
+    std::cerr << " ERROR: Unknown store " << store << ", use bundler, slim or slim_details" << std::endl;
+    return -1;
+  }
+
+  uint64_t rss_before = get_resident_memory( "VmRSS" );
+  Timer load_timer;
+  load_timer.Init();
+  load_timer.Start();
+
+  parse_bundler parser;
+  localization_model model;
+  std::vector< bundler_camera > cameras;
+  uint32_t nb_points = 0;
+  uint64_t nb_views = 0;
+  if ( store == "bundler" )
+  {
+    if ( !parser.load_from_binary_nokey( bundle_file.c_str(), 1 ) )
+      return -1;
+    nb_points = parser.get_number_of_points();
+    const std::vector< feature_3D_info > &feature_infos = parser.get_feature_infos();
+    for ( uint32_t i = 0; i < nb_points; ++i )
+      nb_views += feature_infos[i].view_list.size();
+  }
+  else
+  {
+    if ( !model.load( bundle_file, cameras, store == "slim_details" ) )
+      return -1;
+    nb_points = model.get_nb_points();
+    nb_views = model.get_nb_views();
+    model.print_statistics();
+  }
+  load_timer.Stop();
+
+  uint64_t rss_after = get_resident_memory( "VmRSS" );
+  uint64_t rss_peak = get_resident_memory( "VmHWM" );
+  double rss_delta = 1024.0 * (double) ( rss_after - rss_before );
+  std::cout << " loaded " << nb_points << " points with " << nb_views << " views with the " << store << " store in " << load_timer.GetElapsedTime() << "s" << std::endl;
+  std::cout << " resident memory: " << rss_before / 1024.0 << " MB before, " << rss_after / 1024.0 << " MB after, " << rss_peak / 1024.0 << " MB peak" << std::endl;
+  std::cout << " the points use " << rss_delta / ( 1024.0 * 1024.0 ) << " MB, " << rss_delta / (double) std::max( nb_points, (uint32_t) 1 ) << " bytes per point ("
+            << sizeof( feature_3D_info ) << " bytes per feature_3D_info before its heap data)" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,327 @@
+#define __STDC_LIMIT_MACROS
+
+// C++ includes
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <stdlib.h>
+
+// includes for classes dealing with SIFT-features
+#include "features/visual_words_handler.hh"
+#include "features/desc_assignments.hh"
+#include "features/vw_assignments.hh"
+#include "features/hamming_embedding.hh"
+#include "features/hamming_delta.hh"
+#include "sfm/parse_bundler.hh"
+#include "sfm/covisibility_graph.hh"
+
+// stopwatch
+#include "timer.hh"
+
+#include "model_cache.hh"
+
+// the names of the cached artifacts
+const std::string quantization_stage( "quantization" );
+const std::string assignments_stage( "assignments" );
+const std::string hamming_stage( "hamming" );
+const std::string vocabulary_stage( "vocabulary" );
+const std::string covisibility_stage( "covisibility" );
+
+
+////
+// Parses the .info file
+bool parse_bundle( parse_bundler &parser, const std::string &bundle, int bundle_type )
+{
+  std::cout << "-> parsing the bundler output from " << bundle << std::endl;
+  Timer timer;
+  timer.Init();
+  timer.Start();
+  if ( !parser.load_from_binary( bundle.c_str(), bundle_type ) )
+    return false;
+  timer.Stop();
+  std::cout << "--> done parsing the bundler output in " << timer.GetElapsedTime() << "s" << std::endl;
+  return true;
+}
+
+////
+// Builds the covisibility graph of the cameras from the visibility lists of the points and saves
+// it to filename (through the cache if it is enabled).
+bool save_covisibility_graph( parse_bundler &parser, const std::string &filename, const model_cache &cache, uint64_t key )
+{
+  Timer timer;
+  timer.Init();
+  timer.Start();
+  covisibility_graph graph;
+  graph.build( parser.get_feature_infos(), parser.get_number_of_cameras(), covisibility_graph::default_min_shared_points, covisibility_graph::default_max_neighbors );
+  timer.Stop();
+  std::cout << "-> built the covisibility graph in " << timer.GetElapsedTime() << "s" << std::endl;
+  graph.print_statistics();
+
+  if ( !cache.is_enabled() )
+    return graph.save( filename );
+  if ( !graph.save( cache.get_temporary_filename( covisibility_stage, key ) ) || !cache.commit( covisibility_stage, key ) )
+    return false;
+  return cache.copy_to( covisibility_stage, key, filename );
+}
+
+
+int main (int argc, char **argv)
+{
+  if ( argc < 11 )
+  {
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " -    Builds a localizable model in one process: quantization of the descriptors of the 3D points,   - " << std::endl;
+    std::cout << " -    selection of the representative descriptors, computation of the hamming thresholds and of the - " << std::endl;
+    std::cout << " -    binary signatures (compute_desc_assignments followed by compute_hamming_threshold).            - " << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " - usage: build_localization_model bundle bundle_type nb_cluster clusters mode assignment_type       - " << std::endl;
+    std::cout << " -        branching paths projection out_hamming [cache_dir]                                         - " << std::endl;
+    std::cout << " - Parameters:                                                                                       - " << std::endl;
+    std::cout << " -  argv[1]: The .info file                                                                          - " << std::endl;
+    std::cout << " -  argv[2]: The file format of the .info file (0: Bundle2Info, 1: with camera information)          - " << std::endl;
+    std::cout << " -  argv[3]: The number of visual words                                                              - " << std::endl;
+    std::cout << " -  argv[4]: The visual vocabulary. Each row stores one visual word (as 128 floats)                  - " << std::endl;
+    std::cout << " -  argv[5]: The representative mode (see compute_desc_assignments), only modes storing unsigned    - " << std::endl;
+    std::cout << " -           char descriptors (0, 3, 5, 6, 7) are supported                                          - " << std::endl;
+    std::cout << " -  argv[6]: 0 to use a single kd-tree, 1 to use a vocabulary tree (hkmeans) for the assignments     - " << std::endl;
+    std::cout << " -  argv[7]: The branching factor of the vocabulary tree                                             - " << std::endl;
+    std::cout << " -  argv[8]: The number of paths checked when assigning descriptors to visual words                  - " << std::endl;
+    std::cout << " -  argv[9]: The projection matrix used in hamming embedding                                         - " << std::endl;
+    std::cout << " -  argv[10]: Output file (same format as the output of compute_hamming_threshold). The covisibility  - " << std::endl;
+    std::cout << " -            graph of the cameras is written to argv[10].covisibility                               - " << std::endl;
+    std::cout << " -  argv[11]: (optional) An existing directory in which intermediate results are cached. Results    - " << std::endl;
+    std::cout << " -            are keyed by the content of the input files and the parameters, e.g., changing only    - " << std::endl;
+    std::cout << " -            the projection matrix skips the visual word assignments.                               - " << std::endl;
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    return -1;
+  }
+
+  ////
+  // get the parameters
+  std::string bundle( argv[1] );
+  int bundle_type = atoi( argv[2] );
+  uint32_t nb_cluster = (uint32_t) atoi( argv[3] );
+  std::string cluster_file( argv[4] );
+  int mode = atoi( argv[5] );
+  int assignment_type = atoi( argv[6] );
+  int nb_branching = atoi( argv[7] );
+  int nb_paths = atoi( argv[8] );
+  std::string projection_file( argv[9] );
+  std::string hamming_output( argv[10] );
+  std::string covisibility_output = hamming_output + ".covisibility";
+
+  if ( !( mode == 0 || mode == 3 || mode == 5 || mode == 6 || mode == 7 ) )
+  {
+    std::cerr << " ERROR: Mode " << mode << " does not store unsigned char descriptors, aborting " << std::endl;
+    return -1;
+  }
+  if ( assignment_type < 0 || assignment_type > 1 )
+  {
+    std::cerr << " ERROR: Unknown type to compute the visual word assignments." << std::endl;
+    return -1;
+  }
+  if ( bundle_type < 0 || bundle_type > 1 )
+  {
+    std::cerr << " ERROR: Unknown file format for the binary .info file." << std::endl;
+    return -1;
+  }
+
+  model_cache cache;
+  if ( argc > 11 )
+    cache.set_directory( std::string( argv[11] ) );
+
+  Timer timer;
+
+  ////
+  // compute the keys of the intermediate results
+  uint64_t vocabulary_key = 0, quantization_key = 0, assignments_key = 0, hamming_key = 0, covisibility_key = 0;
+  if ( cache.is_enabled() )
+  {
+    timer.Init();
+    timer.Start();
+    uint64_t bundle_hash, cluster_hash, projection_hash;
+    if ( !model_cache::hash_file( bundle, bundle_hash ) || !model_cache::hash_file( cluster_file, cluster_hash ) || !model_cache::hash_file( projection_file, projection_hash ) )
+    {
+      std::cerr << " ERROR: Cannot read the input files" << std::endl;
+      return -1;
+    }
+    vocabulary_key = model_cache::combine( cluster_hash, (uint64_t) nb_cluster );
+    vocabulary_key = model_cache::combine( vocabulary_key, (uint64_t) assignment_type );
+    vocabulary_key = model_cache::combine( vocabulary_key, (uint64_t) nb_branching );
+    quantization_key = model_cache::combine( bundle_hash, (uint64_t) bundle_type );
+    quantization_key = model_cache::combine( quantization_key, cluster_hash );
+    quantization_key = model_cache::combine( quantization_key, (uint64_t) nb_cluster );
+    quantization_key = model_cache::combine( quantization_key, (uint64_t) assignment_type );
+    quantization_key = model_cache::combine( quantization_key, (uint64_t) nb_branching );
+    quantization_key = model_cache::combine( quantization_key, (uint64_t) nb_paths );
+    assignments_key = model_cache::combine( quantization_key, (uint64_t) mode );
+    hamming_key = model_cache::combine( assignments_key, projection_hash );
+    covisibility_key = model_cache::combine( bundle_hash, (uint64_t) bundle_type );
+    covisibility_key = model_cache::combine( covisibility_key, (uint64_t) covisibility_graph::default_min_shared_points );
+    covisibility_key = model_cache::combine( covisibility_key, (uint64_t) covisibility_graph::default_max_neighbors );
+    timer.Stop();
+    std::cout << "-> hashed the input files in " << timer.GetElapsedTime() << "s" << std::endl;
+  }
+
+  // the covisibility graph only depends on the bundle, it is built whenever the bundle is parsed
+  bool covisibility_done = false;
+  if ( cache.contains( covisibility_stage, covisibility_key ) )
+  {
+    std::cout << "-> the covisibility graph is up to date, copying it from " << cache.get_filename( covisibility_stage, covisibility_key ) << std::endl;
+    if ( !cache.copy_to( covisibility_stage, covisibility_key, covisibility_output ) )
+      return -1;
+    covisibility_done = true;
+  }
+
+  if ( cache.contains( hamming_stage, hamming_key ) )
+  {
+    std::cout << "-> the model is up to date, copying it from " << cache.get_filename( hamming_stage, hamming_key ) << std::endl;
+    if ( !covisibility_done )
+    {
+      parse_bundler parser;
+      if ( !parse_bundle( parser, bundle, bundle_type ) || !save_covisibility_graph( parser, covisibility_output, cache, covisibility_key ) )
+        return -1;
+    }
+    return ( cache.copy_to( hamming_stage, hamming_key, hamming_output ) && hamming_delta::discard( hamming_output ) ) ? 0 : -1;
+  }
+
+  hamming_embedding embedding;
+  if ( !embedding.load_projection_matrix( projection_file ) )
+    return -1;
+
+  std::vector< uint64_t > signatures;
+
+  // the stop words are flagged with the defaults of compute_hamming_threshold
+  stop_words words;
+
+  if ( cache.contains( assignments_stage, assignments_key ) )
+  {
+    ////
+    // the assignments are cached, only the hamming embedding has to be computed
+    std::cout << "-> using the cached assignments " << cache.get_filename( assignments_stage, assignments_key ) << std::endl;
+    if ( !covisibility_done )
+    {
+      parse_bundler parser;
+      if ( !parse_bundle( parser, bundle, bundle_type ) || !save_covisibility_graph( parser, covisibility_output, cache, covisibility_key ) )
+        return -1;
+    }
+    vw_assignments assignments;
+    if ( !assignments.load( cache.get_filename( assignments_stage, assignments_key ) ) )
+      return -1;
+
+    timer.Init();
+    timer.Start();
+    embedding.embed( assignments, assignments.get_descriptors(), assignments.get_nb_descriptors(), signatures );
+    timer.Stop();
+    std::cout << "--> computed the hamming embedding in " << timer.GetElapsedTime() << "s" << std::endl;
+    hamming_embedding::print_deduplication_statistics( assignments, signatures );
+    words.analyze( assignments, signatures, 99.9, 4.0 );
+    words.print_statistics();
+
+    if ( !embedding.save( cache.is_enabled() ? cache.get_temporary_filename( hamming_stage, hamming_key ) : hamming_output, assignments, signatures, true, &words ) )
+      return -1;
+  }
+  else
+  {
+    ////
+    // load the Bundler data
+    parse_bundler parser;
+    if ( !parse_bundle( parser, bundle, bundle_type ) )
+      return -1;
+    std::vector< feature_3D_info >& feature_infos = parser.get_feature_infos();
+    if ( !covisibility_done && !save_covisibility_graph( parser, covisibility_output, cache, covisibility_key ) )
+      return -1;
+
+    ////
+    // the vocabulary is needed for the quantization and for modes 1 and 7 (assignment of the mean descriptors)
+    visual_words_handler vw_handler;
+    vw_handler.set_nb_trees( 1 );
+    vw_handler.set_nb_visual_words( nb_cluster );
+    vw_handler.set_branching( nb_branching );
+    vw_handler.set_method( std::string( "flann" ) );
+    if ( assignment_type == 0 )
+      vw_handler.set_flann_type( std::string( "randomkd" ) );
+    else
+      vw_handler.set_flann_type( std::string( "hkmeans" ) );
+
+    timer.Init();
+    timer.Start();
+    // with a cache, the search tree is saved once and mapped into memory by later runs
+    std::string vocabulary_index_file = cache.get_filename( vocabulary_stage, vocabulary_key );
+    bool vocabulary_loaded = cache.is_enabled() ? vw_handler.load_trees_flann( cluster_file, vocabulary_index_file ) : vw_handler.create_flann_search_index( cluster_file );
+    if ( !vocabulary_loaded )
+    {
+      std::cout << " ERROR: Could not load the cluster centers from " << cluster_file << std::endl;;
+      return -1;
+    }
+    timer.Stop();
+    std::cout << "-> loaded the vocabulary tree in " << timer.GetElapsedTime() << "s" << std::endl;
+
+    ////
+    // quantization
+    std::vector< uint32_t > descriptor_2_vw_assignments;
+    timer.Init();
+    timer.Start();
+    if ( cache.load_uint32( quantization_stage, quantization_key, descriptor_2_vw_assignments ) )
+      std::cout << "-> using the cached visual word assignments " << cache.get_filename( quantization_stage, quantization_key ) << std::endl;
+    else
+    {
+      std::cout << "-> Assigning the descriptors to visual words (this might take a while)" << std::endl;
+      desc_assignments::quantize( feature_infos, vw_handler, assignment_type, nb_paths, nb_cluster, descriptor_2_vw_assignments );
+      if ( cache.is_enabled() )
+        cache.save_uint32( quantization_stage, quantization_key, descriptor_2_vw_assignments );
+    }
+    timer.Stop();
+    std::cout << "--> done in " << timer.GetElapsedTime() << "s" << std::endl;
+
+    ////
+    // representative descriptors
+    desc_assignments assignments;
+    timer.Init();
+    timer.Start();
+    if ( !assignments.compute_representatives( feature_infos, descriptor_2_vw_assignments, vw_handler, mode, nb_cluster ) )
+      return -1;
+    timer.Stop();
+    std::cout << "-> computed the representative descriptors in " << timer.GetElapsedTime() << "s" << std::endl;
+    assignments.print_statistics();
+
+    if ( cache.is_enabled() )
+    {
+      if ( assignments.save( cache.get_temporary_filename( assignments_stage, assignments_key ) ) )
+        cache.commit( assignments_stage, assignments_key );
+    }
+
+    // the descriptors of the 3D points are not needed anymore
+    parser.clear();
+
+    ////
+    // hamming embedding
+    timer.Init();
+    timer.Start();
+    embedding.embed( assignments, assignments.get_descriptors(), assignments.get_nb_descriptors(), signatures );
+    timer.Stop();
+    std::cout << "-> computed the hamming embedding in " << timer.GetElapsedTime() << "s" << std::endl;
+    hamming_embedding::print_deduplication_statistics( assignments, signatures );
+    words.analyze( assignments, signatures, 99.9, 4.0 );
+    words.print_statistics();
+
+    if ( !embedding.save( cache.is_enabled() ? cache.get_temporary_filename( hamming_stage, hamming_key ) : hamming_output, assignments, signatures, true, &words ) )
+      return -1;
+  }
+
+  if ( cache.is_enabled() )
+  {
+    if ( !cache.commit( hamming_stage, hamming_key ) || !cache.copy_to( hamming_stage, hamming_key, hamming_output ) )
+      return -1;
+  }
+
+  // a rebuilt model contains the points appended by update_localization_model, their delta file would not extend it
+  if ( !hamming_delta::discard( hamming_output ) )
+    return -1;
+
+  std::cout << "-> saved the model to " << hamming_output << " and the covisibility graph to " << covisibility_output << std::endl;
+  return 0;
+}
@@ -25,12 +25,28 @@
 #include "features/SIFT_loader.hh"
 #include "features/visual_words_handler.hh"
 #include "sfm/parse_bundler.hh"
+#include "sfm/localization_model.hh"
+#include "sfm/geo_prior.hh"
+#include "sfm/pose_estimator.hh"
+#include "sfm/consistency_filter.hh"
+#include "sfm/sequence_tracker.hh"
+#include "sfm/covisibility_graph.hh"
+#include "sfm/place_index.hh"
+#include "sfm/visibility_index.hh"
+#include "query_budget.hh"
+#include "features/inverted_file.hh"
+#include "features/hamming_embedding.hh"
+#include "features/stop_words.hh"
+#include "features/hamming_delta.hh"
 
 // stopwatch
 #include "timer.hh"
 
 #include "exif_reader/exif_reader.hh"
 
+#include "tiled_model.hh"
+#include "vw_shards.hh"
+
 const uint64_t sift_dim = 128;
 
 class Spatial_Bin
@@ -54,16 +70,59 @@ bool cmp_dist( const std::pair< int, float >& a, const std::pair< int, float >&
 	return ( a.second < b.second );
 }
 
+// keep the cap (3D point id, hamming distance) pairs with the smallest distances, ties are broken by the order of the hits
+void cap_hits( std::vector< std::pair< uint32_t, uint32_t > > &hits, size_t cap )
+{
+	if ( hits.size() <= cap )
+		return;
+	std::vector< uint32_t > distances( hits.size() );
+	for ( size_t m = 0; m < hits.size(); ++m )
+		distances[m] = hits[m].second;
+	std::nth_element( distances.begin(), distances.begin() + ( cap - 1 ), distances.end() );
+	uint32_t max_distance = distances[cap - 1];
+	size_t nb_below = 0;
+	for ( size_t m = 0; m < hits.size(); ++m )
+	{
+		if ( hits[m].second < max_distance )
+			++nb_below;
+	}
+	// all hits below the largest kept distance and the first ones at that distance
+	size_t nb_kept = 0, nb_at_max = cap - nb_below;
+	for ( size_t m = 0; m < hits.size(); ++m )
+	{
+		if ( hits[m].second < max_distance || ( hits[m].second == max_distance && nb_at_max-- > 0 ) )
+			hits[nb_kept++] = hits[m];
+	}
+	hits.resize( nb_kept );
+}
+
+// the position of a keypoint (centered at the principal point) corrected for the radial distortion of the query, if its focal length is known
+Eigen::Vector2d get_undistorted_point( const SIFT_keypoint &keypoint, double focal, double radial )
+{
+	Eigen::Vector2d distorted( keypoint.x, keypoint.y );
+	if ( focal <= 0.0 || radial == 0.0 )
+		return distorted;
+	// invert x_d = x_u * ( 1 + radial * |x_u|^2 / focal^2 ) with fixed point iterations
+	Eigen::Vector2d undistorted = distorted;
+	for ( int k = 0; k < 5; ++k )
+		undistorted = distorted / ( 1.0 + radial * undistorted.squaredNorm() / ( focal * focal ) );
+	return undistorted;
+}
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------
 
-int main (int argc, char **argv)
+// the localization with nb_bits bit signatures, tiled models and shards always use 64 bits
+template< int nb_bits >
+int localize (int argc, char **argv)
 {
+	typedef typename hamming_signature< nb_bits >::type signature_t;
+
 	if ( argc < 15 )
 	{
 		std::cout << "______________________________________________________________________________________________________________________________________" << std::endl;
 		std::cout << " - Usage: cascaded_parallel_filtering_aachenDayNight                                                                                - " << std::endl;
 		std::cout << " - Generate two set of 2D-3D matches for final geometry-wise disambiguation for Aachen Day-Night dataset                            - " << std::endl;
-		std::cout << " - In this code, the dimension of hamming binary signatures is set to 64                                                            - " << std::endl;
+		std::cout << " - The binary signatures have 32, 64 or 128 bits, as given by the header of argv[4] (tiled models and shards use 64 bits)           - " << std::endl;
 		std::cout << " - Parameters:                                                                                                                      - " << std::endl;
 		std::cout << " -  argv[1]: The list of query images                                                                                               - " << std::endl;
 		std::cout << " -  argv[2]: The number of visual words                                                                                             - " << std::endl;
@@ -80,6 +139,55 @@ int main (int argc, char **argv)
 		std::cout << " -  argv[13] and argv[14]: The output 2D-3D matches                                                                                 - " << std::endl;
 		std::cout << " -  argv[13] stores the 2D positions and argv[14] stores the 3D positions                                                           - " << std::endl;
 		std::cout << " -  (first 2D-3D matches for computing the auxliary camera pose, then 2D-3D matches that serve as Visibility-wise match pool )      - " << std::endl;
+		std::cout << " - Optional parameters (given as pairs after argv[14]):                                                                             - " << std::endl;
+		std::cout << " -  --vocabulary_index file: Binary file storing the visual vocabulary and its search tree. Created on the first run, later runs   - " << std::endl;
+		std::cout << " -                           map it into memory instead of building the tree again                                               - " << std::endl;
+		std::cout << " -  --georegistration file: Reference GPS position and 4x4 transformation from model coordinates to meters east/north/up. Queries  - " << std::endl;
+		std::cout << " -                          with GPS information are only matched against points seen by cameras within --gps_radius         - " << std::endl;
+		std::cout << " -  --gps_radius meters: Search radius around the GPS position of a query (default 300)                                             - " << std::endl;
+		std::cout << " -  --gps_tile_size meters: Size of the tiles the cameras are sorted into (default 300)                                              - " << std::endl;
+		std::cout << " -  --tiled_model file: Index of a tiled model (see tile_localization_model) used instead of argv[4] and argv[6]. Only the tiles      - " << std::endl;
+		std::cout << " -                      within --gps_radius of a query are loaded, requires --georegistration. Queries without GPS are skipped  - " << std::endl;
+		std::cout << " -  --tile_memory_budget MB: Maximal size of the tiles kept in memory (default 1024)                                                 - " << std::endl;
+		std::cout << " -  --shards prefix: Match against the shards served by match_shard_server on the sockets prefix_i.sock instead                      - " << std::endl;
+		std::cout << " -                   of loading the inverted lists and signatures of argv[4]                                                         - " << std::endl;
+		std::cout << " -  --nb_shards n: The number of shards (default 1)                                                                                  - " << std::endl;
+		std::cout << " -  --multi_index n: Index the visual words with at least n distinct signatures with multi-index hashing instead of scanning them,   - " << std::endl;
+		std::cout << " -                   \"auto\" chooses n with a benchmark on the loaded model (default: no multi-index)                               - " << std::endl;
+		std::cout << " -  --stop_words n: Keep at most n correspondences with the smallest distances for features in the stop words flagged in argv[4]     - " << std::endl;
+		std::cout << " -                  (oversized or bursty visual words), 0 or \"skip\" does not match these features (default: no limit)                - " << std::endl;
+		std::cout << " -  --poses file: Estimate the pose of every query with LO-RANSAC, an auxiliary pose from the first set of matches filters the       - " << std::endl;
+		std::cout << " -                second set, from which the final pose is computed. The poses are written as name qw qx qy qz tx ty tz              - " << std::endl;
+		std::cout << " -  --pose_threshold pixels: The inlier threshold of the pose estimation and of the filtering (default 10)                           - " << std::endl;
+		std::cout << " -  --pose_focal known|unknown: Use the focal lengths of argv[1] with P3P or estimate them with an approximate P4Pf                  - " << std::endl;
+		std::cout << " -                              (P3P with a 1D search over the focal length, not a minimal solver; default known,                    - " << std::endl;
+		std::cout << " -                              unknown for queries without a positive focal length)                                                 - " << std::endl;
+		std::cout << " -  --pose_sampling prosac|uniform|benchmark: Sample the matches in the order of their scores with PROSAC, which needs               - " << std::endl;
+		std::cout << " -                                  far fewer hypotheses if the best scored matches are inliers, or uniformly. benchmark             - " << std::endl;
+		std::cout << " -                                  uses PROSAC and measures the hypotheses and time of uniform sampling with a second               - " << std::endl;
+		std::cout << " -                                  run per pose, otherwise they are estimated from the inlier ratio (default prosac)                - " << std::endl;
+		std::cout << " -  --consistency_filter n: Remove the matches of each top image of the visibility-wise pool whose scale and orientation             - " << std::endl;
+		std::cout << " -                          changes disagree with their dominant mode in a histogram with n orientation bins (default 0: off)        - " << std::endl;
+		std::cout << " -  --deadline ms: Anytime mode with a latency budget per query. Stages that run out of time keep the largest keypoints,             - " << std::endl;
+		std::cout << " -                 stop matching (cheapest visual words first), halve top_rank_k and top_rank_k1 and limit the pose hypotheses       - " << std::endl;
+		std::cout << " -  --budget_report file: Write \"query name latency_ms flags\" per query, flags is 0 for complete results (1 keypoints capped, 2      - " << std::endl;
+		std::cout << " -                        matching stopped, 4 top images reduced, 8 pose hypotheses limited)                                         - " << std::endl;
+		std::cout << " -  --prioritized n: Match the features in the order of the lengths of their inverted lists and stop once n correspondences          - " << std::endl;
+		std::cout << " -                   pass the ratio test of the voting (default 0: match all features, cannot be combined with --shards)             - " << std::endl;
+		std::cout << " -  --tracking n: Track the frames of a session (optional 9th column of argv[1]): a frame is matched against the points of the       - " << std::endl;
+		std::cout << " -                top images of the previous frame of its session and their covisible neighbors, and against the whole model if      - " << std::endl;
+		std::cout << " -                fewer than n correspondences pass the ratio test (default 0: off, not with --tiled_model or --shards)              - " << std::endl;
+		std::cout << " -  --covisibility file: The covisibility graph of the cameras written by build_localization_model (model.covisibility). Without     - " << std::endl;
+		std::cout << " -                       it, the graph is built at startup if --tracking or --covisible_expansion need it (not with --tiled_model)   - " << std::endl;
+		std::cout << " -  --covisible_expansion n: Add the matches of the n strongest covisible neighbors (with votes) of every top_rank_k1 image to the   - " << std::endl;
+		std::cout << " -                           visibility-wise match pool (default 0: off)                                                             - " << std::endl;
+		std::cout << " -  --places n: Cluster the cameras into places along the covisibility graph, vote for the places of the matched points first and    - " << std::endl;
+		std::cout << " -              only for the cameras of the n top ranked places (default 0: camera-level voting only, not with --tiled_model)        - " << std::endl;
+		std::cout << " -  --place_size m: The maximal number of cameras per place (default 20)                                                             - " << std::endl;
+		std::cout << " -  --place_benchmark 0|1: With --places, also run camera-level voting on every query (its votes are discarded) and                  - " << std::endl;
+		std::cout << " -                         report its time next to the time of the hierarchical voting (default 0)                                   - " << std::endl;
+		std::cout << " -  --visibility views|compressed: Vote through the camera lists of the points (default) or through compressed camera sets,          - " << std::endl;
+		std::cout << " -                                 which replace the lists unless --consistency_filter needs them (not with --tiled_model)           - " << std::endl;
 		std::cout << "______________________________________________________________________________________________________________________________________" << std::endl;
 		return -1;
 	}
@@ -88,11 +196,204 @@ int main (int argc, char **argv)
 	std::string cluster_file( argv[3] );
 	std::string hamming_results( argv[4] );
 	int nb_branching = atoi( argv[5] );
-	parse_bundler parser;
+
+	// optional parameters, given as pairs "--name value" after the required ones
+	std::string vocabulary_index_file( "" );
+	std::string georegistration_file( "" );
+	double gps_radius = 300.0;
+	double gps_tile_size = 300.0;
+	std::string tiled_model_file( "" );
+	double tile_memory_budget = 1024.0;
+	std::string shard_prefix( "" );
+	int nb_shards = 1;
+	std::string multi_index_min_codes( "" );
+	std::string stop_word_cap( "" );
+	std::string poses_file( "" );
+	double pose_threshold = 10.0;
+	std::string pose_focal( "known" );
+	std::string pose_sampling( "prosac" );
+	uint32_t nb_consistency_bins = 0;
+	double deadline_ms = 0.0;
+	std::string budget_report_file( "" );
+	uint32_t min_qualified_corrs = 0;
+	uint32_t min_tracking_corrs = 0;
+	std::string covisibility_file( "" );
+	uint32_t nb_covisible_expansion = 0;
+	uint32_t nb_top_places = 0;
+	uint32_t max_place_size = 20;
+	bool benchmark_places = false;
+	std::string visibility_mode( "views" );
+	for ( int i = 15; i < argc; i += 2 )
+	{
+		std::string option( argv[i] );
+		if ( i + 1 >= argc )
+		{
+			std::cerr << " ERROR: No value given for " << option << std::endl;
+			return -1;
+		}
+		if ( option == "--vocabulary_index" )
+			vocabulary_index_file = argv[i + 1];
+		else if ( option == "--georegistration" )
+			georegistration_file = argv[i + 1];
+		else if ( option == "--gps_radius" )
+			gps_radius = atof( argv[i + 1] );
+		else if ( option == "--gps_tile_size" )
+			gps_tile_size = atof( argv[i + 1] );
+		else if ( option == "--tiled_model" )
+			tiled_model_file = argv[i + 1];
+		else if ( option == "--tile_memory_budget" )
+			tile_memory_budget = atof( argv[i + 1] );
+		else if ( option == "--shards" )
+			shard_prefix = argv[i + 1];
+		else if ( option == "--nb_shards" )
+			nb_shards = atoi( argv[i + 1] );
+		else if ( option == "--multi_index" )
+			multi_index_min_codes = argv[i + 1];
+		else if ( option == "--stop_words" )
+			stop_word_cap = argv[i + 1];
+		else if ( option == "--poses" )
+			poses_file = argv[i + 1];
+		else if ( option == "--pose_threshold" )
+			pose_threshold = atof( argv[i + 1] );
+		else if ( option == "--pose_focal" )
+			pose_focal = argv[i + 1];
+		else if ( option == "--pose_sampling" )
+			pose_sampling = argv[i + 1];
+		else if ( option == "--consistency_filter" )
+			nb_consistency_bins = (uint32_t) atoi( argv[i + 1] );
+		else if ( option == "--deadline" )
+			deadline_ms = atof( argv[i + 1] );
+		else if ( option == "--budget_report" )
+			budget_report_file = argv[i + 1];
+		else if ( option == "--prioritized" )
+			min_qualified_corrs = (uint32_t) atoi( argv[i + 1] );
+		else if ( option == "--tracking" )
+			min_tracking_corrs = (uint32_t) atoi( argv[i + 1] );
+		else if ( option == "--covisibility" )
+			covisibility_file = argv[i + 1];
+		else if ( option == "--covisible_expansion" )
+			nb_covisible_expansion = (uint32_t) atoi( argv[i + 1] );
+		else if ( option == "--places" )
+			nb_top_places = (uint32_t) atoi( argv[i + 1] );
+		else if ( option == "--place_size" )
+			max_place_size = (uint32_t) atoi( argv[i + 1] );
+		else if ( option == "--place_benchmark" )
+			benchmark_places = ( atoi( argv[i + 1] ) != 0 );
+		else if ( option == "--visibility" )
+			visibility_mode = argv[i + 1];
+		else
+		{
+			std::cerr << " ERROR: Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	// in tiled mode, the points and the inverted lists are loaded per query
+	tiled_model tiles;
+	bool use_tiled_model = !tiled_model_file.empty();
+	if ( use_tiled_model )
+	{
+		if ( georegistration_file.empty() )
+		{
+			std::cerr << " ERROR: --tiled_model requires --georegistration" << std::endl;
+			return -1;
+		}
+		tiles.set_memory_budget( uint64_t( tile_memory_budget * 1024.0 * 1024.0 ) );
+		if ( !tiles.open( tiled_model_file ) )
+			return -1;
+		if ( tiles.get_nb_clusters() != nb_clusters )
+		{
+			std::cerr << " ERROR: The tiled model uses " << tiles.get_nb_clusters() << " visual words" << std::endl;
+			return -1;
+		}
+	}
+
+	if ( !stop_word_cap.empty() && ( use_tiled_model || !shard_prefix.empty() ) )
+	{
+		std::cerr << " ERROR: --stop_words cannot be combined with --tiled_model or --shards" << std::endl;
+		return -1;
+	}
+
+	// the shards scan the lists after all features were assigned
+	if ( min_qualified_corrs > 0 && !shard_prefix.empty() )
+	{
+		std::cerr << " ERROR: --prioritized cannot be combined with --shards" << std::endl;
+		return -1;
+	}
+
+	// tracking restricts the inverted file of the whole model
+	if ( min_tracking_corrs > 0 && ( use_tiled_model || !shard_prefix.empty() ) )
+	{
+		std::cerr << " ERROR: --tracking cannot be combined with --tiled_model or --shards" << std::endl;
+		return -1;
+	}
+
+	// the tiles do not store the visibility lists of the whole model
+	if ( nb_covisible_expansion > 0 && use_tiled_model && covisibility_file.empty() )
+	{
+		std::cerr << " ERROR: --covisible_expansion with --tiled_model requires --covisibility" << std::endl;
+		return -1;
+	}
+
+	// the places are built from the points seen by every camera
+	if ( nb_top_places > 0 && use_tiled_model )
+	{
+		std::cerr << " ERROR: --places cannot be combined with --tiled_model" << std::endl;
+		return -1;
+	}
+
+	if ( visibility_mode != "views" && visibility_mode != "compressed" )
+	{
+		std::cerr << " ERROR: Unknown visibility mode " << visibility_mode << ", use views or compressed" << std::endl;
+		return -1;
+	}
+	// in tiled mode, the visibility lists are loaded per query
+	if ( visibility_mode == "compressed" && use_tiled_model )
+	{
+		std::cerr << " ERROR: --visibility compressed cannot be combined with --tiled_model" << std::endl;
+		return -1;
+	}
+
+	// the tiles do not store the scales and orientations of the views
+	if ( nb_consistency_bins > 0 && use_tiled_model )
+	{
+		std::cerr << " ERROR: --consistency_filter cannot be combined with --tiled_model" << std::endl;
+		return -1;
+	}
+
+	// in sharded mode, the inverted lists and the signatures are held by other processes
+	vw_shard_coordinator shards;
+	bool use_shards = !shard_prefix.empty();
+	if ( use_shards )
+	{
+		if ( use_tiled_model || !georegistration_file.empty() )
+		{
+			std::cerr << " ERROR: --shards cannot be combined with --tiled_model or --georegistration" << std::endl;
+			return -1;
+		}
+		if ( nb_shards <= 0 || !shards.connect( shard_prefix, (uint32_t) nb_shards ) )
+			return -1;
+		if ( shards.get_nb_clusters() != nb_clusters )
+		{
+			std::cerr << " ERROR: The shards use " << shards.get_nb_clusters() << " visual words" << std::endl;
+			return -1;
+		}
+		shards.print_statistics();
+	}
+
+	// the positions of the points and the cameras seeing them, in tiled mode the points of the tiles of the current query
+	localization_model model;
+	std::vector< bundler_camera > camera_infos;
 	std::string bundle_file( argv[6] );
 	//Read the data from file in .info format. Note that we exclude loading the original SIFT/RootSIFT descriptors
-	//Instead, we use the binary descriptors in hamming_results(arg[4])
-	parser.load_from_binary_nokey( bundle_file.c_str(), 1 );
+	//Instead, we use the binary descriptors in hamming_results(arg[4]). The scales and orientations of the views
+	//are only needed by the consistency filter
+	if ( !use_tiled_model )
+	{
+		if ( !model.load( bundle_file, camera_infos, nb_consistency_bins > 0 ) )
+			return -1;
+		model.print_statistics();
+	}
 	size_t hamming_dist_threshold = (size_t) atoi( argv[7] );
 	int valid_corrs_threshold =  atoi( argv[8] );
 	int top_rank_k = atoi( argv[9] );
@@ -106,10 +407,76 @@ int main (int argc, char **argv)
 	std::string pos_3d( argv[14] );
 	// create and open the output file
 	std::ofstream ofs_3d( pos_3d.c_str(), std::ios::out );
-	uint32_t nb_cameras = parser.get_number_of_cameras();
-	uint32_t nb_points_bundler = parser.get_number_of_points();
-	std::vector< feature_3D_info >& feature_infos = parser.get_feature_infos();
-	std::vector< bundler_camera >& camera_infos = parser.get_cameras();
+	// the poses estimated in-process
+	bool estimate_poses = !poses_file.empty();
+	bool pose_unknown_focal = ( pose_focal == "unknown" );
+	bool pose_progressive = ( pose_sampling != "uniform" );
+	std::ofstream ofs_poses;
+	if ( estimate_poses )
+	{
+		ofs_poses.open( poses_file.c_str(), std::ios::out );
+		if ( !ofs_poses.is_open() )
+		{
+			std::cerr << " ERROR: Cannot write the poses to " << poses_file << std::endl;
+			return -1;
+		}
+	}
+	pose_estimator pose_solver;
+	pose_solver.set_progressive_sampling( pose_progressive );
+	pose_solver.set_uniform_measurement( pose_sampling == "benchmark" );
+	// a query is considered localized if its auxiliary pose has at least this many inliers
+	const size_t min_pose_inliers = 12;
+	std::vector< Eigen::Vector2d > pose_image_points;
+	std::vector< Eigen::Vector3d > pose_points;
+	std::vector< uint32_t > pose_inliers;
+	std::vector< std::pair< double, int > > pose_order;
+	// the scale and orientation pre-filter of the visibility-wise pool
+	bool use_consistency_filter = ( nb_consistency_bins > 0 );
+	consistency_filter consistency;
+	consistency.set_bins( nb_consistency_bins, 1.0 );
+	std::vector< bool > consistent_matches;
+	std::vector< int > inconsistent_ids;
+
+	// the anytime mode: the shares of the deadline after which matching stops, the top images are reduced and
+	// the pose hypotheses are limited. At least min_budget_keypoints features are matched.
+	query_budget budget;
+	budget.set_deadline( 0.001 * deadline_ms );
+	const double budget_matching_share = 0.5, budget_selection_share = 0.7, budget_pose_share = 0.8;
+	const uint32_t min_budget_keypoints = 100, max_budget_pose_iterations = 1000;
+	// the time per keypoint of the visual word assignment and the matching, learned from the previous queries
+	double avrg_keypoint_time = 0.0;
+	std::vector< uint32_t > keypoint_order;
+	std::vector< std::pair< float, uint32_t > > keypoint_keys;
+	std::vector< double > query_latencies;
+	double nb_degraded = 0.0;
+	// prioritized search: the features are matched in the order of their list lengths until enough correspondences are qualified
+	bool use_prioritized_search = ( min_qualified_corrs > 0 );
+	double avrg_matched_feature_ratio = 0.0, avrg_prioritized_scanned_ratio = 0.0;
+	std::ofstream ofs_budget;
+	if ( !budget_report_file.empty() )
+	{
+		ofs_budget.open( budget_report_file.c_str(), std::ios::out );
+		if ( !ofs_budget.is_open() )
+		{
+			std::cerr << " ERROR: Cannot write the budget report to " << budget_report_file << std::endl;
+			return -1;
+		}
+	}
+	uint32_t nb_cameras = use_tiled_model ? tiles.get_nb_cameras() : (uint32_t) camera_infos.size();
+	uint32_t nb_points_bundler = use_tiled_model ? tiles.get_nb_points() : model.get_nb_points();
+	if ( use_tiled_model )
+		camera_infos.resize( nb_cameras );
+	// the distances of the query features matched to every point
+	query_point_matches point_matches;
+	point_matches.resize( model.get_nb_points() );
+	// the prioritized search and the tracking stop once enough correspondences pass the ratio test of the voting
+	if ( min_qualified_corrs > 0 || min_tracking_corrs > 0 )
+		point_matches.set_ratio_test( ratio_test_threshold );
+
+	// the number of points seen by every camera, used to normalize the votes
+	std::vector< uint32_t > camera_point_counts( nb_cameras, 0 );
+	for ( uint32_t j = 0; j < nb_cameras; ++j )
+		camera_point_counts[j] = use_tiled_model ? tiles.get_camera_point_counts()[j] : model.get_nb_camera_points( j );
 	visual_words_handler vw_handler;
 	vw_handler.set_nb_trees( 1 );
 	vw_handler.set_nb_visual_words( nb_clusters );
@@ -117,7 +484,8 @@ int main (int argc, char **argv)
 
 	vw_handler.set_method(std::string("flann"));
 	vw_handler.set_flann_type(std::string("hkmeans"));
-	if ( !vw_handler.create_flann_search_index( cluster_file ) )
+	bool vocabulary_loaded = vocabulary_index_file.empty() ? vw_handler.create_flann_search_index( cluster_file ) : vw_handler.load_trees_flann( cluster_file, vocabulary_index_file );
+	if ( !vocabulary_loaded )
 	{
 		std::cout << " ERROR: Could not load the cluster centers from " << cluster_file << std::endl;;
 		return -1;
@@ -127,82 +495,301 @@ int main (int argc, char **argv)
 	// load the assignments for the visual words and binary descriptors.
 
 	std::cout << "* Loading and parsing the assignments ... " << std::endl;
-	std::vector < std::bitset<64> > all_binary_descriptors;
-	// store the 3D positions of the 3D points
+	// the binary signatures of the mapped tiles of a tiled model
+	std::vector< signature_t > all_binary_descriptors;
 
-	// for every visual word, store a vector of (3D point id, descriptor id) pairs, where the 3D point id
-	// is the index of the 3D point in points3D and the descriptor id is the position of the first entry of the corresponding
-	// descriptor in all_descriptors / all_descriptors_float
-	std::vector< std::vector< std::pair< uint32_t, uint32_t > > > vw_points_descriptors(nb_clusters);
+	// for every visual word, the 3D point ids (index of the 3D point in points3D) of its entries and
+	// the binary signatures of the corresponding descriptors, compressed into a single array
+	basic_inverted_file< nb_bits > inverted_lists;
 
-	// store per visual word the number of (point, descriptor) pairs store in it
-	std::vector< uint32_t > nb_points_per_vw(nb_clusters, 0);
+	// the costs and stop word flags of the visual words, stored at the end of the hamming file
+	stop_words words;
+	bool use_stop_words = !stop_word_cap.empty();
+	size_t max_stop_word_hits = ( stop_word_cap == "skip" ) ? 0 : (size_t) atoi( stop_word_cap.c_str() );
 
 	// number of non-empty visual words, the number of 3D points and the total number of descriptors
 	uint32_t nb_non_empty_vw, nb_3D_points, nb_descriptors;
 
-	for ( uint32_t i = 0; i < nb_clusters; ++i )
-		vw_points_descriptors[i].clear();
+	//read the he thresholds
+	Eigen::Matrix<float, nb_bits, Eigen::Dynamic> he_thresholds;
+	Eigen::Matrix<float, nb_bits, 128, Eigen::RowMajor> projection_matrix;
 
-	// load the assignments from a file generated by compute_desc_assignments
-	std::ifstream ifs( hamming_results.c_str(), std::ios::in  );
-	std::cout << "read file from " << hamming_results << std::endl;
+	if ( use_tiled_model )
+	{
+		// the thresholds and the projection matrix are stored in the index, everything else in the tiles
+		nb_3D_points = tiles.get_nb_points();
+		nb_descriptors = tiles.get_nb_descriptors();
+		he_thresholds = Eigen::Map< const Eigen::Matrix<float, nb_bits, Eigen::Dynamic> >( &tiles.get_thresholds()[0], nb_bits, nb_clusters );
+		projection_matrix = Eigen::Map< const Eigen::Matrix<float, nb_bits, 128, Eigen::RowMajor> >( &tiles.get_projection()[0] );
+		std::cout << "  loaded the index of " << tiles.get_tiles().size() << " tiles from " << tiled_model_file << std::endl;
+	}
+	else if ( use_shards )
+	{
+		// the thresholds and the projection matrix are provided by the shards
+		nb_3D_points = shards.get_nb_points();
+		nb_descriptors = shards.get_nb_descriptors();
+		he_thresholds = Eigen::Map< const Eigen::Matrix<float, nb_bits, Eigen::Dynamic> >( &shards.get_thresholds()[0], nb_bits, nb_clusters );
+		projection_matrix = Eigen::Map< const Eigen::Matrix<float, nb_bits, 128, Eigen::RowMajor> >( &shards.get_projection()[0] );
+		std::cout << "  connected to " << nb_shards << " shards at " << shard_prefix << std::endl;
+	}
+	else
+	{
+		// load the assignments from a file generated by compute_desc_assignments
+		std::ifstream ifs( hamming_results.c_str(), std::ios::in  );
+		std::cout << "read file from " << hamming_results << std::endl;
+
+		// files in visual word order store the signatures with the entries of the words
+		bool word_order = hamming_embedding::read_word_order_keyword( ifs );
+
+		uint32_t nb_clusts;
+		ifs >> nb_3D_points >> nb_clusts >> nb_non_empty_vw >> nb_descriptors;
+		std::cout << " num of descriptors " << nb_descriptors << std::endl;
+
+		int num_words; int num_dimensions; int num_bits;
+		ifs >> num_words >> num_dimensions >> num_bits;
+		//read the hamming thresholds of visual words.
+		he_thresholds.resize(num_bits, num_words);
+		for (int i = 0; i < num_words; ++i) {
+			for (int j = 0; j < num_bits; ++j) {
+				ifs >> he_thresholds(j, i);
+			}
+		}
+		//read projection matrix
+		for (int i = 0; i < num_bits; ++i) {
+			for (int j = 0; j < num_dimensions; ++j) {
+				ifs >> projection_matrix(i, j);
+			}
+		}
 
-	uint32_t nb_clusts;
-	ifs >> nb_3D_points >> nb_clusts >> nb_non_empty_vw >> nb_descriptors;
-	std::cout << " num of descriptors " << nb_descriptors << std::endl;
+		//read the binary descriptors, they are copied into the inverted file
+		std::vector< signature_t > binary_descriptors( word_order ? 0 : nb_descriptors );
+		for (int i = 0; i < binary_descriptors.size(); ++i) {
+			ifs >> binary_descriptors[i];
+		}
 
-	//read the he thresholds
-	Eigen::Matrix<float, 64, Eigen::Dynamic> he_thresholds;
-	Eigen::Matrix<float, 64, 128, Eigen::RowMajor> projection_matrix;
+		// the entries appended by update_localization_model are added to the lists of their words
+		basic_hamming_delta< nb_bits > delta;
+		if ( !delta.load( hamming_results, nb_clusters, nb_3D_points ) )
+			return -1;
+		if ( !delta.empty() )
+		{
+			binary_descriptors.reserve( binary_descriptors.size() + delta.get_nb_entries() );
+			std::cout << "  merging " << delta.get_nb_entries() << " entries of " << delta.get_nb_points() - nb_3D_points << " new points from "
+			          << basic_hamming_delta< nb_bits >::get_filename( hamming_results ) << std::endl;
+		}
 
-	int num_words; int num_dimensions; int num_bits;
-	ifs >> num_words >> num_dimensions >> num_bits;
-	//read the hamming thresholds of visual words.
-	he_thresholds.resize(num_bits, num_words);
-	for (int i = 0; i < num_words; ++i) {
-		for (int j = 0; j < num_bits; ++j) {
-			ifs >> he_thresholds(j, i);
+		//read assignments, the lists are stored in increasing order of the visual words
+		int nb_small_clusters = 0;
+		int empty_clusters = 0;
+		inverted_lists.init( nb_clusters );
+		std::vector< std::pair< uint32_t, uint32_t > > list;
+		for (int i = 0; i < nb_clusters; ++i) {
+			int id; int nb_pairs;
+			ifs >> id >> nb_pairs;
+			list.resize( nb_pairs );
+			if (nb_pairs <= 5)
+				nb_small_clusters++;
+			if (nb_pairs == 0)
+				empty_clusters++;
+			if ( word_order )
+			{
+				// the signatures of the word are read into binary_descriptors, the descriptor id is the position in the word
+				binary_descriptors.resize( nb_pairs );
+				for (int j = 0; j < nb_pairs ; ++j)
+				{
+					ifs >> list[j].first >> binary_descriptors[j];
+					list[j].second = j;
+				}
+			}
+			else
+			{
+				for (int j = 0; j < nb_pairs ; ++j)
+				{
+					ifs >> list[j].first >> list[j].second;
+				}
+			}
+			if ( id >= 0 && (uint32_t) id < nb_clusters )
+			{
+				const uint32_t *delta_points = delta.get_points( id );
+				const signature_t *delta_signatures = delta.get_signatures( id );
+				for ( uint32_t j = 0; j < delta.get_nb_entries( id ); ++j )
+				{
+					list.push_back( std::make_pair( delta_points[j], (uint32_t) binary_descriptors.size() ) );
+					binary_descriptors.push_back( delta_signatures[j] );
+				}
+			}
+			if ( !inverted_lists.add_list( id, list, binary_descriptors ) )
+				return -1;
 		}
-	}
-	//read projection matrix
-	for (int i = 0; i < num_bits; ++i) {
-		for (int j = 0; j < num_dimensions; ++j) {
-			ifs >> projection_matrix(i, j);
+		if ( !words.load( ifs, nb_clusters ) )
+			return -1;
+		ifs.close();
+		inverted_lists.finalize();
+		if ( !delta.empty() )
+		{
+			nb_3D_points = delta.get_nb_points();
+			nb_descriptors += delta.get_nb_entries();
+			// the stop word section of the file does not cover the appended entries
+			if ( !words.empty() )
+			{
+				std::vector< uint32_t > costs( nb_clusters ), nb_codes( nb_clusters );
+				for ( uint32_t i = 0; i < nb_clusters; ++i )
+				{
+					costs[i] = inverted_lists.get_nb_entries( i );
+					nb_codes[i] = inverted_lists.get_nb_codes( i );
+				}
+				words.analyze_counts( costs, nb_codes, words.get_percentile(), words.get_burst_ratio() );
+			}
+		}
+		std::vector< signature_t >().swap( binary_descriptors );
+		std::cout << "  done loading assignments, small clusters " << nb_small_clusters
+		          << " empty clusters " << empty_clusters  << std::endl;
+		inverted_lists.print_memory_statistics( nb_descriptors );
+		if ( use_stop_words )
+		{
+			if ( words.empty() )
+			{
+				std::cerr << " ERROR: --stop_words requires a hamming file with stop word flags, compute it again with compute_hamming_threshold" << std::endl;
+				return -1;
+			}
+			std::cout << "  " << words.get_nb_stop_words() << " stop words with " << words.get_nb_stop_entries() << " entries, keeping at most "
+			          << max_stop_word_hits << " correspondences per feature" << std::endl;
 		}
-	}
 
-	//read the binary descriptors as uint_64
-	all_binary_descriptors.resize(nb_descriptors);
-	for (int i = 0; i < nb_descriptors; ++i) {
-		uint64_t tmp_desc;
-		ifs >> tmp_desc;
-		all_binary_descriptors[i] = std::bitset<64>(tmp_desc);
+		// index the largest visual words for a sub-linear search of the signatures within the threshold
+		if ( !multi_index_min_codes.empty() )
+		{
+			Timer index_timer;
+			index_timer.Init();
+			index_timer.Start();
+			uint32_t min_codes = 0;
+			if ( multi_index_min_codes == "auto" )
+				min_codes = inverted_lists.calibrate_multi_index( (uint32_t) hamming_dist_threshold );
+			else
+			{
+				min_codes = (uint32_t) atoi( multi_index_min_codes.c_str() );
+				inverted_lists.build_multi_index( (uint32_t) hamming_dist_threshold, min_codes );
+			}
+			index_timer.Stop();
+			if ( inverted_lists.get_nb_indexed_words() > 0 )
+				std::cout << "  multi-index for the " << inverted_lists.get_nb_indexed_words() << " visual words with at least " << min_codes << " codes: "
+				          << inverted_lists.get_multi_index_memory() / ( 1024.0 * 1024.0 ) << " MB, built in " << index_timer.GetElapsedTime() << "s" << std::endl;
+		}
 	}
 
-	//read assignments;
-	int nb_small_clusters = 0;
-	int empty_clusters = 0;
-	for (int i = 0; i < nb_clusters; ++i) {
-		int id; int nb_pairs;
-		ifs >> id >> nb_pairs;
-		vw_points_descriptors[id].resize( nb_pairs );
-		nb_points_per_vw[id] = nb_pairs;
-		if (nb_pairs <= 5)
-			nb_small_clusters++;
-		if (nb_pairs == 0)
-			empty_clusters++;
-		int pt_id; int desc_id;
-		for (int j = 0; j < nb_pairs ; ++j)
-		{
-			ifs >> pt_id >> desc_id;
-			vw_points_descriptors[id][j].first = pt_id;
-			vw_points_descriptors[id][j].second = desc_id;
+	// the points seen by every camera, only needed to restrict the search by GPS position or by tracking
+	if ( !use_tiled_model && ( !georegistration_file.empty() || min_tracking_corrs > 0 ) )
+		model.index_camera_points();
+	// index the cameras and the inverted lists by location for queries with GPS information
+	geo_prior prior;
+	bool use_geo_prior = !georegistration_file.empty();
+	if ( use_geo_prior )
+	{
+		if ( !prior.load_georegistration( georegistration_file ) )
+			return -1;
+		// in a tiled model, the points are already sorted into tiles
+		if ( !use_tiled_model )
+		{
+			prior.index_cameras( camera_infos, model, gps_tile_size );
+			prior.index_inverted_lists( inverted_lists, nb_points_bundler );
 		}
 	}
-	ifs.close();
-	std::cout << "  done loading assignments, small clusters " << nb_small_clusters
-	          << " empty clusters " << empty_clusters  << std::endl;
+	// the covisibility graph of the cameras, for tracking and for the expansion of the top ranked images
+	covisibility_graph covisibility;
+	bool use_tracking = ( min_tracking_corrs > 0 );
+	if ( !covisibility_file.empty() )
+	{
+		if ( !covisibility.load( covisibility_file ) )
+			return -1;
+		if ( covisibility.get_nb_cameras() != nb_cameras )
+		{
+			std::cerr << " ERROR: The covisibility graph has " << covisibility.get_nb_cameras() << " cameras instead of " << nb_cameras
+			          << ", build it again with build_localization_model" << std::endl;
+			return -1;
+		}
+		covisibility.print_statistics();
+	}
+	else if ( use_tracking || nb_covisible_expansion > 0 || nb_top_places > 0 )
+	{
+		Timer covisibility_timer;
+		covisibility_timer.Init();
+		covisibility_timer.Start();
+		covisibility.build( model, nb_cameras, covisibility_graph::default_min_shared_points, covisibility_graph::default_max_neighbors );
+		covisibility_timer.Stop();
+		std::cout << " built the covisibility graph in " << covisibility_timer.GetElapsedTime() << "s" << std::endl;
+		covisibility.print_statistics();
+	}
+	// the top_rank_k1 images and their covisible neighbors, and the images already added to them
+	std::vector< uint32_t > k1_cameras;
+	std::vector< bool > k1_camera_added( nb_cameras, false );
+	double avrg_expanded_cameras = 0.0;
+
+	// index the entries of the points for tracking sessions
+	sequence_tracker tracker;
+	const uint32_t max_tracking_neighbors = 10;
+	if ( use_tracking )
+		tracker.index( model, nb_cameras, covisibility, inverted_lists, max_tracking_neighbors );
+
+	// the places of the cameras for the hierarchical voting
+	place_index places;
+	bool use_places = ( nb_top_places > 0 );
+	std::vector< double > place_scores;
+	std::vector< uint32_t > voted_places, top_places;
+	std::vector< std::pair< double, uint32_t > > place_rank;
+	double avrg_place_votes = 0.0, avrg_camera_votes = 0.0, avrg_full_camera_votes = 0.0;
+	// the time of casting the votes, and of camera-level voting on the same matches with --place_benchmark
+	double avrg_vote_time = 0.0, avrg_camera_level_vote_time = 0.0;
+	std::vector< std::vector< int > > camera_level_votes;
+	if ( use_places && benchmark_places )
+		camera_level_votes.resize( nb_cameras );
+	if ( use_places )
+	{
+		Timer place_timer;
+		place_timer.Init();
+		place_timer.Start();
+		places.build( model, nb_cameras, covisibility, std::max( max_place_size, (uint32_t) 1 ) );
+		place_timer.Stop();
+		std::cout << " clustered the cameras into places in " << place_timer.GetElapsedTime() << "s, " << (double) model.get_nb_views() / (double) std::max( nb_points_bundler, (uint32_t) 1 )
+		          << " cameras per point" << std::endl;
+		places.print_statistics();
+		place_scores.assign( places.get_nb_places(), 0.0 );
+	}
+
+	// the cameras seeing every point as compressed sets, the cameras of the model are released unless the
+	// consistency filter needs them to find the scales and orientations of the views (the graph and the places are built above)
+	visibility_index visibility;
+	bool use_visibility_index = ( visibility_mode == "compressed" );
+	std::vector< uint32_t > point_cameras;
+	if ( use_visibility_index )
+	{
+		Timer visibility_timer;
+		visibility_timer.Init();
+		visibility_timer.Start();
+		visibility.build( model );
+		visibility_timer.Stop();
+		std::cout << " compressed the visibility of the points in " << visibility_timer.GetElapsedTime() << "s" << std::endl;
+		visibility.print_statistics();
+		if ( !use_consistency_filter )
+			model.release_cameras();
+	}
+	double nb_tracked_queries = 0.0, nb_tracking_fallbacks = 0.0;
+	double avrg_tracked_latency = 0.0, avrg_untracked_latency = 0.0;
+	std::vector< uint32_t > tracked_cameras;
+	// the inverted list entries of the current keypoint within the GPS radius
+	std::vector< std::pair< uint32_t, uint32_t > > geo_entries;
+	// the (3D point id, hamming distance) pairs of the current keypoint within the hamming threshold
+	std::vector< std::pair< uint32_t, uint32_t > > list_hits;
+	double nb_geo_queries = 0.0;
+
+	// the tiles mapped for the current query and the offsets of their points and descriptors
+	std::vector< uint32_t > query_tiles;
+	std::vector< const tile_segment* > query_segments;
+	std::vector< uint32_t > segment_point_base;
+	std::vector< uint32_t > segment_desc_base;
+
+	// the signatures of the keypoints of the current query and the hits returned by the shards
+	std::vector< shard_query > shard_queries;
+	std::vector< shard_hit > shard_hits;
 
 
 	// now load all the filenames of the query images
@@ -215,6 +802,8 @@ int main (int argc, char **argv)
 	std::vector< float > cx;
 	std::vector< float > cy;
 	std::vector< float > radial;
+	// the optional session ids of the queries, for tracking
+	std::vector< std::string > sessions;
 	key_filenames.clear();
 	input_width.clear();
 	input_height.clear();
@@ -224,14 +813,19 @@ int main (int argc, char **argv)
 	std::ifstream ifs_key( keylist.c_str(), std::ios::in );
 	std::string tmp_string;
 	std::string tmp_string2;
+	std::string tmp_session;
+	std::string query_line;
 	float tmp_width, tmp_height, tmp_focal, tmp_cx, tmp_cy, tmp_radial;
 
-	while ( !ifs_key.eof() )
+	// one query per line, the session id is optional
+	while ( std::getline( ifs_key, query_line ) )
 	{
+		std::istringstream query_stream( query_line );
 		tmp_string = "";
 		tmp_string2 = " ";
-		ifs_key >> tmp_string >> tmp_string2 >> tmp_width >> tmp_height >> tmp_focal
-		        >> tmp_cx >> tmp_cy >> tmp_radial;
+		tmp_session = "";
+		query_stream >> tmp_string >> tmp_string2 >> tmp_width >> tmp_height >> tmp_focal
+		             >> tmp_cx >> tmp_cy >> tmp_radial >> tmp_session;
 		if ( !tmp_string.empty() )
 		{
 			key_filenames.push_back(tmp_string);
@@ -241,6 +835,7 @@ int main (int argc, char **argv)
 			cx.push_back(tmp_cx);
 			cy.push_back(tmp_cy);
 			radial.push_back(tmp_radial);
+			sessions.push_back(tmp_session);
 		}
 
 	}
@@ -261,6 +856,12 @@ int main (int argc, char **argv)
 	double avrg_final_pick_time = 0.0;
 	double avrg_voting_time = 0.0;
 	double avrg_vw_time = 0.0;
+	double avrg_scanned_ratio = 0.0;
+	double total_skipped_features = 0.0, total_avoided_entries = 0.0, total_capped_hits = 0.0;
+	double avrg_pose_time = 0.0, avrg_pose_solver_time = 0.0, avrg_pose_p4pf_time = 0.0, avrg_pose_optimization_time = 0.0;
+	double avrg_pose_hypotheses = 0.0, avrg_pose_uniform_hypotheses = 0.0, avrg_pose_uniform_time = 0.0;
+	double avrg_consistency_time = 0.0, avrg_pruning_rate = 0.0;
+	double nb_localized = 0.0;
 	std::vector< std::pair< uint32_t, uint32_t > > corrs;
 	std::vector< std::pair< double, uint32_t > > corrs_score;
 	std::vector< std::pair< double, uint32_t > > corrs_ratio_test;
@@ -273,6 +874,7 @@ int main (int argc, char **argv)
 		desc_dist.clear();
 		corrs_score.clear();
 		corrs_ratio_test.clear();
+		budget.start();
 		// load the features
 		SIFT_loader key_loader;
 		key_loader.load_features( key_filenames[i].c_str(), LOWE );
@@ -290,6 +892,13 @@ int main (int argc, char **argv)
 		exif_reader::open_exif( jpg_filename.c_str() );
 		img_width = exif_reader::get_image_width();
 		img_height = exif_reader::get_image_height();
+		bool query_has_gps = exif_reader::is_gps_data_present();
+		double query_latitude = 0.0, query_longitude = 0.0;
+		if ( query_has_gps )
+		{
+			query_latitude = exif_reader::get_gps_latitude();
+			query_longitude = exif_reader::get_gps_longitude();
+		}
 		exif_reader::close_exif();
 
 		double max_width = 0; double max_height = 0;
@@ -318,12 +927,100 @@ int main (int argc, char **argv)
 			continue;
 		}
 
+		// map the tiles around the GPS position of the query, their points and signatures are appended
+		// to model and all_binary_descriptors
+		if ( use_tiled_model )
+		{
+			query_tiles.clear();
+			if ( query_has_gps )
+			{
+				double east, north;
+				prior.gps_to_local( query_latitude, query_longitude, east, north );
+				tiles.select_tiles( east, north, gps_radius, query_tiles );
+			}
+			if ( query_tiles.empty() )
+			{
+				std::cout << "query image " << i << " has no GPS position or no tiles within " << gps_radius << "m, skipping it" << std::endl;
+				for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
+				{
+					if ( descriptors[j] != 0 )
+						delete [] descriptors[j];
+					descriptors[j] = 0;
+				}
+				descriptors.clear();
+				keypoints.clear();
+				continue;
+			}
+
+			tiles.begin_query();
+			model.clear();
+			all_binary_descriptors.clear();
+			query_segments.clear();
+			segment_point_base.clear();
+			segment_desc_base.clear();
+			for ( size_t t = 0; t < query_tiles.size(); ++t )
+			{
+				const tile_segment *segment = tiles.acquire( query_tiles[t] );
+				if ( segment == 0 )
+					continue;
+				query_segments.push_back( segment );
+				segment_point_base.push_back( model.get_nb_points() );
+				segment_desc_base.push_back( (uint32_t) all_binary_descriptors.size() );
+
+				const float *positions = segment->get_positions();
+				const uint32_t *view_offsets = segment->get_view_offsets();
+				const uint32_t *view_cameras = segment->get_view_cameras();
+				for ( uint32_t k = 0; k < segment->get_nb_points(); ++k )
+					model.add_point( positions[3 * k], positions[3 * k + 1], positions[3 * k + 2], view_cameras + view_offsets[k], view_offsets[k + 1] - view_offsets[k] );
+
+				const uint64_t *signatures = segment->get_signatures();
+				for ( uint32_t k = 0; k < segment->get_nb_descriptors(); ++k )
+					all_binary_descriptors.push_back( signature_t( signatures[k] ) );
+			}
+			point_matches.resize( model.get_nb_points() );
+			std::cout << "query " << i << " uses " << query_segments.size() << " tiles with " << model.get_nb_points() << " points" << std::endl;
+			tiles.print_statistics();
+		}
+
 		for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
 		{
 			keypoints[j].x -= (img_width - 1.0) / 2.0f;
 			keypoints[j].y = (img_height - 1.0) / 2.0f - keypoints[j].y;
 		}
 
+		// anytime mode: keep the keypoints with the largest scales that can be matched within the budget
+		if ( budget.is_enabled() && avrg_keypoint_time > 0.0 )
+		{
+			double remaining_time = budget.get_remaining( budget_matching_share );
+			uint32_t max_keypoints = ( remaining_time > 0.0 ) ? (uint32_t) std::min( remaining_time / avrg_keypoint_time, (double) nb_loaded_keypoints ) : 0;
+			max_keypoints = std::max( max_keypoints, min_budget_keypoints );
+			if ( max_keypoints < nb_loaded_keypoints )
+			{
+				keypoint_keys.clear();
+				for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
+					keypoint_keys.push_back( std::make_pair( -keypoints[j].scale, j ) );
+				std::stable_sort( keypoint_keys.begin(), keypoint_keys.end() );
+				std::vector< SIFT_keypoint > kept_keypoints( max_keypoints );
+				std::vector< unsigned char* > kept_descriptors( max_keypoints );
+				for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
+				{
+					uint32_t id = keypoint_keys[j].second;
+					if ( j < max_keypoints )
+					{
+						kept_keypoints[j] = keypoints[id];
+						kept_descriptors[j] = descriptors[id];
+					}
+					else if ( descriptors[id] != 0 )
+						delete [] descriptors[id];
+				}
+				keypoints.swap( kept_keypoints );
+				descriptors.swap( kept_descriptors );
+				std::cout << "query " << i << " keeps the " << max_keypoints << " of " << nb_loaded_keypoints << " keypoints with the largest scales" << std::endl;
+				nb_loaded_keypoints = max_keypoints;
+				budget.degrade( query_budget::keypoints_capped );
+			}
+		}
+
 		//we use 4x4 bins to divide the query image
 		//the bottom left corresponds to bin 0 and the top right corresponds to bin 15
 		const int h_cell = 4;
@@ -363,10 +1060,7 @@ int main (int argc, char **argv)
 		for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
 			query_set[j].clear();
 
-		for (int j = 0; j < feature_infos.size(); j++)
-		{
-			feature_infos[j].matched_query.clear();
-		}
+		point_matches.clear();
 
 		Timer all_timer;
 		all_timer.Init();
@@ -383,49 +1077,236 @@ int main (int argc, char **argv)
 		vw_handler.assign_visual_words_ucharv( descriptors, nb_loaded_keypoints, computed_visual_words );
 
 		time_.Stop();
+		double query_vw_time = time_.GetElapsedTime();
 		avrg_vw_time = avrg_vw_time * nb_query / (nb_query + 1.0) + time_.GetElapsedTime() / (nb_query + 1.0);
 		std::cout << "average assign vw time " << avrg_vw_time << "s" << std::endl;
 
 		time_.Init();
 		time_.Start();
 
-		int corrs_index = 0;
-		for ( size_t j = 0; j < nb_loaded_keypoints; ++j )
+		// restrict the search to the points seen by cameras close to the GPS position of the query
+		bool query_uses_geo_prior = use_geo_prior && !use_tiled_model && query_has_gps && prior.select( query_latitude, query_longitude, gps_radius );
+		if ( query_uses_geo_prior )
 		{
-			//get the assigned visual word index.
-			uint32_t assignment = uint32_t( computed_visual_words[j] );
-
-			//first, project the SIFT to hamming space.
-			Eigen::Matrix<float, 64, 1> proj_sift = projection_matrix * query_sift.col(j);
-			//generate the binary descriptor
-			std::bitset<64> binary_descriptor;
-			for (int k = 0 ; k < 64; k++)
+			std::cout << "query " << i << " uses its GPS position: " << prior.get_nb_selected_cameras() << " cameras in "
+			          << prior.get_nb_selected_tiles() << " of " << prior.get_nb_tiles() << " tiles" << std::endl;
+			nb_geo_queries += 1.0;
+		}
+		// tracking: restrict the search to the points of the top images of the previous frame of the session
+		bool query_uses_tracking = use_tracking && tracker.select( sessions[i] );
+		if ( query_uses_tracking )
+		{
+			std::cout << "query " << i << " tracks session " << sessions[i] << ": " << tracker.get_nb_selected_cameras() << " of "
+			          << tracker.get_nb_cameras() << " cameras, " << tracker.get_nb_selected_points() << " points, "
+			          << tracker.get_nb_selected_entries() << " of " << tracker.get_nb_entries() << " entries" << std::endl;
+		}
+		bool query_tracking_failed = false;
+		double nb_scanned_entries = 0.0, nb_list_entries = 0.0;
+		double nb_skipped_features = 0.0, nb_avoided_entries = 0.0, nb_capped_hits = 0.0;
+
+		// anytime mode and prioritized search: match the features in the order of the costs (list lengths) of their
+		// visual words, such that as many features as possible are matched before the budget runs out or enough
+		// correspondences are found
+		keypoint_order.resize( nb_loaded_keypoints );
+		for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
+			keypoint_order[j] = j;
+		double nb_query_entries = 0.0;
+		if ( ( budget.is_enabled() || use_prioritized_search ) && !use_shards )
+		{
+			keypoint_keys.clear();
+			for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
 			{
-				binary_descriptor[k] = proj_sift[k] > he_thresholds(k, assignment);
+				uint32_t assignment = uint32_t( computed_visual_words[j] ), cost = 0;
+				if ( use_tiled_model )
+				{
+					const uint32_t *entries = 0;
+					for ( size_t t = 0; t < query_segments.size(); ++t )
+						cost += query_segments[t]->get_entries( assignment, entries );
+				}
+				else
+					cost = inverted_lists.get_nb_entries( assignment );
+				keypoint_keys.push_back( std::make_pair( (float) cost, j ) );
+				nb_query_entries += (double) cost;
 			}
-			//in the visual words, compute the hamming distance to each db binary descriptors.
-			int per_vw_size = vw_points_descriptors[assignment].size();
-			if (per_vw_size > 0)
+			std::stable_sort( keypoint_keys.begin(), keypoint_keys.end() );
+			for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
+				keypoint_order[j] = keypoint_keys[j].second;
+		}
+		size_t nb_matched_features = nb_loaded_keypoints, nb_qualified_corrs = 0;
+
+		int corrs_index = 0;
+		shard_queries.clear();
+		// a tracked frame is matched again against the whole model if too few correspondences qualify
+		for ( int pass = 0; pass < 2; ++pass )
+		{
+			for ( size_t o = 0; o < nb_loaded_keypoints; ++o )
 			{
-				for (int m = 0; m < per_vw_size; ++m)
+				if ( budget.is_enabled() && o >= min_budget_keypoints && ( o & 31 ) == 0 && budget.is_exceeded( budget_matching_share ) )
+				{
+					std::cout << "query " << i << " stops matching after " << o << " of " << nb_loaded_keypoints << " features" << std::endl;
+					budget.degrade( query_budget::matching_stopped );
+					nb_matched_features = o;
+					break;
+				}
+				if ( use_prioritized_search && o > 0 && ( o & 31 ) == 0 )
+				{
+					nb_qualified_corrs = point_matches.get_nb_qualified();
+					if ( nb_qualified_corrs >= min_qualified_corrs )
+					{
+						nb_matched_features = o;
+						break;
+					}
+				}
+				size_t j = keypoint_order[o];
+
+				//get the assigned visual word index.
+				uint32_t assignment = uint32_t( computed_visual_words[j] );
+
+				if ( query_uses_tracking )
+					tracker.get_entries( assignment, geo_entries );
+				else if ( query_uses_geo_prior )
+					prior.get_entries( assignment, geo_entries );
+				else if ( use_tiled_model )
+				{
+					// gather the entries of the mapped tiles, the ids are shifted to the position of the tile in model and all_binary_descriptors
+					geo_entries.clear();
+					for ( size_t t = 0; t < query_segments.size(); ++t )
+					{
+						const uint32_t *entries = 0;
+						uint32_t nb_entries = query_segments[t]->get_entries( assignment, entries );
+						for ( uint32_t k = 0; k < nb_entries; ++k )
+							geo_entries.push_back( std::make_pair( segment_point_base[t] + entries[2 * k], segment_desc_base[t] + entries[2 * k + 1] ) );
+					}
+				}
+				// the inverted file is empty if the lists are stored in tiles or shards
+				if ( !use_tiled_model && !use_shards )
+					nb_list_entries += (double) inverted_lists.get_nb_entries( assignment );
+
+				// features in stop words are not matched if no correspondences are kept for them
+				bool in_stop_word = use_stop_words && words.is_stop_word( assignment );
+				if ( in_stop_word && max_stop_word_hits == 0 )
+				{
+					nb_skipped_features += 1.0;
+					nb_avoided_entries += (double) ( ( query_uses_tracking || query_uses_geo_prior ) ? geo_entries.size() : inverted_lists.get_nb_entries( assignment ) );
+					continue;
+				}
+
+				//first, project the SIFT to hamming space.
+				Eigen::Matrix<float, nb_bits, 1> proj_sift = projection_matrix * query_sift.col(j);
+				//generate the binary descriptor
+				signature_t binary_descriptor = signature_t();
+				for (int k = 0 ; k < nb_bits; k++)
+				{
+					if ( proj_sift[k] > he_thresholds(k, assignment) )
+						set_signature_bit( binary_descriptor, k );
+				}
+				// the lists are scanned by the shards once the signatures of all keypoints are known (shards use 64 bits)
+				if ( use_shards )
+				{
+					shard_query query;
+					query.keypoint = (uint32_t) j;
+					query.vw = assignment;
+					query.signature = get_signature_bits( binary_descriptor, 0, 64 );
+					shard_queries.push_back( query );
+					continue;
+				}
+				//in the visual words, compute the hamming distance to each db binary descriptors.
+				list_hits.clear();
+				if ( query_uses_tracking || query_uses_geo_prior || use_tiled_model )
 				{
-					int binary_id = vw_points_descriptors[assignment][m].second;
-					size_t hamming_dist = (binary_descriptor ^ all_binary_descriptors[binary_id]).count();
-					if (hamming_dist <= hamming_dist_threshold)
+					// the second entry of geo_entries is the position of the signature in the inverted file or in the mapped tiles
+					const std::vector< signature_t > &signatures = use_tiled_model ? all_binary_descriptors : inverted_lists.get_signatures();
+					for ( size_t m = 0; m < geo_entries.size(); ++m )
 					{
-						query_set[j].push_back(hamming_dist);
-						feature_infos[vw_points_descriptors[assignment][m].first].matched_query.push_back(hamming_dist);
-						desc_dist.push_back(std::make_pair(corrs_index , hamming_dist));
-						corrs.push_back(std::make_pair( j, vw_points_descriptors[assignment][m].first ));
-						corrs_index++;
+						size_t hamming_dist = hamming_distance( binary_descriptor, signatures[geo_entries[m].second] );
+						if (hamming_dist <= hamming_dist_threshold)
+							list_hits.push_back( std::make_pair( geo_entries[m].first, (uint32_t) hamming_dist ) );
 					}
+					nb_scanned_entries += (double) geo_entries.size();
+				}
+				else
+					nb_scanned_entries += (double) inverted_lists.scan( assignment, binary_descriptor, (uint32_t) hamming_dist_threshold, list_hits );
+				if ( in_stop_word && list_hits.size() > max_stop_word_hits )
+				{
+					nb_capped_hits += (double) ( list_hits.size() - max_stop_word_hits );
+					cap_hits( list_hits, max_stop_word_hits );
+				}
+
+				for ( size_t m = 0; m < list_hits.size(); ++m )
+				{
+					query_set[j].push_back(list_hits[m].second);
+					point_matches.add( list_hits[m].first, list_hits[m].second );
+					desc_dist.push_back(std::make_pair(corrs_index , list_hits[m].second));
+					corrs.push_back(std::make_pair( j, list_hits[m].first ));
+					corrs_index++;
 				}
 			}
+			if ( !query_uses_tracking || point_matches.get_nb_qualified() >= min_tracking_corrs )
+				break;
+			std::cout << "query " << i << " lost session " << sessions[i] << ", matching against the whole model" << std::endl;
+			point_matches.clear();
+			for ( size_t m = 0; m < query_set.size(); ++m )
+				query_set[m].clear();
+			corrs.clear();
+			desc_dist.clear();
+			corrs_index = 0;
+			nb_matched_features = nb_loaded_keypoints;
+			query_uses_tracking = false;
+			query_tracking_failed = true;
+		}
+		if ( use_shards )
+		{
+			// the hits are ordered as if the lists were scanned in the loop above
+			if ( !shards.match( shard_queries, (uint32_t) hamming_dist_threshold, shard_hits ) )
+				return -1;
+			for ( size_t m = 0; m < shard_hits.size(); ++m )
+			{
+				const shard_hit &hit = shard_hits[m];
+				query_set[hit.keypoint].push_back(hit.distance);
+				point_matches.add( hit.point, hit.distance );
+				desc_dist.push_back(std::make_pair(corrs_index , hit.distance));
+				corrs.push_back(std::make_pair( hit.keypoint, hit.point ));
+				corrs_index++;
+			}
+			const std::vector< uint64_t > &scanned = shards.get_scanned_entries();
+			for ( size_t m = 0; m < scanned.size(); ++m )
+				nb_scanned_entries += (double) scanned[m];
+			std::cout << "query " << i << " scanned " << nb_scanned_entries << " entries on " << scanned.size() << " shards" << std::endl;
 		}
 		std::cout << "query " << i << " << corrs number ---------------- " << corrs.size() << std::endl;
+		if ( use_stop_words )
+		{
+			total_skipped_features += nb_skipped_features;
+			total_avoided_entries += nb_avoided_entries;
+			total_capped_hits += nb_capped_hits;
+			std::cout << "query " << i << " skipped " << nb_skipped_features << " features in stop words (" << nb_avoided_entries << " entries not scanned), dropped "
+			          << nb_capped_hits << " correspondences, on average " << total_skipped_features / ( nb_query + 1.0 ) << " features, "
+			          << total_avoided_entries / ( nb_query + 1.0 ) << " entries and " << total_capped_hits / ( nb_query + 1.0 ) << " correspondences per query" << std::endl;
+		}
 		time_.Stop();
 		avrg_matching_time = avrg_matching_time * nb_query / (nb_query + 1.0) + time_.GetElapsedTime() / (nb_query + 1.0);
+		if ( nb_loaded_keypoints > 0 && !( budget.get_flags() & query_budget::matching_stopped ) )
+			avrg_keypoint_time = avrg_keypoint_time * nb_query / (nb_query + 1.0) + ( query_vw_time + time_.GetElapsedTime() ) / (double) nb_loaded_keypoints / (nb_query + 1.0);
 		std::cout << "average hamming feature matching time " << avrg_matching_time << "s" << std::endl;
+		if ( use_prioritized_search )
+		{
+			if ( nb_matched_features == nb_loaded_keypoints )
+				nb_qualified_corrs = point_matches.get_nb_qualified();
+			double matched_feature_ratio = ( nb_loaded_keypoints > 0 ) ? (double) nb_matched_features / (double) nb_loaded_keypoints : 1.0;
+			double prioritized_scanned_ratio = ( nb_query_entries > 0.0 ) ? nb_scanned_entries / nb_query_entries : 1.0;
+			avrg_matched_feature_ratio = avrg_matched_feature_ratio * nb_query / (nb_query + 1.0) + matched_feature_ratio / (nb_query + 1.0);
+			avrg_prioritized_scanned_ratio = avrg_prioritized_scanned_ratio * nb_query / (nb_query + 1.0) + prioritized_scanned_ratio / (nb_query + 1.0);
+			std::cout << "query " << i << " prioritized search matched " << nb_matched_features << " of " << nb_loaded_keypoints << " features ("
+			          << nb_scanned_entries << " of " << nb_query_entries << " list entries), " << nb_qualified_corrs << " qualified correspondences, average ratios "
+			          << avrg_matched_feature_ratio << " of the features and " << avrg_prioritized_scanned_ratio << " of the entries" << std::endl;
+		}
+		if ( use_geo_prior && !use_tiled_model )
+		{
+			double scanned_ratio = ( nb_list_entries > 0.0 ) ? nb_scanned_entries / nb_list_entries : 1.0;
+			avrg_scanned_ratio = avrg_scanned_ratio * nb_query / (nb_query + 1.0) + scanned_ratio / (nb_query + 1.0);
+			std::cout << "scanned " << nb_scanned_entries << " of " << nb_list_entries << " inverted list entries, average ratio "
+			          << avrg_scanned_ratio << " (" << nb_geo_queries << " of " << nb_query + 1.0 << " queries used GPS)" << std::endl;
+		}
 
 		time_.Init();
 		time_.Start();
@@ -443,10 +1324,11 @@ int main (int argc, char **argv)
 			}
 			cur_avg_feature_distance /= (double) q_set_size;
 
-			int match_in_query = feature_infos[cur_3d_id].matched_query.size();
+			const std::vector< float > &matched_query = point_matches.get( cur_3d_id );
+			int match_in_query = matched_query.size();
 			for (int k = 0; k < match_in_query; k++)
 			{
-				cur_avg_in_query_distance += (double)feature_infos[cur_3d_id].matched_query[k];
+				cur_avg_in_query_distance += (double)matched_query[k];
 			}
 			double ratio_test_in_query = (double)desc_dist[j].second * (double)match_in_query *
 			                             (double)match_in_query / cur_avg_in_query_distance;
@@ -477,6 +1359,44 @@ int main (int argc, char **argv)
 			camera_infos[j].avg_hamming_distance = 0;
 		}
 
+		// hierarchical voting: the confident matches vote for the places of their points, and only the
+		// cameras of the top ranked places are voted for below
+		double nb_place_votes = 0.0, nb_camera_votes = 0.0, nb_full_camera_votes = 0.0;
+		Timer vote_timer;
+		vote_timer.Init();
+		vote_timer.Start();
+		if ( use_places )
+		{
+			voted_places.clear();
+			for (int j = 0; j < corrs.size(); j++)
+			{
+				if (corrs_ratio_test[j].first > 1.0f / ratio_test_threshold || corrs_score[j].first < 0.8)
+					continue;
+				const uint32_t *point_places = places.get_point_places( corrs[j].second );
+				uint32_t nb_point_places = places.get_nb_point_places( corrs[j].second );
+				for ( uint32_t k = 0; k < nb_point_places; ++k )
+				{
+					if ( place_scores[point_places[k]] == 0.0 )
+						voted_places.push_back( point_places[k] );
+					place_scores[point_places[k]] += corrs_score[j].first;
+				}
+				nb_place_votes += (double) nb_point_places;
+			}
+			// the places are normalized like the cameras, by the square root of the number of points they see
+			place_rank.clear();
+			for ( size_t j = 0; j < voted_places.size(); ++j )
+			{
+				place_rank.push_back( std::make_pair( place_scores[voted_places[j]] / sqrt( (double) places.get_nb_points( voted_places[j] ) ), voted_places[j] ) );
+				place_scores[voted_places[j]] = 0.0;
+			}
+			size_t nb_selected_places = std::min( place_rank.size(), (size_t) nb_top_places );
+			std::partial_sort( place_rank.begin(), place_rank.begin() + nb_selected_places, place_rank.end(), compare_score );
+			top_places.clear();
+			for ( size_t j = 0; j < nb_selected_places; ++j )
+				top_places.push_back( place_rank[j].second );
+			places.select( top_places );
+		}
+
 		//do the voting
 		int qualified_corrs_nb = 0;
 		std::map<std::string, bool> checkingmap;
@@ -488,10 +1408,36 @@ int main (int argc, char **argv)
 				int cur_2d_pt = corrs[j].first;
 
 				qualified_corrs_nb++;
-				for (int k = 0; k < feature_infos[cur_3d_pt].view_list.size(); k++)
+				if ( use_places )
+				{
+					// only the cameras of the selected places of the point
+					nb_full_camera_votes += (double) places.get_nb_point_views( cur_3d_pt );
+					point_cameras.clear();
+					const uint32_t *point_places = places.get_point_places( cur_3d_pt );
+					for ( uint32_t k = 0; k < places.get_nb_point_places( cur_3d_pt ); ++k )
+					{
+						if ( !places.is_place_selected( point_places[k] ) )
+							continue;
+						const uint32_t *place_cameras = places.get_point_place_cameras( cur_3d_pt, k );
+						point_cameras.insert( point_cameras.end(), place_cameras, place_cameras + places.get_nb_point_place_cameras( cur_3d_pt, k ) );
+					}
+				}
+				else if ( use_visibility_index )
+					visibility.get_cameras( cur_3d_pt, point_cameras );
+				bool listed_cameras = use_places || use_visibility_index;
+				int nb_point_cameras = listed_cameras ? (int) point_cameras.size() : (int) model.get_nb_views( cur_3d_pt );
+				if ( !use_places )
+					nb_full_camera_votes += (double) nb_point_cameras;
+				for (int k = 0; k < nb_point_cameras; k++)
 				{
 					bool find_multiple = false;
-					int cur_img = feature_infos[cur_3d_pt].view_list[k].camera;
+					int cur_img = listed_cameras ? (int) point_cameras[k] : (int) model.get_cameras( cur_3d_pt )[k];
+					// only cameras within the GPS radius and, for tracked frames, the cameras selected by the tracker are voted for
+					if ( query_uses_geo_prior && !prior.is_camera_selected( cur_img ) )
+						continue;
+					if ( query_uses_tracking && !tracker.is_camera_selected( cur_img ) )
+						continue;
+					nb_camera_votes += 1.0;
 					for (int vt = 0; vt < camera_infos[cur_img].vote_list.size(); vt++)
 					{
 						if (corrs[camera_infos[cur_img].vote_list[vt]].first == cur_2d_pt)
@@ -504,7 +1450,57 @@ int main (int argc, char **argv)
 				}
 			}
 		}
+		vote_timer.Stop();
+		avrg_vote_time = avrg_vote_time * nb_query / (nb_query + 1.0) + vote_timer.GetElapsedTime() / (nb_query + 1.0);
 		std::cout << "there are " << qualified_corrs_nb << " matches passing the ratio test " << std::endl;
+		if ( use_places && benchmark_places )
+		{
+			// the votes camera-level voting would cast for the same matches, into separate lists
+			vote_timer.Init();
+			vote_timer.Start();
+			for (int j = 0; j < corrs.size(); j++)
+			{
+				if ( !( corrs_ratio_test[j].first <= 1.0f / ratio_test_threshold ) )
+					continue;
+				int cur_3d_pt = corrs[j].second;
+				if ( use_visibility_index )
+					visibility.get_cameras( cur_3d_pt, point_cameras );
+				int nb_point_cameras = use_visibility_index ? (int) point_cameras.size() : (int) model.get_nb_views( cur_3d_pt );
+				for (int k = 0; k < nb_point_cameras; k++)
+				{
+					int cur_img = use_visibility_index ? (int) point_cameras[k] : (int) model.get_cameras( cur_3d_pt )[k];
+					if ( query_uses_geo_prior && !prior.is_camera_selected( cur_img ) )
+						continue;
+					if ( query_uses_tracking && !tracker.is_camera_selected( cur_img ) )
+						continue;
+					bool find_multiple = false;
+					for (int vt = 0; vt < camera_level_votes[cur_img].size(); vt++)
+						find_multiple = find_multiple || ( corrs[camera_level_votes[cur_img][vt]].first == corrs[j].first );
+					if (!find_multiple)
+						camera_level_votes[cur_img].push_back(j);
+				}
+			}
+			vote_timer.Stop();
+			avrg_camera_level_vote_time = avrg_camera_level_vote_time * nb_query / (nb_query + 1.0) + vote_timer.GetElapsedTime() / (nb_query + 1.0);
+			for (int j = 0; j < nb_cameras; j++)
+				camera_level_votes[j].clear();
+		}
+		if ( use_places )
+		{
+			avrg_place_votes = avrg_place_votes * nb_query / (nb_query + 1.0) + nb_place_votes / (nb_query + 1.0);
+			avrg_camera_votes = avrg_camera_votes * nb_query / (nb_query + 1.0) + nb_camera_votes / (nb_query + 1.0);
+			avrg_full_camera_votes = avrg_full_camera_votes * nb_query / (nb_query + 1.0) + nb_full_camera_votes / (nb_query + 1.0);
+			std::cout << "selected " << top_places.size() << " of " << places.get_nb_places() << " places with " << nb_place_votes << " place votes, "
+			          << nb_camera_votes << " of " << nb_full_camera_votes << " camera votes, average " << avrg_place_votes + avrg_camera_votes
+			          << " votes instead of " << avrg_full_camera_votes << std::endl;
+			std::cout << "average time of casting the votes " << avrg_vote_time << "s with places";
+			if ( benchmark_places )
+				std::cout << ", " << avrg_camera_level_vote_time << "s with camera-level voting (speedup "
+				          << ( avrg_vote_time > 0.0 ? avrg_camera_level_vote_time / avrg_vote_time : 1.0 ) << ")";
+			std::cout << std::endl;
+		}
+		else
+			std::cout << "average time of casting the votes " << avrg_vote_time << "s" << std::endl;
 
 
 		std::vector< std::pair< double, uint32_t > > camera_rank;
@@ -523,7 +1519,7 @@ int main (int argc, char **argv)
 						camera_infos[j].avg_hamming_distance += desc_dist[camera_infos[j].vote_list[k]].second;
 					}
 				}
-				double nb_pt_per_db = camera_infos[j].point_list.size();
+				double nb_pt_per_db = camera_point_counts[j];
 				camera_infos[j].probability /= sqrt(nb_pt_per_db);
 				double vote_pt_per_db = camera_infos[j].vote_list.size();
 				camera_infos[j].avg_hamming_distance /= vote_pt_per_db;
@@ -537,6 +1533,28 @@ int main (int argc, char **argv)
 
 		std::sort(camera_rank.begin(), camera_rank.end(), compare_score);
 		time_.Stop();
+
+		// anytime mode: select from fewer top ranked images if the budget is running out
+		int query_top_rank_k = top_rank_k, query_top_rank_k1 = top_rank_k1;
+		if ( budget.is_exceeded( budget_selection_share ) )
+		{
+			query_top_rank_k = std::max( top_rank_k / 2, 1 );
+			query_top_rank_k1 = std::max( top_rank_k1 / 2, 1 );
+			budget.degrade( query_budget::images_reduced );
+		}
+
+		// tracking: the next frame of the session starts from the top images of this one, unless the search in
+		// the whole model failed as well
+		if ( use_tracking && !sessions[i].empty() )
+		{
+			tracked_cameras.clear();
+			if ( qualified_corrs_nb >= (int) min_tracking_corrs )
+			{
+				for ( int j = 0; j < camera_rank.size() && j < query_top_rank_k1; ++j )
+					tracked_cameras.push_back( camera_rank[j].second );
+			}
+			tracker.update( sessions[i], tracked_cameras );
+		}
 		avrg_voting_time = avrg_voting_time * nb_query / (nb_query + 1.0) + time_.GetElapsedTime() / (nb_query + 1.0);
 		std::cout << "average voting time " << avrg_voting_time << "s" << std::endl;
 
@@ -576,7 +1594,7 @@ int main (int argc, char **argv)
 
 		for (int j = 0; j < camera_rank.size(); j++)
 		{
-			if (j >= top_rank_k)
+			if (j >= query_top_rank_k)
 				break;
 			int top_cam = camera_rank[j].second;
 			int confident_pt_nb = 0;
@@ -599,7 +1617,7 @@ int main (int argc, char **argv)
 		corrs_in_top_img.clear();
 		for (int j = 0; j < camera_rank.size(); j++)
 		{
-			if (j >= top_rank_k)
+			if (j >= query_top_rank_k)
 				break;
 			int top_cam = camera_rank[j].second;
 			for (int k = 0; k < camera_infos[top_cam].vote_list.size(); k++)
@@ -626,7 +1644,7 @@ int main (int argc, char **argv)
 		int nb_top_corrs = 0;
 		for (int j = 0; j < camera_rank.size(); j++)
 		{
-			if (j >= top_rank_k)
+			if (j >= query_top_rank_k)
 				break;
 			int top_cam = camera_rank[j].second;
 			for (int k = 0; k < camera_infos[top_cam].vote_list.size(); k++)
@@ -707,14 +1725,71 @@ int main (int argc, char **argv)
 
 		time_.Init();
 		time_.Start();
+		Timer consistency_timer;
+		consistency_timer.Init();
+		inconsistent_ids.clear();
+
+		// the top_rank_k1 images, followed by the strongest covisible neighbors of each of them that received votes
+		k1_cameras.clear();
+		for (int j = 0; j < camera_rank.size() && j < query_top_rank_k1; j++)
+			k1_cameras.push_back( camera_rank[j].second );
+		if ( nb_covisible_expansion > 0 )
+		{
+			size_t nb_top_cameras = k1_cameras.size();
+			for ( size_t j = 0; j < nb_top_cameras; ++j )
+				k1_camera_added[k1_cameras[j]] = true;
+			for ( size_t j = 0; j < nb_top_cameras; ++j )
+			{
+				const uint32_t *neighbors = covisibility.get_neighbors( k1_cameras[j] );
+				uint32_t degree = covisibility.get_degree( k1_cameras[j] ), nb_added = 0;
+				for ( uint32_t k = 0; k < degree && nb_added < nb_covisible_expansion; ++k )
+				{
+					if ( k1_camera_added[neighbors[k]] || camera_infos[neighbors[k]].vote_list.empty() )
+						continue;
+					k1_camera_added[neighbors[k]] = true;
+					k1_cameras.push_back( neighbors[k] );
+					++nb_added;
+				}
+			}
+			for ( size_t j = 0; j < k1_cameras.size(); ++j )
+				k1_camera_added[k1_cameras[j]] = false;
+			double nb_expanded_cameras = (double) ( k1_cameras.size() - nb_top_cameras );
+			avrg_expanded_cameras = avrg_expanded_cameras * nb_query / (nb_query + 1.0) + nb_expanded_cameras / (nb_query + 1.0);
+			std::cout << "expanded the " << nb_top_cameras << " top ranked images by " << nb_expanded_cameras << " covisible images, average "
+			          << avrg_expanded_cameras << std::endl;
+		}
 
-		for (int j = 0; j < camera_rank.size(); j++)
+		for (size_t j = 0; j < k1_cameras.size(); j++)
 		{
-			if (j >= top_rank_k1)
-				break;
-			int top_cam = camera_rank[j].second;
+			int top_cam = k1_cameras[j];
+			// keep the matches of the image whose scale and orientation changes agree with the dominant mode
+			if ( use_consistency_filter )
+			{
+				consistency_timer.Restart();
+				consistency.clear();
+				for (int k = 0; k < camera_infos[top_cam].vote_list.size(); k++)
+				{
+					const SIFT_keypoint &keypoint = keypoints[corrs[camera_infos[top_cam].vote_list[k]].first];
+					uint32_t cur_3d_pt = corrs[camera_infos[top_cam].vote_list[k]].second;
+					const uint32_t *point_views = model.get_cameras( cur_3d_pt );
+					uint32_t nb_views = model.get_nb_views( cur_3d_pt ), v = 0;
+					while ( v < nb_views && point_views[v] != (uint32_t) top_cam )
+						++v;
+					if ( v < nb_views )
+						consistency.add_match( model.get_scales( cur_3d_pt )[v], model.get_orientations( cur_3d_pt )[v], keypoint.scale, keypoint.orientation );
+					else
+						consistency.add_match( 0.0f, 0.0f, keypoint.scale, keypoint.orientation );
+				}
+				consistency.filter( consistent_matches );
+				consistency_timer.Stop();
+			}
 			for (int k = 0; k < camera_infos[top_cam].vote_list.size(); k++)
 			{
+				if ( use_consistency_filter && !consistent_matches[k] )
+				{
+					inconsistent_ids.push_back( camera_infos[top_cam].vote_list[k] );
+					continue;
+				}
 				if (!potential_picked[camera_infos[top_cam].vote_list[k]])
 				{
 					potential_chosen_pt.push_back(camera_infos[top_cam].vote_list[k]);
@@ -723,6 +1798,26 @@ int main (int argc, char **argv)
 			}
 		}
 		std::cout << "potential chosen point size " << potential_chosen_pt.size() << std::endl;
+		if ( use_consistency_filter )
+		{
+			// a match is pruned if it is inconsistent in all top images that voted for it (potential_picked is
+			// not used any more and marks the counted matches)
+			int nb_pruned = 0;
+			for ( size_t j = 0; j < inconsistent_ids.size(); ++j )
+			{
+				if ( !potential_picked[inconsistent_ids[j]] )
+				{
+					potential_picked[inconsistent_ids[j]] = true;
+					++nb_pruned;
+				}
+			}
+			double pruning_rate = ( nb_pruned > 0 ) ? (double) nb_pruned / (double) ( nb_pruned + potential_chosen_pt.size() ) : 0.0;
+			avrg_consistency_time = avrg_consistency_time * nb_query / (nb_query + 1.0) + consistency_timer.GetElapsedTime() / (nb_query + 1.0);
+			avrg_pruning_rate = avrg_pruning_rate * nb_query / (nb_query + 1.0) + pruning_rate / (nb_query + 1.0);
+			std::cout << "consistency filter pruned " << nb_pruned << " of " << nb_pruned + potential_chosen_pt.size() << " matches (" << 100.0 * pruning_rate
+			          << "%) in " << consistency_timer.GetElapsedTime() << "s, average pruning rate " << 100.0 * avrg_pruning_rate << "%, average time "
+			          << avrg_consistency_time << "s" << std::endl;
+		}
 
 		time_.Stop();
 		avrg_final_pick_time = avrg_final_pick_time * nb_query / (nb_query + 1.0) + time_.GetElapsedTime() / (nb_query + 1.0);
@@ -745,23 +1840,173 @@ int main (int argc, char **argv)
 		for (int j = 0; j < chosen_pt.size(); j++ )
 		{
 			ofs_2d << keypoints[corrs[chosen_pt[j]].first].x << " " << keypoints[corrs[chosen_pt[j]].first].y << std::endl;
-			ofs_3d << std::setprecision(16) << feature_infos[corrs[chosen_pt[j]].second].point.x << " "
-			       << std::setprecision(16) << feature_infos[corrs[chosen_pt[j]].second].point.y << " "
-			       << std::setprecision(16) << feature_infos[corrs[chosen_pt[j]].second].point.z << std::endl;
+			ofs_3d << std::setprecision(16) << model.get_x( corrs[chosen_pt[j]].second ) << " "
+			       << std::setprecision(16) << model.get_y( corrs[chosen_pt[j]].second ) << " "
+			       << std::setprecision(16) << model.get_z( corrs[chosen_pt[j]].second ) << std::endl;
 
 		}
 		ofs_2d << i << " " << potential_chosen_pt.size() << std::endl;
 		ofs_3d << i << " " << potential_chosen_pt.size() << std::endl;
 		for (int j = 0; j < potential_chosen_pt.size(); j++ )
 		{
-			//std::cout << feature_infos[corrs[chosen_pt[j]].second].matched_query.size() << " ";
+			//std::cout << point_matches.get( corrs[chosen_pt[j]].second ).size() << " ";
 			ofs_2d << keypoints[corrs[potential_chosen_pt[j]].first].x << " "
 			       << keypoints[corrs[potential_chosen_pt[j]].first].y << std::endl;
-			ofs_3d << std::setprecision(16) << feature_infos[corrs[potential_chosen_pt[j]].second].point.x << " "
-			       << std::setprecision(16) << feature_infos[corrs[potential_chosen_pt[j]].second].point.y << " "
-			       << std::setprecision(16) << feature_infos[corrs[potential_chosen_pt[j]].second].point.z << std::endl;
+			ofs_3d << std::setprecision(16) << model.get_x( corrs[potential_chosen_pt[j]].second ) << " "
+			       << std::setprecision(16) << model.get_y( corrs[potential_chosen_pt[j]].second ) << " "
+			       << std::setprecision(16) << model.get_z( corrs[potential_chosen_pt[j]].second ) << std::endl;
 		}
 
+		// the pose of the query: an auxiliary pose is estimated from the selected matches, the final pose from the
+		// matches of the visibility-wise pool within the threshold of the auxiliary pose, with its focal length
+		if ( estimate_poses )
+		{
+			time_.Init();
+			time_.Start();
+			bool known_focal = !pose_unknown_focal && focal_length[i] > 0.0f;
+			double focal = known_focal ? (double) focal_length[i] : 0.0;
+			double image_size = (double) std::max( img_width, img_height );
+			if ( image_size > 0.0 )
+				pose_solver.set_focal_range( 0.3 * image_size, 6.0 * image_size );
+			// anytime mode: limit the number of hypotheses if the budget is running out
+			bool limit_pose_hypotheses = budget.is_exceeded( budget_pose_share );
+			pose_solver.set_iteration_bounds( 10, limit_pose_hypotheses ? max_budget_pose_iterations : 10000 );
+
+			// PROSAC draws its samples from the best matches first, ordered by their updated scores
+			pose_order.clear();
+			for (int j = 0; j < chosen_pt.size(); j++ )
+				pose_order.push_back( std::make_pair( new_corrs_score[chosen_pt[j]].first, chosen_pt[j] ) );
+			if ( pose_progressive )
+				std::stable_sort( pose_order.begin(), pose_order.end(), compare_score );
+
+			pose_image_points.clear();
+			pose_points.clear();
+			for (int j = 0; j < pose_order.size(); j++ )
+			{
+				int cur_id = pose_order[j].second;
+				uint32_t point = corrs[cur_id].second;
+				pose_image_points.push_back( get_undistorted_point( keypoints[corrs[cur_id].first], focal, radial[i] ) );
+				pose_points.push_back( Eigen::Vector3d( model.get_x( point ), model.get_y( point ), model.get_z( point ) ) );
+			}
+			camera_pose auxiliary_pose, final_pose;
+			bool localized = pose_solver.estimate( pose_image_points, pose_points, focal, pose_threshold, auxiliary_pose, pose_inliers )
+			                 && pose_inliers.size() >= min_pose_inliers;
+			double solver_time = pose_solver.get_solver_time();
+			// without a known focal length, the hypotheses of the auxiliary pose come from the approximate P4Pf
+			double p4pf_time = known_focal ? 0.0 : solver_time;
+			double optimization_time = pose_solver.get_optimization_time();
+			double nb_hypotheses = pose_solver.get_nb_iterations();
+			double nb_uniform_hypotheses = pose_solver.get_nb_uniform_iterations();
+			double uniform_time = pose_solver.get_uniform_time();
+			bool uniform_measured = pose_solver.is_uniform_measured();
+			if ( limit_pose_hypotheses && pose_solver.get_nb_iterations() >= max_budget_pose_iterations )
+				budget.degrade( query_budget::pose_limited );
+			size_t nb_auxiliary_matches = pose_points.size(), nb_auxiliary_inliers = pose_inliers.size();
+			size_t nb_final_matches = 0, nb_final_inliers = 0;
+			if ( localized )
+			{
+				pose_order.clear();
+				for (int j = 0; j < potential_chosen_pt.size(); j++ )
+					pose_order.push_back( std::make_pair( new_corrs_score[potential_chosen_pt[j]].first, potential_chosen_pt[j] ) );
+				if ( pose_progressive )
+					std::stable_sort( pose_order.begin(), pose_order.end(), compare_score );
+
+				pose_image_points.clear();
+				pose_points.clear();
+				for (int j = 0; j < pose_order.size(); j++ )
+				{
+					int cur_id = pose_order[j].second;
+					uint32_t point = corrs[cur_id].second;
+					Eigen::Vector2d image_point = get_undistorted_point( keypoints[corrs[cur_id].first], focal, radial[i] );
+					Eigen::Vector3d position( model.get_x( point ), model.get_y( point ), model.get_z( point ) );
+					if ( get_reprojection_error( auxiliary_pose, image_point, position ) <= pose_threshold )
+					{
+						pose_image_points.push_back( image_point );
+						pose_points.push_back( position );
+					}
+				}
+				nb_final_matches = pose_points.size();
+				if ( pose_solver.estimate( pose_image_points, pose_points, auxiliary_pose.focal_length, pose_threshold, final_pose, pose_inliers ) )
+					nb_final_inliers = pose_inliers.size();
+				else
+				{
+					final_pose = auxiliary_pose;
+					nb_final_inliers = nb_auxiliary_inliers;
+				}
+				solver_time += pose_solver.get_solver_time();
+				optimization_time += pose_solver.get_optimization_time();
+				nb_hypotheses += pose_solver.get_nb_iterations();
+				nb_uniform_hypotheses += pose_solver.get_nb_uniform_iterations();
+				uniform_time += pose_solver.get_uniform_time();
+				uniform_measured = uniform_measured && pose_solver.is_uniform_measured();
+				if ( limit_pose_hypotheses && pose_solver.get_nb_iterations() >= max_budget_pose_iterations )
+					budget.degrade( query_budget::pose_limited );
+			}
+			time_.Stop();
+			// the uniform runs of the benchmark mode are reported separately
+			avrg_pose_time = avrg_pose_time * nb_query / (nb_query + 1.0) + ( time_.GetElapsedTime() - uniform_time ) / (nb_query + 1.0);
+			avrg_pose_uniform_time = avrg_pose_uniform_time * nb_query / (nb_query + 1.0) + uniform_time / (nb_query + 1.0);
+			avrg_pose_solver_time = avrg_pose_solver_time * nb_query / (nb_query + 1.0) + solver_time / (nb_query + 1.0);
+			avrg_pose_p4pf_time = avrg_pose_p4pf_time * nb_query / (nb_query + 1.0) + p4pf_time / (nb_query + 1.0);
+			avrg_pose_optimization_time = avrg_pose_optimization_time * nb_query / (nb_query + 1.0) + optimization_time / (nb_query + 1.0);
+			avrg_pose_hypotheses = avrg_pose_hypotheses * nb_query / (nb_query + 1.0) + nb_hypotheses / (nb_query + 1.0);
+			avrg_pose_uniform_hypotheses = avrg_pose_uniform_hypotheses * nb_query / (nb_query + 1.0) + nb_uniform_hypotheses / (nb_query + 1.0);
+
+			if ( localized )
+			{
+				nb_localized += 1.0;
+				std::cout << "query " << i << " pose: auxiliary " << nb_auxiliary_inliers << " of " << nb_auxiliary_matches << " inliers, final "
+				          << nb_final_inliers << " of " << nb_final_matches << " inliers, focal length " << final_pose.focal_length << ( known_focal ? " (known)" : " (approximate P4Pf)" ) << std::endl;
+
+				// the benchmark format uses the rotation and translation of the camera with y pointing down and z forward
+				Eigen::Matrix3d flip = Eigen::Vector3d( 1.0, -1.0, -1.0 ).asDiagonal();
+				Eigen::Quaterniond rotation( flip * final_pose.rotation );
+				Eigen::Vector3d translation = flip * final_pose.translation;
+				ofs_poses << jpg_filename << std::setprecision(16) << " " << rotation.w() << " " << rotation.x() << " " << rotation.y() << " " << rotation.z()
+				          << " " << translation[0] << " " << translation[1] << " " << translation[2] << std::endl;
+			}
+			else
+				std::cout << "query " << i << " pose: not localized (" << nb_auxiliary_inliers << " of " << nb_auxiliary_matches << " inliers)" << std::endl;
+			std::cout << "average pose estimation time " << avrg_pose_time << "s (hypothesis solvers " << avrg_pose_solver_time << "s, of which approximate P4Pf "
+			          << avrg_pose_p4pf_time << "s, local optimization " << avrg_pose_optimization_time << "s), localized " << nb_localized << " of " << nb_query + 1.0
+			          << " queries" << std::endl;
+			std::cout << "query " << i << " pose hypotheses: " << nb_hypotheses << " (uniform sampling needs " << nb_uniform_hypotheses
+			          << ( uniform_measured ? ", measured" : ", estimated" ) << "), average " << avrg_pose_hypotheses << " (uniform sampling needs "
+			          << avrg_pose_uniform_hypotheses << ", reduction factor " << ( avrg_pose_hypotheses > 0.0 ? avrg_pose_uniform_hypotheses / avrg_pose_hypotheses : 1.0 )
+			          << ")" << std::endl;
+			if ( pose_sampling == "benchmark" )
+				std::cout << "average pose estimation time with uniform sampling " << avrg_pose_uniform_time << "s" << std::endl;
+		}
+
+		// the latency of the query from loading its features to its pose
+		double query_latency = budget.get_elapsed();
+		query_latencies.push_back( query_latency );
+		if ( use_tracking )
+		{
+			if ( query_uses_tracking )
+			{
+				avrg_tracked_latency = avrg_tracked_latency * nb_tracked_queries / (nb_tracked_queries + 1.0) + query_latency / (nb_tracked_queries + 1.0);
+				nb_tracked_queries += 1.0;
+			}
+			else
+			{
+				double nb_untracked_queries = nb_query - nb_tracked_queries;
+				avrg_untracked_latency = avrg_untracked_latency * nb_untracked_queries / (nb_untracked_queries + 1.0) + query_latency / (nb_untracked_queries + 1.0);
+			}
+			if ( query_tracking_failed )
+				nb_tracking_fallbacks += 1.0;
+			std::cout << "tracked " << nb_tracked_queries << " of " << nb_query + 1.0 << " queries (" << nb_tracking_fallbacks << " fell back to the whole model), average latency "
+			          << 1000.0 * avrg_tracked_latency << "ms tracked, " << 1000.0 * avrg_untracked_latency << "ms otherwise" << std::endl;
+		}
+		if ( budget.get_flags() != 0 )
+			nb_degraded += 1.0;
+		std::cout << "query " << i << " latency " << 1000.0 * query_latency << "ms";
+		if ( budget.is_enabled() )
+			std::cout << " (deadline " << deadline_ms << "ms, " << budget.get_description() << ", " << nb_degraded << " of " << nb_query + 1.0 << " queries degraded)";
+		std::cout << std::endl;
+		if ( ofs_budget.is_open() )
+			ofs_budget << i << " " << jpg_filename << " " << 1000.0 * query_latency << " " << budget.get_flags() << std::endl;
+
 		for ( uint32_t j = 0; j < nb_loaded_keypoints; ++j )
 		{
 			if ( descriptors[j] != 0 )
@@ -770,10 +2015,7 @@ int main (int argc, char **argv)
 		}
 		descriptors.clear();
 		keypoints.clear();
-		for (int j = 0; j < feature_infos.size(); j++)
-		{
-			feature_infos[j].matched_query.clear();
-		}
+		point_matches.clear();
 		corrs.clear();
 		bin.clear();
 		query_set.clear();
@@ -785,9 +2027,51 @@ int main (int argc, char **argv)
 	}
 	ofs_2d.close();
 	ofs_3d.close();
+	if ( estimate_poses )
+		ofs_poses.close();
+	if ( ofs_budget.is_open() )
+		ofs_budget.close();
+
+	// the latency percentiles (nearest rank) over all processed queries
+	if ( !query_latencies.empty() )
+	{
+		std::sort( query_latencies.begin(), query_latencies.end() );
+		size_t nb_latencies = query_latencies.size();
+		std::cout << "query latencies of " << nb_latencies << " queries: median " << 1000.0 * query_latencies[( nb_latencies - 1 ) / 2] << "ms, p90 "
+		          << 1000.0 * query_latencies[( nb_latencies * 90 + 99 ) / 100 - 1] << "ms, p99 " << 1000.0 * query_latencies[( nb_latencies * 99 + 99 ) / 100 - 1]
+		          << "ms, max " << 1000.0 * query_latencies.back() << "ms";
+		if ( budget.is_enabled() )
+			std::cout << ", " << nb_degraded << " degraded under a deadline of " << deadline_ms << "ms";
+		std::cout << std::endl;
+	}
 	return 0;
 }
 
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main (int argc, char **argv)
+{
+	// the width of the signatures is read from the header of the hamming file, which is not used by tiled models and shards
+	int nb_bits = 64;
+	bool reads_hamming_file = ( argc >= 15 );
+	for ( int i = 15; i < argc; i += 2 )
+	{
+		std::string option( argv[i] );
+		if ( option == "--tiled_model" || option == "--shards" )
+			reads_hamming_file = false;
+	}
+	if ( reads_hamming_file )
+		nb_bits = read_signature_bits( argv[4] );
+
+	if ( nb_bits == 32 )
+		return localize< 32 >( argc, argv );
+	else if ( nb_bits == 64 )
+		return localize< 64 >( argc, argv );
+	else if ( nb_bits == 128 )
+		return localize< 128 >( argc, argv );
+	return -1;
+}
+
 
 
 
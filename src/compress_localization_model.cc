@@ -0,0 +1,732 @@
+#define __STDC_LIMIT_MACROS
+
+// C++ includes
+#include <vector>
+#include <queue>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include <bitset>
+
+// includes for classes dealing with SIFT-features
+#include "features/SIFT_loader.hh"
+#include "features/visual_words_handler.hh"
+#include "features/vw_assignments.hh"
+#include "features/hamming_embedding.hh"
+#include "features/hamming_model.hh"
+#include "features/hamming_delta.hh"
+#include "sfm/parse_bundler.hh"
+#include "sfm/info_delta.hh"
+
+// stopwatch
+#include "timer.hh"
+
+#include "mapped_file.hh"
+
+// size of a camera in a .info file of format 1 (focal length, kappa 1 & 2, width, height, rotation, translation)
+const uint64_t info_camera_size = 3 * sizeof( double ) + 2 * sizeof( int32_t ) + 12 * sizeof( double );
+
+// size of a view in a .info file (camera id, x, y, scale, orientation, descriptor)
+const uint64_t info_view_size = sizeof( uint32_t ) + 4 * sizeof( float ) + 128;
+
+
+////
+// Memory used by the localizer for a point: its position, its visibility list, its
+// (point, descriptor) pairs in the inverted lists and the signatures of its descriptors.
+uint64_t point_memory( uint32_t nb_views, uint32_t nb_entries, uint32_t nb_descriptors )
+{
+  return 3 * sizeof( float ) + nb_views * sizeof( uint32_t ) + nb_entries * 2 * sizeof( uint32_t ) + nb_descriptors * sizeof( uint64_t );
+}
+
+////
+// Candidate of the greedy selection. The gains only decrease during the selection,
+// so a candidate whose stored gain is outdated is updated and pushed back (lazy greedy).
+struct cover_candidate
+{
+  uint32_t gain;
+  uint32_t nb_views;
+  uint32_t point;
+
+  bool operator<( const cover_candidate &other ) const
+  {
+    if ( gain != other.gain )
+      return gain < other.gain;
+    if ( nb_views != other.nb_views )
+      return nb_views < other.nb_views;
+    return point > other.point;
+  }
+};
+
+////
+// Copies the cameras and the selected points of a .info file without parsing the
+// descriptors. The blocks appended by update_localization_model are merged into
+// a plain .info file.
+bool write_reduced_info( const std::string &input, int format, const std::vector< feature_3D_info > &feature_infos, uint32_t nb_selected, const std::string &output )
+{
+  mapped_file input_file;
+  if ( !input_file.open( input ) )
+    return false;
+
+  const unsigned char *data = input_file.data();
+  const uint64_t size = input_file.size();
+  const uint64_t camera_size = ( format == 1 ) ? info_camera_size : 0;
+
+  // the offsets of the cameras and points of the file and of its blocks
+  std::vector< uint64_t > camera_offsets, point_offsets;
+  std::vector< uint32_t > nb_block_cameras, nb_block_points;
+  uint32_t nb_cameras = 0, nb_points = 0;
+  uint64_t offset = sizeof( uint32_t );
+  uint32_t nb_cameras_block = 0;
+  bool valid = ( size >= sizeof( uint32_t ) );
+  if ( valid )
+    memcpy( &nb_cameras_block, data, sizeof( uint32_t ) );
+  while ( valid )
+  {
+    camera_offsets.push_back( offset );
+    nb_block_cameras.push_back( nb_cameras_block );
+    nb_cameras += nb_cameras_block;
+    offset += nb_cameras_block * camera_size;
+    uint32_t nb_points_block = 0;
+    if ( offset + sizeof( uint32_t ) > size )
+    {
+      valid = false;
+      break;
+    }
+    memcpy( &nb_points_block, data + offset, sizeof( uint32_t ) );
+    offset += sizeof( uint32_t );
+    point_offsets.push_back( offset );
+    nb_block_points.push_back( nb_points_block );
+    nb_points += nb_points_block;
+
+    // skip the points of the block
+    for ( uint32_t i = 0; i < nb_points_block && valid; ++i )
+    {
+      uint32_t size_view_list = 0;
+      if ( offset + 3 * sizeof( float ) + sizeof( uint32_t ) > size )
+      {
+        valid = false;
+        break;
+      }
+      memcpy( &size_view_list, data + offset + 3 * sizeof( float ), sizeof( uint32_t ) );
+      offset += 3 * sizeof( float ) + sizeof( uint32_t ) + size_view_list * info_view_size;
+      valid = ( offset <= size );
+    }
+    if ( !valid || !info_delta::next_block( data, size, offset, nb_cameras_block ) )
+      break;
+  }
+  if ( !valid || offset != size || nb_points != (uint32_t) feature_infos.size() )
+  {
+    std::cerr << " ERROR: " << input << " is truncated" << std::endl;
+    return false;
+  }
+
+  std::ofstream ofs( output.c_str(), std::ios::out | std::ios::binary );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << " ERROR: Cannot write to " << output << std::endl;
+    return false;
+  }
+  ofs.write( (const char*) &nb_cameras, sizeof( uint32_t ) );
+  for ( size_t i = 0; i < camera_offsets.size(); ++i )
+    ofs.write( (const char*) data + camera_offsets[i], nb_block_cameras[i] * camera_size );
+  ofs.write( (const char*) &nb_selected, sizeof( uint32_t ) );
+
+  uint32_t point_id = 0;
+  for ( size_t i = 0; i < point_offsets.size(); ++i )
+  {
+    offset = point_offsets[i];
+    for ( uint32_t j = 0; j < nb_block_points[i]; ++j, ++point_id )
+    {
+      uint32_t size_view_list = 0;
+      memcpy( &size_view_list, data + offset + 3 * sizeof( float ), sizeof( uint32_t ) );
+      uint64_t point_size = 3 * sizeof( float ) + sizeof( uint32_t ) + size_view_list * info_view_size;
+      if ( feature_infos[point_id].s_flag )
+        ofs.write( (const char*) data + offset, point_size );
+      offset += point_size;
+    }
+  }
+
+  if ( !ofs )
+  {
+    std::cerr << " ERROR: Could not copy the points of " << input << " to " << output << std::endl;
+    return false;
+  }
+  ofs.close();
+  return true;
+}
+
+////
+// Writes the assignments of the selected points in the format of compute_desc_assignments,
+// descriptors that are not used anymore are removed.
+bool write_reduced_assignments( const vw_assignments &assignments, const std::vector< uint32_t > &point_map, uint32_t nb_selected, const std::string &output )
+{
+  uint32_t nb_clusters = assignments.get_nb_clusters();
+  std::vector< uint32_t > descriptor_map( assignments.get_nb_descriptors(), UINT32_MAX );
+  std::vector< uint32_t > kept_descriptors;
+  uint32_t nb_non_empty_vw = 0;
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    const uint32_t *pairs = assignments.get_assignments( vw );
+    bool non_empty = false;
+    for ( uint32_t j = 0; j < assignments.get_nb_assignments( vw ); ++j )
+    {
+      if ( point_map[pairs[2 * j]] == UINT32_MAX )
+        continue;
+      non_empty = true;
+      if ( descriptor_map[pairs[2 * j + 1]] == UINT32_MAX )
+      {
+        descriptor_map[pairs[2 * j + 1]] = (uint32_t) kept_descriptors.size();
+        kept_descriptors.push_back( pairs[2 * j + 1] );
+      }
+    }
+    if ( non_empty )
+      ++nb_non_empty_vw;
+  }
+
+  std::ofstream ofs( output.c_str(), std::ios::out | std::ios::binary );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << " ERROR: Cannot write to " << output << std::endl;
+    return false;
+  }
+
+  uint32_t nb_descriptors = (uint32_t) kept_descriptors.size();
+  ofs.write( (const char*) &nb_selected, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_clusters, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_non_empty_vw, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_descriptors, sizeof( uint32_t ) );
+
+  const float *points = assignments.get_points();
+  for ( uint32_t i = 0; i < (uint32_t) point_map.size(); ++i )
+  {
+    if ( point_map[i] != UINT32_MAX )
+      ofs.write( (const char*) ( points + 3 * i ), 3 * sizeof( float ) );
+  }
+  const unsigned char *descriptors = assignments.get_descriptors();
+  for ( uint32_t i = 0; i < nb_descriptors; ++i )
+    ofs.write( (const char*) ( descriptors + 128 * (uint64_t) kept_descriptors[i] ), 128 );
+
+  std::vector< uint32_t > word;
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    const uint32_t *pairs = assignments.get_assignments( vw );
+    word.clear();
+    for ( uint32_t j = 0; j < assignments.get_nb_assignments( vw ); ++j )
+    {
+      if ( point_map[pairs[2 * j]] == UINT32_MAX )
+        continue;
+      word.push_back( point_map[pairs[2 * j]] );
+      word.push_back( descriptor_map[pairs[2 * j + 1]] );
+    }
+    uint32_t nb_pairs = (uint32_t) ( word.size() / 2 );
+    ofs.write( (const char*) &vw, sizeof( uint32_t ) );
+    ofs.write( (const char*) &nb_pairs, sizeof( uint32_t ) );
+    if ( nb_pairs > 0 )
+      ofs.write( (const char*) &word[0], word.size() * sizeof( uint32_t ) );
+  }
+
+  if ( !ofs )
+  {
+    std::cerr << " ERROR: Could not write the assignments to " << output << std::endl;
+    return false;
+  }
+  ofs.close();
+  return true;
+}
+
+////
+// A held-out query: its keypoint file and the database images showing the same scene.
+struct held_out_query
+{
+  std::string key_filename;
+  std::vector< uint32_t > cameras;
+};
+
+bool load_held_out_queries( const std::string &filename, std::vector< held_out_query > &queries )
+{
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << " ERROR: Cannot read the query list " << filename << std::endl;
+    return false;
+  }
+  std::string line;
+  while ( std::getline( ifs, line ) )
+  {
+    std::stringstream s( line );
+    held_out_query query;
+    uint32_t camera;
+    if ( !( s >> query.key_filename ) )
+      continue;
+    while ( s >> camera )
+      query.cameras.push_back( camera );
+    queries.push_back( query );
+  }
+  return true;
+}
+
+////
+// Matches the signatures of a query against the inverted lists (restricted to the selected points
+// if selected_only is set), lets every matched point vote for the images seeing it and returns true
+// if one of the images of the query is among the top_k images.
+bool retrieve( const std::vector< uint32_t > &words, const std::vector< uint64_t > &signatures, const hamming_model &model, const std::vector< feature_3D_info > &feature_infos,
+               bool selected_only, uint32_t hamming_threshold, uint32_t top_k, const std::vector< uint32_t > &cameras, std::vector< uint32_t > &votes, std::vector< uint32_t > &point_stamps, uint32_t stamp )
+{
+  std::fill( votes.begin(), votes.end(), 0 );
+  const std::vector< uint64_t > &db_signatures = model.get_signatures();
+  for ( size_t j = 0; j < words.size(); ++j )
+  {
+    const uint32_t *pairs = model.get_assignments( words[j] );
+    std::bitset< 64 > signature( signatures[j] );
+    for ( uint32_t m = 0; m < model.get_nb_assignments( words[j] ); ++m )
+    {
+      uint32_t point = pairs[2 * m];
+      if ( ( selected_only && !feature_infos[point].s_flag ) || point_stamps[point] == stamp )
+        continue;
+      if ( ( signature ^ std::bitset< 64 >( db_signatures[pairs[2 * m + 1]] ) ).count() > hamming_threshold )
+        continue;
+      // every point votes once per query
+      point_stamps[point] = stamp;
+      for ( size_t k = 0; k < feature_infos[point].view_list.size(); ++k )
+      {
+        if ( feature_infos[point].view_list[k].camera < votes.size() )
+          ++votes[feature_infos[point].view_list[k].camera];
+      }
+    }
+  }
+
+  std::vector< std::pair< uint32_t, uint32_t > > ranking;
+  for ( uint32_t c = 0; c < (uint32_t) votes.size(); ++c )
+  {
+    if ( votes[c] > 0 )
+      ranking.push_back( std::make_pair( votes[c], c ) );
+  }
+  size_t nb_ranked = std::min( (size_t) top_k, ranking.size() );
+  std::partial_sort( ranking.begin(), ranking.begin() + nb_ranked, ranking.end(), std::greater< std::pair< uint32_t, uint32_t > >() );
+  for ( size_t r = 0; r < nb_ranked; ++r )
+  {
+    if ( std::find( cameras.begin(), cameras.end(), ranking[r].second ) != cameras.end() )
+      return true;
+  }
+  return false;
+}
+
+
+int main (int argc, char **argv)
+{
+  if ( argc < 7 )
+  {
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " -    Compresses a model by selecting a subset of its 3D points such that every database image     - " << std::endl;
+    std::cout << " -    still sees at least K selected points (greedy K-cover, points seen by many images that are   - " << std::endl;
+    std::cout << " -    not covered yet are selected first). Writes the reduced .info and hamming files.             - " << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " - usage: compress_localization_model bundle bundle_type hamming K out_bundle out_hamming [options]  - " << std::endl;
+    std::cout << " - Parameters:                                                                                       - " << std::endl;
+    std::cout << " -  argv[1]: The .info file                                                                          - " << std::endl;
+    std::cout << " -  argv[2]: The file format of the .info file (0: Bundle2Info, 1: with camera information)          - " << std::endl;
+    std::cout << " -  argv[3]: The model (output of compute_hamming_threshold or build_localization_model)             - " << std::endl;
+    std::cout << " -  argv[4]: The number of selected points every database image should see                           - " << std::endl;
+    std::cout << " -  argv[5]: The output .info file containing the selected points                                    - " << std::endl;
+    std::cout << " -  argv[6]: The output model containing the selected points                                         - " << std::endl;
+    std::cout << " - Optional parameters (given as pairs after argv[6]):                                               - " << std::endl;
+    std::cout << " -  --memory_budget MB: Maximal memory of the compressed model in the localizer (default: no limit).  - " << std::endl;
+    std::cout << " -                      Once all images are covered, the remaining budget is filled with the points  - " << std::endl;
+    std::cout << " -                      seen by the most images.                                                     - " << std::endl;
+    std::cout << " -  --assignments file: Descriptor assignments (output of compute_desc_assignments) to be reduced     - " << std::endl;
+    std::cout << " -  --assignments_output file: The reduced assignments                                               - " << std::endl;
+    std::cout << " -  --queries file: Held-out queries to measure the recall of the retrieval stage, one query per   - " << std::endl;
+    std::cout << " -                  line: the .key file followed by the ids of the database images of the scene      - " << std::endl;
+    std::cout << " -  --clusters file: The visual vocabulary (required by --queries)                                   - " << std::endl;
+    std::cout << " -  --branching b: The branching factor of the vocabulary tree (default 10)                          - " << std::endl;
+    std::cout << " -  --vocabulary_index file: Binary file storing the vocabulary and its search tree                   - " << std::endl;
+    std::cout << " -  --hamming_threshold t: The hamming distance threshold of the matching (default 16)               - " << std::endl;
+    std::cout << " -  --top_k k: A query is retrieved if one of its images is among the top k images (default 20)      - " << std::endl;
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    return -1;
+  }
+
+  std::string bundle( argv[1] );
+  int bundle_type = atoi( argv[2] );
+  std::string hamming_input( argv[3] );
+  uint32_t K = (uint32_t) atoi( argv[4] );
+  std::string bundle_output( argv[5] );
+  std::string hamming_output( argv[6] );
+
+  double memory_budget_mb = 0.0;
+  std::string assignments_input( "" ), assignments_output( "" );
+  std::string query_list( "" ), cluster_file( "" ), vocabulary_index_file( "" );
+  int nb_branching = 10;
+  uint32_t hamming_threshold = 16;
+  uint32_t top_k = 20;
+  for ( int i = 7; i < argc; i += 2 )
+  {
+    std::string option( argv[i] );
+    if ( i + 1 >= argc )
+    {
+      std::cerr << " ERROR: No value given for " << option << std::endl;
+      return -1;
+    }
+    if ( option == "--memory_budget" )
+      memory_budget_mb = atof( argv[i + 1] );
+    else if ( option == "--assignments" )
+      assignments_input = argv[i + 1];
+    else if ( option == "--assignments_output" )
+      assignments_output = argv[i + 1];
+    else if ( option == "--queries" )
+      query_list = argv[i + 1];
+    else if ( option == "--clusters" )
+      cluster_file = argv[i + 1];
+    else if ( option == "--branching" )
+      nb_branching = atoi( argv[i + 1] );
+    else if ( option == "--vocabulary_index" )
+      vocabulary_index_file = argv[i + 1];
+    else if ( option == "--hamming_threshold" )
+      hamming_threshold = (uint32_t) atoi( argv[i + 1] );
+    else if ( option == "--top_k" )
+      top_k = (uint32_t) atoi( argv[i + 1] );
+    else
+    {
+      std::cerr << " ERROR: Unknown option " << option << std::endl;
+      return -1;
+    }
+  }
+
+  if ( bundle_type < 0 || bundle_type > 1 )
+  {
+    std::cerr << " ERROR: Unknown file format for the binary .info file." << std::endl;
+    return -1;
+  }
+  if ( assignments_input.empty() != assignments_output.empty() )
+  {
+    std::cerr << " ERROR: --assignments and --assignments_output have to be given together" << std::endl;
+    return -1;
+  }
+  if ( !query_list.empty() && cluster_file.empty() )
+  {
+    std::cerr << " ERROR: --queries requires --clusters" << std::endl;
+    return -1;
+  }
+
+  Timer timer;
+  timer.Init();
+  timer.Start();
+
+  ////
+  // load the points (without descriptors) and the model
+  parse_bundler parser;
+  if ( !parser.load_from_binary_nokey( bundle.c_str(), bundle_type ) )
+    return -1;
+  std::vector< feature_3D_info >& feature_infos = parser.get_feature_infos();
+  std::vector< bundler_camera >& camera_infos = parser.get_cameras();
+  uint32_t nb_points = (uint32_t) feature_infos.size();
+  uint32_t nb_cameras = (uint32_t) camera_infos.size();
+
+  hamming_embedding embedding;
+  hamming_model model;
+  if ( !model.load( hamming_input, embedding ) )
+    return -1;
+  if ( model.get_nb_points() != nb_points )
+  {
+    std::cerr << " ERROR: The model contains " << model.get_nb_points() << " points, but " << bundle << " contains " << nb_points << std::endl;
+    return -1;
+  }
+  uint32_t nb_clusters = model.get_nb_clusters();
+
+  timer.Stop();
+  std::cout << "-> loaded " << nb_points << " points seen by " << nb_cameras << " images and " << model.get_nb_descriptors() << " descriptors in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  ////
+  // the memory of every point in the localizer
+  std::vector< uint32_t > point_entries( nb_points, 0 );
+  std::vector< uint32_t > point_descriptors( nb_points, 0 );
+  std::vector< uint32_t > descriptor_point( model.get_nb_descriptors(), UINT32_MAX );
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    const uint32_t *pairs = model.get_assignments( vw );
+    for ( uint32_t j = 0; j < model.get_nb_assignments( vw ); ++j )
+    {
+      ++point_entries[pairs[2 * j]];
+      if ( descriptor_point[pairs[2 * j + 1]] == UINT32_MAX )
+      {
+        descriptor_point[pairs[2 * j + 1]] = pairs[2 * j];
+        ++point_descriptors[pairs[2 * j]];
+      }
+    }
+  }
+  std::vector< uint32_t >().swap( descriptor_point );
+
+  uint64_t total_memory = 0;
+  std::vector< uint64_t > point_bytes( nb_points, 0 );
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    point_bytes[i] = point_memory( (uint32_t) feature_infos[i].view_list.size(), point_entries[i], point_descriptors[i] );
+    total_memory += point_bytes[i];
+  }
+  uint64_t memory_budget = ( memory_budget_mb > 0.0 ) ? uint64_t( memory_budget_mb * 1024.0 * 1024.0 ) : UINT64_MAX;
+
+  ////
+  // greedy K-cover: an image is covered once it sees K selected points (or all of its points if it sees less)
+  timer.Init();
+  timer.Start();
+  for ( uint32_t c = 0; c < nb_cameras; ++c )
+  {
+    camera_infos[c].importance = (uint32_t) camera_infos[c].point_list.size();
+    camera_infos[c].cover = 0;
+    camera_infos[c].covered_flag = ( camera_infos[c].importance == 0 || K == 0 );
+  }
+
+  std::priority_queue< cover_candidate > candidates;
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    feature_infos[i].s_flag = false;
+    cover_candidate candidate;
+    candidate.gain = 0;
+    for ( size_t k = 0; k < feature_infos[i].view_list.size(); ++k )
+    {
+      uint32_t c = feature_infos[i].view_list[k].camera;
+      if ( c < nb_cameras && !camera_infos[c].covered_flag )
+        ++candidate.gain;
+    }
+    feature_infos[i].gain = (float) candidate.gain;
+    candidate.nb_views = (uint32_t) feature_infos[i].view_list.size();
+    candidate.point = i;
+    if ( candidate.gain > 0 )
+      candidates.push( candidate );
+  }
+
+  uint64_t selected_memory = 0;
+  uint32_t nb_selected = 0;
+  uint32_t nb_over_budget = 0;
+  while ( !candidates.empty() )
+  {
+    cover_candidate candidate = candidates.top();
+    candidates.pop();
+    feature_3D_info &info = feature_infos[candidate.point];
+
+    // recompute the gain, the candidate is only selected if it is still the best one
+    uint32_t gain = 0;
+    for ( size_t k = 0; k < info.view_list.size(); ++k )
+    {
+      uint32_t c = info.view_list[k].camera;
+      if ( c < nb_cameras && !camera_infos[c].covered_flag )
+        ++gain;
+    }
+    info.gain = (float) gain;
+    if ( gain == 0 )
+      continue;
+    if ( gain < candidate.gain )
+    {
+      candidate.gain = gain;
+      candidates.push( candidate );
+      continue;
+    }
+
+    if ( selected_memory + point_bytes[candidate.point] > memory_budget )
+    {
+      ++nb_over_budget;
+      continue;
+    }
+
+    info.s_flag = true;
+    selected_memory += point_bytes[candidate.point];
+    ++nb_selected;
+    for ( size_t k = 0; k < info.view_list.size(); ++k )
+    {
+      uint32_t c = info.view_list[k].camera;
+      if ( c >= nb_cameras )
+        continue;
+      ++camera_infos[c].cover;
+      if ( camera_infos[c].cover >= std::min( K, camera_infos[c].importance ) )
+        camera_infos[c].covered_flag = true;
+    }
+  }
+  uint32_t nb_cover_points = nb_selected;
+
+  // fill the remaining budget with the points seen by the most images
+  if ( memory_budget != UINT64_MAX )
+  {
+    std::vector< std::pair< uint32_t, uint32_t > > remaining;
+    for ( uint32_t i = 0; i < nb_points; ++i )
+    {
+      if ( !feature_infos[i].s_flag )
+        remaining.push_back( std::make_pair( (uint32_t) feature_infos[i].view_list.size(), i ) );
+    }
+    std::stable_sort( remaining.begin(), remaining.end(), std::greater< std::pair< uint32_t, uint32_t > >() );
+    for ( size_t j = 0; j < remaining.size(); ++j )
+    {
+      uint32_t i = remaining[j].second;
+      if ( selected_memory + point_bytes[i] > memory_budget )
+        continue;
+      feature_infos[i].s_flag = true;
+      selected_memory += point_bytes[i];
+      ++nb_selected;
+      for ( size_t k = 0; k < feature_infos[i].view_list.size(); ++k )
+      {
+        if ( feature_infos[i].view_list[k].camera < nb_cameras )
+          ++camera_infos[feature_infos[i].view_list[k].camera].cover;
+      }
+    }
+  }
+
+  uint32_t nb_covered = 0;
+  for ( uint32_t c = 0; c < nb_cameras; ++c )
+  {
+    if ( camera_infos[c].covered_flag )
+      ++nb_covered;
+  }
+  timer.Stop();
+  std::cout << "-> selected " << nb_cover_points << " points for the " << K << "-cover";
+  if ( memory_budget != UINT64_MAX )
+    std::cout << " and " << nb_selected - nb_cover_points << " points to fill the budget";
+  std::cout << " in " << timer.GetElapsedTime() << "s" << std::endl;
+  if ( nb_covered < nb_cameras )
+    std::cout << "  WARNING: " << nb_cameras - nb_covered << " images are not covered, " << nb_over_budget << " points did not fit into the memory budget" << std::endl;
+
+  ////
+  // write the reduced model, the points and descriptors are renumbered
+  timer.Init();
+  timer.Start();
+  std::vector< uint32_t > point_map( nb_points, UINT32_MAX );
+  uint32_t next_point = 0;
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    if ( feature_infos[i].s_flag )
+      point_map[i] = next_point++;
+  }
+
+  hamming_model reduced_model;
+  reduced_model.set_nb_points( nb_selected );
+  reduced_model.set_nb_clusters( nb_clusters );
+  std::vector< uint32_t > descriptor_map( model.get_nb_descriptors(), UINT32_MAX );
+  const std::vector< uint64_t > &signatures = model.get_signatures();
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    const uint32_t *pairs = model.get_assignments( vw );
+    for ( uint32_t j = 0; j < model.get_nb_assignments( vw ); ++j )
+    {
+      if ( point_map[pairs[2 * j]] == UINT32_MAX )
+        continue;
+      if ( descriptor_map[pairs[2 * j + 1]] == UINT32_MAX )
+        descriptor_map[pairs[2 * j + 1]] = reduced_model.add_descriptor( signatures[pairs[2 * j + 1]] );
+      reduced_model.add_assignment( vw, point_map[pairs[2 * j]], descriptor_map[pairs[2 * j + 1]] );
+    }
+  }
+  std::vector< uint32_t >().swap( descriptor_map );
+
+  // flag the stop words of the reduced lists, with the parameters used for the full model
+  stop_words words;
+  if ( !model.get_stop_words().empty() )
+    words.analyze( reduced_model, reduced_model.get_signatures(), model.get_stop_words().get_percentile(), model.get_stop_words().get_burst_ratio() );
+
+  if ( !embedding.save( hamming_output, reduced_model, reduced_model.get_signatures(), true, &words ) || !hamming_delta::discard( hamming_output ) )
+    return -1;
+  if ( !write_reduced_info( bundle, bundle_type, feature_infos, nb_selected, bundle_output ) )
+    return -1;
+  if ( !assignments_input.empty() )
+  {
+    vw_assignments assignments;
+    if ( !assignments.load( assignments_input ) )
+      return -1;
+    if ( assignments.get_nb_points() != nb_points )
+    {
+      std::cerr << " ERROR: " << assignments_input << " contains " << assignments.get_nb_points() << " points, but " << bundle << " contains " << nb_points << std::endl;
+      return -1;
+    }
+    if ( !write_reduced_assignments( assignments, point_map, nb_selected, assignments_output ) )
+      return -1;
+  }
+  timer.Stop();
+  std::cout << "-> wrote the compressed model to " << bundle_output << " and " << hamming_output;
+  if ( !assignments_output.empty() )
+    std::cout << " and " << assignments_output;
+  std::cout << " in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  ////
+  // report
+  uint64_t reduced_memory = 0;
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    if ( feature_infos[i].s_flag )
+      reduced_memory += point_bytes[i];
+  }
+  std::cout << "-> retained " << nb_selected << " of " << nb_points << " points (" << 100.0 * nb_selected / std::max( nb_points, (uint32_t) 1 ) << "%), "
+            << reduced_model.get_nb_descriptors() << " of " << model.get_nb_descriptors() << " descriptors" << std::endl;
+  std::cout << "-> memory in the localizer: " << total_memory / ( 1024.0 * 1024.0 ) << " MB -> " << reduced_memory / ( 1024.0 * 1024.0 ) << " MB, saved "
+            << ( total_memory - reduced_memory ) / ( 1024.0 * 1024.0 ) << " MB (" << 100.0 * ( total_memory - reduced_memory ) / std::max( total_memory, (uint64_t) 1 ) << "%)" << std::endl;
+  std::cout << "-> " << nb_covered << " of " << nb_cameras << " images see at least " << K << " selected points (or all of their points)" << std::endl;
+
+  ////
+  // recall of the retrieval stage on the held-out queries, for the original and the compressed model
+  if ( !query_list.empty() )
+  {
+    std::vector< held_out_query > queries;
+    if ( !load_held_out_queries( query_list, queries ) )
+      return -1;
+
+    visual_words_handler vw_handler;
+    vw_handler.set_nb_trees( 1 );
+    vw_handler.set_nb_visual_words( nb_clusters );
+    vw_handler.set_branching( nb_branching );
+    vw_handler.set_method( std::string( "flann" ) );
+    vw_handler.set_flann_type( std::string( "hkmeans" ) );
+    bool vocabulary_loaded = vocabulary_index_file.empty() ? vw_handler.create_flann_search_index( cluster_file ) : vw_handler.load_trees_flann( cluster_file, vocabulary_index_file );
+    if ( !vocabulary_loaded )
+    {
+      std::cerr << " ERROR: Could not load the cluster centers from " << cluster_file << std::endl;
+      return -1;
+    }
+    vw_handler.set_nb_paths( 1 );
+
+    std::vector< uint32_t > votes( nb_cameras, 0 );
+    std::vector< uint32_t > point_stamps( nb_points, 0 );
+    uint32_t stamp = 0;
+    uint32_t nb_evaluated = 0, nb_retrieved_original = 0, nb_retrieved_compressed = 0;
+    std::vector< uint32_t > words;
+    std::vector< uint64_t > query_signatures;
+    for ( size_t q = 0; q < queries.size(); ++q )
+    {
+      SIFT_loader key_loader;
+      key_loader.load_features( queries[q].key_filename.c_str(), LOWE );
+      std::vector< unsigned char* >& descriptors = key_loader.get_descriptors();
+      uint32_t nb_keypoints = (uint32_t) descriptors.size();
+      if ( nb_keypoints == 0 )
+      {
+        std::cout << "  WARNING: No features in " << queries[q].key_filename << std::endl;
+        continue;
+      }
+
+      words.resize( nb_keypoints );
+      vw_handler.assign_visual_words_ucharv( descriptors, nb_keypoints, words );
+      query_signatures.resize( nb_keypoints );
+      for ( uint32_t j = 0; j < nb_keypoints; ++j )
+        query_signatures[j] = embedding.compute_signature( descriptors[j], words[j] );
+      for ( uint32_t j = 0; j < nb_keypoints; ++j )
+      {
+        if ( descriptors[j] != 0 )
+          delete [] descriptors[j];
+        descriptors[j] = 0;
+      }
+      descriptors.clear();
+
+      ++nb_evaluated;
+      if ( retrieve( words, query_signatures, model, feature_infos, false, hamming_threshold, top_k, queries[q].cameras, votes, point_stamps, ++stamp ) )
+        ++nb_retrieved_original;
+      if ( retrieve( words, query_signatures, model, feature_infos, true, hamming_threshold, top_k, queries[q].cameras, votes, point_stamps, ++stamp ) )
+        ++nb_retrieved_compressed;
+    }
+
+    double denominator = std::max( nb_evaluated, (uint32_t) 1 );
+    std::cout << "-> retrieval recall (one of the images of the query among the top " << top_k << ") on " << nb_evaluated << " held-out queries: original "
+              << nb_retrieved_original / denominator << ", compressed " << nb_retrieved_compressed / denominator << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,78 @@
+#define __STDC_LIMIT_MACROS
+
+// C++ includes
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <stdlib.h>
+
+#include "features/hamming_embedding.hh"
+#include "features/hamming_model.hh"
+#include "features/hamming_delta.hh"
+
+// stopwatch
+#include "timer.hh"
+
+// load the model with nb_bits bit signatures and write it in the requested order
+template< int nb_bits >
+bool convert( const std::string &hamming_input, const std::string &hamming_output, bool descriptor_order )
+{
+  basic_hamming_model< nb_bits > model;
+  basic_hamming_embedding< nb_bits > embedding;
+  if ( !model.load( hamming_input, embedding ) )
+    return false;
+
+  std::cout << "* Loaded " << model.get_nb_descriptors() << " " << nb_bits << " bit signatures of " << model.get_nb_points() << " points in " << model.get_nb_clusters() << " visual words" << std::endl;
+  hamming_embedding::print_deduplication_statistics( model, model.get_signatures() );
+
+  // the stop word section is copied unchanged, the lists are the same. The entries of the delta file of the
+  // input were merged when loading, so the output has no delta file
+  return embedding.save( hamming_output, model, model.get_signatures(), !descriptor_order, &model.get_stop_words() ) && hamming_delta::discard( hamming_output );
+}
+
+
+int main (int argc, char **argv)
+{
+  if ( argc < 3 )
+  {
+    std::cout << "_______________________________________________________________________________________________" << std::endl;
+    std::cout << " -                                                                                           - " << std::endl;
+    std::cout << " -    Converts a hamming file (output of compute_hamming_threshold) into visual word order:  - " << std::endl;
+    std::cout << " -    the signatures are stored together with the 3D point ids of the entries of every word, - " << std::endl;
+    std::cout << " -    sorted by point id, instead of being referenced by descriptor id.                      - " << std::endl;
+    std::cout << " -                                                                                           - " << std::endl;
+    std::cout << " - usage: convert_hamming_model input output [descriptor_order]                              - " << std::endl;
+    std::cout << " - Parameters:                                                                               - " << std::endl;
+    std::cout << " -  argv[1]: The hamming file to convert (either order, with 32, 64 or 128 bit signatures)   - " << std::endl;
+    std::cout << " -  argv[2]: The output file                                                                 - " << std::endl;
+    std::cout << " -  argv[3]: If 1, the output is written in the original descriptor order instead (for tools - " << std::endl;
+    std::cout << " -           that do not read files in visual word order). Default: 0                        - " << std::endl;
+    std::cout << "_______________________________________________________________________________________________" << std::endl;
+    return -1;
+  }
+
+  std::string hamming_input( argv[1] );
+  std::string hamming_output( argv[2] );
+  bool descriptor_order = ( argc > 3 && atoi( argv[3] ) != 0 );
+
+  Timer timer;
+  timer.Init();
+  timer.Start();
+
+  // the signature width is taken from the header of the input
+  int nb_bits = read_signature_bits( hamming_input );
+  bool converted = false;
+  if ( nb_bits == 32 )
+    converted = convert< 32 >( hamming_input, hamming_output, descriptor_order );
+  else if ( nb_bits == 64 )
+    converted = convert< 64 >( hamming_input, hamming_output, descriptor_order );
+  else if ( nb_bits == 128 )
+    converted = convert< 128 >( hamming_input, hamming_output, descriptor_order );
+  if ( !converted )
+    return -1;
+
+  timer.Stop();
+  std::cout << "* Wrote " << hamming_output << " in " << ( descriptor_order ? "descriptor" : "visual word" ) << " order in " << timer.GetElapsedTime() << "s" << std::endl;
+  return 0;
+}
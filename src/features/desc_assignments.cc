@@ -0,0 +1,562 @@
+#include "desc_assignments.hh"
+
+#include <set>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <float.h>
+
+
+////
+// functions used to compute representative descriptors
+////
+
+// computes medoid descriptor from a vector of descriptors. returns the index of the medoids
+static uint32_t compute_medoid( const std::vector< unsigned char > &desc )
+{
+  uint32_t med_id = 0;
+
+  uint32_t nb_desc = uint32_t( desc.size() );
+
+  double max_dist = DBL_MAX;
+
+  for ( uint32_t i = 0; i < nb_desc; i += 128 )
+  {
+    double cur_dist = 0.0;
+    for ( uint32_t j = 0; j < nb_desc; j += 128 )
+    {
+      double dist = 0.0;
+      for ( uint32_t k = 0; k < 128; ++k )
+      {
+        double x = desc[i + k] - desc[j + k];
+        dist += x * x;
+      }
+      cur_dist += sqrt(dist);
+    }
+    if ( cur_dist < max_dist )
+    {
+      max_dist = cur_dist;
+      med_id = i / 128;
+    }
+  }
+
+  return med_id;
+}
+
+// computes the mean descriptor from a vectors of descriptors. the mean is stored in the variable mean
+static void compute_mean( const std::vector< unsigned char > &desc, std::vector< float > &mean )
+{
+  mean.resize( 128, 0 );
+  uint32_t N = (uint32_t) desc.size() / 128;
+  for ( uint32_t i = 0; i < N; ++i )
+  {
+    uint32_t index = i * 128;
+    for ( uint32_t j = 0; j < 128; ++j )
+      mean[j] += (float) desc[index + j];
+  }
+  float n = float(N);
+  for ( int j = 0; j < 128; ++j )
+    mean[j] /= n;
+}
+
+// rounds a mean descriptor to the nearest integer values
+static void round_mean( const std::vector< float > &mean_descriptor, std::vector< unsigned char > &integer_mean )
+{
+  integer_mean.assign( 128, 0 );
+  for ( int k = 0; k < 128; ++k )
+  {
+    float bottom =  mean_descriptor[k] - floor( mean_descriptor[k] );
+    float top =  ceil( mean_descriptor[k] ) - mean_descriptor[k];
+    if ( bottom < top )
+      integer_mean[k] = (unsigned char) floor( mean_descriptor[k] );
+    else
+      integer_mean[k] = (unsigned char) ceil( mean_descriptor[k] );
+  }
+}
+
+// gathers all descriptors of point info that are assigned to visual word vw
+static void gather_word_descriptors( const feature_3D_info &info, const uint32_t *point_assignments, size_t vw, std::vector< unsigned char > &visual_word_descriptors )
+{
+  visual_word_descriptors.clear();
+  size_t nb_desc_i = info.view_list.size();
+  for ( size_t j = 0; j < nb_desc_i; ++j )
+  {
+    if ( vw == point_assignments[j] )
+    {
+      for ( uint32_t k = uint32_t(j) * 128; k < uint32_t(j) * 128 + 128; ++k )
+        visual_word_descriptors.push_back(info.descriptors[k]);
+    }
+  }
+}
+
+//---------------------------------------------------
+
+desc_assignments::desc_assignments( )
+{
+  mMode = 6;
+}
+
+//---------------------------------------------------
+
+desc_assignments::~desc_assignments( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+void desc_assignments::quantize( std::vector< feature_3D_info > &feature_infos, visual_words_handler &vw_handler, int assignment_type, int nb_paths, uint32_t nb_cluster, std::vector< uint32_t > &descriptor_2_vw )
+{
+  uint32_t nb_points = (uint32_t) feature_infos.size();
+
+  uint32_t total_nb_descriptors = 0;
+  for ( uint32_t i = 0; i < nb_points; ++i )
+    total_nb_descriptors += (uint32_t) feature_infos[i].view_list.size();
+
+  descriptor_2_vw.resize( total_nb_descriptors );
+
+  // we do the assignments in batches of 10000 descriptors to speed things up
+  uint32_t batch_size = 10000;
+
+  uint32_t offset = 0;
+  uint32_t selected_desc = 0;
+  uint64_t index1, index2;
+  std::vector< unsigned char > tmp_descriptors( 128 * batch_size );
+
+  std::vector< uint32_t > cluster_assignments_( batch_size, 0 );
+
+  // execute the batches
+  uint32_t total_offset = 0;
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    uint32_t nb_desc_i = (uint32_t) feature_infos[i].view_list.size();
+
+    total_offset += nb_desc_i;
+
+    for ( uint32_t j = 0; j < nb_desc_i; ++j )
+    {
+      // copy the descriptor
+      index1 = selected_desc * 128;
+      index2 = uint64_t(j) * uint64_t(128);
+      for ( uint64_t k = 0; k < 128; ++k )
+        tmp_descriptors[index1 + k] = feature_infos[i].descriptors[index2 + k];
+
+      ++selected_desc;
+
+      // check if we have selected enough descriptors to do a batch assignment
+      if ( (selected_desc == batch_size) || (offset + selected_desc == total_nb_descriptors) || (total_offset + selected_desc == total_nb_descriptors ) )
+      {
+        //after iccv ,we change to 1
+        if ( assignment_type == 0 )
+          vw_handler.set_nb_paths( 10 );
+        else
+          vw_handler.set_nb_paths( nb_paths );
+
+        vw_handler.assign_visual_words_uchar( tmp_descriptors, selected_desc, cluster_assignments_ );
+
+        for ( uint32_t l = 0; l < selected_desc; ++l )
+        {
+          if ( cluster_assignments_[l] > nb_cluster )
+          {
+            std::cout << cluster_assignments_[l] << " : ";
+            for ( uint32_t ll = 0; ll < 128; ++ll )
+              std::cout << " " << int(tmp_descriptors[128 * l + ll]);
+            std::cout << std::endl;
+          }
+          descriptor_2_vw[offset + l] = cluster_assignments_[l];
+        }
+
+        if(offset % 1000000 == 0){
+                 std::cout << offset << " / " << total_nb_descriptors << std::endl;
+
+        }
+
+        offset += selected_desc;
+        selected_desc = 0;
+      }
+    }
+  }
+}
+
+//---------------------------------------------------
+
+bool desc_assignments::compute_representatives( std::vector< feature_3D_info > &feature_infos, const std::vector< uint32_t > &descriptor_2_vw, visual_words_handler &vw_handler, int mode, uint32_t nb_cluster )
+{
+  if ( mode < 0 || mode > 7 )
+  {
+    std::cerr << "[desc_assignments]: ERROR: Unknown mode " << mode << std::endl;
+    return false;
+  }
+
+  clear();
+  mMode = mode;
+
+  uint32_t nb_points = (uint32_t) feature_infos.size();
+
+  mPoints.resize( 3 * uint64_t( nb_points ) );
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    mPoints[3 * i] = feature_infos[i].point.x;
+    mPoints[3 * i + 1] = feature_infos[i].point.y;
+    mPoints[3 * i + 2] = feature_infos[i].point.z;
+  }
+
+  mAssignments.resize( nb_cluster );
+
+  uint32_t offset = 0;
+
+  std::vector< unsigned char > visual_word_descriptors;
+  std::vector< float > mean_descriptor;
+  std::vector< unsigned char > integer_mean;
+
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    // get the number of views of that point, which coincides with the number of
+    // descriptors available for that point
+    uint32_t nb_desc_i = (uint32_t) feature_infos[i].view_list.size();
+    const uint32_t *point_assignments = nb_desc_i > 0 ? &descriptor_2_vw[offset] : 0;
+
+    // determine the unique activated visual words
+    std::set< size_t > activated_visual_words;
+    for ( size_t j = 0; j < nb_desc_i; ++j )
+      activated_visual_words.insert( point_assignments[j] );
+
+    // compute representatives depending on the mode chosen by the user
+    if ( mode == 0 )
+    {
+      // compute for each visual word the medoid descriptors and store it
+      for ( std::set< size_t >::iterator it = activated_visual_words.begin(); it != activated_visual_words.end(); ++it )
+      {
+        // gather all descriptors assigned to visual word *it
+        gather_word_descriptors( feature_infos[i], point_assignments, *it, visual_word_descriptors );
+
+        // now compute the medoid
+        uint64_t med_id = compute_medoid( visual_word_descriptors );
+
+        // get the id of the new medoid descriptor for the (point id, descriptor id) pair
+        uint64_t desc_id = uint64_t( mDescriptors.size() ) / 128;
+
+        // add the new descriptor to the set of all used descriptors
+        for ( uint64_t k = 128 * med_id; k < (128 * med_id + 128 ); ++k )
+          mDescriptors.push_back(visual_word_descriptors[k]);
+
+        add_assignment( *it, i, desc_id );
+      }
+    }
+    else if ( mode == 3 )
+    {
+      // compute the medoid descriptor for the 3D point and assign it to all visual words that one of the
+      // descriptors is assigned to
+      uint32_t med_id = compute_medoid( feature_infos[i].descriptors );
+      uint32_t desc_id = uint32_t( mDescriptors.size() ) / 128;
+
+      // insert the medoid and add references to it
+      for ( uint32_t k = 128 * med_id; k < (128 * med_id + 128 ); ++k )
+        mDescriptors.push_back(feature_infos[i].descriptors[k]);
+
+      for ( std::set< size_t >::iterator it = activated_visual_words.begin(); it != activated_visual_words.end(); ++it )
+        add_assignment( *it, i, desc_id );
+    }
+    else if ( mode == 4 )
+    {
+      // compute for each visual word the mean descriptors
+      for ( std::set< size_t >::iterator it = activated_visual_words.begin(); it != activated_visual_words.end(); ++it )
+      {
+        gather_word_descriptors( feature_infos[i], point_assignments, *it, visual_word_descriptors );
+
+        mean_descriptor.clear();
+        compute_mean( visual_word_descriptors, mean_descriptor );
+
+        uint32_t desc_id = uint64_t( mDescriptorsFloat.size() ) / 128;
+
+        // store the descriptor
+        for ( uint32_t k = 0; k < 128; ++k )
+          mDescriptorsFloat.push_back(mean_descriptor[k]);
+
+        add_assignment( *it, i, desc_id );
+      }
+    }
+    else if ( mode == 5 )
+    {
+      // all descriptors: assign all descriptors belonging to the visual word to it
+      for ( std::set< size_t >::iterator it = activated_visual_words.begin(); it != activated_visual_words.end(); ++it )
+      {
+        for ( size_t j = 0; j < nb_desc_i; ++j )
+        {
+          if ( *it == point_assignments[j] )
+          {
+            uint32_t desc_id = uint64_t( mDescriptors.size() ) / 128;
+            for ( uint32_t k = uint32_t(j) * 128; k < uint32_t(j) * 128 + 128; ++k )
+              mDescriptors.push_back(feature_infos[i].descriptors[k]);
+            add_assignment( *it, i, desc_id );
+          }
+        }
+      }
+    }
+    else if ( mode == 6 )
+    {
+      // integer mean per visual word: compute for each visual word the mean descriptors,
+      // round it to the next integer and store it
+      for ( std::set< size_t >::iterator it = activated_visual_words.begin(); it != activated_visual_words.end(); ++it )
+      {
+        gather_word_descriptors( feature_infos[i], point_assignments, *it, visual_word_descriptors );
+
+        mean_descriptor.clear();
+        compute_mean( visual_word_descriptors, mean_descriptor );
+        round_mean( mean_descriptor, integer_mean );
+
+        uint32_t desc_id = uint64_t( mDescriptors.size() ) / 128;
+
+        // store the descriptor
+        for ( uint32_t k = 0; k < 128; ++k )
+          mDescriptors.push_back(integer_mean[k]);
+
+        add_assignment( *it, i, desc_id );
+      }
+    }
+    else if ( mode == 1 || mode == 2 )
+    {
+      // compute the mean descriptor
+      mean_descriptor.clear();
+      compute_mean( feature_infos[i].descriptors, mean_descriptor );
+
+      // store the descriptor
+      uint32_t desc_id = uint64_t( mDescriptorsFloat.size() ) / 128;
+
+      for ( uint32_t k = 0; k < 128; ++k )
+        mDescriptorsFloat.push_back(mean_descriptor[k]);
+
+      if ( mode == 1 )
+      {
+        std::vector< uint32_t > assignment(1, 0);
+        // compute the visual word of the mean descriptor and assign it to the word
+        vw_handler.set_nb_paths( 10 );
+        vw_handler.assign_visual_words_float( mean_descriptor, 1, assignment );
+
+        add_assignment( assignment[0], i, desc_id );
+      }
+      else
+      {
+        // store the reference to the mean descriptor in all activated visual words
+        for ( std::set< size_t >::iterator it = activated_visual_words.begin(); it != activated_visual_words.end(); ++it )
+          add_assignment( *it, i, desc_id );
+      }
+    }
+    else if ( mode == 7 )
+    {
+      // compute the mean descriptor and round it to the nearest integer values
+      mean_descriptor.clear();
+      compute_mean( feature_infos[i].descriptors, mean_descriptor );
+      round_mean( mean_descriptor, integer_mean );
+
+      uint32_t desc_id = uint64_t( mDescriptors.size() ) / 128;
+
+      // store the descriptor
+      for ( uint32_t k = 0; k < 128; ++k )
+        mDescriptors.push_back(integer_mean[k]);
+
+      std::vector< uint32_t > assignment(1, 0);
+      // compute the visual word of the mean descriptor and assign it to the word
+      vw_handler.set_nb_paths( 10 );
+      vw_handler.assign_visual_words_float( mean_descriptor, 1, assignment );
+
+      add_assignment( assignment[0], i, desc_id );
+    }
+
+    offset += nb_desc_i;
+  }
+
+  return true;
+}
+
+//---------------------------------------------------
+
+void desc_assignments::add_assignment( uint32_t vw, uint32_t point_id, uint32_t desc_id )
+{
+  mAssignments[vw].push_back( point_id );
+  mAssignments[vw].push_back( desc_id );
+}
+
+//---------------------------------------------------
+
+void desc_assignments::print_statistics( ) const
+{
+  uint32_t nb_cluster = get_nb_clusters();
+  uint32_t nb_non_empty_vw = 0;
+  double points_per_vw = 0;
+  uint32_t max_polys = 0;
+  for ( uint32_t i = 0; i < nb_cluster; ++i )
+  {
+    uint32_t nb_pairs = get_nb_assignments( i );
+    if ( nb_pairs > 0 )
+    {
+      ++nb_non_empty_vw;
+      points_per_vw += (double) nb_pairs;
+      max_polys = std::max( max_polys, nb_pairs );
+    }
+  }
+
+  std::cout << std::endl << "################ statistics #################" << std::endl;
+  std::cout << " #activated vws: " << nb_non_empty_vw << " ( " << double(nb_non_empty_vw) / double(nb_cluster) * 100.0 << " % ) with " << points_per_vw / double(nb_non_empty_vw) << " 3D points on average (for activated polys), max: " << max_polys << std::endl;
+  std::cout << " # 3D points : " << get_nb_points() << std::endl;
+  std::cout << " # computed medoid descriptors: " << mDescriptors.size() / 128 << std::endl;
+  std::cout << " # computed mean descriptors: " << mDescriptorsFloat.size() / 128 << std::endl;
+  std::cout << "################ statistics #################" << std::endl << std::endl;
+}
+
+//---------------------------------------------------
+
+void desc_assignments::print_memory_requirements( ) const
+{
+  uint32_t nb_points = get_nb_points();
+  uint32_t nb_assignments = 0;
+  for ( uint32_t i = 0; i < get_nb_clusters(); ++i )
+    nb_assignments += get_nb_assignments( i );
+
+  std::cout << "***** Memory requirements ******" << std::endl;
+  std::cout << " " << nb_points << " points -> " << nb_points * 3 << " floats -> " << nb_points * uint32_t(3) * uint32_t( sizeof( float ) ) / ( uint32_t(1024) * uint32_t(1024) ) << " MB " << std::endl;
+  if ( uses_uchar_descriptors() )
+    std::cout << " " << uint32_t( mDescriptors.size() / 128 ) << " descriptors -> " << uint32_t( mDescriptors.size() ) << " unsigned chars -> " << uint32_t( mDescriptors.size() ) / ( uint32_t(1024) * uint32_t(1024) ) * sizeof( unsigned char ) << " MB " << std::endl;
+  else
+    std::cout << " " << uint32_t( mDescriptorsFloat.size() / 128 ) << " descriptors -> " << uint32_t( mDescriptorsFloat.size() ) << " floats -> " << uint32_t( mDescriptorsFloat.size() ) / ( uint32_t(1024) * uint32_t(1024) ) * sizeof( float ) << " MB " << std::endl;
+  std::cout << " " << nb_assignments << " assignments -> " << nb_assignments * 2 << " uint32_t -> " << nb_assignments * uint32_t(2) * uint32_t( sizeof( uint32_t ) ) / ( uint32_t(1024) * uint32_t(1024) ) << " MB " << std::endl;
+  if ( uses_uchar_descriptors() )
+    std::cout << " in total : " << nb_assignments * uint32_t(2) * uint32_t( sizeof( uint32_t ) ) / ( uint32_t(1024) * uint32_t(1024) ) + nb_points * uint32_t(3) * uint32_t( sizeof( float ) ) / ( uint32_t(1024) * uint32_t(1024) )  + uint32_t( mDescriptors.size() ) / ( uint32_t(1024) * uint32_t(1024) ) * sizeof( unsigned char ) << " MB " << std::endl;
+  else
+    std::cout << " in total : " << nb_assignments * uint32_t(2) * uint32_t( sizeof( uint32_t ) ) / ( uint32_t(1024) * uint32_t(1024) ) + nb_points * uint32_t(3) * uint32_t( sizeof( float ) ) / ( uint32_t(1024) * uint32_t(1024) )  + uint32_t( mDescriptorsFloat.size() ) / ( uint32_t(1024) * uint32_t(1024) ) * sizeof( float ) << " MB " << std::endl;
+}
+
+//---------------------------------------------------
+
+bool desc_assignments::save( const std::string &filename ) const
+{
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::binary );
+
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[desc_assignments]: ERROR: Could not write the descriptors to file " << filename << std::endl;
+    return false;
+  }
+
+  uint32_t nb_points = get_nb_points();
+  uint32_t nb_cluster = get_nb_clusters();
+  uint32_t nb_non_empty_vw = get_nb_non_empty_vw();
+  uint32_t nb_descriptors = get_nb_descriptors();
+
+  // first write the number of remaining 3D points and the number of vw and the number of non-empty visual words and the number of descriptors
+  ofs.write( (char*) &nb_points, sizeof( uint32_t ) );
+  ofs.write( (char*) &nb_cluster, sizeof( uint32_t ) );
+  ofs.write( (char*) &nb_non_empty_vw, sizeof( uint32_t ) );
+  ofs.write( (char*) &nb_descriptors, sizeof( uint32_t ) );
+
+  // then the 3D points together
+  if ( !mPoints.empty() )
+    ofs.write( (const char*) &mPoints[0], mPoints.size() * sizeof( float ) );
+
+  // now the descriptors
+  if ( uses_uchar_descriptors() )
+  {
+    if ( !mDescriptors.empty() )
+      ofs.write( (const char*) &mDescriptors[0], mDescriptors.size() * sizeof( unsigned char ) );
+  }
+  else
+  {
+    if ( !mDescriptorsFloat.empty() )
+      ofs.write( (const char*) &mDescriptorsFloat[0], mDescriptorsFloat.size() * sizeof( float ) );
+  }
+
+  // write out the assignments vw -> ( 3D point id, descriptor id )
+  // format: cluster_id nb_assignments assignments (as pairs of uint32_t )
+  for ( uint32_t i = 0; i < nb_cluster; ++i )
+  {
+    uint32_t nb_desc_assignments = get_nb_assignments( i );
+    ofs.write( (char*) &i, sizeof( uint32_t ) );
+    ofs.write( (char*) &nb_desc_assignments, sizeof( uint32_t ) );
+    if ( nb_desc_assignments > 0 )
+      ofs.write( (const char*) &mAssignments[i][0], mAssignments[i].size() * sizeof( uint32_t ) );
+  }
+
+  ofs.close();
+  return true;
+}
+
+//---------------------------------------------------
+
+bool desc_assignments::uses_uchar_descriptors( ) const
+{
+  return ( mMode == 0 || mMode == 3 || mMode == 5 || mMode == 6 || mMode == 7 );
+}
+
+//---------------------------------------------------
+
+void desc_assignments::clear( )
+{
+  mPoints.clear();
+  mDescriptors.clear();
+  mDescriptorsFloat.clear();
+  mAssignments.clear();
+}
+
+//---------------------------------------------------
+
+uint32_t desc_assignments::get_nb_points( ) const
+{
+  return uint32_t( mPoints.size() / 3 );
+}
+
+//---------------------------------------------------
+
+uint32_t desc_assignments::get_nb_clusters( ) const
+{
+  return uint32_t( mAssignments.size() );
+}
+
+//---------------------------------------------------
+
+uint32_t desc_assignments::get_nb_non_empty_vw( ) const
+{
+  uint32_t nb_non_empty_vw = 0;
+  for ( size_t i = 0; i < mAssignments.size(); ++i )
+  {
+    if ( !mAssignments[i].empty() )
+      ++nb_non_empty_vw;
+  }
+  return nb_non_empty_vw;
+}
+
+//---------------------------------------------------
+
+uint32_t desc_assignments::get_nb_descriptors( ) const
+{
+  if ( uses_uchar_descriptors() )
+    return uint32_t( mDescriptors.size() / 128 );
+  return uint32_t( mDescriptorsFloat.size() / 128 );
+}
+
+//---------------------------------------------------
+
+const unsigned char* desc_assignments::get_descriptors( ) const
+{
+  return mDescriptors.empty() ? 0 : &mDescriptors[0];
+}
+
+//---------------------------------------------------
+
+const float* desc_assignments::get_descriptors_float( ) const
+{
+  return mDescriptorsFloat.empty() ? 0 : &mDescriptorsFloat[0];
+}
+
+//---------------------------------------------------
+
+uint32_t desc_assignments::get_nb_assignments( uint32_t vw ) const
+{
+  return uint32_t( mAssignments[vw].size() / 2 );
+}
+
+//---------------------------------------------------
+
+const uint32_t* desc_assignments::get_assignments( uint32_t vw ) const
+{
+  return mAssignments[vw].empty() ? 0 : &mAssignments[vw][0];
+}
@@ -0,0 +1,92 @@
+#ifndef DESC_ASSIGNMENTS_HH
+#define DESC_ASSIGNMENTS_HH
+
+/**
+ *    Class to compute the assignments of the descriptors of 3D points to visual
+ *    words and to select the representative descriptors stored per visual word.
+ *    This is the in-memory counterpart of the .bin file written by
+ *    compute_desc_assignments (which can be read again with vw_assignments),
+ *    the accessors follow the same interface such that both can be passed to
+ *    hamming_embedding::embed.
+ *
+ *    Representative modes:
+ *     0 - Medoid per visual word (unsigned char)
+ *     1 - Mean per point, assigned to the visual word of the mean (float)
+ *     2 - Mean per point, assigned to every visual word of one of its descriptors (float)
+ *     3 - Medoid per point, assigned to every visual word of one of its descriptors (unsigned char)
+ *     4 - Mean per visual word (float)
+ *     5 - All descriptors (unsigned char)
+ *     6 - Integer mean per visual word (unsigned char)
+ *     7 - Integer mean per point, assigned to the visual word of the mean (unsigned char)
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "../sfm/parse_bundler.hh"
+#include "visual_words_handler.hh"
+
+
+class desc_assignments
+{
+  public:
+    //! constructor
+    desc_assignments( );
+
+    //! destructor
+    ~desc_assignments( );
+
+    /**
+     * Assign all descriptors of the 3D points to visual words (in batches of 10000 descriptors).
+     * descriptor_2_vw[k] is the visual word of the k-th descriptor, where descriptors are enumerated
+     * point by point in the order of the view lists.
+    **/
+    static void quantize( std::vector< feature_3D_info > &feature_infos, visual_words_handler &vw_handler, int assignment_type, int nb_paths, uint32_t nb_cluster, std::vector< uint32_t > &descriptor_2_vw );
+
+    //! compute the representative descriptors of all points for the given mode (see above), returns false for unknown modes
+    bool compute_representatives( std::vector< feature_3D_info > &feature_infos, const std::vector< uint32_t > &descriptor_2_vw, visual_words_handler &vw_handler, int mode, uint32_t nb_cluster );
+
+    //! print statistics about the number of activated visual words
+    void print_statistics( ) const;
+
+    //! print the memory requirements of the assignments
+    void print_memory_requirements( ) const;
+
+    //! save the assignments in the binary format read by vw_assignments and compute_hamming_threshold
+    bool save( const std::string &filename ) const;
+
+    //! returns true if the representatives are stored as unsigned chars, false if floats are used
+    bool uses_uchar_descriptors( ) const;
+
+    //! clears all data
+    void clear( );
+
+    // accessors following the interface of vw_assignments
+    uint32_t get_nb_points( ) const;
+    uint32_t get_nb_clusters( ) const;
+    uint32_t get_nb_non_empty_vw( ) const;
+    uint32_t get_nb_descriptors( ) const;
+    const unsigned char* get_descriptors( ) const;
+    const float* get_descriptors_float( ) const;
+    uint32_t get_nb_assignments( uint32_t vw ) const;
+    const uint32_t* get_assignments( uint32_t vw ) const;
+
+  private:
+    //! add a (point id, descriptor id) pair to a visual word
+    void add_assignment( uint32_t vw, uint32_t point_id, uint32_t desc_id );
+
+    int mMode;
+
+    //! the 3D point positions, 3 floats per point
+    std::vector< float > mPoints;
+
+    //! the representative descriptors, either as unsigned char or float values (depending on the mode)
+    std::vector< unsigned char > mDescriptors;
+    std::vector< float > mDescriptorsFloat;
+
+    //! for every visual word the (3D point id, descriptor id) pairs, stored as consecutive uint32_t
+    std::vector< std::vector< uint32_t > > mAssignments;
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include "hamming_delta.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <errno.h>
+
+
+template< int nb_bits >
+basic_hamming_delta< nb_bits >::basic_hamming_delta( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+basic_hamming_delta< nb_bits >::~basic_hamming_delta( )
+{
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+std::string basic_hamming_delta< nb_bits >::get_filename( const std::string &hamming_file )
+{
+  return hamming_file + ".delta";
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_delta< nb_bits >::load( const std::string &hamming_file, uint32_t nb_clusters, uint32_t nb_points )
+{
+  clear();
+  mNbPoints = nb_points;
+  mOffsets.assign( nb_clusters + 1, 0 );
+
+  std::string filename = get_filename( hamming_file );
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+    return true;
+
+  // read the entries of all sections, they are sorted by visual word below
+  std::vector< uint32_t > words;
+  std::string keyword;
+  while ( ifs >> keyword )
+  {
+    uint32_t nb_points_before, nb_points_after, nb_entries;
+    ifs >> nb_points_before >> nb_points_after >> nb_entries;
+    if ( keyword != "delta" || !ifs || nb_points_before != mNbPoints || nb_points_after < nb_points_before )
+    {
+      std::cerr << "[hamming_delta]: ERROR: " << filename << " does not extend the " << mNbPoints << " points of " << hamming_file << std::endl;
+      clear();
+      return false;
+    }
+    for ( uint32_t i = 0; i < nb_entries; ++i )
+    {
+      uint32_t vw, point;
+      signature_t signature;
+      ifs >> vw >> point >> signature;
+      if ( !ifs || vw >= nb_clusters || point < nb_points_before || point >= nb_points_after )
+      {
+        std::cerr << "[hamming_delta]: ERROR: Invalid entry in " << filename << std::endl;
+        clear();
+        return false;
+      }
+      words.push_back( vw );
+      mPoints.push_back( point );
+      mSignatures.push_back( signature );
+    }
+    mNbPoints = nb_points_after;
+  }
+  ifs.close();
+
+  // counting sort by visual word, the entries of a word keep the order of the file
+  for ( size_t i = 0; i < words.size(); ++i )
+    ++mOffsets[words[i] + 1];
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+    mOffsets[i + 1] += mOffsets[i];
+  std::vector< uint32_t > positions( mOffsets.begin(), mOffsets.end() - 1 );
+  std::vector< uint32_t > points( mPoints.size() );
+  std::vector< signature_t > signatures( mSignatures.size() );
+  for ( size_t i = 0; i < words.size(); ++i )
+  {
+    uint32_t position = positions[words[i]]++;
+    points[position] = mPoints[i];
+    signatures[position] = mSignatures[i];
+  }
+  mPoints.swap( points );
+  mSignatures.swap( signatures );
+  return true;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_delta< nb_bits >::append( const std::string &hamming_file, uint32_t nb_points_before, uint32_t nb_points_after, const std::vector< uint32_t > &words,
+                                             const std::vector< uint32_t > &points, const std::vector< signature_t > &signatures )
+{
+  // the section is written at once, such that a failed update does not leave a partial section
+  std::ostringstream section;
+  section << "delta " << nb_points_before << " " << nb_points_after << " " << words.size() << std::endl;
+  for ( size_t i = 0; i < words.size(); ++i )
+    section << words[i] << " " << points[i] << " " << signatures[i] << std::endl;
+
+  std::string filename = get_filename( hamming_file );
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::app );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[hamming_delta]: ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+  const std::string &data = section.str();
+  ofs.write( data.c_str(), data.size() );
+  ofs.close();
+  if ( !ofs )
+  {
+    std::cerr << "[hamming_delta]: ERROR: Could not append to " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_delta< nb_bits >::discard( const std::string &hamming_file )
+{
+  std::string filename = get_filename( hamming_file );
+  if ( ::remove( filename.c_str() ) == 0 )
+  {
+    std::cout << "[hamming_delta]: Removed " << filename << ", the entries appended to the previous " << hamming_file << " do not extend the new one" << std::endl;
+    return true;
+  }
+  if ( errno == ENOENT )
+    return true;
+  std::cerr << "[hamming_delta]: ERROR: Cannot remove " << filename << ", delete it before using " << hamming_file << std::endl;
+  return false;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_delta< nb_bits >::clear( )
+{
+  mNbPoints = 0;
+  mOffsets.assign( 1, 0 );
+  mPoints.clear();
+  mSignatures.clear();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_delta< nb_bits >::empty( ) const
+{
+  return mPoints.empty();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_delta< nb_bits >::get_nb_points( ) const
+{
+  return mNbPoints;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_delta< nb_bits >::get_nb_entries( ) const
+{
+  return uint32_t( mPoints.size() );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_delta< nb_bits >::get_nb_entries( uint32_t vw ) const
+{
+  return ( vw + 1 < mOffsets.size() ) ? mOffsets[vw + 1] - mOffsets[vw] : 0;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const uint32_t* basic_hamming_delta< nb_bits >::get_points( uint32_t vw ) const
+{
+  return get_nb_entries( vw ) == 0 ? 0 : &mPoints[mOffsets[vw]];
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const typename basic_hamming_delta< nb_bits >::signature_t* basic_hamming_delta< nb_bits >::get_signatures( uint32_t vw ) const
+{
+  return get_nb_entries( vw ) == 0 ? 0 : &mSignatures[mOffsets[vw]];
+}
+
+//---------------------------------------------------
+
+template class basic_hamming_delta< 32 >;
+template class basic_hamming_delta< 64 >;
+template class basic_hamming_delta< 128 >;
@@ -0,0 +1,101 @@
+#ifndef HAMMING_DELTA_HH
+#define HAMMING_DELTA_HH
+
+/**
+ *    Entries appended to a hamming file by update_localization_model. Instead
+ *    of rewriting the hamming file, an update appends a section to the text
+ *    file hamming_file.delta, such that its cost only depends on the number of
+ *    new entries. A section starts with the line
+ *
+ *      delta nb_points_before nb_points_after nb_entries
+ *
+ *    followed by one "visual word, 3D point id, signature" line per entry. The
+ *    first section extends the points of the hamming file, every following
+ *    section the points of the previous one. The readers of hamming files
+ *    (hamming_model, the localizer and the shards) merge the entries into the
+ *    lists of their words, after the entries of the hamming file. Since the
+ *    new points are numbered after the existing ones, the entries of every
+ *    merged list stay sorted by point id.
+ *
+ *    A delta file only extends the hamming file it was appended to. The tools
+ *    writing a hamming file (compute_hamming_threshold, build_localization_model,
+ *    convert_hamming_model and compress_localization_model) remove the delta
+ *    file of their output once it is written, see discard.
+ *
+ *    The stop word section of the hamming file describes the lists without the
+ *    delta entries, readers flag the stop words again with its parameters.
+ *    The class is instantiated for 32, 64 and 128 bit signatures, hamming_delta
+ *    holds 64 bit signatures.
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "hamming_signature.hh"
+
+
+template< int nb_bits >
+class basic_hamming_delta
+{
+  public:
+    typedef typename hamming_signature< nb_bits >::type signature_t;
+
+    //! constructor
+    basic_hamming_delta( );
+
+    //! destructor
+    ~basic_hamming_delta( );
+
+    //! the name of the delta file of a hamming file
+    static std::string get_filename( const std::string &hamming_file );
+
+    /**
+     * Load the delta file of a hamming file with nb_clusters visual words and nb_points 3D points. If there
+     * is no delta file, nothing is loaded (see empty) and true is returned. Returns false if the file is
+     * invalid or its sections do not extend the given number of points.
+    **/
+    bool load( const std::string &hamming_file, uint32_t nb_clusters, uint32_t nb_points );
+
+    /**
+     * Append a section to the delta file of a hamming file: the points nb_points_before to
+     * nb_points_after - 1 with the entries (words[i], points[i], signatures[i]).
+    **/
+    static bool append( const std::string &hamming_file, uint32_t nb_points_before, uint32_t nb_points_after, const std::vector< uint32_t > &words,
+                        const std::vector< uint32_t > &points, const std::vector< signature_t > &signatures );
+
+    /**
+     * Remove the delta file of a hamming file that was written again, its entries are part of the new file or
+     * belong to a replaced model. Returns true if there is no delta file anymore.
+    **/
+    static bool discard( const std::string &hamming_file );
+
+    //! clears all data
+    void clear( );
+
+    //! returns true if no entries were loaded
+    bool empty( ) const;
+
+    //! the number of 3D points after the last section
+    uint32_t get_nb_points( ) const;
+
+    //! the total number of entries
+    uint32_t get_nb_entries( ) const;
+
+    //! the entries of a visual word in the order of the file
+    uint32_t get_nb_entries( uint32_t vw ) const;
+    const uint32_t* get_points( uint32_t vw ) const;
+    const signature_t* get_signatures( uint32_t vw ) const;
+
+  private:
+    uint32_t mNbPoints;
+
+    //! the entries of word vw are the entries mOffsets[vw] to mOffsets[vw+1]-1
+    std::vector< uint32_t > mOffsets;
+    std::vector< uint32_t > mPoints;
+    std::vector< signature_t > mSignatures;
+};
+
+typedef basic_hamming_delta< 64 > hamming_delta;
+
+#endif
@@ -0,0 +1,185 @@
+#include "hamming_embedding.hh"
+
+#include <iostream>
+#include <fstream>
+
+
+template< int nb_bits >
+basic_hamming_embedding< nb_bits >::basic_hamming_embedding( )
+{
+  mProjection.setZero();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+basic_hamming_embedding< nb_bits >::~basic_hamming_embedding( )
+{}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_embedding< nb_bits >::load_projection_matrix( const std::string &filename )
+{
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[hamming_embedding]: ERROR: Cannot read the projection matrix from " << filename << std::endl;
+    return false;
+  }
+
+  for ( int i = 0; i < nb_bits; ++i )
+  {
+    for ( int j = 0; j < 128; ++j )
+      ifs >> mProjection( i, j );
+  }
+  if ( !ifs )
+  {
+    std::cerr << "[hamming_embedding]: ERROR: " << filename << " has less than " << nb_bits << " rows of 128 values" << std::endl;
+    return false;
+  }
+  ifs.close();
+
+  return true;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const typename basic_hamming_embedding< nb_bits >::projection_matrix_t& basic_hamming_embedding< nb_bits >::get_projection_matrix( ) const
+{
+  return mProjection;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_embedding< nb_bits >::set_projection_matrix( const projection_matrix_t &projection )
+{
+  mProjection = projection;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const typename basic_hamming_embedding< nb_bits >::threshold_matrix_t& basic_hamming_embedding< nb_bits >::get_thresholds( ) const
+{
+  return mThresholds;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_embedding< nb_bits >::set_thresholds( const threshold_matrix_t &thresholds )
+{
+  mThresholds = thresholds;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+typename basic_hamming_embedding< nb_bits >::signature_t basic_hamming_embedding< nb_bits >::compute_signature( const unsigned char *descriptor, uint32_t vw ) const
+{
+  Eigen::Matrix< float, 128, 1 > sift;
+  for ( int k = 0; k < 128; ++k )
+    sift[k] = (float) descriptor[k];
+  Eigen::Matrix< float, nb_bits, 1 > proj_sift = mProjection * sift;
+
+  signature_t signature = signature_t();
+  for ( int k = 0; k < nb_bits; ++k )
+  {
+    if ( proj_sift[k] > mThresholds( k, vw ) )
+      set_signature_bit( signature, k );
+  }
+  return signature;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_embedding< nb_bits >::embed_visual_word( const unsigned char *descriptors, const uint32_t *desc_ids, uint32_t nb_desc, uint32_t stride, float *thresholds, signature_t *signatures ) const
+{
+  if ( nb_desc == 0 )
+  {
+    for ( int k = 0; k < nb_bits; ++k )
+      thresholds[k] = 0.0f;
+    return;
+  }
+
+  // gather the descriptors of the word and project all of them with a single matrix product
+  Eigen::Matrix< float, 128, Eigen::Dynamic > sift( 128, nb_desc );
+  for ( uint32_t j = 0; j < nb_desc; ++j )
+  {
+    const unsigned char *desc = descriptors + uint64_t( desc_ids[stride * j] ) * 128;
+    for ( int k = 0; k < 128; ++k )
+      sift( k, j ) = (float) desc[k];
+  }
+  Eigen::Matrix< float, nb_bits, Eigen::Dynamic > proj_sift = mProjection * sift;
+
+  // the threshold of each dimension is the median of the projected values
+  const uint32_t median_element = nb_desc / 2;
+  std::vector< float > entries( nb_desc );
+  for ( int k = 0; k < nb_bits; ++k )
+  {
+    for ( uint32_t j = 0; j < nb_desc; ++j )
+      entries[j] = proj_sift( k, j );
+    std::nth_element( entries.begin(), entries.begin() + median_element, entries.end() );
+    thresholds[k] = entries[median_element];
+  }
+
+  // binarize the projected descriptors
+  for ( uint32_t j = 0; j < nb_desc; ++j )
+  {
+    signature_t signature = signature_t();
+    for ( int k = 0; k < nb_bits; ++k )
+    {
+      if ( proj_sift( k, j ) > thresholds[k] )
+        set_signature_bit( signature, k );
+    }
+    signatures[desc_ids[stride * j]] = signature;
+  }
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_embedding< nb_bits >::read_word_order_keyword( std::istream &is )
+{
+  // files in descriptor order start with the number of 3D points
+  is >> std::ws;
+  if ( is.peek() != 'w' )
+    return false;
+  std::string keyword;
+  is >> keyword;
+  return ( keyword == "word_order" );
+}
+
+//---------------------------------------------------
+
+int read_signature_bits( const std::string &filename )
+{
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[hamming_embedding]: ERROR: Cannot read " << filename << std::endl;
+    return 0;
+  }
+
+  // the number of bits is the last value of the second line of the header
+  hamming_embedding::read_word_order_keyword( ifs );
+  uint32_t nb_points, nb_clusters, nb_non_empty_vw, nb_descriptors;
+  int num_words, num_dimensions, num_bits;
+  ifs >> nb_points >> nb_clusters >> nb_non_empty_vw >> nb_descriptors >> num_words >> num_dimensions >> num_bits;
+  if ( !ifs || ( num_bits != 32 && num_bits != 64 && num_bits != 128 ) )
+  {
+    std::cerr << "[hamming_embedding]: ERROR: " << filename << " is not a hamming file with 32, 64 or 128 bit signatures" << std::endl;
+    return 0;
+  }
+  return num_bits;
+}
+
+//---------------------------------------------------
+
+template class basic_hamming_embedding< 32 >;
+template class basic_hamming_embedding< 64 >;
+template class basic_hamming_embedding< 128 >;
@@ -0,0 +1,261 @@
+#ifndef HAMMING_EMBEDDING_HH
+#define HAMMING_EMBEDDING_HH
+
+/**
+ *    Hamming embedding of SIFT descriptors: A nb_bits x 128 projection matrix
+ *    maps every descriptor into a nb_bits dimensional space, where it is
+ *    binarized using per visual word thresholds (the median of the projected
+ *    database descriptors assigned to that word). The resulting signatures are
+ *    compared using the Hamming distance. The class is instantiated for 32, 64
+ *    and 128 bit signatures (see hamming_signature.hh), hamming_embedding is the
+ *    64 bit version used by the tools that only support the original width.
+ *
+ *    The thresholds and the signatures of the database descriptors are computed
+ *    in a single pass per visual word. Visual words are processed in parallel
+ *    (OpenMP, dynamic scheduling, largest words first) since the number of
+ *    descriptors per word is very skewed.
+ *
+ *    The text file read by the localization exists in two layouts. The original
+ *    one (descriptor order) lists the signatures of all descriptors, indexed by
+ *    descriptor id, followed by the (3D point id, descriptor id) pairs of every
+ *    visual word. Files in visual word order start with the keyword word_order
+ *    and store the (3D point id, signature) pairs of every visual word, sorted by
+ *    point id, such that the entries of a word can be read without indirection.
+ *    The descriptor id of an entry is its position in the file. The number of
+ *    bits of the signatures is stored in the header of both layouts and can be
+ *    read with read_signature_bits to choose the instantiation for a file.
+ *    Both layouts can end with the stop word section (see stop_words.hh).
+**/
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <stdint.h>
+
+#include <Eigen/Dense>
+
+#include "hamming_signature.hh"
+#include "stop_words.hh"
+
+
+template< int nb_bits >
+class basic_hamming_embedding
+{
+  public:
+    typedef typename hamming_signature< nb_bits >::type signature_t;
+    typedef Eigen::Matrix< float, nb_bits, 128, Eigen::RowMajor > projection_matrix_t;
+    typedef Eigen::Matrix< float, nb_bits, Eigen::Dynamic > threshold_matrix_t;
+
+    //! constructor
+    basic_hamming_embedding( );
+
+    //! destructor
+    ~basic_hamming_embedding( );
+
+    //! load the projection matrix (the first nb_bits rows of 128 floats) from a text file
+    bool load_projection_matrix( const std::string &filename );
+
+    //! get / set the projection matrix
+    const projection_matrix_t& get_projection_matrix( ) const;
+    void set_projection_matrix( const projection_matrix_t &projection );
+
+    //! get / set the thresholds (one column of nb_bits values per visual word)
+    const threshold_matrix_t& get_thresholds( ) const;
+    void set_thresholds( const threshold_matrix_t &thresholds );
+
+    //! compute the signature of a descriptor (128 unsigned chars) assigned to visual word vw using the current thresholds
+    signature_t compute_signature( const unsigned char *descriptor, uint32_t vw ) const;
+
+    /**
+     * Compute the thresholds for one visual word and the signatures of its descriptors.
+     * desc_ids[stride * j] is the id of the j-th descriptor of the word, its entries are
+     * descriptors[128 * id] ... descriptors[128 * id + 127]. The nb_bits thresholds are stored in
+     * thresholds, the signature of descriptor id in signatures[id].
+     * Empty words get zero thresholds.
+    **/
+    void embed_visual_word( const unsigned char *descriptors, const uint32_t *desc_ids, uint32_t nb_desc, uint32_t stride, float *thresholds, signature_t *signatures ) const;
+
+    /**
+     * Compute the thresholds of all visual words and the signatures of all descriptors.
+     * assignments has to provide get_nb_clusters(), get_nb_assignments( vw ) and
+     * get_assignments( vw ), the latter returning (3D point id, descriptor id) pairs as
+     * consecutive uint32_t values (see vw_assignments).
+    **/
+    template< class assignment_lists >
+    void embed( const assignment_lists &assignments, const unsigned char *descriptors, uint32_t nb_descriptors, std::vector< signature_t > &signatures );
+
+    /**
+     * Save the thresholds, the projection matrix, the signatures and the assignments into the text file
+     * read by the localization (the output format of compute_hamming_threshold), in visual word order
+     * or, if word_order is false, in descriptor order. If words is given and not empty, its costs and stop
+     * word flags are appended.
+    **/
+    template< class assignment_lists >
+    bool save( const std::string &filename, const assignment_lists &assignments, const std::vector< signature_t > &signatures, bool word_order = true, const stop_words *words = 0 ) const;
+
+    /**
+     * Print the number of entries and the number of distinct signatures per visual word (summed over all
+     * words), i.e., the number of signatures the localization has to compare to a query feature with and
+     * without deduplicating identical signatures within a word. Works for signatures of any width.
+    **/
+    template< class assignment_lists, class signature_type >
+    static void print_deduplication_statistics( const assignment_lists &assignments, const std::vector< signature_type > &signatures );
+
+    //! returns true and skips the keyword if the stream is at the start of a file in visual word order
+    static bool read_word_order_keyword( std::istream &is );
+
+  private:
+    projection_matrix_t mProjection;
+
+    threshold_matrix_t mThresholds;
+};
+
+typedef basic_hamming_embedding< 64 > hamming_embedding;
+
+//! the number of bits of the signatures of a hamming file (32, 64 or 128), 0 if the file cannot be read or the width is not supported
+int read_signature_bits( const std::string &filename );
+
+//---------------------------------------------------
+
+template< int nb_bits >
+template< class assignment_lists >
+void basic_hamming_embedding< nb_bits >::embed( const assignment_lists &assignments, const unsigned char *descriptors, uint32_t nb_descriptors, std::vector< signature_t > &signatures )
+{
+  uint32_t nb_clusters = assignments.get_nb_clusters();
+  mThresholds.resize( nb_bits, nb_clusters );
+  signatures.assign( nb_descriptors, signature_t() );
+  if ( nb_descriptors == 0 )
+  {
+    mThresholds.setZero();
+    return;
+  }
+
+  // process the largest visual words first such that they do not end up as stragglers
+  std::vector< std::pair< uint32_t, uint32_t > > word_order( nb_clusters );
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+    word_order[i] = std::make_pair( assignments.get_nb_assignments( i ), i );
+  std::sort( word_order.begin(), word_order.end(), std::greater< std::pair< uint32_t, uint32_t > >() );
+
+  int nb_words = (int) nb_clusters;
+  #pragma omp parallel for schedule(dynamic, 1)
+  for ( int i = 0; i < nb_words; ++i )
+  {
+    uint32_t vw = word_order[i].second;
+    // every descriptor belongs to exactly one visual word, so the threads write disjoint signatures
+    const uint32_t *word_assignments = assignments.get_assignments( vw );
+    embed_visual_word( descriptors, word_assignments == 0 ? 0 : word_assignments + 1, assignments.get_nb_assignments( vw ), 2, mThresholds.col( vw ).data(), &signatures[0] );
+  }
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+template< class assignment_lists, class signature_type >
+void basic_hamming_embedding< nb_bits >::print_deduplication_statistics( const assignment_lists &assignments, const std::vector< signature_type > &signatures )
+{
+  uint64_t nb_entries = 0, nb_distinct = 0;
+  std::vector< signature_type > word_signatures;
+  for ( uint32_t i = 0; i < assignments.get_nb_clusters(); ++i )
+  {
+    uint32_t in_word_nb = assignments.get_nb_assignments( i );
+    const uint32_t *word_assignments = assignments.get_assignments( i );
+    word_signatures.resize( in_word_nb );
+    for ( uint32_t j = 0; j < in_word_nb; ++j )
+      word_signatures[j] = signatures[word_assignments[2 * j + 1]];
+    std::sort( word_signatures.begin(), word_signatures.end() );
+    nb_entries += in_word_nb;
+    nb_distinct += std::unique( word_signatures.begin(), word_signatures.end() ) - word_signatures.begin();
+  }
+  std::cout << "[hamming_embedding]: " << nb_entries << " entries with " << nb_distinct << " distinct signatures per visual word, deduplication ratio "
+            << ( nb_distinct > 0 ? (double) nb_entries / (double) nb_distinct : 1.0 ) << std::endl;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+template< class assignment_lists >
+bool basic_hamming_embedding< nb_bits >::save( const std::string &filename, const assignment_lists &assignments, const std::vector< signature_t > &signatures, bool word_order, const stop_words *words ) const
+{
+  std::ofstream ofs( filename.c_str(), std::ios::out );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[hamming_embedding]: ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+
+  uint32_t nb_clusters = assignments.get_nb_clusters();
+
+  // in visual word order, every entry has its own signature
+  uint32_t nb_descriptors = assignments.get_nb_descriptors();
+  if ( word_order )
+  {
+    nb_descriptors = 0;
+    for ( uint32_t i = 0; i < nb_clusters; ++i )
+      nb_descriptors += assignments.get_nb_assignments( i );
+    ofs << "word_order" << std::endl;
+  }
+
+  ofs << assignments.get_nb_points() << " " << nb_clusters << " " << assignments.get_nb_non_empty_vw() << " " << nb_descriptors << std::endl;
+  ofs << nb_clusters << " 128 " << nb_bits << std::endl;
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+  {
+    for ( int j = 0; j < nb_bits; ++j )
+      ofs << std::setprecision(16) << mThresholds( j, i ) << " ";
+    ofs << std::endl;
+  }
+
+  for ( int i = 0; i < nb_bits; ++i )
+  {
+    for ( int j = 0; j < 128; ++j )
+      ofs << std::setprecision(16) << mProjection( i, j ) << " ";
+    ofs << std::endl;
+  }
+
+  if ( word_order )
+  {
+    // the (3D point id, signature) pairs of every visual word, sorted by point id
+    std::vector< std::pair< uint32_t, uint32_t > > entries;
+    for ( uint32_t i = 0; i < nb_clusters; ++i )
+    {
+      uint32_t in_word_nb = assignments.get_nb_assignments( i );
+      const uint32_t *word_assignments = assignments.get_assignments( i );
+      entries.resize( in_word_nb );
+      for ( uint32_t j = 0; j < in_word_nb; ++j )
+        entries[j] = std::make_pair( word_assignments[2 * j], word_assignments[2 * j + 1] );
+      std::sort( entries.begin(), entries.end() );
+      ofs << i << " " << in_word_nb << std::endl;
+      for ( uint32_t j = 0; j < in_word_nb; ++j )
+        ofs << entries[j].first << " " << signatures[entries[j].second] << " ";
+      ofs << std::endl;
+    }
+  }
+  else
+  {
+    // the binary descriptors
+    for ( size_t i = 0; i < signatures.size(); ++i )
+      ofs << signatures[i] << std::endl;
+
+    // the assignments
+    for ( uint32_t i = 0; i < nb_clusters; ++i )
+    {
+      uint32_t in_word_nb = assignments.get_nb_assignments( i );
+      const uint32_t *word_assignments = assignments.get_assignments( i );
+      ofs << i << " " << in_word_nb << std::endl;
+      for ( uint32_t j = 0; j < in_word_nb; ++j )
+        ofs << word_assignments[2 * j] << " " << word_assignments[2 * j + 1] << " ";
+      ofs << std::endl;
+    }
+  }
+
+  if ( words != 0 && !words->empty() )
+    words->save( ofs );
+
+  ofs.close();
+  return true;
+}
+
+#endif
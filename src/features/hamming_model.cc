@@ -0,0 +1,303 @@
+#include "hamming_model.hh"
+#include "hamming_delta.hh"
+
+#include <iostream>
+#include <fstream>
+
+
+template< int nb_bits >
+basic_hamming_model< nb_bits >::basic_hamming_model( )
+{
+  mNbPoints = 0;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+basic_hamming_model< nb_bits >::~basic_hamming_model( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_model< nb_bits >::load( const std::string &filename, basic_hamming_embedding< nb_bits > &embedding )
+{
+  clear();
+
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[hamming_model]: ERROR: Cannot read " << filename << std::endl;
+    return false;
+  }
+
+  bool word_order;
+  uint32_t nb_clusters, nb_descriptors;
+  if ( !read_header( ifs, filename, embedding, word_order, nb_clusters, nb_descriptors ) )
+    return false;
+
+  // the binary descriptors, in visual word order they are stored with the assignments
+  mSignatures.resize( word_order ? 0 : nb_descriptors );
+  for ( uint32_t i = 0; i < mSignatures.size(); ++i )
+    ifs >> mSignatures[i];
+  if ( word_order )
+    mSignatures.reserve( nb_descriptors );
+
+  // the assignments
+  mAssignments.resize( nb_clusters );
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+  {
+    uint32_t id, nb_pairs;
+    ifs >> id >> nb_pairs;
+    if ( !ifs || id >= nb_clusters )
+    {
+      std::cerr << "[hamming_model]: ERROR: Invalid assignments in " << filename << std::endl;
+      clear();
+      return false;
+    }
+    mAssignments[id].resize( 2 * nb_pairs );
+    if ( word_order )
+    {
+      // the entries are numbered in the order of the file
+      for ( uint32_t j = 0; j < nb_pairs; ++j )
+      {
+        mAssignments[id][2 * j + 1] = (uint32_t) mSignatures.size();
+        mSignatures.push_back( signature_t() );
+        ifs >> mAssignments[id][2 * j] >> mSignatures.back();
+      }
+    }
+    else
+    {
+      for ( uint32_t j = 0; j < 2 * nb_pairs; ++j )
+        ifs >> mAssignments[id][j];
+    }
+  }
+
+  if ( !ifs || mSignatures.size() != nb_descriptors )
+  {
+    std::cerr << "[hamming_model]: ERROR: " << filename << " is truncated" << std::endl;
+    clear();
+    return false;
+  }
+
+  // the optional stop word section
+  if ( !mStopWords.load( ifs, nb_clusters ) )
+  {
+    clear();
+    return false;
+  }
+
+  ifs.close();
+
+  // the entries appended by updates, the new signatures are numbered after the ones of the file
+  basic_hamming_delta< nb_bits > delta;
+  if ( !delta.load( filename, nb_clusters, mNbPoints ) )
+  {
+    clear();
+    return false;
+  }
+  if ( !delta.empty() )
+  {
+    for ( uint32_t i = 0; i < nb_clusters; ++i )
+    {
+      const uint32_t *points = delta.get_points( i );
+      const signature_t *signatures = delta.get_signatures( i );
+      for ( uint32_t j = 0; j < delta.get_nb_entries( i ); ++j )
+        add_assignment( i, points[j], add_descriptor( signatures[j] ) );
+    }
+    mNbPoints = delta.get_nb_points();
+    if ( !mStopWords.empty() )
+      mStopWords.analyze( *this, mSignatures, mStopWords.get_percentile(), mStopWords.get_burst_ratio() );
+  }
+  return true;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_model< nb_bits >::load_header( const std::string &filename, basic_hamming_embedding< nb_bits > &embedding )
+{
+  clear();
+
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[hamming_model]: ERROR: Cannot read " << filename << std::endl;
+    return false;
+  }
+
+  bool word_order;
+  uint32_t nb_clusters, nb_descriptors;
+  if ( !read_header( ifs, filename, embedding, word_order, nb_clusters, nb_descriptors ) )
+    return false;
+  mAssignments.resize( nb_clusters );
+  ifs.close();
+  return true;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_hamming_model< nb_bits >::read_header( std::istream &is, const std::string &filename, basic_hamming_embedding< nb_bits > &embedding, bool &word_order,
+                                                  uint32_t &nb_clusters, uint32_t &nb_descriptors )
+{
+  word_order = basic_hamming_embedding< nb_bits >::read_word_order_keyword( is );
+
+  uint32_t nb_non_empty_vw;
+  is >> mNbPoints >> nb_clusters >> nb_non_empty_vw >> nb_descriptors;
+
+  int num_words, num_dimensions, num_bits;
+  is >> num_words >> num_dimensions >> num_bits;
+  if ( !is || num_dimensions != 128 || num_bits != nb_bits || num_words != (int) nb_clusters )
+  {
+    std::cerr << "[hamming_model]: ERROR: Unsupported hamming file " << filename << " ( " << num_words << " words, " << num_dimensions << " dimensions, " << num_bits << " bits )" << std::endl;
+    return false;
+  }
+
+  // the hamming thresholds of the visual words
+  typename basic_hamming_embedding< nb_bits >::threshold_matrix_t thresholds( nb_bits, nb_clusters );
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+  {
+    for ( int j = 0; j < nb_bits; ++j )
+      is >> thresholds( j, i );
+  }
+  embedding.set_thresholds( thresholds );
+
+  // the projection matrix
+  typename basic_hamming_embedding< nb_bits >::projection_matrix_t projection;
+  for ( int i = 0; i < nb_bits; ++i )
+  {
+    for ( int j = 0; j < 128; ++j )
+      is >> projection( i, j );
+  }
+  embedding.set_projection_matrix( projection );
+  if ( !is )
+  {
+    std::cerr << "[hamming_model]: ERROR: " << filename << " is truncated" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_model< nb_bits >::clear( )
+{
+  mNbPoints = 0;
+  mSignatures.clear();
+  mAssignments.clear();
+  mStopWords.clear();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_model< nb_bits >::set_nb_points( uint32_t nb_points )
+{
+  mNbPoints = nb_points;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_model< nb_bits >::set_nb_clusters( uint32_t nb_clusters )
+{
+  mAssignments.resize( nb_clusters );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_model< nb_bits >::add_descriptor( signature_t signature )
+{
+  mSignatures.push_back( signature );
+  return uint32_t( mSignatures.size() - 1 );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_hamming_model< nb_bits >::add_assignment( uint32_t vw, uint32_t point_id, uint32_t desc_id )
+{
+  mAssignments[vw].push_back( point_id );
+  mAssignments[vw].push_back( desc_id );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const std::vector< typename basic_hamming_model< nb_bits >::signature_t >& basic_hamming_model< nb_bits >::get_signatures( ) const
+{
+  return mSignatures;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const stop_words& basic_hamming_model< nb_bits >::get_stop_words( ) const
+{
+  return mStopWords;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_model< nb_bits >::get_nb_points( ) const
+{
+  return mNbPoints;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_model< nb_bits >::get_nb_clusters( ) const
+{
+  return uint32_t( mAssignments.size() );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_model< nb_bits >::get_nb_non_empty_vw( ) const
+{
+  uint32_t nb_non_empty_vw = 0;
+  for ( size_t i = 0; i < mAssignments.size(); ++i )
+  {
+    if ( !mAssignments[i].empty() )
+      ++nb_non_empty_vw;
+  }
+  return nb_non_empty_vw;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_model< nb_bits >::get_nb_descriptors( ) const
+{
+  return uint32_t( mSignatures.size() );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_hamming_model< nb_bits >::get_nb_assignments( uint32_t vw ) const
+{
+  return uint32_t( mAssignments[vw].size() / 2 );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const uint32_t* basic_hamming_model< nb_bits >::get_assignments( uint32_t vw ) const
+{
+  return mAssignments[vw].empty() ? 0 : &mAssignments[vw][0];
+}
+
+//---------------------------------------------------
+
+template class basic_hamming_model< 32 >;
+template class basic_hamming_model< 64 >;
+template class basic_hamming_model< 128 >;
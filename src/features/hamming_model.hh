@@ -0,0 +1,93 @@
+#ifndef HAMMING_MODEL_HH
+#define HAMMING_MODEL_HH
+
+/**
+ *    Class holding the binary signatures of the database descriptors and the
+ *    (3D point id, descriptor id) pairs of every visual word, as stored in the
+ *    text file written by compute_hamming_threshold. The hamming thresholds
+ *    and the projection matrix of the file are stored in a hamming_embedding.
+ *    The accessors follow the interface of vw_assignments such that the model
+ *    can be passed to hamming_embedding::save. The model is instantiated for
+ *    32, 64 and 128 bit signatures, hamming_model holds 64 bit signatures.
+ *    The stop word section of the file, if present, is loaded as well, and
+ *    the entries of its delta file (see hamming_delta) are merged.
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "hamming_embedding.hh"
+
+
+template< int nb_bits >
+class basic_hamming_model
+{
+  public:
+    typedef typename hamming_signature< nb_bits >::type signature_t;
+
+    //! constructor
+    basic_hamming_model( );
+
+    //! destructor
+    ~basic_hamming_model( );
+
+    /**
+     * Load the model from a file written by compute_hamming_threshold (in either order), the thresholds and the
+     * projection matrix are stored in embedding. Fails if the signatures of the file do not have nb_bits bits.
+    **/
+    bool load( const std::string &filename, basic_hamming_embedding< nb_bits > &embedding );
+
+    /**
+     * Load only the header of a file written by compute_hamming_threshold: the number of points (without the
+     * delta file) and visual words, the thresholds and the projection matrix. The lists stay empty.
+    **/
+    bool load_header( const std::string &filename, basic_hamming_embedding< nb_bits > &embedding );
+
+    //! clears all data
+    void clear( );
+
+    //! set the number of 3D points the point ids refer to
+    void set_nb_points( uint32_t nb_points );
+
+    //! set the number of visual words, needed before assignments are added to an empty model
+    void set_nb_clusters( uint32_t nb_clusters );
+
+    //! add a new database descriptor with the given signature, returns its descriptor id
+    uint32_t add_descriptor( signature_t signature );
+
+    //! add a (3D point id, descriptor id) pair to a visual word
+    void add_assignment( uint32_t vw, uint32_t point_id, uint32_t desc_id );
+
+    //! get the signatures of all database descriptors (indexed by descriptor id)
+    const std::vector< signature_t >& get_signatures( ) const;
+
+    //! get the costs and stop word flags of the file (empty if the file has none)
+    const stop_words& get_stop_words( ) const;
+
+    // accessors following the interface of vw_assignments
+    uint32_t get_nb_points( ) const;
+    uint32_t get_nb_clusters( ) const;
+    uint32_t get_nb_non_empty_vw( ) const;
+    uint32_t get_nb_descriptors( ) const;
+    uint32_t get_nb_assignments( uint32_t vw ) const;
+    const uint32_t* get_assignments( uint32_t vw ) const;
+
+  private:
+    //! read the header and the thresholds and the projection matrix, shared by load and load_header
+    bool read_header( std::istream &is, const std::string &filename, basic_hamming_embedding< nb_bits > &embedding, bool &word_order,
+                      uint32_t &nb_clusters, uint32_t &nb_descriptors );
+
+    uint32_t mNbPoints;
+
+    std::vector< signature_t > mSignatures;
+
+    //! for every visual word the (3D point id, descriptor id) pairs, stored as consecutive uint32_t
+    std::vector< std::vector< uint32_t > > mAssignments;
+
+    stop_words mStopWords;
+};
+
+typedef basic_hamming_model< 64 > hamming_model;
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef HAMMING_SIGNATURE_HH
+#define HAMMING_SIGNATURE_HH
+
+/**
+ *    Binary signatures of the hamming embedding with 32, 64 or 128 bits. The
+ *    type of the signatures with nb_bits bits is hamming_signature< nb_bits >::type:
+ *    32 and 64 bit signatures are unsigned integers, 128 bit signatures are
+ *    stored in two 64 bit words. The functions below are overloaded for all
+ *    three types, such that the code computing, storing and comparing
+ *    signatures is written once as a template on the number of bits.
+ *
+ *    In text files, 32 and 64 bit signatures are written as decimal numbers,
+ *    128 bit signatures as 32 hexadecimal digits (most significant first).
+**/
+
+#include <bitset>
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+
+//! a 128 bit signature, bit k < 64 is bit k of low, bit k >= 64 is bit k - 64 of high
+struct signature128
+{
+  uint64_t low, high;
+
+  signature128( ) : low( 0 ), high( 0 ) {}
+
+  explicit signature128( uint64_t low_bits, uint64_t high_bits = 0 ) : low( low_bits ), high( high_bits ) {}
+
+  bool operator==( const signature128 &other ) const
+  {
+    return low == other.low && high == other.high;
+  }
+
+  bool operator!=( const signature128 &other ) const
+  {
+    return !( *this == other );
+  }
+
+  bool operator<( const signature128 &other ) const
+  {
+    return high < other.high || ( high == other.high && low < other.low );
+  }
+
+  signature128 operator^( const signature128 &other ) const
+  {
+    return signature128( low ^ other.low, high ^ other.high );
+  }
+};
+
+//! the signature type for a number of bits
+template< int nb_bits >
+struct hamming_signature;
+
+template<>
+struct hamming_signature< 32 >
+{
+  typedef uint32_t type;
+};
+
+template<>
+struct hamming_signature< 64 >
+{
+  typedef uint64_t type;
+};
+
+template<>
+struct hamming_signature< 128 >
+{
+  typedef signature128 type;
+};
+
+//---------------------------------------------------
+
+//! the number of bits set in a signature
+inline uint32_t signature_weight( uint32_t signature )
+{
+  return (uint32_t) std::bitset< 32 >( signature ).count();
+}
+
+inline uint32_t signature_weight( uint64_t signature )
+{
+  return (uint32_t) std::bitset< 64 >( signature ).count();
+}
+
+inline uint32_t signature_weight( const signature128 &signature )
+{
+  return (uint32_t) ( std::bitset< 64 >( signature.low ).count() + std::bitset< 64 >( signature.high ).count() );
+}
+
+//! the hamming distance of two signatures
+template< class signature_t >
+inline uint32_t hamming_distance( const signature_t &a, const signature_t &b )
+{
+  return signature_weight( a ^ b );
+}
+
+//---------------------------------------------------
+
+//! set bit k of a signature
+inline void set_signature_bit( uint32_t &signature, uint32_t k )
+{
+  signature |= uint32_t( 1 ) << k;
+}
+
+inline void set_signature_bit( uint64_t &signature, uint32_t k )
+{
+  signature |= uint64_t( 1 ) << k;
+}
+
+inline void set_signature_bit( signature128 &signature, uint32_t k )
+{
+  if ( k < 64 )
+    signature.low |= uint64_t( 1 ) << k;
+  else
+    signature.high |= uint64_t( 1 ) << ( k - 64 );
+}
+
+//---------------------------------------------------
+
+//! the mask of the lowest bits bits, bits <= 64
+inline uint64_t get_low_bits_mask( uint32_t bits )
+{
+  return ( bits >= 64 ) ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << bits ) - 1;
+}
+
+//! the bits shift to shift + bits - 1 of a signature, shifted to the lowest bits (bits <= 64)
+inline uint64_t get_signature_bits( uint32_t signature, uint32_t shift, uint32_t bits )
+{
+  return ( uint64_t( signature ) >> shift ) & get_low_bits_mask( bits );
+}
+
+inline uint64_t get_signature_bits( uint64_t signature, uint32_t shift, uint32_t bits )
+{
+  return ( shift >= 64 ) ? 0 : ( signature >> shift ) & get_low_bits_mask( bits );
+}
+
+inline uint64_t get_signature_bits( const signature128 &signature, uint32_t shift, uint32_t bits )
+{
+  if ( shift >= 64 )
+    return get_signature_bits( signature.high, shift - 64, bits );
+  if ( shift == 0 )
+    return signature.low & get_low_bits_mask( bits );
+  return ( ( signature.low >> shift ) | ( signature.high << ( 64 - shift ) ) ) & get_low_bits_mask( bits );
+}
+
+//---------------------------------------------------
+
+inline std::ostream& operator<<( std::ostream &os, const signature128 &signature )
+{
+  char digits[33];
+  snprintf( digits, sizeof( digits ), "%016llx%016llx", (unsigned long long) signature.high, (unsigned long long) signature.low );
+  return os << digits;
+}
+
+inline std::istream& operator>>( std::istream &is, signature128 &signature )
+{
+  std::string digits;
+  if ( !( is >> digits ) )
+    return is;
+  if ( digits.size() != 32 || digits.find_first_not_of( "0123456789abcdefABCDEF" ) != std::string::npos )
+  {
+    is.setstate( std::ios::failbit );
+    return is;
+  }
+  signature.high = (uint64_t) strtoull( digits.substr( 0, 16 ).c_str(), 0, 16 );
+  signature.low = (uint64_t) strtoull( digits.substr( 16 ).c_str(), 0, 16 );
+  return is;
+}
+
+#endif
@@ -0,0 +1,766 @@
+#define __STDC_LIMIT_MACROS
+
+#include "inverted_file.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <sys/time.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+// the decoder reads up to 16 bytes of data per group, the data array is padded such that this never leaves it
+static const size_t data_padding = 16;
+
+// byte length of a value in Stream VByte minus 1
+static inline uint32_t value_length_code( uint32_t value )
+{
+  if ( value < ( 1u << 8 ) )
+    return 0;
+  if ( value < ( 1u << 16 ) )
+    return 1;
+  if ( value < ( 1u << 24 ) )
+    return 2;
+  return 3;
+}
+
+// for every control byte, the number of data bytes of its group and the shuffle mask moving them into 4 uint32_t
+struct stream_vbyte_tables
+{
+  uint8_t lengths[256];
+  uint8_t shuffles[256][16];
+
+  stream_vbyte_tables( )
+  {
+    for ( int control = 0; control < 256; ++control )
+    {
+      uint8_t byte = 0;
+      for ( int k = 0; k < 4; ++k )
+      {
+        uint32_t length = ( ( control >> ( 2 * k ) ) & 3 ) + 1;
+        for ( uint32_t b = 0; b < 4; ++b )
+          shuffles[control][4 * k + b] = ( b < length ) ? byte++ : 0x80;
+      }
+      lengths[control] = byte;
+    }
+  }
+};
+
+static const stream_vbyte_tables svb_tables;
+
+// decode the 4 values of a group, returns the number of data bytes read
+static inline uint32_t decode_group( uint8_t control, const uint8_t *data, uint32_t *values )
+{
+#ifdef __SSSE3__
+  __m128i bytes = _mm_loadu_si128( (const __m128i*) data );
+  __m128i shuffle = _mm_loadu_si128( (const __m128i*) svb_tables.shuffles[control] );
+  _mm_storeu_si128( (__m128i*) values, _mm_shuffle_epi8( bytes, shuffle ) );
+#else
+  const uint8_t *ptr = data;
+  for ( int k = 0; k < 4; ++k )
+  {
+    uint32_t length = ( ( control >> ( 2 * k ) ) & 3 ) + 1;
+    uint32_t value = 0;
+    for ( uint32_t b = 0; b < length; ++b )
+      value |= uint32_t( ptr[b] ) << ( 8 * b );
+    values[k] = value;
+    ptr += length;
+  }
+#endif
+  return svb_tables.lengths[control];
+}
+
+// sequential reader of the values of a word
+struct stream_vbyte_reader
+{
+  const uint8_t *control;
+  const uint8_t *data;
+  uint32_t values[4];
+  uint32_t position;
+
+  stream_vbyte_reader( const uint8_t *list, uint32_t nb_groups )
+  {
+    control = list;
+    data = list + nb_groups;
+    position = 4;
+  }
+
+  inline uint32_t next( )
+  {
+    if ( position == 4 )
+    {
+      data += decode_group( *control++, data, values );
+      position = 0;
+    }
+    return values[position++];
+  }
+
+  // skip n values, full groups are skipped without decoding them
+  inline void skip( uint32_t n )
+  {
+    uint32_t in_group = std::min( n, 4 - position );
+    position += in_group;
+    n -= in_group;
+    for ( ; n >= 4; n -= 4 )
+      data += svb_tables.lengths[*control++];
+    if ( n > 0 )
+    {
+      data += decode_group( *control++, data, values );
+      position = n;
+    }
+  }
+};
+
+// the range of the number of bits of a substring of a multi-index, the tables have at most 2^11 buckets
+static const uint32_t min_substring_bits = 4;
+static const uint32_t max_substring_bits = 11;
+
+// parameters of the microbenchmark choosing the minimum size of an indexed word
+static const uint32_t min_calibration_codes = 64;
+static const uint32_t nb_calibration_queries = 64;
+static const uint32_t max_calibration_words = 8;
+
+// the number of values of a substring of the given number of bits within the radius
+static uint64_t get_nb_probes( uint32_t bits, uint32_t radius )
+{
+  uint64_t nb_probes = 0, binomial = 1;
+  for ( uint32_t k = 0; k <= radius && k <= bits; ++k )
+  {
+    nb_probes += binomial;
+    binomial = binomial * ( bits - k ) / ( k + 1 );
+  }
+  return nb_probes;
+}
+
+// all masks of the given number of bits with at most radius bits set (starting at bit start)
+static void enumerate_masks( uint32_t bits, uint32_t radius, uint32_t start, uint32_t mask, std::vector< uint32_t > &masks )
+{
+  masks.push_back( mask );
+  if ( radius == 0 )
+    return;
+  for ( uint32_t b = start; b < bits; ++b )
+    enumerate_masks( bits, radius - 1, b + 1, mask | ( 1u << b ), masks );
+}
+
+// the number of bits of substring i if nb_bits bits are split into nb_substrings substrings
+static inline uint32_t get_substring_bits( uint32_t i, uint32_t nb_substrings, uint32_t nb_bits )
+{
+  return nb_bits / nb_substrings + ( ( i < nb_bits % nb_substrings ) ? 1 : 0 );
+}
+
+// the expected number of probes and comparisons of a multi-index with uniformly distributed bits
+static double get_multi_index_cost( uint32_t nb_codes, uint32_t nb_substrings, uint32_t nb_bits, uint32_t threshold )
+{
+  double cost = 0.0;
+  for ( uint32_t i = 0; i < nb_substrings; ++i )
+  {
+    uint32_t bits = get_substring_bits( i, nb_substrings, nb_bits );
+    double nb_probes = (double) get_nb_probes( bits, threshold / nb_substrings );
+    cost += nb_probes * ( 1.0 + (double) nb_codes / (double) ( 1u << bits ) );
+  }
+  return cost;
+}
+
+static inline double get_time( )
+{
+  timeval time;
+  gettimeofday( &time, 0 );
+  return (double) time.tv_sec + 1e-6 * (double) time.tv_usec;
+}
+
+static inline uint64_t xorshift( uint64_t &state )
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+basic_inverted_file< nb_bits >::basic_inverted_file( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+basic_inverted_file< nb_bits >::~basic_inverted_file( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_inverted_file< nb_bits >::init( uint32_t nb_clusters )
+{
+  clear();
+  mNbClusters = nb_clusters;
+  mEntryOffsets.assign( nb_clusters + 1, 0 );
+  mCodeOffsets.assign( nb_clusters + 1, 0 );
+  mByteOffsets.assign( nb_clusters + 1, 0 );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_inverted_file< nb_bits >::clear( )
+{
+  mNbClusters = 0;
+  mNbAdded = 0;
+  mEntryOffsets.clear();
+  mCodeOffsets.clear();
+  mByteOffsets.clear();
+  mData.clear();
+  mSignatures.clear();
+  clear_multi_index();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_inverted_file< nb_bits >::add_list( uint32_t vw, const std::vector< std::pair< uint32_t, uint32_t > > &pairs, const std::vector< signature_t > &signatures )
+{
+  if ( vw < mNbAdded || vw >= mNbClusters )
+  {
+    std::cerr << "[inverted_file]: ERROR: Visual word " << vw << " is added out of order" << std::endl;
+    return false;
+  }
+
+  // skipped words are empty
+  for ( ; mNbAdded < vw; ++mNbAdded )
+  {
+    mEntryOffsets[mNbAdded + 1] = mEntryOffsets[mNbAdded];
+    mCodeOffsets[mNbAdded + 1] = mCodeOffsets[mNbAdded];
+    mByteOffsets[mNbAdded + 1] = mByteOffsets[mNbAdded];
+  }
+
+  // sort the entries by signature and point id, replacing the descriptor ids by the signatures
+  uint32_t nb_entries = (uint32_t) pairs.size();
+  std::vector< std::pair< signature_t, uint32_t > > entries( nb_entries );
+  for ( uint32_t j = 0; j < nb_entries; ++j )
+    entries[j] = std::make_pair( signatures[pairs[j].second], pairs[j].first );
+  std::sort( entries.begin(), entries.end() );
+
+  // the codes as (first point id, first entry) pairs, ordered by their first point id
+  std::vector< std::pair< uint32_t, uint32_t > > codes;
+  for ( uint32_t j = 0; j < nb_entries; ++j )
+  {
+    if ( j == 0 || entries[j].first != entries[j - 1].first )
+      codes.push_back( std::make_pair( entries[j].second, j ) );
+  }
+  std::sort( codes.begin(), codes.end() );
+  uint32_t nb_codes = (uint32_t) codes.size();
+
+  // for every code the number of entries, the difference of its first point id to the one of the
+  // previous code and the differences of the following point ids
+  std::vector< uint32_t > values;
+  values.reserve( nb_entries + nb_codes );
+  uint32_t previous_first = 0;
+  for ( uint32_t c = 0; c < nb_codes; ++c )
+  {
+    uint32_t start = codes[c].second;
+    uint32_t end = start + 1;
+    while ( end < nb_entries && entries[end].first == entries[start].first )
+      ++end;
+    mSignatures.push_back( entries[start].first );
+    values.push_back( end - start );
+    values.push_back( entries[start].second - previous_first );
+    previous_first = entries[start].second;
+    for ( uint32_t k = start + 1; k < end; ++k )
+      values.push_back( entries[k].second - entries[k - 1].second );
+  }
+
+  // control bytes first, then the data bytes, the last group is padded with zeros
+  uint32_t nb_groups = ( (uint32_t) values.size() + 3 ) / 4;
+  values.resize( 4 * nb_groups, 0 );
+  uint64_t control_start = mData.size();
+  mData.resize( control_start + nb_groups, 0 );
+  for ( uint32_t j = 0; j < values.size(); ++j )
+  {
+    uint32_t code = value_length_code( values[j] );
+    mData[control_start + j / 4] |= uint8_t( code << ( 2 * ( j % 4 ) ) );
+    for ( uint32_t b = 0; b <= code; ++b )
+      mData.push_back( uint8_t( values[j] >> ( 8 * b ) ) );
+  }
+
+  mEntryOffsets[vw + 1] = mEntryOffsets[vw] + nb_entries;
+  mCodeOffsets[vw + 1] = mCodeOffsets[vw] + nb_codes;
+  mByteOffsets[vw + 1] = mData.size();
+  mNbAdded = vw + 1;
+  return true;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_inverted_file< nb_bits >::finalize( )
+{
+  for ( ; mNbAdded < mNbClusters; ++mNbAdded )
+  {
+    mEntryOffsets[mNbAdded + 1] = mEntryOffsets[mNbAdded];
+    mCodeOffsets[mNbAdded + 1] = mCodeOffsets[mNbAdded];
+    mByteOffsets[mNbAdded + 1] = mByteOffsets[mNbAdded];
+  }
+  mData.resize( mData.size() + data_padding, 0 );
+
+  // release the memory reserved while the lists were added
+  std::vector< uint8_t >( mData ).swap( mData );
+  std::vector< signature_t >( mSignatures ).swap( mSignatures );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::get_nb_clusters( ) const
+{
+  return mNbClusters;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::get_nb_entries( ) const
+{
+  return mEntryOffsets.empty() ? 0 : mEntryOffsets.back();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::get_nb_entries( uint32_t vw ) const
+{
+  return mEntryOffsets[vw + 1] - mEntryOffsets[vw];
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::get_entry_offset( uint32_t vw ) const
+{
+  return mEntryOffsets[vw];
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::get_nb_codes( ) const
+{
+  return (uint32_t) mSignatures.size();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::get_nb_codes( uint32_t vw ) const
+{
+  return mCodeOffsets[vw + 1] - mCodeOffsets[vw];
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+const std::vector< typename basic_inverted_file< nb_bits >::signature_t >& basic_inverted_file< nb_bits >::get_signatures( ) const
+{
+  return mSignatures;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_inverted_file< nb_bits >::get_entries( uint32_t vw, std::vector< std::pair< uint32_t, uint32_t > > &entries ) const
+{
+  entries.clear();
+  uint32_t nb_groups = ( get_nb_entries( vw ) + get_nb_codes( vw ) + 3 ) / 4;
+  stream_vbyte_reader reader( &mData[mByteOffsets[vw]], nb_groups );
+  uint32_t first = 0;
+  for ( uint32_t c = mCodeOffsets[vw]; c < mCodeOffsets[vw + 1]; ++c )
+  {
+    uint32_t nb_code_entries = reader.next();
+    first += reader.next();
+    uint32_t point = first;
+    entries.push_back( std::make_pair( point, c ) );
+    for ( uint32_t k = 1; k < nb_code_entries; ++k )
+    {
+      point += reader.next();
+      entries.push_back( std::make_pair( point, c ) );
+    }
+  }
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::scan( uint32_t vw, signature_t signature, uint32_t threshold, std::vector< std::pair< uint32_t, uint32_t > > &hits ) const
+{
+  if ( threshold == mIndexThreshold && has_multi_index( vw ) )
+    return scan_multi_index( vw, signature, hits );
+  return scan_linear( vw, signature, threshold, hits );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::scan_linear( uint32_t vw, signature_t signature, uint32_t threshold, std::vector< std::pair< uint32_t, uint32_t > > &hits ) const
+{
+  uint32_t nb_groups = ( get_nb_entries( vw ) + get_nb_codes( vw ) + 3 ) / 4;
+  stream_vbyte_reader reader( &mData[mByteOffsets[vw]], nb_groups );
+
+  uint32_t first = 0;
+  for ( uint32_t c = mCodeOffsets[vw]; c < mCodeOffsets[vw + 1]; ++c )
+  {
+    // the first point id is needed by the next code
+    uint32_t nb_code_entries = reader.next();
+    first += reader.next();
+    uint32_t distance = hamming_distance( signature, mSignatures[c] );
+    if ( distance > threshold )
+    {
+      reader.skip( nb_code_entries - 1 );
+      continue;
+    }
+    uint32_t point = first;
+    hits.push_back( std::make_pair( point, distance ) );
+    for ( uint32_t k = 1; k < nb_code_entries; ++k )
+    {
+      point += reader.next();
+      hits.push_back( std::make_pair( point, distance ) );
+    }
+  }
+  return get_nb_entries( vw );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::scan_multi_index( uint32_t vw, signature_t signature, std::vector< std::pair< uint32_t, uint32_t > > &hits ) const
+{
+  const multi_index &index = mMultiIndices[mMultiIndexIds[vw]];
+  const signature_t *codes = &mSignatures[mCodeOffsets[vw]];
+  const uint32_t *point_offsets = &mIndexPointOffsets[index.point_offsets];
+
+  // the (code, hamming distance) pairs within the threshold
+  std::vector< std::pair< uint32_t, uint32_t > > matches;
+  uint32_t nb_compared = 0;
+  for ( uint32_t i = 0; i < index.nb_substrings; ++i )
+  {
+    const substring &s = mSubstrings[index.first_substring + i];
+    uint32_t key = (uint32_t) get_signature_bits( signature, s.shift, s.bits );
+    const uint32_t *offsets = &mBucketOffsets[s.bucket_offsets];
+    for ( uint32_t m = s.first_mask; m < s.last_mask; ++m )
+    {
+      uint32_t bucket = key ^ mProbeMasks[m];
+      for ( uint32_t k = offsets[bucket]; k < offsets[bucket + 1]; ++k )
+      {
+        uint32_t c = mTableCodes[s.table_codes + k];
+        signature_t difference = signature ^ codes[c];
+        nb_compared += point_offsets[c + 1] - point_offsets[c];
+        uint32_t distance = signature_weight( difference );
+        if ( distance > mIndexThreshold )
+          continue;
+
+        // the code was already found in an earlier table if its substring was within the radius there
+        bool reported = false;
+        for ( uint32_t j = 0; j < i && !reported; ++j )
+        {
+          const substring &t = mSubstrings[index.first_substring + j];
+          reported = ( signature_weight( get_signature_bits( difference, t.shift, t.bits ) ) <= index.radius );
+        }
+        if ( !reported )
+          matches.push_back( std::make_pair( c, distance ) );
+      }
+    }
+  }
+
+  // report the entries in entry order, as the linear scan
+  std::sort( matches.begin(), matches.end() );
+  for ( size_t i = 0; i < matches.size(); ++i )
+  {
+    uint32_t c = matches[i].first;
+    for ( uint32_t p = point_offsets[c]; p < point_offsets[c + 1]; ++p )
+      hits.push_back( std::make_pair( mIndexPoints[p], matches[i].second ) );
+  }
+  return nb_compared;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_inverted_file< nb_bits >::build_multi_index( uint32_t threshold, uint32_t min_codes )
+{
+  clear_multi_index();
+  mIndexThreshold = threshold;
+
+  // the probe masks are shared by all substrings with the same number of bits and radius
+  std::map< std::pair< uint32_t, uint32_t >, std::pair< uint32_t, uint32_t > > mask_ranges;
+  std::vector< std::pair< uint32_t, uint32_t > > entries;
+  std::vector< uint32_t > next;
+
+  for ( uint32_t vw = 0; vw < mNbClusters; ++vw )
+  {
+    uint32_t nb_codes = get_nb_codes( vw );
+    if ( nb_codes == 0 || nb_codes < min_codes )
+      continue;
+
+    // choose the number of substrings, index the word only if this is cheaper than comparing all codes
+    uint32_t nb_substrings = 0;
+    double best_cost = (double) nb_codes;
+    for ( uint32_t m = ( nb_bits + max_substring_bits - 1 ) / max_substring_bits; m <= nb_bits / min_substring_bits; ++m )
+    {
+      double cost = get_multi_index_cost( nb_codes, m, nb_bits, threshold );
+      if ( cost < best_cost )
+      {
+        best_cost = cost;
+        nb_substrings = m;
+      }
+    }
+    if ( nb_substrings == 0 )
+      continue;
+
+    if ( mMultiIndexIds.empty() )
+      mMultiIndexIds.assign( mNbClusters, UINT32_MAX );
+
+    multi_index index;
+    index.first_substring = (uint32_t) mSubstrings.size();
+    index.nb_substrings = nb_substrings;
+    index.radius = threshold / nb_substrings;
+    index.point_offsets = mIndexPointOffsets.size();
+
+    // the point ids of the codes, the entries of a code are consecutive
+    get_entries( vw, entries );
+    for ( size_t j = 0; j < entries.size(); ++j )
+    {
+      if ( j == 0 || entries[j].second != entries[j - 1].second )
+        mIndexPointOffsets.push_back( (uint32_t) mIndexPoints.size() );
+      mIndexPoints.push_back( entries[j].first );
+    }
+    mIndexPointOffsets.push_back( (uint32_t) mIndexPoints.size() );
+
+    // one table per substring
+    const signature_t *codes = &mSignatures[mCodeOffsets[vw]];
+    uint32_t shift = 0;
+    for ( uint32_t i = 0; i < nb_substrings; ++i )
+    {
+      substring s;
+      s.shift = shift;
+      s.bits = get_substring_bits( i, nb_substrings, nb_bits );
+      shift += s.bits;
+
+      std::pair< uint32_t, uint32_t > mask_key( s.bits, index.radius );
+      if ( mask_ranges.find( mask_key ) == mask_ranges.end() )
+      {
+        uint32_t first_mask = (uint32_t) mProbeMasks.size();
+        enumerate_masks( s.bits, index.radius, 0, 0, mProbeMasks );
+        mask_ranges[mask_key] = std::make_pair( first_mask, (uint32_t) mProbeMasks.size() );
+      }
+      s.first_mask = mask_ranges[mask_key].first;
+      s.last_mask = mask_ranges[mask_key].second;
+
+      uint32_t nb_buckets = 1u << s.bits;
+      s.bucket_offsets = mBucketOffsets.size();
+      s.table_codes = mTableCodes.size();
+      mBucketOffsets.resize( mBucketOffsets.size() + nb_buckets + 1, 0 );
+      mTableCodes.resize( mTableCodes.size() + nb_codes );
+      uint32_t *offsets = &mBucketOffsets[s.bucket_offsets];
+      for ( uint32_t c = 0; c < nb_codes; ++c )
+        ++offsets[get_signature_bits( codes[c], s.shift, s.bits ) + 1];
+      for ( uint32_t b = 0; b < nb_buckets; ++b )
+        offsets[b + 1] += offsets[b];
+      next.assign( offsets, offsets + nb_buckets );
+      for ( uint32_t c = 0; c < nb_codes; ++c )
+        mTableCodes[s.table_codes + next[get_signature_bits( codes[c], s.shift, s.bits )]++] = c;
+
+      mSubstrings.push_back( s );
+    }
+
+    mMultiIndexIds[vw] = (uint32_t) mMultiIndices.size();
+    mMultiIndices.push_back( index );
+  }
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::calibrate_multi_index( uint32_t threshold )
+{
+  build_multi_index( threshold, min_calibration_codes );
+  if ( mMultiIndices.empty() )
+  {
+    std::cout << "[inverted_file]: no visual word is large enough for a multi-index" << std::endl;
+    return UINT32_MAX;
+  }
+
+  // the words are grouped by the binary logarithm of their number of codes, a few words of every group are timed
+  std::vector< double > linear_time( 33, 0.0 ), index_time( 33, 0.0 );
+  std::vector< uint32_t > nb_timed_words( 33, 0 ), nb_timed_queries( 33, 0 );
+  std::vector< signature_t > queries( nb_calibration_queries );
+  std::vector< std::pair< uint32_t, uint32_t > > hits;
+  uint64_t state = 88172645463325252ull;
+
+  for ( uint32_t vw = 0; vw < mNbClusters; ++vw )
+  {
+    if ( !has_multi_index( vw ) )
+      continue;
+    uint32_t nb_codes = get_nb_codes( vw );
+    uint32_t size_class = 0;
+    while ( ( nb_codes >> ( size_class + 1 ) ) > 0 )
+      ++size_class;
+    if ( nb_timed_words[size_class] >= max_calibration_words )
+      continue;
+    ++nb_timed_words[size_class];
+
+    // half of the queries are codes of the word with a few flipped bits, the other half is random
+    const signature_t *codes = &mSignatures[mCodeOffsets[vw]];
+    for ( uint32_t q = 0; q < nb_calibration_queries; ++q )
+    {
+      signature_t flips = signature_t();
+      if ( q % 2 == 0 )
+      {
+        uint32_t nb_flips = (uint32_t) ( xorshift( state ) % ( threshold + 1 ) );
+        for ( uint32_t k = 0; k < nb_flips; ++k )
+          set_signature_bit( flips, (uint32_t) ( xorshift( state ) % nb_bits ) );
+      }
+      else
+      {
+        for ( uint32_t k = 0; k < nb_bits; ++k )
+        {
+          if ( xorshift( state ) & 1 )
+            set_signature_bit( flips, k );
+        }
+      }
+      queries[q] = codes[xorshift( state ) % nb_codes] ^ flips;
+    }
+
+    double start = get_time();
+    for ( uint32_t q = 0; q < nb_calibration_queries; ++q )
+    {
+      hits.clear();
+      scan_linear( vw, queries[q], threshold, hits );
+    }
+    double middle = get_time();
+    for ( uint32_t q = 0; q < nb_calibration_queries; ++q )
+    {
+      hits.clear();
+      scan_multi_index( vw, queries[q], hits );
+    }
+    double end = get_time();
+    linear_time[size_class] += middle - start;
+    index_time[size_class] += end - middle;
+    nb_timed_queries[size_class] += nb_calibration_queries;
+  }
+
+  // the crossover is the smallest size from which on the multi-index is faster for all larger words
+  uint32_t crossover_class = 33;
+  for ( int size_class = 32; size_class >= 0; --size_class )
+  {
+    if ( nb_timed_words[size_class] == 0 )
+      continue;
+    std::cout << "[inverted_file]: words with " << ( 1u << size_class ) << " to " << ( 2u << size_class ) - 1 << " codes: linear scan "
+              << 1e6 * linear_time[size_class] / nb_timed_queries[size_class] << "us, multi-index " << 1e6 * index_time[size_class] / nb_timed_queries[size_class]
+              << "us per query feature" << std::endl;
+    if ( index_time[size_class] >= linear_time[size_class] )
+      break;
+    crossover_class = (uint32_t) size_class;
+  }
+
+  if ( crossover_class == 33 )
+  {
+    clear_multi_index();
+    std::cout << "[inverted_file]: the linear scan is faster for all words, no multi-index is used" << std::endl;
+    return UINT32_MAX;
+  }
+
+  uint32_t min_codes = std::max( min_calibration_codes, 1u << crossover_class );
+  build_multi_index( threshold, min_codes );
+  return min_codes;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_inverted_file< nb_bits >::clear_multi_index( )
+{
+  mMultiIndexIds.clear();
+  mMultiIndices.clear();
+  mSubstrings.clear();
+  mBucketOffsets.clear();
+  mTableCodes.clear();
+  mIndexPointOffsets.clear();
+  mIndexPoints.clear();
+  mProbeMasks.clear();
+  mIndexThreshold = UINT32_MAX;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+bool basic_inverted_file< nb_bits >::has_multi_index( uint32_t vw ) const
+{
+  return !mMultiIndexIds.empty() && mMultiIndexIds[vw] != UINT32_MAX;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint32_t basic_inverted_file< nb_bits >::get_nb_indexed_words( ) const
+{
+  return (uint32_t) mMultiIndices.size();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint64_t basic_inverted_file< nb_bits >::get_multi_index_memory( ) const
+{
+  return sizeof( uint32_t ) * (uint64_t) ( mMultiIndexIds.size() + mBucketOffsets.size() + mTableCodes.size() + mIndexPointOffsets.size() + mIndexPoints.size() + mProbeMasks.size() )
+         + sizeof( multi_index ) * (uint64_t) mMultiIndices.size() + sizeof( substring ) * (uint64_t) mSubstrings.size();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint64_t basic_inverted_file< nb_bits >::get_memory( ) const
+{
+  return sizeof( uint32_t ) * (uint64_t) ( mEntryOffsets.size() + mCodeOffsets.size() ) + sizeof( uint64_t ) * (uint64_t) mByteOffsets.size()
+         + (uint64_t) mData.size() + sizeof( signature_t ) * (uint64_t) mSignatures.size() + get_multi_index_memory();
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+uint64_t basic_inverted_file< nb_bits >::get_uncompressed_memory( uint32_t nb_descriptors ) const
+{
+  uint64_t memory = sizeof( std::vector< std::pair< uint32_t, uint32_t > > ) * (uint64_t) mNbClusters;
+  for ( uint32_t vw = 0; vw < mNbClusters; ++vw )
+  {
+    uint32_t nb_entries = get_nb_entries( vw );
+    if ( nb_entries > 0 )
+      memory += 16 + sizeof( std::pair< uint32_t, uint32_t > ) * (uint64_t) nb_entries;
+  }
+  return memory + sizeof( signature_t ) * (uint64_t) nb_descriptors;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void basic_inverted_file< nb_bits >::print_memory_statistics( uint32_t nb_descriptors ) const
+{
+  double uncompressed = get_uncompressed_memory( nb_descriptors ) / ( 1024.0 * 1024.0 );
+  double compressed = get_memory() / ( 1024.0 * 1024.0 );
+  double encoded = ( mData.size() - data_padding ) / ( 1024.0 * 1024.0 );
+  uint32_t nb_entries = get_nb_entries();
+  std::cout << "[inverted_file]: " << nb_entries << " entries with " << get_nb_codes() << " distinct signatures in " << mNbClusters << " lists (deduplication ratio "
+            << ( get_nb_codes() > 0 ? (double) nb_entries / (double) get_nb_codes() : 1.0 ) << "): " << compressed << " MB (point ids and code sizes " << encoded << " MB, "
+            << ( nb_entries > 0 ? 8.0 * ( mData.size() - data_padding ) / nb_entries : 0.0 ) << " bits per entry), "
+            << uncompressed << " MB as vectors of (point, descriptor) pairs" << std::endl;
+}
+
+//---------------------------------------------------
+
+template class basic_inverted_file< 32 >;
+template class basic_inverted_file< 64 >;
+template class basic_inverted_file< 128 >;
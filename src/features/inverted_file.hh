@@ -0,0 +1,209 @@
+#ifndef INVERTED_FILE_HH
+#define INVERTED_FILE_HH
+
+/**
+ *    Compressed inverted file for the (3D point id, binary signature) entries
+ *    of the visual words, instantiated for 32, 64 and 128 bit signatures
+ *    (inverted_file holds 64 bit signatures). All lists are stored in a
+ *    single array (CSR layout): the entries of word vw are the entries
+ *    get_entry_offset( vw ) to get_entry_offset( vw + 1 ) - 1.
+ *
+ *    Within a word, entries with identical signatures are grouped: every
+ *    distinct signature (code) is stored once, followed by the point ids of its
+ *    entries, such that a scan computes one hamming distance per code and only
+ *    reads the point ids of codes within the threshold. The entries of a code are
+ *    sorted by point id, the codes of a word by their first point id.
+ *
+ *    For every code, the number of its entries, the difference of its first
+ *    point id to the first point id of the previous code and the differences of
+ *    the following point ids to their predecessor are encoded with Stream VByte
+ *    (one control byte for every 4 values holding the byte lengths of the
+ *    values, followed by the data bytes). The values of a word are padded to a
+ *    multiple of 4, so every control byte describes a full group. The groups are
+ *    decoded with SSSE3 shuffles if the code is compiled with SSSE3 support
+ *    (e.g., -mssse3 or -march=native) and with a scalar loop otherwise. The
+ *    point ids of codes outside the threshold are skipped using the control
+ *    bytes only.
+ *
+ *    Words with many codes can additionally be indexed with multi-index hashing
+ *    (Norouzi et al., Fast Search in Hamming Space with Multi-Index Hashing,
+ *    CVPR 2012): the nb_bits bits of the codes are split into m substrings and
+ *    the codes are sorted into one table per substring, indexed by the value
+ *    of the substring. A code within hamming distance r of the query has at least
+ *    one substring within distance r / m of the corresponding substring of the
+ *    query, so only the buckets within that radius have to be probed. The
+ *    number of substrings is chosen per word with a cost model assuming
+ *    uniformly distributed bits, the minimum number of codes of an indexed word
+ *    either by the user or by a microbenchmark on the words of the model.
+**/
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+#include "hamming_signature.hh"
+
+
+template< int nb_bits >
+class basic_inverted_file
+{
+  public:
+    typedef typename hamming_signature< nb_bits >::type signature_t;
+
+    //! constructor
+    basic_inverted_file( );
+
+    //! destructor
+    ~basic_inverted_file( );
+
+    //! clears all data and prepares an empty inverted file for nb_clusters visual words
+    void init( uint32_t nb_clusters );
+
+    //! clears all data
+    void clear( );
+
+    /**
+     * Add the list of visual word vw, given as (3D point id, descriptor id) pairs, the signatures are
+     * taken from signatures[descriptor id]. The words have to be added in increasing order (words that are
+     * skipped stay empty). Returns false if vw is out of order.
+    **/
+    bool add_list( uint32_t vw, const std::vector< std::pair< uint32_t, uint32_t > > &pairs, const std::vector< signature_t > &signatures );
+
+    //! to be called once all lists are added, releases the unused memory of the arrays
+    void finalize( );
+
+    uint32_t get_nb_clusters( ) const;
+
+    //! the total number of entries
+    uint32_t get_nb_entries( ) const;
+
+    //! the number of entries of a visual word
+    uint32_t get_nb_entries( uint32_t vw ) const;
+
+    //! the id of the first entry of a visual word
+    uint32_t get_entry_offset( uint32_t vw ) const;
+
+    //! the total number of codes (distinct signatures per visual word)
+    uint32_t get_nb_codes( ) const;
+
+    //! the number of codes of a visual word
+    uint32_t get_nb_codes( uint32_t vw ) const;
+
+    //! the signatures of all codes
+    const std::vector< signature_t >& get_signatures( ) const;
+
+    //! get the (3D point id, code id) pairs of the entries of a visual word, in entry order
+    void get_entries( uint32_t vw, std::vector< std::pair< uint32_t, uint32_t > > &entries ) const;
+
+    /**
+     * Compare the codes of a visual word to the signature of a query feature. Appends a (3D point id,
+     * hamming distance) pair for every entry within the threshold to hits, in entry order. Uses the
+     * multi-index of the word if it was built for this threshold and the linear scan otherwise.
+     * Returns the number of entries whose signature was compared to the query.
+    **/
+    uint32_t scan( uint32_t vw, signature_t signature, uint32_t threshold, std::vector< std::pair< uint32_t, uint32_t > > &hits ) const;
+
+    //! compare all codes of a visual word to the signature of a query feature (see scan)
+    uint32_t scan_linear( uint32_t vw, signature_t signature, uint32_t threshold, std::vector< std::pair< uint32_t, uint32_t > > &hits ) const;
+
+    //! probe the multi-index of a visual word, which has to be indexed (see scan)
+    uint32_t scan_multi_index( uint32_t vw, signature_t signature, std::vector< std::pair< uint32_t, uint32_t > > &hits ) const;
+
+    /**
+     * Build the multi-index for all words with at least min_codes codes for which the cost model
+     * predicts fewer operations than for the linear scan, for queries with the given hamming threshold.
+     * Replaces a previously built multi-index.
+    **/
+    void build_multi_index( uint32_t threshold, uint32_t min_codes );
+
+    /**
+     * Determine the minimum number of codes of an indexed word with a microbenchmark: the linear scan
+     * and the multi-index are timed on a sample of the words of the model with synthetic queries, the
+     * crossover is the smallest word size from which on the multi-index is faster. Builds the
+     * multi-index for the words above the crossover and returns it (UINT32_MAX if the linear scan was
+     * always faster, in which case no multi-index is built).
+    **/
+    uint32_t calibrate_multi_index( uint32_t threshold );
+
+    //! removes the multi-index
+    void clear_multi_index( );
+
+    //! returns true if the visual word has a multi-index
+    bool has_multi_index( uint32_t vw ) const;
+
+    //! the number of indexed words
+    uint32_t get_nb_indexed_words( ) const;
+
+    //! the number of bytes used by the multi-index
+    uint64_t get_multi_index_memory( ) const;
+
+    //! the number of bytes used by the inverted file
+    uint64_t get_memory( ) const;
+
+    /**
+     * The number of bytes the same data takes as one std::vector of (3D point id, descriptor id) pairs per
+     * visual word plus one signature per descriptor (the layout used before), assuming 16 bytes of
+     * allocator overhead per non-empty vector.
+    **/
+    uint64_t get_uncompressed_memory( uint32_t nb_descriptors ) const;
+
+    //! print the memory of the compressed and the uncompressed layout and the number of codes
+    void print_memory_statistics( uint32_t nb_descriptors ) const;
+
+  private:
+    uint32_t mNbClusters;
+
+    //! the entries of word vw are mEntryOffsets[vw] to mEntryOffsets[vw+1]-1
+    std::vector< uint32_t > mEntryOffsets;
+
+    //! the codes of word vw are mCodeOffsets[vw] to mCodeOffsets[vw+1]-1
+    std::vector< uint32_t > mCodeOffsets;
+
+    //! the encoded values of word vw start at mData[mByteOffsets[vw]]
+    std::vector< uint64_t > mByteOffsets;
+    std::vector< uint8_t > mData;
+
+    //! the signatures, indexed by code id
+    std::vector< signature_t > mSignatures;
+
+    //! the number of words added so far
+    uint32_t mNbAdded;
+
+    //! a substring of the codes and the table of an indexed word
+    struct substring
+    {
+      //! the position of the lowest bit and the number of bits
+      uint32_t shift, bits;
+      //! the table has 2^bits buckets, the codes of bucket b are table_codes[bucket_offsets[b]] to table_codes[bucket_offsets[b+1]-1]
+      uint64_t bucket_offsets, table_codes;
+      //! the masks of all values within the probing radius are mProbeMasks[first_mask] to mProbeMasks[last_mask-1]
+      uint32_t first_mask, last_mask;
+    };
+
+    struct multi_index
+    {
+      //! the substrings are mSubstrings[first_substring] to mSubstrings[first_substring+nb_substrings-1]
+      uint32_t first_substring, nb_substrings;
+      //! the radius probed in every table
+      uint32_t radius;
+      //! the point ids of code c (relative to the first code of the word) are mIndexPoints[mIndexPointOffsets[point_offsets+c]] ...
+      uint64_t point_offsets;
+    };
+
+    //! for every word the id of its multi-index or UINT32_MAX (empty if no multi-index was built)
+    std::vector< uint32_t > mMultiIndexIds;
+    std::vector< multi_index > mMultiIndices;
+    std::vector< substring > mSubstrings;
+    std::vector< uint32_t > mBucketOffsets;
+    std::vector< uint32_t > mTableCodes;
+    std::vector< uint32_t > mIndexPointOffsets;
+    std::vector< uint32_t > mIndexPoints;
+    std::vector< uint32_t > mProbeMasks;
+
+    //! the threshold the multi-index was built for
+    uint32_t mIndexThreshold;
+};
+
+typedef basic_inverted_file< 64 > inverted_file;
+
+#endif
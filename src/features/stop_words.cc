@@ -0,0 +1,232 @@
+#include "stop_words.hh"
+
+#include <string>
+#include <cmath>
+
+
+stop_words::stop_words( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+stop_words::~stop_words( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+void stop_words::clear( )
+{
+  mPercentile = 100.0;
+  mBurstRatio = 0.0;
+  mLengthThreshold = 0;
+  mCosts.clear();
+  mFlags.clear();
+}
+
+//---------------------------------------------------
+
+bool stop_words::empty( ) const
+{
+  return mCosts.empty();
+}
+
+//---------------------------------------------------
+
+void stop_words::flag_words( const std::vector< uint32_t > &nb_codes )
+{
+  uint32_t nb_clusters = uint32_t( mCosts.size() );
+  mFlags.assign( nb_clusters, 0 );
+
+  std::vector< uint32_t > lengths;
+  lengths.reserve( nb_clusters );
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+  {
+    if ( mCosts[i] > 0 )
+      lengths.push_back( mCosts[i] );
+  }
+  mLengthThreshold = 0;
+  if ( lengths.empty() )
+    return;
+  std::sort( lengths.begin(), lengths.end() );
+
+  // the length at the percentile (nearest rank), longer words are oversized
+  double percentile = std::max( 0.0, std::min( 100.0, mPercentile ) );
+  size_t rank = (size_t) ceil( percentile / 100.0 * (double) lengths.size() );
+  mLengthThreshold = lengths[std::min( std::max( rank, (size_t) 1 ), lengths.size() ) - 1];
+  uint32_t median_length = lengths[( lengths.size() - 1 ) / 2];
+
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+  {
+    if ( mCosts[i] > mLengthThreshold )
+      mFlags[i] |= oversized;
+    if ( mBurstRatio > 0.0 && nb_codes[i] > 0 && mCosts[i] >= median_length && (double) mCosts[i] >= mBurstRatio * (double) nb_codes[i] )
+      mFlags[i] |= bursty;
+  }
+}
+
+//---------------------------------------------------
+
+void stop_words::analyze_counts( const std::vector< uint32_t > &costs, const std::vector< uint32_t > &nb_codes, double percentile, double burst_ratio )
+{
+  mPercentile = percentile;
+  mBurstRatio = burst_ratio;
+  mCosts = costs;
+  flag_words( nb_codes );
+}
+
+//---------------------------------------------------
+
+bool stop_words::save( std::ostream &os ) const
+{
+  std::streamsize precision = os.precision( 6 );
+  os << "stop_words " << mPercentile << " " << mBurstRatio << " " << mLengthThreshold << std::endl;
+  os.precision( precision );
+  for ( size_t i = 0; i < mCosts.size(); ++i )
+    os << mCosts[i] << " " << (int) mFlags[i] << std::endl;
+  return !os.fail();
+}
+
+//---------------------------------------------------
+
+bool stop_words::load( std::istream &is, uint32_t nb_clusters )
+{
+  clear();
+
+  std::string keyword;
+  if ( !( is >> keyword ) )
+    return true;
+  if ( keyword != "stop_words" )
+  {
+    std::cerr << "[stop_words]: ERROR: Unexpected " << keyword << " after the inverted lists" << std::endl;
+    return false;
+  }
+
+  is >> mPercentile >> mBurstRatio >> mLengthThreshold;
+  mCosts.resize( nb_clusters );
+  mFlags.resize( nb_clusters );
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+  {
+    int flags = 0;
+    is >> mCosts[i] >> flags;
+    mFlags[i] = (uint8_t) flags;
+  }
+  if ( !is )
+  {
+    std::cerr << "[stop_words]: ERROR: The stop word section does not list " << nb_clusters << " visual words" << std::endl;
+    clear();
+    return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------
+
+uint32_t stop_words::get_nb_clusters( ) const
+{
+  return uint32_t( mCosts.size() );
+}
+
+//---------------------------------------------------
+
+double stop_words::get_percentile( ) const
+{
+  return mPercentile;
+}
+
+//---------------------------------------------------
+
+double stop_words::get_burst_ratio( ) const
+{
+  return mBurstRatio;
+}
+
+//---------------------------------------------------
+
+uint32_t stop_words::get_length_threshold( ) const
+{
+  return mLengthThreshold;
+}
+
+//---------------------------------------------------
+
+uint32_t stop_words::get_cost( uint32_t vw ) const
+{
+  return mCosts[vw];
+}
+
+//---------------------------------------------------
+
+uint8_t stop_words::get_flags( uint32_t vw ) const
+{
+  return mFlags[vw];
+}
+
+//---------------------------------------------------
+
+bool stop_words::is_stop_word( uint32_t vw ) const
+{
+  return mFlags[vw] != 0;
+}
+
+//---------------------------------------------------
+
+uint32_t stop_words::get_nb_stop_words( ) const
+{
+  uint32_t nb_stop_words = 0;
+  for ( size_t i = 0; i < mFlags.size(); ++i )
+  {
+    if ( mFlags[i] != 0 )
+      ++nb_stop_words;
+  }
+  return nb_stop_words;
+}
+
+//---------------------------------------------------
+
+uint64_t stop_words::get_nb_stop_entries( ) const
+{
+  uint64_t nb_stop_entries = 0;
+  for ( size_t i = 0; i < mFlags.size(); ++i )
+  {
+    if ( mFlags[i] != 0 )
+      nb_stop_entries += mCosts[i];
+  }
+  return nb_stop_entries;
+}
+
+//---------------------------------------------------
+
+void stop_words::print_statistics( ) const
+{
+  std::vector< uint32_t > lengths;
+  uint64_t nb_entries = 0;
+  uint32_t nb_oversized = 0, nb_bursty = 0;
+  for ( size_t i = 0; i < mCosts.size(); ++i )
+  {
+    if ( mCosts[i] > 0 )
+      lengths.push_back( mCosts[i] );
+    nb_entries += mCosts[i];
+    if ( mFlags[i] & oversized )
+      ++nb_oversized;
+    if ( mFlags[i] & bursty )
+      ++nb_bursty;
+  }
+  if ( lengths.empty() )
+  {
+    std::cout << "[stop_words]: no entries" << std::endl;
+    return;
+  }
+  std::sort( lengths.begin(), lengths.end() );
+
+  std::cout << "[stop_words]: list lengths of the " << lengths.size() << " non-empty visual words: median " << lengths[( lengths.size() - 1 ) / 2]
+            << ", 90% " << lengths[( lengths.size() - 1 ) * 9 / 10] << ", 99% " << lengths[( lengths.size() - 1 ) * 99 / 100]
+            << ", 99.9% " << lengths[( lengths.size() - 1 ) * 999 / 1000] << ", max " << lengths.back() << std::endl;
+  uint64_t nb_stop_entries = get_nb_stop_entries();
+  std::cout << "[stop_words]: " << nb_oversized << " oversized words (more than " << mLengthThreshold << " entries, " << mPercentile << "% percentile) and "
+            << nb_bursty << " bursty words (at least " << mBurstRatio << " entries per signature), " << get_nb_stop_words() << " stop words with "
+            << nb_stop_entries << " of " << nb_entries << " entries (" << ( nb_entries > 0 ? 100.0 * (double) nb_stop_entries / (double) nb_entries : 0.0 ) << "%)" << std::endl;
+}
@@ -0,0 +1,139 @@
+#ifndef STOP_WORDS_HH
+#define STOP_WORDS_HH
+
+/**
+ *    Per visual word costs and stop word flags of a model. The cost of a
+ *    word is the number of its entries, i.e., the number of entries a query
+ *    feature assigned to the word is compared to and the maximal number of
+ *    correspondences it can generate. Two kinds of words are flagged:
+ *
+ *    - oversized words, whose list is longer than the given percentile of the
+ *      list lengths of the non-empty words. They dominate the time spent
+ *      scanning the inverted lists.
+ *    - bursty words, in which the entries share few distinct signatures (at
+ *      least burst_ratio entries per signature on average) and which are at
+ *      least as long as the median list. They stem from repetitive structures
+ *      and flood the voting with correspondences to many points at the same
+ *      distance.
+ *
+ *    The flags are computed when the hamming file is built and appended to it
+ *    as a section starting with the keyword stop_words, followed by the
+ *    parameters of the analysis and one (cost, flags) line per visual word.
+ *    Tools that read the lists only ignore the section, so files with and
+ *    without it can be used interchangeably. Entries appended by
+ *    update_localization_model (see hamming_delta) are not covered by the
+ *    section, the readers merging them flag the words again.
+**/
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdint.h>
+
+
+class stop_words
+{
+  public:
+    //! the flags of a visual word
+    enum { oversized = 1, bursty = 2 };
+
+    //! constructor
+    stop_words( );
+
+    //! destructor
+    ~stop_words( );
+
+    //! clears all data
+    void clear( );
+
+    //! returns true if no analysis was loaded or computed
+    bool empty( ) const;
+
+    /**
+     * Compute the costs and flags of all visual words. assignments has to provide the interface of
+     * vw_assignments, signatures[descriptor id] is the signature of a descriptor. Words longer than the
+     * percentile (in [0, 100], 100 flags no word) of the list lengths are oversized, words with at least
+     * burst_ratio entries per distinct signature (0 flags no word) are bursty.
+    **/
+    template< class assignment_lists, class signature_type >
+    void analyze( const assignment_lists &assignments, const std::vector< signature_type > &signatures, double percentile, double burst_ratio );
+
+    //! compute the flags from the list length and the number of distinct signatures of every visual word (see analyze)
+    void analyze_counts( const std::vector< uint32_t > &costs, const std::vector< uint32_t > &nb_codes, double percentile, double burst_ratio );
+
+    //! write the section to a hamming file
+    bool save( std::ostream &os ) const;
+
+    /**
+     * Read the section from a hamming file whose lists were just read. If the file has no section, nothing
+     * is loaded (see empty) and true is returned. Returns false if the section is invalid or does not list
+     * nb_clusters words.
+    **/
+    bool load( std::istream &is, uint32_t nb_clusters );
+
+    uint32_t get_nb_clusters( ) const;
+
+    //! the parameters of the analysis
+    double get_percentile( ) const;
+    double get_burst_ratio( ) const;
+
+    //! the list length above which words are oversized
+    uint32_t get_length_threshold( ) const;
+
+    //! the cost (number of entries) of a visual word
+    uint32_t get_cost( uint32_t vw ) const;
+
+    //! the flags of a visual word
+    uint8_t get_flags( uint32_t vw ) const;
+
+    //! returns true if the visual word is oversized or bursty
+    bool is_stop_word( uint32_t vw ) const;
+
+    //! the number of stop words and the number of their entries
+    uint32_t get_nb_stop_words( ) const;
+    uint64_t get_nb_stop_entries( ) const;
+
+    //! print the list length percentiles and the number and cost of the flagged words
+    void print_statistics( ) const;
+
+  private:
+    //! flag the words once mCosts and the number of codes per word are known
+    void flag_words( const std::vector< uint32_t > &nb_codes );
+
+    double mPercentile;
+    double mBurstRatio;
+    uint32_t mLengthThreshold;
+
+    std::vector< uint32_t > mCosts;
+    std::vector< uint8_t > mFlags;
+};
+
+//---------------------------------------------------
+
+template< class assignment_lists, class signature_type >
+void stop_words::analyze( const assignment_lists &assignments, const std::vector< signature_type > &signatures, double percentile, double burst_ratio )
+{
+  uint32_t nb_clusters = assignments.get_nb_clusters();
+  mPercentile = percentile;
+  mBurstRatio = burst_ratio;
+  mCosts.resize( nb_clusters );
+
+  // the number of distinct signatures of every word
+  std::vector< uint32_t > nb_codes( nb_clusters, 0 );
+  std::vector< signature_type > word_signatures;
+  for ( uint32_t i = 0; i < nb_clusters; ++i )
+  {
+    uint32_t in_word_nb = assignments.get_nb_assignments( i );
+    const uint32_t *word_assignments = assignments.get_assignments( i );
+    mCosts[i] = in_word_nb;
+    word_signatures.resize( in_word_nb );
+    for ( uint32_t j = 0; j < in_word_nb; ++j )
+      word_signatures[j] = signatures[word_assignments[2 * j + 1]];
+    std::sort( word_signatures.begin(), word_signatures.end() );
+    nb_codes[i] = uint32_t( std::unique( word_signatures.begin(), word_signatures.end() ) - word_signatures.begin() );
+  }
+
+  flag_words( nb_codes );
+}
+
+#endif
@@ -23,6 +23,24 @@
 \*===========================================================================*/
 
 #include "visual_words_handler.hh"
+#include "../mapped_file.hh"
+
+#include <cstring>
+#include <unistd.h>
+
+// identifies files written by load_trees_flann
+static const char vocabulary_index_magic[8] = { 'V', 'W', 'I', 'N', 'D', 'E', 'X', '1' };
+
+// header of the files written by load_trees_flann, followed by the cluster centers (floats) and the flann index
+struct vocabulary_index_header
+{
+  char magic[8];
+  uint32_t nb_visual_words;
+  int32_t flann_index_type;
+  int32_t branching;
+  int32_t nb_trees;
+  uint64_t cluster_hash;
+};
 
 
 
@@ -288,6 +306,56 @@ bool visual_words_handler::load_trees_flann( std::string &cluster_file, std::str
     delete [] mFlannIndex;
   mFlannIndex = 0;
 
+  // the saved index is only valid for the same cluster centers and index parameters
+  uint64_t cluster_hash = 0;
+  {
+    mapped_file clusters;
+    if ( !clusters.open( cluster_file ) )
+    {
+      std::cerr << "[Visual_Words_Handler]: ERROR: Cannot read the clusters from " << cluster_file << std::endl;
+      return false;
+    }
+    cluster_hash = clusters.hash();
+  }
+
+  vocabulary_index_header header;
+  memcpy( header.magic, vocabulary_index_magic, 8 );
+  header.nb_visual_words = mNbVisualWords;
+  header.flann_index_type = mFlannIndexType;
+  header.branching = ( mFlannIndexType == 1 ) ? mBranching : 0;
+  header.nb_trees = ( mFlannIndexType == 2 ) ? mNbTrees : 0;
+  header.cluster_hash = cluster_hash;
+
+  // try to load the saved index
+  {
+    mapped_file saved_index;
+    if ( access( tree_file.c_str(), R_OK ) == 0 && saved_index.open( tree_file ) )
+    {
+      uint64_t centers_size = sizeof( float ) * 128 * (uint64_t) mNbVisualWords;
+      if ( saved_index.size() > sizeof( vocabulary_index_header ) + centers_size && memcmp( saved_index.data(), &header, sizeof( vocabulary_index_header ) ) == 0 )
+      {
+        std::cout << "[Visual_Words_Handler]: Loading tree... " << std::endl;
+        saved_index.prefetch();
+        memcpy( mClusterCentersFlann.data, saved_index.data() + sizeof( vocabulary_index_header ), centers_size );
+
+        // the tree is read directly from the mapped file
+        uint64_t tree_offset = sizeof( vocabulary_index_header ) + centers_size;
+        FILE *tree_stream = fmemopen( (void*) ( saved_index.data() + tree_offset ), (size_t) ( saved_index.size() - tree_offset ), "rb" );
+        if ( tree_stream != 0 )
+        {
+          create_flann_index();
+          mFlannIndex->loadIndex( tree_stream );
+          fclose( tree_stream );
+
+          initialize();
+          std::cout << "[Visual_Words_Handler]: Tree loaded " << std::endl;
+          return true;
+        }
+      }
+      std::cout << "[Visual_Words_Handler]: The tree in " << tree_file << " does not match the clusters and parameters, rebuilding it" << std::endl;
+    }
+  }
+
   // load the clusters from a text file
   {
     std::ifstream ifs( cluster_file.c_str(), std::ios::in );
@@ -310,47 +378,34 @@ bool visual_words_handler::load_trees_flann( std::string &cluster_file, std::str
     ifs.close();
   }
 
-  // check if the file for the tree exists
-  bool exists = false;
-  {
-    std::ifstream in( tree_file.c_str() );
-    exists = in.is_open();
-    in.close();
-  }
-
-  if ( exists )
-  {
-    // load the tree
-    std::cout << "[Visual_Words_Handler]: Loading tree... " << std::endl;
-    mFlannIndex = new flann::Index< flann::L2< float > >( mClusterCentersFlann, flann::SavedIndexParams( tree_file ) );
-    std::cout << "[Visual_Words_Handler]: Tree loaded " << std::endl;
-  }
-  else
-  {
-    // create the tree and save it
-    std::cout << "[Visual_Words_Handler]: Building the tree... " << std::endl;
+  // create the tree and save it
+  std::cout << "[Visual_Words_Handler]: Building the tree... " << std::endl;
 
+  // NOTE: Make sure that we allways generate the same tree for a set of features / cluster centers and are not
+  // afflicted by any calls to rand or srand
+  srand(1);
 
-    // NOTE: Make sure that we allways generate the same tree for a set of features / cluster centers and are not
-    // afflicted by any calls to rand or srand
-    srand(1);
+  create_flann_index();
+  mFlannIndex->buildIndex();
+  std::cout << "[Visual_Words_Handler]: Tree built. " << std::endl;
 
-    switch ( mFlannIndexType )
+  // write to a temporary file first such that concurrently started processes never see a partial index
+  std::string tmp_file = tree_file + ".tmp";
+  FILE *fout = fopen( tmp_file.c_str(), "wb" );
+  if ( fout == 0 )
+    std::cerr << "[Visual_Words_Handler]: WARNING: Cannot save the tree to " << tree_file << std::endl;
+  else
+  {
+    fwrite( &header, sizeof( vocabulary_index_header ), 1, fout );
+    fwrite( mClusterCentersFlann.data, sizeof( float ), 128 * (size_t) mNbVisualWords, fout );
+    mFlannIndex->saveIndex( fout );
+    bool written = ( ferror( fout ) == 0 );
+    written = ( fclose( fout ) == 0 ) && written;
+    if ( !written || rename( tmp_file.c_str(), tree_file.c_str() ) != 0 )
     {
-    case 0:
-      mFlannIndex = new flann::Index< flann::L2< float > >( mClusterCentersFlann, flann::AutotunedIndexParams( mTargetPrecision, mBuildWeight, mMemoryWeight, mSampleFraction ) );
-      break;
-    case 1:
-      mFlannIndex = new flann::Index< flann::L2< float > >( mClusterCentersFlann, flann::KMeansIndexParams( mBranching ) );
-      break;
-    case 2:
-      mFlannIndex = new flann::Index< flann::L2< float > >( mClusterCentersFlann, flann::KDTreeIndexParams( mNbTrees ) );
-      break;
-
+      std::cerr << "[Visual_Words_Handler]: WARNING: Cannot save the tree to " << tree_file << std::endl;
+      unlink( tmp_file.c_str() );
     }
-    mFlannIndex->buildIndex();
-    mFlannIndex->save( tree_file );
-    std::cout << "[Visual_Words_Handler]: Tree built. " << std::endl;
   }
 
   initialize();
@@ -360,6 +415,24 @@ bool visual_words_handler::load_trees_flann( std::string &cluster_file, std::str
 
 //---------------------------------------------------
 
+void visual_words_handler::create_flann_index( )
+{
+  switch ( mFlannIndexType )
+  {
+  case 0:
+    mFlannIndex = new flann::Index< flann::L2< float > >( mClusterCentersFlann, flann::AutotunedIndexParams( mTargetPrecision, mBuildWeight, mMemoryWeight, mSampleFraction ) );
+    break;
+  case 1:
+    mFlannIndex = new flann::Index< flann::L2< float > >( mClusterCentersFlann, flann::KMeansIndexParams( mBranching ) );
+    break;
+  case 2:
+    mFlannIndex = new flann::Index< flann::L2< float > >( mClusterCentersFlann, flann::KDTreeIndexParams( mNbTrees ) );
+    break;
+  }
+}
+
+//---------------------------------------------------
+
 void visual_words_handler::rebuild_flann_index()
 {
   if ( mFlannIndex != 0 )
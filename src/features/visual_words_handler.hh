@@ -112,7 +112,9 @@ class visual_words_handler
     
     
     /**
-     * load the tree(s) for flann assignments. If neccessary (and specified), the tree is created. Returns true if the tree was loaded or created
+     * load the tree(s) for flann assignments from tree_file, which stores the cluster centers in binary form followed by the flann index and is
+     * mapped into memory. The file is only used if it was created from the same cluster file (compared by a content hash), number of visual words,
+     * index type and branching / number of trees. Otherwise, the tree is built and saved to tree_file. Returns true if the tree was loaded or created
     **/
     bool load_trees_flann( std::string &cluster_file, std::string &tree_file );
     
@@ -166,6 +168,9 @@ class visual_words_handler
     void assign_and_save_prefix_float( std::string &filename, std::vector< float > &descriptors, uint32_t nb_descriptors );
 
   private:
+    //! creates (but does not build) a flann index of type mFlannIndexType on mClusterCentersFlann
+    void create_flann_index( );
+
     //! resize the datastructures to contain feature and assignment information
     void resize( uint32_t nb_descriptors );
     
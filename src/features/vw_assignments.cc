@@ -0,0 +1,163 @@
+#include "vw_assignments.hh"
+
+#include <iostream>
+
+vw_assignments::vw_assignments( )
+{
+  mNbPoints = mNbClusters = mNbNonEmptyVW = mNbDescriptors = 0;
+  mPoints = 0;
+  mDescriptors = 0;
+}
+
+//---------------------------------------------------
+
+vw_assignments::~vw_assignments( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+bool vw_assignments::load( const std::string &filename )
+{
+  clear();
+
+  if ( !mFile.open( filename ) )
+    return false;
+
+  // the descriptors are accessed in visual word order, i.e., more or less at random,
+  // so get the whole file into the page cache up front
+  mFile.prefetch();
+
+  const unsigned char *data = mFile.data();
+  uint64_t file_size = mFile.size();
+
+  if ( file_size < 4 * sizeof( uint32_t ) )
+  {
+    std::cerr << "[vw_assignments]: ERROR: " << filename << " is too small to contain a header" << std::endl;
+    clear();
+    return false;
+  }
+
+  // header: #points #cluster #non-empty cluster #descriptors
+  const uint32_t *header = (const uint32_t*) data;
+  mNbPoints = header[0];
+  mNbClusters = header[1];
+  mNbNonEmptyVW = header[2];
+  mNbDescriptors = header[3];
+
+  uint64_t offset = 4 * sizeof( uint32_t );
+  uint64_t points_size = uint64_t( mNbPoints ) * 3 * sizeof( float );
+  uint64_t descriptors_size = uint64_t( mNbDescriptors ) * 128 * sizeof( unsigned char );
+
+  if ( offset + points_size + descriptors_size > file_size )
+  {
+    std::cerr << "[vw_assignments]: ERROR: " << filename << " is truncated" << std::endl;
+    clear();
+    return false;
+  }
+
+  // all sections are multiples of 4 bytes, so the points and the assignments are properly aligned
+  mPoints = (const float*) ( data + offset );
+  offset += points_size;
+  mDescriptors = data + offset;
+  offset += descriptors_size;
+
+  // index the assignments: cluster-id #assignments assignments
+  mAssignments.assign( mNbClusters, (const uint32_t*) 0 );
+  mNbAssignments.assign( mNbClusters, 0 );
+  for ( uint32_t i = 0; i < mNbClusters; ++i )
+  {
+    if ( offset + 2 * sizeof( uint32_t ) > file_size )
+    {
+      std::cerr << "[vw_assignments]: ERROR: " << filename << " is truncated (or stores float descriptors)" << std::endl;
+      clear();
+      return false;
+    }
+    const uint32_t *word_header = (const uint32_t*) ( data + offset );
+    uint32_t id = word_header[0];
+    uint32_t nb_pairs = word_header[1];
+    offset += 2 * sizeof( uint32_t );
+
+    if ( id >= mNbClusters || offset + uint64_t( nb_pairs ) * 2 * sizeof( uint32_t ) > file_size )
+    {
+      std::cerr << "[vw_assignments]: ERROR: Invalid assignments for visual word " << id << " in " << filename << " (the file might store float descriptors)" << std::endl;
+      clear();
+      return false;
+    }
+
+    mAssignments[id] = (const uint32_t*) ( data + offset );
+    mNbAssignments[id] = nb_pairs;
+    offset += uint64_t( nb_pairs ) * 2 * sizeof( uint32_t );
+  }
+
+  return true;
+}
+
+//---------------------------------------------------
+
+void vw_assignments::clear( )
+{
+  mFile.close();
+  mNbPoints = mNbClusters = mNbNonEmptyVW = mNbDescriptors = 0;
+  mPoints = 0;
+  mDescriptors = 0;
+  mAssignments.clear();
+  mNbAssignments.clear();
+}
+
+//---------------------------------------------------
+
+uint32_t vw_assignments::get_nb_points( ) const
+{
+  return mNbPoints;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_assignments::get_nb_clusters( ) const
+{
+  return mNbClusters;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_assignments::get_nb_non_empty_vw( ) const
+{
+  return mNbNonEmptyVW;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_assignments::get_nb_descriptors( ) const
+{
+  return mNbDescriptors;
+}
+
+//---------------------------------------------------
+
+const float* vw_assignments::get_points( ) const
+{
+  return mPoints;
+}
+
+//---------------------------------------------------
+
+const unsigned char* vw_assignments::get_descriptors( ) const
+{
+  return mDescriptors;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_assignments::get_nb_assignments( uint32_t vw ) const
+{
+  return mNbAssignments[vw];
+}
+
+//---------------------------------------------------
+
+const uint32_t* vw_assignments::get_assignments( uint32_t vw ) const
+{
+  return mAssignments[vw];
+}
@@ -0,0 +1,79 @@
+#ifndef VW_ASSIGNMENTS_HH
+#define VW_ASSIGNMENTS_HH
+
+/**
+ *    Class to access the descriptor-to-visual word assignments written by
+ *    compute_desc_assignments (the .bin file) without copying them.
+ *    The file is mapped into memory and the 3D points, the descriptors and
+ *    the (3D point id, descriptor id) pairs of every visual word are used in place.
+ *
+ *    Only files storing the descriptors as unsigned chars (modes 0, 3, 5, 6, 7
+ *    of compute_desc_assignments) are supported.
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "../mapped_file.hh"
+
+
+class vw_assignments
+{
+  public:
+    //! constructor
+    vw_assignments( );
+
+    //! destructor
+    ~vw_assignments( );
+
+    //! maps the assignment file into memory and indexes its sections, returns false if the file is not valid
+    bool load( const std::string &filename );
+
+    //! releases the mapped file
+    void clear( );
+
+    //! get the number of 3D points stored in the file
+    uint32_t get_nb_points( ) const;
+
+    //! get the number of visual words stored in the file
+    uint32_t get_nb_clusters( ) const;
+
+    //! get the number of non-empty visual words
+    uint32_t get_nb_non_empty_vw( ) const;
+
+    //! get the number of descriptors stored in the file
+    uint32_t get_nb_descriptors( ) const;
+
+    //! get the 3D point positions (3 floats per point)
+    const float* get_points( ) const;
+
+    //! get the descriptors (128 unsigned chars per descriptor)
+    const unsigned char* get_descriptors( ) const;
+
+    //! get the number of (3D point id, descriptor id) pairs assigned to a visual word
+    uint32_t get_nb_assignments( uint32_t vw ) const;
+
+    /**
+     * get the (3D point id, descriptor id) pairs assigned to a visual word, stored as
+     * 2 * get_nb_assignments( vw ) consecutive uint32_t values (point id first)
+    **/
+    const uint32_t* get_assignments( uint32_t vw ) const;
+
+  private:
+    mapped_file mFile;
+
+    uint32_t mNbPoints, mNbClusters, mNbNonEmptyVW, mNbDescriptors;
+
+    const float *mPoints;
+
+    const unsigned char *mDescriptors;
+
+    //! for every visual word, a pointer to its first assignment inside the mapped file
+    std::vector< const uint32_t* > mAssignments;
+
+    //! for every visual word, the number of assignments
+    std::vector< uint32_t > mNbAssignments;
+};
+
+#endif
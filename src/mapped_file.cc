@@ -0,0 +1,138 @@
+#include "mapped_file.hh"
+
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+// parameters of the 64 bit FNV-1a hash
+static const uint64_t fnv_offset_basis = 14695981039346656037ULL;
+static const uint64_t fnv_prime = 1099511628211ULL;
+
+mapped_file::mapped_file( )
+{
+  mFileDescriptor = -1;
+  mData = 0;
+  mSize = 0;
+}
+
+//-----------------------------------
+
+mapped_file::~mapped_file( )
+{
+  close();
+}
+
+//-----------------------------------
+
+bool mapped_file::open( const std::string &filename )
+{
+  close();
+
+  mFileDescriptor = ::open( filename.c_str(), O_RDONLY );
+  if ( mFileDescriptor < 0 )
+  {
+    std::cerr << "[mapped_file]: ERROR: Cannot open " << filename << std::endl;
+    return false;
+  }
+
+  struct stat file_stats;
+  if ( fstat( mFileDescriptor, &file_stats ) != 0 )
+  {
+    std::cerr << "[mapped_file]: ERROR: Cannot determine the size of " << filename << std::endl;
+    close();
+    return false;
+  }
+  mSize = (uint64_t) file_stats.st_size;
+
+  // mmap does not accept empty mappings, an empty file is simply an empty range
+  if ( mSize == 0 )
+    return true;
+
+  mData = mmap( 0, (size_t) mSize, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0 );
+  if ( mData == MAP_FAILED )
+  {
+    std::cerr << "[mapped_file]: ERROR: Cannot map " << filename << " into memory" << std::endl;
+    mData = 0;
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+//-----------------------------------
+
+void mapped_file::close( )
+{
+  if ( mData != 0 )
+    munmap( mData, (size_t) mSize );
+  mData = 0;
+  mSize = 0;
+
+  if ( mFileDescriptor >= 0 )
+    ::close( mFileDescriptor );
+  mFileDescriptor = -1;
+}
+
+//-----------------------------------
+
+bool mapped_file::is_open( ) const
+{
+  return ( mFileDescriptor >= 0 );
+}
+
+//-----------------------------------
+
+const unsigned char* mapped_file::data( ) const
+{
+  return (const unsigned char*) mData;
+}
+
+//-----------------------------------
+
+uint64_t mapped_file::size( ) const
+{
+  return mSize;
+}
+
+//-----------------------------------
+
+void mapped_file::prefetch( ) const
+{
+  if ( mData != 0 )
+    madvise( mData, (size_t) mSize, MADV_WILLNEED );
+}
+
+//-----------------------------------
+
+uint64_t mapped_file::hash( ) const
+{
+  // FNV-1a over 8 byte words (the remaining bytes are hashed individually), which is
+  // fast enough to hash multi-gigabyte .info files at disk bandwidth. The hash is
+  // seeded with the file size.
+  const unsigned char *data = (const unsigned char*) mData;
+  uint64_t nb_words = mSize / 8;
+
+  uint64_t hash = fnv_offset_basis;
+  uint64_t size = mSize;
+  for ( int i = 0; i < 8; ++i )
+  {
+    hash = ( hash ^ ( size & 0xFF ) ) * fnv_prime;
+    size >>= 8;
+  }
+
+  for ( uint64_t i = 0; i < nb_words; ++i )
+  {
+    uint64_t word;
+    memcpy( &word, data + 8 * i, 8 );
+    hash = ( hash ^ word ) * fnv_prime;
+  }
+  for ( uint64_t i = 8 * nb_words; i < mSize; ++i )
+    hash = ( hash ^ uint64_t( data[i] ) ) * fnv_prime;
+
+  return hash;
+}
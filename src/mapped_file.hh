@@ -0,0 +1,58 @@
+#ifndef MAPPED_FILE_HH
+#define MAPPED_FILE_HH
+
+/**
+ *    Class to map a file read-only into memory (mmap).
+ *    The mapped data can be used in place, i.e., large binary model
+ *    files do not have to be copied into std::vectors entry by entry.
+ *    Note that this implementation only works for Linux and Mac OS.
+**/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+
+class mapped_file
+{
+  public:
+    //! constructor
+    mapped_file( );
+
+    //! destructor, unmaps the file
+    ~mapped_file( );
+
+    //! maps the file into memory, returns false if the file could not be mapped
+    bool open( const std::string &filename );
+
+    //! unmaps the file
+    void close( );
+
+    //! returns true if a file is currently mapped
+    bool is_open( ) const;
+
+    //! get a pointer to the first byte of the file
+    const unsigned char* data( ) const;
+
+    //! get the size of the mapped file in bytes
+    uint64_t size( ) const;
+
+    //! advise the kernel to read the whole file ahead, such that later accesses do not stall on page faults
+    void prefetch( ) const;
+
+    //! compute a 64 bit content hash (FNV-1a) of the mapped file
+    uint64_t hash( ) const;
+
+  private:
+    // mapped files cannot be copied
+    mapped_file( const mapped_file &other );
+    void operator=( const mapped_file &other );
+
+    int mFileDescriptor;
+
+    void *mData;
+
+    uint64_t mSize;
+};
+
+#endif
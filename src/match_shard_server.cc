@@ -0,0 +1,105 @@
+#define __STDC_LIMIT_MACROS
+
+// C++ includes
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// stopwatch
+#include "timer.hh"
+
+#include "vw_shards.hh"
+
+
+// load a shard and answer the requests of coordinators until a shutdown is requested
+int run_shard( const std::string &hamming_input, uint32_t nb_shards, uint32_t shard_id, const std::string &socket_prefix )
+{
+  Timer timer;
+  timer.Init();
+  timer.Start();
+
+  vw_shard shard;
+  if ( !shard.load( hamming_input, nb_shards, shard_id ) )
+    return -1;
+
+  timer.Stop();
+  std::cout << "-> shard " << shard_id << " of " << nb_shards << ": loaded " << shard.get_nb_entries() << " entries and " << shard.get_nb_signatures()
+            << " signatures in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  return shard.serve( vw_shard::get_socket_filename( socket_prefix, shard_id ) ) ? 0 : -1;
+}
+
+
+int main (int argc, char **argv)
+{
+  if ( argc < 4 )
+  {
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " -    Serves a part of the inverted lists and binary signatures of a model for sharded matching     - " << std::endl;
+    std::cout << " -    (option --shards of cascaded_parallel_filtering_aachenDayNight). The visual words are         - " << std::endl;
+    std::cout << " -    partitioned by id, shard i holds the words vw with vw % nb_shards == i and listens on the      - " << std::endl;
+    std::cout << " -    Unix socket socket_prefix_i.sock.                                                              - " << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " - usage: match_shard_server hamming nb_shards socket_prefix [shard_id]                              - " << std::endl;
+    std::cout << " - Parameters:                                                                                       - " << std::endl;
+    std::cout << " -  argv[1]: The model (output of compute_hamming_threshold or build_localization_model)             - " << std::endl;
+    std::cout << " -  argv[2]: The number of shards                                                                    - " << std::endl;
+    std::cout << " -  argv[3]: The prefix of the socket filenames                                                      - " << std::endl;
+    std::cout << " -  argv[4]: The shard served by this process. If omitted, one process is started for every shard   - " << std::endl;
+    std::cout << " -           on this machine and the program returns once all of them terminated.                   - " << std::endl;
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    return -1;
+  }
+
+  std::string hamming_input( argv[1] );
+  int nb_shards = atoi( argv[2] );
+  std::string socket_prefix( argv[3] );
+  if ( nb_shards <= 0 )
+  {
+    std::cerr << " ERROR: The number of shards has to be positive" << std::endl;
+    return -1;
+  }
+
+  if ( argc > 4 )
+  {
+    int shard_id = atoi( argv[4] );
+    if ( shard_id < 0 || shard_id >= nb_shards )
+    {
+      std::cerr << " ERROR: Invalid shard id " << shard_id << std::endl;
+      return -1;
+    }
+    return run_shard( hamming_input, (uint32_t) nb_shards, (uint32_t) shard_id, socket_prefix );
+  }
+
+  ////
+  // local launcher: one child process per shard
+  std::vector< pid_t > children;
+  for ( int i = 0; i < nb_shards; ++i )
+  {
+    pid_t pid = fork();
+    if ( pid < 0 )
+    {
+      std::cerr << " ERROR: Cannot start the process of shard " << i << std::endl;
+      break;
+    }
+    if ( pid == 0 )
+      exit( run_shard( hamming_input, (uint32_t) nb_shards, (uint32_t) i, socket_prefix ) == 0 ? 0 : 1 );
+    children.push_back( pid );
+  }
+
+  int nb_failed = nb_shards - (int) children.size();
+  for ( size_t i = 0; i < children.size(); ++i )
+  {
+    int status = 0;
+    if ( waitpid( children[i], &status, 0 ) < 0 || !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+      ++nb_failed;
+  }
+  std::cout << "-> all shards terminated, " << nb_failed << " with an error" << std::endl;
+  return nb_failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,166 @@
+#include "model_cache.hh"
+#include "mapped_file.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <stdio.h>
+#include <unistd.h>
+
+// prime of the 64 bit FNV-1a hash (see mapped_file::hash)
+static const uint64_t fnv_prime = 1099511628211ULL;
+
+model_cache::model_cache( )
+{
+  mDirectory = "";
+}
+
+//-----------------------------------
+
+model_cache::~model_cache( )
+{}
+
+//-----------------------------------
+
+void model_cache::set_directory( const std::string &directory )
+{
+  mDirectory = directory;
+  // strip trailing slashes
+  while ( mDirectory.size() > 1 && mDirectory[mDirectory.size() - 1] == '/' )
+    mDirectory.erase( mDirectory.size() - 1 );
+}
+
+//-----------------------------------
+
+bool model_cache::is_enabled( ) const
+{
+  return !mDirectory.empty();
+}
+
+//-----------------------------------
+
+bool model_cache::hash_file( const std::string &filename, uint64_t &hash )
+{
+  mapped_file file;
+  if ( !file.open( filename ) )
+    return false;
+
+  hash = file.hash();
+  return true;
+}
+
+//-----------------------------------
+
+uint64_t model_cache::combine( uint64_t key, uint64_t value )
+{
+  for ( int i = 0; i < 8; ++i )
+  {
+    key = ( key ^ ( value & 0xFF ) ) * fnv_prime;
+    value >>= 8;
+  }
+  return key;
+}
+
+//-----------------------------------
+
+std::string model_cache::get_filename( const std::string &stage, uint64_t key ) const
+{
+  std::ostringstream s;
+  s << mDirectory << "/" << stage << "_" << std::hex << std::setw(16) << std::setfill('0') << key;
+  return s.str();
+}
+
+//-----------------------------------
+
+bool model_cache::contains( const std::string &stage, uint64_t key ) const
+{
+  if ( !is_enabled() )
+    return false;
+  return ( access( get_filename( stage, key ).c_str(), R_OK ) == 0 );
+}
+
+//-----------------------------------
+
+std::string model_cache::get_temporary_filename( const std::string &stage, uint64_t key ) const
+{
+  return get_filename( stage, key ) + ".tmp";
+}
+
+//-----------------------------------
+
+bool model_cache::commit( const std::string &stage, uint64_t key ) const
+{
+  if ( rename( get_temporary_filename( stage, key ).c_str(), get_filename( stage, key ).c_str() ) != 0 )
+  {
+    std::cerr << "[model_cache]: ERROR: Cannot store the artifact " << get_filename( stage, key ) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//-----------------------------------
+
+bool model_cache::save_uint32( const std::string &stage, uint64_t key, const std::vector< uint32_t > &data ) const
+{
+  if ( !is_enabled() )
+    return false;
+
+  std::string filename = get_temporary_filename( stage, key );
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::binary );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[model_cache]: ERROR: Cannot write " << filename << std::endl;
+    return false;
+  }
+
+  uint64_t nb_entries = data.size();
+  ofs.write( (const char*) &nb_entries, sizeof( uint64_t ) );
+  if ( nb_entries > 0 )
+    ofs.write( (const char*) &data[0], nb_entries * sizeof( uint32_t ) );
+  ofs.close();
+
+  return commit( stage, key );
+}
+
+//-----------------------------------
+
+bool model_cache::load_uint32( const std::string &stage, uint64_t key, std::vector< uint32_t > &data ) const
+{
+  if ( !contains( stage, key ) )
+    return false;
+
+  mapped_file file;
+  if ( !file.open( get_filename( stage, key ) ) || file.size() < sizeof( uint64_t ) )
+    return false;
+
+  uint64_t nb_entries;
+  memcpy( &nb_entries, file.data(), sizeof( uint64_t ) );
+  if ( file.size() != sizeof( uint64_t ) + nb_entries * sizeof( uint32_t ) )
+  {
+    std::cerr << "[model_cache]: WARNING: Ignoring the corrupt artifact " << get_filename( stage, key ) << std::endl;
+    return false;
+  }
+
+  data.resize( nb_entries );
+  if ( nb_entries > 0 )
+    memcpy( &data[0], file.data() + sizeof( uint64_t ), nb_entries * sizeof( uint32_t ) );
+
+  return true;
+}
+
+//-----------------------------------
+
+bool model_cache::copy_to( const std::string &stage, uint64_t key, const std::string &filename ) const
+{
+  std::ifstream ifs( get_filename( stage, key ).c_str(), std::ios::in | std::ios::binary );
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::binary );
+  if ( !ifs.is_open() || !ofs.is_open() )
+  {
+    std::cerr << "[model_cache]: ERROR: Cannot copy " << get_filename( stage, key ) << " to " << filename << std::endl;
+    return false;
+  }
+  ofs << ifs.rdbuf();
+  return true;
+}
@@ -0,0 +1,65 @@
+#ifndef MODEL_CACHE_HH
+#define MODEL_CACHE_HH
+
+/**
+ *    Class to cache intermediate artifacts of the model building pipeline
+ *    (e.g., visual word assignments) in a directory. Every artifact is identified
+ *    by the name of the stage that produced it and a 64 bit key, which is computed
+ *    from the content hashes of the input files and the parameters of the stage.
+ *    Changing an input or a parameter thus automatically invalidates all artifacts
+ *    depending on it.
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+
+class model_cache
+{
+  public:
+    //! constructor, caching is disabled until a directory is set
+    model_cache( );
+
+    //! destructor
+    ~model_cache( );
+
+    //! set the (existing) directory in which the artifacts are stored. An empty string disables caching.
+    void set_directory( const std::string &directory );
+
+    //! returns true if a cache directory was set
+    bool is_enabled( ) const;
+
+    //! compute a content hash of a file, returns false if the file cannot be read
+    static bool hash_file( const std::string &filename, uint64_t &hash );
+
+    //! mix a value (e.g., a parameter) into a key
+    static uint64_t combine( uint64_t key, uint64_t value );
+
+    //! get the filename of an artifact
+    std::string get_filename( const std::string &stage, uint64_t key ) const;
+
+    //! returns true if the artifact exists in the cache
+    bool contains( const std::string &stage, uint64_t key ) const;
+
+    /**
+     * get the filename an artifact should be written to. Once the artifact is written completely,
+     * commit has to be called to make it visible, such that interrupted runs never leave partial artifacts.
+    **/
+    std::string get_temporary_filename( const std::string &stage, uint64_t key ) const;
+
+    //! makes an artifact written to get_temporary_filename visible, returns false on failure
+    bool commit( const std::string &stage, uint64_t key ) const;
+
+    //! store / load an artifact consisting of an array of uint32_t values
+    bool save_uint32( const std::string &stage, uint64_t key, const std::vector< uint32_t > &data ) const;
+    bool load_uint32( const std::string &stage, uint64_t key, std::vector< uint32_t > &data ) const;
+
+    //! copy an artifact to a file outside of the cache
+    bool copy_to( const std::string &stage, uint64_t key, const std::string &filename ) const;
+
+  private:
+    std::string mDirectory;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "query_budget.hh"
+
+
+query_budget::query_budget( )
+{
+  mDeadline = 0.0;
+  mFlags = 0;
+  gettimeofday( &mStart, 0 );
+}
+
+//---------------------------------------------------
+
+query_budget::~query_budget( )
+{
+}
+
+//---------------------------------------------------
+
+void query_budget::set_deadline( double deadline )
+{
+  mDeadline = ( deadline > 0.0 ) ? deadline : 0.0;
+}
+
+//---------------------------------------------------
+
+bool query_budget::is_enabled( ) const
+{
+  return mDeadline > 0.0;
+}
+
+//---------------------------------------------------
+
+double query_budget::get_deadline( ) const
+{
+  return mDeadline;
+}
+
+//---------------------------------------------------
+
+void query_budget::start( )
+{
+  mFlags = 0;
+  gettimeofday( &mStart, 0 );
+}
+
+//---------------------------------------------------
+
+double query_budget::get_elapsed( ) const
+{
+  timeval now;
+  gettimeofday( &now, 0 );
+  return (double) ( now.tv_sec - mStart.tv_sec ) + (double) ( now.tv_usec - mStart.tv_usec ) * 1e-6;
+}
+
+//---------------------------------------------------
+
+double query_budget::get_remaining( double fraction ) const
+{
+  return fraction * mDeadline - get_elapsed();
+}
+
+//---------------------------------------------------
+
+bool query_budget::is_exceeded( double fraction ) const
+{
+  return is_enabled() && get_elapsed() >= fraction * mDeadline;
+}
+
+//---------------------------------------------------
+
+void query_budget::degrade( int flag )
+{
+  mFlags |= flag;
+}
+
+//---------------------------------------------------
+
+int query_budget::get_flags( ) const
+{
+  return mFlags;
+}
+
+//---------------------------------------------------
+
+std::string query_budget::get_description( ) const
+{
+  if ( mFlags == 0 )
+    return std::string( "complete" );
+
+  std::string description;
+  if ( mFlags & keypoints_capped )
+    description += "keypoints capped, ";
+  if ( mFlags & matching_stopped )
+    description += "matching stopped, ";
+  if ( mFlags & images_reduced )
+    description += "top images reduced, ";
+  if ( mFlags & pose_limited )
+    description += "pose hypotheses limited, ";
+  return description.substr( 0, description.size() - 2 );
+}
@@ -0,0 +1,66 @@
+#ifndef QUERY_BUDGET_HH
+#define QUERY_BUDGET_HH
+
+/**
+ *    Per-query latency budget for the anytime mode of the localizer. The
+ *    budget is started when a query is taken up, and every stage checks
+ *    whether the time spent so far exceeds its share of the deadline. A stage
+ *    that runs out of time degrades its result (e.g., it stops matching and
+ *    keeps the correspondences found so far) and records this in the flags of
+ *    the query, such that degraded results can be told apart from complete
+ *    ones. Without a deadline, no stage is ever out of time.
+**/
+
+#include <string>
+#include <sys/time.h>
+
+
+class query_budget
+{
+  public:
+    //! the stages that degraded their result
+    enum { keypoints_capped = 1, matching_stopped = 2, images_reduced = 4, pose_limited = 8 };
+
+    //! constructor, without deadline
+    query_budget( );
+
+    //! destructor
+    ~query_budget( );
+
+    //! set the deadline per query in seconds, 0 disables the budget
+    void set_deadline( double deadline );
+
+    //! returns true if a deadline was set
+    bool is_enabled( ) const;
+
+    //! get the deadline in seconds
+    double get_deadline( ) const;
+
+    //! start the budget of a new query and clear its flags
+    void start( );
+
+    //! the time in seconds since start
+    double get_elapsed( ) const;
+
+    //! the time in seconds left until the given fraction of the deadline is used, negative if it is exceeded
+    double get_remaining( double fraction ) const;
+
+    //! returns true if the given fraction of the deadline is used, always false without deadline
+    bool is_exceeded( double fraction ) const;
+
+    //! record that a stage degraded its result
+    void degrade( int flag );
+
+    //! the flags of the stages that degraded the result of the current query, 0 if it is complete
+    int get_flags( ) const;
+
+    //! a readable list of the degraded stages
+    std::string get_description( ) const;
+
+  private:
+    double mDeadline;
+    timeval mStart;
+    int mFlags;
+};
+
+#endif
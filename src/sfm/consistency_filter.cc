@@ -0,0 +1,145 @@
+#include "consistency_filter.hh"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+// scale changes beyond this many bins are clamped
+static const int max_scale_bin = 32;
+
+//---------------------------------------------------
+
+consistency_filter::consistency_filter( )
+{
+  mNbOrientationBins = 12;
+  mScaleBinWidth = 1.0;
+  mMinMatches = 8;
+  clear();
+}
+
+//---------------------------------------------------
+
+consistency_filter::~consistency_filter( )
+{
+  clear();
+  mHistogram.clear();
+}
+
+//---------------------------------------------------
+
+void consistency_filter::set_bins( uint32_t nb_orientation_bins, double scale_bin_width )
+{
+  // at least 3 bins, such that the neighborhood of a bin does not wrap around onto itself
+  mNbOrientationBins = std::max( nb_orientation_bins, (uint32_t) 3 );
+  mScaleBinWidth = ( scale_bin_width > 0.0 ) ? scale_bin_width : 1.0;
+}
+
+//---------------------------------------------------
+
+void consistency_filter::set_min_matches( uint32_t min_matches )
+{
+  mMinMatches = min_matches;
+}
+
+//---------------------------------------------------
+
+void consistency_filter::clear( )
+{
+  mOrientationBins.clear();
+  mScaleBins.clear();
+  mMinScaleBin = max_scale_bin;
+  mMaxScaleBin = -max_scale_bin;
+}
+
+//---------------------------------------------------
+
+void consistency_filter::add_match( float database_scale, float database_orientation, float query_scale, float query_orientation )
+{
+  if ( database_scale <= 0.0f || query_scale <= 0.0f )
+  {
+    mOrientationBins.push_back( -1 );
+    mScaleBins.push_back( 0 );
+    return;
+  }
+
+  double orientation_change = fmod( (double) query_orientation - (double) database_orientation, 2.0 * M_PI );
+  if ( orientation_change < 0.0 )
+    orientation_change += 2.0 * M_PI;
+  int orientation_bin = (int) ( orientation_change / ( 2.0 * M_PI ) * (double) mNbOrientationBins );
+  mOrientationBins.push_back( std::min( orientation_bin, (int) mNbOrientationBins - 1 ) );
+
+  double scale_change = log( (double) query_scale / (double) database_scale ) / log( 2.0 );
+  int scale_bin = (int) floor( scale_change / mScaleBinWidth );
+  scale_bin = std::max( -max_scale_bin, std::min( max_scale_bin, scale_bin ) );
+  mScaleBins.push_back( scale_bin );
+  mMinScaleBin = std::min( mMinScaleBin, scale_bin );
+  mMaxScaleBin = std::max( mMaxScaleBin, scale_bin );
+}
+
+//---------------------------------------------------
+
+uint32_t consistency_filter::filter( std::vector< bool > &consistent )
+{
+  uint32_t nb_matches = (uint32_t) mOrientationBins.size();
+  consistent.assign( nb_matches, true );
+
+  uint32_t nb_voting = 0;
+  for ( uint32_t i = 0; i < nb_matches; ++i )
+  {
+    if ( mOrientationBins[i] >= 0 )
+      ++nb_voting;
+  }
+  if ( nb_voting < mMinMatches || nb_voting == 0 )
+    return nb_matches;
+
+  int nb_orientation_bins = (int) mNbOrientationBins;
+  int nb_scale_bins = mMaxScaleBin - mMinScaleBin + 1;
+  mHistogram.assign( nb_orientation_bins * nb_scale_bins, 0 );
+  for ( uint32_t i = 0; i < nb_matches; ++i )
+  {
+    if ( mOrientationBins[i] >= 0 )
+      ++mHistogram[mOrientationBins[i] * nb_scale_bins + mScaleBins[i] - mMinScaleBin];
+  }
+
+  // the mode: the bin with the most votes in its neighborhood
+  int best_orientation = 0, best_scale = 0;
+  uint32_t best_votes = 0;
+  for ( int o = 0; o < nb_orientation_bins; ++o )
+  {
+    for ( int s = 0; s < nb_scale_bins; ++s )
+    {
+      uint32_t votes = 0;
+      for ( int k = -1; k <= 1; ++k )
+      {
+        int neighbor_orientation = ( o + k + nb_orientation_bins ) % nb_orientation_bins;
+        for ( int l = std::max( s - 1, 0 ); l <= std::min( s + 1, nb_scale_bins - 1 ); ++l )
+          votes += mHistogram[neighbor_orientation * nb_scale_bins + l];
+      }
+      if ( votes > best_votes )
+      {
+        best_votes = votes;
+        best_orientation = o;
+        best_scale = s + mMinScaleBin;
+      }
+    }
+  }
+
+  uint32_t nb_consistent = 0;
+  for ( uint32_t i = 0; i < nb_matches; ++i )
+  {
+    if ( mOrientationBins[i] >= 0 )
+    {
+      int orientation_distance = abs( mOrientationBins[i] - best_orientation );
+      orientation_distance = std::min( orientation_distance, nb_orientation_bins - orientation_distance );
+      consistent[i] = ( orientation_distance <= 1 && abs( mScaleBins[i] - best_scale ) <= 1 );
+    }
+    if ( consistent[i] )
+      ++nb_consistent;
+  }
+  return nb_consistent;
+}
@@ -0,0 +1,70 @@
+#ifndef CONSISTENCY_FILTER_HH
+#define CONSISTENCY_FILTER_HH
+
+/**
+ *    Cheap geometric pre-filter for the matches of a query to one database
+ *    image, based on the scale and orientation of the keypoints. For a correct
+ *    match, the orientation change between the database keypoint and the query
+ *    keypoint is roughly the in-plane rotation between the two images, and the
+ *    scale change follows the ratio of the viewing distances. Both are thus
+ *    similar for most correct matches, while they are random for wrong ones.
+ *
+ *    Every match votes with its (orientation change, log2 scale change) into a
+ *    2D histogram with circular orientation bins. As in 1-point RANSAC, each
+ *    match is a hypothesis of the transformation; the dominant mode is the bin
+ *    whose 3x3 neighborhood collects the most votes, and the matches outside of
+ *    this neighborhood are rejected. Matches without a scale (e.g., views that
+ *    were not read from a key file) do not vote and are always kept.
+**/
+
+#include <vector>
+#include <stdint.h>
+
+
+class consistency_filter
+{
+  public:
+    //! constructor
+    consistency_filter( );
+
+    //! destructor
+    ~consistency_filter( );
+
+    /**
+     * Set the number of orientation bins (default 12, i.e., 30 degrees) and the width of the scale bins
+     * in octaves (default 1). The kept matches lie within one bin of the mode in both dimensions.
+    **/
+    void set_bins( uint32_t nb_orientation_bins, double scale_bin_width );
+
+    //! set the minimal number of voting matches, fewer matches are all kept (default 8)
+    void set_min_matches( uint32_t min_matches );
+
+    //! clear the matches
+    void clear( );
+
+    /**
+     * Add a match from the scale and orientation (in radians) of the database keypoint and of the query
+     * keypoint. A scale that is not positive means that it is unknown.
+    **/
+    void add_match( float database_scale, float database_orientation, float query_scale, float query_orientation );
+
+    /**
+     * Find the dominant mode of the matches added since the last clear. consistent[i] is set to true if
+     * the i-th match is kept. Returns the number of kept matches.
+    **/
+    uint32_t filter( std::vector< bool > &consistent );
+
+  private:
+    uint32_t mNbOrientationBins;
+    double mScaleBinWidth;
+    uint32_t mMinMatches;
+
+    // the bin of every match, -1 if it does not vote
+    std::vector< int > mOrientationBins;
+    std::vector< int > mScaleBins;
+    int mMinScaleBin, mMaxScaleBin;
+
+    std::vector< uint32_t > mHistogram;
+};
+
+#endif
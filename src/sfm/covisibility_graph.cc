@@ -0,0 +1,332 @@
+#include "covisibility_graph.hh"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+
+static const char covisibility_magic[8] = { 'C', 'P', 'F', 'C', 'O', 'V', 'I', '1' };
+
+// orders edges by decreasing weight, ties are broken by the camera id
+static bool compare_edges( const std::pair< uint32_t, uint32_t > &a, const std::pair< uint32_t, uint32_t > &b )
+{
+  return ( a.second > b.second ) || ( a.second == b.second && a.first < b.first );
+}
+
+covisibility_graph::covisibility_graph( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+covisibility_graph::~covisibility_graph( )
+{
+}
+
+//---------------------------------------------------
+
+// the cameras seeing the points, from the visibility lists of parse_bundler or from the slim point store
+class view_list_visibility
+{
+  public:
+    view_list_visibility( const std::vector< feature_3D_info > &feature_infos ) : mFeatureInfos( feature_infos ) { }
+    uint32_t get_nb_points( ) const { return (uint32_t) mFeatureInfos.size(); }
+    uint32_t get_nb_views( uint32_t point ) const { return (uint32_t) mFeatureInfos[point].view_list.size(); }
+    uint32_t get_camera( uint32_t point, uint32_t view ) const { return mFeatureInfos[point].view_list[view].camera; }
+  private:
+    const std::vector< feature_3D_info > &mFeatureInfos;
+};
+
+class model_visibility
+{
+  public:
+    model_visibility( const localization_model &model ) : mModel( model ) { }
+    uint32_t get_nb_points( ) const { return mModel.get_nb_points(); }
+    uint32_t get_nb_views( uint32_t point ) const { return mModel.get_nb_views( point ); }
+    uint32_t get_camera( uint32_t point, uint32_t view ) const { return mModel.get_cameras( point )[view]; }
+  private:
+    const localization_model &mModel;
+};
+
+// the strongest edges of every camera, with the cameras in CSR layout
+template< class visibility_type >
+static void compute_edges( const visibility_type &visibility, uint32_t nb_cameras, uint32_t min_shared_points, uint32_t max_neighbors,
+                           std::vector< uint32_t > &offsets, std::vector< uint32_t > &neighbors, std::vector< uint32_t > &weights )
+{
+  uint32_t nb_points = visibility.get_nb_points();
+
+  // the points seen by every camera
+  std::vector< uint32_t > camera_point_offsets( nb_cameras + 1, 0 );
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    for ( uint32_t j = 0; j < visibility.get_nb_views( i ); ++j )
+    {
+      uint32_t camera = visibility.get_camera( i, j );
+      if ( camera < nb_cameras )
+        ++camera_point_offsets[camera + 1];
+    }
+  }
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+    camera_point_offsets[i + 1] += camera_point_offsets[i];
+  std::vector< uint32_t > camera_points( camera_point_offsets[nb_cameras] );
+  std::vector< uint32_t > fill_positions( camera_point_offsets.begin(), camera_point_offsets.end() - 1 );
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    for ( uint32_t j = 0; j < visibility.get_nb_views( i ); ++j )
+    {
+      uint32_t camera = visibility.get_camera( i, j );
+      if ( camera < nb_cameras )
+        camera_points[fill_positions[camera]++] = i;
+    }
+  }
+
+  // the strongest edges of every camera, the cameras are independent of each other
+  std::vector< std::vector< std::pair< uint32_t, uint32_t > > > edges( nb_cameras );
+  int nb_sources = (int) nb_cameras;
+  #pragma omp parallel
+  {
+    std::vector< uint32_t > shared_points( nb_cameras, 0 );
+    std::vector< uint32_t > touched_cameras;
+    std::vector< std::pair< uint32_t, uint32_t > > candidates;
+
+    #pragma omp for schedule(dynamic, 16)
+    for ( int i = 0; i < nb_sources; ++i )
+    {
+      touched_cameras.clear();
+      for ( uint32_t j = camera_point_offsets[i]; j < camera_point_offsets[i + 1]; ++j )
+      {
+        uint32_t point = camera_points[j];
+        for ( uint32_t k = 0; k < visibility.get_nb_views( point ); ++k )
+        {
+          uint32_t other = visibility.get_camera( point, k );
+          if ( other == (uint32_t) i || other >= nb_cameras )
+            continue;
+          if ( shared_points[other] == 0 )
+            touched_cameras.push_back( other );
+          ++shared_points[other];
+        }
+      }
+
+      candidates.clear();
+      for ( size_t j = 0; j < touched_cameras.size(); ++j )
+      {
+        uint32_t other = touched_cameras[j];
+        if ( shared_points[other] >= min_shared_points )
+          candidates.push_back( std::make_pair( other, shared_points[other] ) );
+        shared_points[other] = 0;
+      }
+      size_t nb_kept = std::min( candidates.size(), (size_t) max_neighbors );
+      std::partial_sort( candidates.begin(), candidates.begin() + nb_kept, candidates.end(), compare_edges );
+      edges[i].assign( candidates.begin(), candidates.begin() + nb_kept );
+    }
+  }
+
+  offsets.assign( nb_cameras + 1, 0 );
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+    offsets[i + 1] = offsets[i] + (uint32_t) edges[i].size();
+  neighbors.resize( offsets[nb_cameras] );
+  weights.resize( offsets[nb_cameras] );
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+  {
+    for ( size_t j = 0; j < edges[i].size(); ++j )
+    {
+      neighbors[offsets[i] + j] = edges[i][j].first;
+      weights[offsets[i] + j] = edges[i][j].second;
+    }
+  }
+}
+
+//---------------------------------------------------
+
+void covisibility_graph::build( const std::vector< feature_3D_info > &feature_infos, uint32_t nb_cameras, uint32_t min_shared_points, uint32_t max_neighbors )
+{
+  compute_edges( view_list_visibility( feature_infos ), nb_cameras, min_shared_points, max_neighbors, mOffsets, mNeighbors, mWeights );
+}
+
+//---------------------------------------------------
+
+void covisibility_graph::build( const localization_model &model, uint32_t nb_cameras, uint32_t min_shared_points, uint32_t max_neighbors )
+{
+  compute_edges( model_visibility( model ), nb_cameras, min_shared_points, max_neighbors, mOffsets, mNeighbors, mWeights );
+}
+
+//---------------------------------------------------
+
+bool covisibility_graph::save( const std::string &filename ) const
+{
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::binary );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[covisibility_graph]: ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+
+  uint32_t nb_cameras = get_nb_cameras(), nb_edges = get_nb_edges();
+  ofs.write( covisibility_magic, 8 );
+  ofs.write( (const char*) &nb_cameras, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_edges, sizeof( uint32_t ) );
+  ofs.write( (const char*) &mOffsets[0], sizeof( uint32_t ) * mOffsets.size() );
+  if ( nb_edges > 0 )
+  {
+    ofs.write( (const char*) &mNeighbors[0], sizeof( uint32_t ) * nb_edges );
+    ofs.write( (const char*) &mWeights[0], sizeof( uint32_t ) * nb_edges );
+  }
+
+  if ( !ofs )
+  {
+    std::cerr << "[covisibility_graph]: ERROR: Could not write " << filename << std::endl;
+    return false;
+  }
+  ofs.close();
+  return true;
+}
+
+//---------------------------------------------------
+
+bool covisibility_graph::load( const std::string &filename )
+{
+  clear();
+
+  std::ifstream ifs( filename.c_str(), std::ios::in | std::ios::binary );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[covisibility_graph]: ERROR: Cannot read " << filename << std::endl;
+    return false;
+  }
+
+  char magic[8];
+  uint32_t nb_cameras = 0, nb_edges = 0;
+  ifs.read( magic, 8 );
+  ifs.read( (char*) &nb_cameras, sizeof( uint32_t ) );
+  ifs.read( (char*) &nb_edges, sizeof( uint32_t ) );
+  if ( !ifs || memcmp( magic, covisibility_magic, 8 ) != 0 )
+  {
+    std::cerr << "[covisibility_graph]: ERROR: " << filename << " is not a covisibility graph" << std::endl;
+    return false;
+  }
+
+  mOffsets.resize( nb_cameras + 1 );
+  mNeighbors.resize( nb_edges );
+  mWeights.resize( nb_edges );
+  ifs.read( (char*) &mOffsets[0], sizeof( uint32_t ) * mOffsets.size() );
+  if ( nb_edges > 0 )
+  {
+    ifs.read( (char*) &mNeighbors[0], sizeof( uint32_t ) * nb_edges );
+    ifs.read( (char*) &mWeights[0], sizeof( uint32_t ) * nb_edges );
+  }
+  if ( !ifs || mOffsets[0] != 0 || mOffsets[nb_cameras] != nb_edges )
+  {
+    std::cerr << "[covisibility_graph]: ERROR: " << filename << " is truncated" << std::endl;
+    clear();
+    return false;
+  }
+  ifs.close();
+
+  // the users index arrays of the cameras with the offsets and the neighbors, they have to be valid
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+  {
+    bool valid = ( mOffsets[i] <= mOffsets[i + 1] && mOffsets[i + 1] <= nb_edges );
+    for ( uint32_t j = mOffsets[i]; j < mOffsets[i + 1] && valid; ++j )
+      valid = ( mNeighbors[j] < nb_cameras );
+    if ( !valid )
+    {
+      std::cerr << "[covisibility_graph]: ERROR: " << filename << " contains invalid edges of camera " << i << std::endl;
+      clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+//---------------------------------------------------
+
+void covisibility_graph::clear( )
+{
+  mOffsets.assign( 1, 0 );
+  mNeighbors.clear();
+  mWeights.clear();
+}
+
+//---------------------------------------------------
+
+uint32_t covisibility_graph::get_nb_cameras( ) const
+{
+  return (uint32_t) mOffsets.size() - 1;
+}
+
+//---------------------------------------------------
+
+uint32_t covisibility_graph::get_nb_edges( ) const
+{
+  return (uint32_t) mNeighbors.size();
+}
+
+//---------------------------------------------------
+
+uint32_t covisibility_graph::get_degree( uint32_t camera ) const
+{
+  return mOffsets[camera + 1] - mOffsets[camera];
+}
+
+//---------------------------------------------------
+
+const uint32_t* covisibility_graph::get_neighbors( uint32_t camera ) const
+{
+  return mNeighbors.empty() ? 0 : &mNeighbors[0] + mOffsets[camera];
+}
+
+//---------------------------------------------------
+
+const uint32_t* covisibility_graph::get_weights( uint32_t camera ) const
+{
+  return mWeights.empty() ? 0 : &mWeights[0] + mOffsets[camera];
+}
+
+//---------------------------------------------------
+
+uint64_t covisibility_graph::get_memory( ) const
+{
+  return sizeof( uint32_t ) * ( mOffsets.size() + mNeighbors.size() + mWeights.size() );
+}
+
+//---------------------------------------------------
+
+void covisibility_graph::print_statistics( ) const
+{
+  uint32_t nb_cameras = get_nb_cameras();
+  std::vector< uint32_t > degrees( nb_cameras );
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+    degrees[i] = get_degree( i );
+  std::sort( degrees.begin(), degrees.end() );
+
+  // the number of cameras per degree range
+  const uint32_t nb_ranges = 7;
+  const uint32_t range_starts[nb_ranges] = { 0, 1, 5, 10, 20, 50, 100 };
+  uint32_t histogram[nb_ranges] = { 0, 0, 0, 0, 0, 0, 0 };
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+  {
+    uint32_t r = nb_ranges - 1;
+    while ( r > 0 && degrees[i] < range_starts[r] )
+      --r;
+    ++histogram[r];
+  }
+
+  std::cout << "[covisibility_graph]: " << nb_cameras << " cameras, " << get_nb_edges() << " edges, degree min / median / mean / max: ";
+  if ( nb_cameras > 0 )
+    std::cout << degrees[0] << " / " << degrees[nb_cameras / 2] << " / " << (double) get_nb_edges() / (double) nb_cameras << " / " << degrees[nb_cameras - 1];
+  else
+    std::cout << "- / - / - / -";
+  std::cout << ", " << get_memory() / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+  std::cout << "[covisibility_graph]: cameras per degree:";
+  for ( uint32_t r = 0; r < nb_ranges; ++r )
+  {
+    std::cout << " " << range_starts[r];
+    if ( r + 1 == nb_ranges )
+      std::cout << "+";
+    else if ( range_starts[r + 1] - 1 > range_starts[r] )
+      std::cout << "-" << range_starts[r + 1] - 1;
+    std::cout << ": " << histogram[r] << ( r + 1 < nb_ranges ? "," : "" );
+  }
+  std::cout << std::endl;
+}
@@ -0,0 +1,80 @@
+#ifndef COVISIBILITY_GRAPH_HH
+#define COVISIBILITY_GRAPH_HH
+
+/**
+ *    Covisibility graph of the cameras of a model. Two cameras are adjacent
+ *    if they see at least a minimal number of common points, the weight of
+ *    the edge is the number of shared points. Only the strongest edges of
+ *    every camera are kept.
+ *
+ *    The graph is stored in CSR layout: the neighbors of camera i are
+ *    get_neighbors(i)[0] to get_neighbors(i)[get_degree(i)-1], sorted by
+ *    decreasing weight, such that stages of the localizer can expand or
+ *    re-rank candidate cameras in O(degree) without going through the
+ *    visibility lists of the points.
+ *
+ *    The graph is built by build_localization_model and saved next to the
+ *    model (<model>.covisibility).
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "parse_bundler.hh"
+#include "localization_model.hh"
+
+
+class covisibility_graph
+{
+  public:
+    //! the edges kept by build_localization_model: cameras sharing at least 10 points, at most 50 neighbors per camera
+    enum { default_min_shared_points = 10, default_max_neighbors = 50 };
+
+    //! constructor
+    covisibility_graph( );
+
+    //! destructor
+    ~covisibility_graph( );
+
+    /**
+     * Build the graph from the visibility lists of the points: for every camera, the (at most max_neighbors)
+     * cameras sharing the most points with it, if they share at least min_shared_points. The cameras are
+     * processed in parallel.
+    **/
+    void build( const std::vector< feature_3D_info > &feature_infos, uint32_t nb_cameras, uint32_t min_shared_points, uint32_t max_neighbors );
+    void build( const localization_model &model, uint32_t nb_cameras, uint32_t min_shared_points, uint32_t max_neighbors );
+
+    //! save the graph in binary format
+    bool save( const std::string &filename ) const;
+
+    //! load a graph saved by save, returns false if the file is not a covisibility graph
+    bool load( const std::string &filename );
+
+    //! remove all cameras and edges
+    void clear( );
+
+    uint32_t get_nb_cameras( ) const;
+    uint32_t get_nb_edges( ) const;
+
+    //! the number of neighbors of the camera
+    uint32_t get_degree( uint32_t camera ) const;
+
+    //! the neighbors of the camera and the numbers of points shared with them, sorted by decreasing weight
+    const uint32_t* get_neighbors( uint32_t camera ) const;
+    const uint32_t* get_weights( uint32_t camera ) const;
+
+    //! the memory used by the graph in bytes
+    uint64_t get_memory( ) const;
+
+    //! print the number of edges, the degree distribution and the memory
+    void print_statistics( ) const;
+
+  private:
+    //! the edges of camera i are mNeighbors[mOffsets[i]] to mNeighbors[mOffsets[i+1]-1]
+    std::vector< uint32_t > mOffsets;
+    std::vector< uint32_t > mNeighbors;
+    std::vector< uint32_t > mWeights;
+};
+
+#endif
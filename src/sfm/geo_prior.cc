@@ -0,0 +1,329 @@
+#include "geo_prior.hh"
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+// mean earth radius in meters
+static const double earth_radius = 6371000.0;
+
+geo_prior::geo_prior( )
+{
+  mReferenceLatitude = mReferenceLongitude = mReferenceHeight = 0.0;
+  mGeoregistration.setIdentity();
+  mTileSize = 1.0;
+  mModel = 0;
+  mQueryStamp = 0;
+  mNbSelectedCameras = 0;
+  mEntryStamp = 0;
+}
+
+//---------------------------------------------------
+
+geo_prior::~geo_prior( )
+{
+  mModel = 0;
+}
+
+//---------------------------------------------------
+
+bool geo_prior::load_georegistration( const std::string &filename )
+{
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[geo_prior]: ERROR: Cannot read the georegistration from " << filename << std::endl;
+    return false;
+  }
+
+  ifs >> mReferenceLatitude >> mReferenceLongitude >> mReferenceHeight;
+  for ( int i = 0; i < 4; ++i )
+  {
+    for ( int j = 0; j < 4; ++j )
+      ifs >> mGeoregistration( i, j );
+  }
+
+  if ( !ifs )
+  {
+    std::cerr << "[geo_prior]: ERROR: " << filename << " does not contain a reference position and a 4x4 matrix" << std::endl;
+    return false;
+  }
+
+  ifs.close();
+  return true;
+}
+
+//---------------------------------------------------
+
+void geo_prior::index_cameras( std::vector< bundler_camera > &cameras, const localization_model &model, double tile_size )
+{
+  mModel = &model;
+  mTileSize = tile_size;
+  mTileIds.clear();
+  mTileCoordinates.clear();
+  mTileCameras.clear();
+  mTiles.clear();
+
+  uint32_t nb_cameras = (uint32_t) cameras.size();
+  mCameraPositions.assign( nb_cameras, std::make_pair( 0.0, 0.0 ) );
+  mCameraTiles.assign( nb_cameras, -1 );
+  mCameraStamps.assign( nb_cameras, 0 );
+
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+  {
+    bundler_camera &cam = cameras[i];
+    if ( cam.focal_length == 0.0 )
+      continue;
+
+    // Bundler projects a point X to R * X + t, i.e., the camera center is -R^T t
+    Eigen::Vector3d center = -( cam.rotation.cast< double >().transpose() * cam.translation );
+    cam.pos_x = center[0];
+    cam.pos_y = center[1];
+    cam.pos_z = center[2];
+
+    model_to_local( center[0], center[1], center[2], mCameraPositions[i].first, mCameraPositions[i].second );
+
+    std::pair< int, int > coordinates = get_tile_coordinates( mCameraPositions[i].first, mCameraPositions[i].second );
+    std::map< std::pair< int, int >, uint32_t >::iterator it = mTileIds.find( coordinates );
+    if ( it == mTileIds.end() )
+    {
+      it = mTileIds.insert( std::make_pair( coordinates, (uint32_t) mTileCoordinates.size() ) ).first;
+      mTileCoordinates.push_back( coordinates );
+      mTileCameras.resize( mTileCoordinates.size() );
+    }
+    mCameraTiles[i] = (int) it->second;
+    mTileCameras[it->second].push_back( i );
+  }
+
+  mTiles.resize( mTileCoordinates.size() );
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void geo_prior::index_inverted_lists( const basic_inverted_file< nb_bits > &lists, uint32_t nb_points )
+{
+  mPointStamps.assign( nb_points, 0 );
+  mEntryStamps.assign( lists.get_nb_entries(), 0 );
+  mQueryStamp = 0;
+  mEntryStamp = 0;
+
+  // the tiles containing a camera that sees the point
+  std::vector< std::vector< uint32_t > > point_tiles( nb_points );
+  for ( size_t i = 0; i < mCameraTiles.size(); ++i )
+  {
+    if ( mCameraTiles[i] < 0 )
+      continue;
+    uint32_t tile_id = (uint32_t) mCameraTiles[i];
+    const uint32_t *points = mModel->get_camera_points( (uint32_t) i );
+    for ( uint32_t j = 0; j < mModel->get_nb_camera_points( (uint32_t) i ); ++j )
+    {
+      std::vector< uint32_t > &tiles = point_tiles[points[j]];
+      if ( std::find( tiles.begin(), tiles.end(), tile_id ) == tiles.end() )
+        tiles.push_back( tile_id );
+    }
+  }
+
+  for ( size_t i = 0; i < mTiles.size(); ++i )
+  {
+    mTiles[i].words.clear();
+    mTiles[i].offsets.clear();
+    mTiles[i].entries.clear();
+    mTiles[i].entry_ids.clear();
+  }
+
+  // the visual words are processed in increasing order, so the words of every tile are sorted
+  std::vector< std::pair< uint32_t, uint32_t > > list;
+  for ( uint32_t vw = 0; vw < lists.get_nb_clusters(); ++vw )
+  {
+    lists.get_entries( vw, list );
+    for ( size_t j = 0; j < list.size(); ++j )
+    {
+      const std::vector< uint32_t > &tiles = point_tiles[list[j].first];
+      for ( size_t k = 0; k < tiles.size(); ++k )
+      {
+        tile &t = mTiles[tiles[k]];
+        if ( t.words.empty() || t.words.back() != vw )
+        {
+          t.words.push_back( vw );
+          t.offsets.push_back( (uint32_t) t.entries.size() );
+        }
+        t.entries.push_back( list[j] );
+        t.entry_ids.push_back( lists.get_entry_offset( vw ) + (uint32_t) j );
+      }
+    }
+  }
+
+  size_t nb_entries = 0;
+  for ( size_t i = 0; i < mTiles.size(); ++i )
+  {
+    mTiles[i].offsets.push_back( (uint32_t) mTiles[i].entries.size() );
+    nb_entries += mTiles[i].entries.size();
+  }
+
+  std::cout << "[geo_prior]: " << mTiles.size() << " tiles of " << mTileSize << "m storing " << nb_entries << " entries" << std::endl;
+}
+
+template void geo_prior::index_inverted_lists( const basic_inverted_file< 32 > &lists, uint32_t nb_points );
+template void geo_prior::index_inverted_lists( const basic_inverted_file< 64 > &lists, uint32_t nb_points );
+template void geo_prior::index_inverted_lists( const basic_inverted_file< 128 > &lists, uint32_t nb_points );
+
+//---------------------------------------------------
+
+bool geo_prior::select( double latitude, double longitude, double radius )
+{
+  ++mQueryStamp;
+  if ( mQueryStamp == 0 )
+  {
+    std::fill( mCameraStamps.begin(), mCameraStamps.end(), 0 );
+    std::fill( mPointStamps.begin(), mPointStamps.end(), 0 );
+    mQueryStamp = 1;
+  }
+  mSelectedTiles.clear();
+  mNbSelectedCameras = 0;
+
+  double east, north;
+  gps_to_local( latitude, longitude, east, north );
+
+  // only tiles overlapping the bounding box of the circle can contain selected cameras
+  std::pair< int, int > min_tile = get_tile_coordinates( east - radius, north - radius );
+  std::pair< int, int > max_tile = get_tile_coordinates( east + radius, north + radius );
+
+  double squared_radius = radius * radius;
+  for ( int x = min_tile.first; x <= max_tile.first; ++x )
+  {
+    for ( int y = min_tile.second; y <= max_tile.second; ++y )
+    {
+      std::map< std::pair< int, int >, uint32_t >::const_iterator it = mTileIds.find( std::make_pair( x, y ) );
+      if ( it == mTileIds.end() )
+        continue;
+
+      const std::vector< uint32_t > &tile_cameras = mTileCameras[it->second];
+      bool tile_selected = false;
+      for ( size_t i = 0; i < tile_cameras.size(); ++i )
+      {
+        uint32_t cam_id = tile_cameras[i];
+        double d_east = mCameraPositions[cam_id].first - east;
+        double d_north = mCameraPositions[cam_id].second - north;
+        if ( d_east * d_east + d_north * d_north > squared_radius )
+          continue;
+
+        mCameraStamps[cam_id] = mQueryStamp;
+        ++mNbSelectedCameras;
+        tile_selected = true;
+
+        const uint32_t *points = mModel->get_camera_points( cam_id );
+        for ( uint32_t j = 0; j < mModel->get_nb_camera_points( cam_id ); ++j )
+          mPointStamps[points[j]] = mQueryStamp;
+      }
+      if ( tile_selected )
+        mSelectedTiles.push_back( it->second );
+    }
+  }
+
+  return mNbSelectedCameras > 0;
+}
+
+//---------------------------------------------------
+
+bool geo_prior::is_camera_selected( uint32_t camera ) const
+{
+  return mCameraStamps[camera] == mQueryStamp;
+}
+
+//---------------------------------------------------
+
+bool geo_prior::is_point_selected( uint32_t point ) const
+{
+  return mPointStamps[point] == mQueryStamp;
+}
+
+//---------------------------------------------------
+
+void geo_prior::get_entries( uint32_t vw, std::vector< std::pair< uint32_t, uint32_t > > &entries )
+{
+  entries.clear();
+
+  bool check_duplicates = ( mSelectedTiles.size() > 1 );
+  if ( check_duplicates )
+  {
+    ++mEntryStamp;
+    if ( mEntryStamp == 0 )
+    {
+      std::fill( mEntryStamps.begin(), mEntryStamps.end(), 0 );
+      mEntryStamp = 1;
+    }
+  }
+
+  for ( size_t i = 0; i < mSelectedTiles.size(); ++i )
+  {
+    const tile &t = mTiles[mSelectedTiles[i]];
+    std::vector< uint32_t >::const_iterator it = std::lower_bound( t.words.begin(), t.words.end(), vw );
+    if ( it == t.words.end() || *it != vw )
+      continue;
+
+    size_t index = it - t.words.begin();
+    for ( uint32_t j = t.offsets[index]; j < t.offsets[index + 1]; ++j )
+    {
+      const std::pair< uint32_t, uint32_t > &entry = t.entries[j];
+      // the tile contains all points seen by its cameras, not all of them are within the radius
+      if ( mPointStamps[entry.first] != mQueryStamp )
+        continue;
+      if ( check_duplicates )
+      {
+        if ( mEntryStamps[t.entry_ids[j]] == mEntryStamp )
+          continue;
+        mEntryStamps[t.entry_ids[j]] = mEntryStamp;
+      }
+      entries.push_back( entry );
+    }
+  }
+}
+
+//---------------------------------------------------
+
+uint32_t geo_prior::get_nb_tiles( ) const
+{
+  return (uint32_t) mTiles.size();
+}
+
+//---------------------------------------------------
+
+uint32_t geo_prior::get_nb_selected_tiles( ) const
+{
+  return (uint32_t) mSelectedTiles.size();
+}
+
+//---------------------------------------------------
+
+uint32_t geo_prior::get_nb_selected_cameras( ) const
+{
+  return mNbSelectedCameras;
+}
+
+//---------------------------------------------------
+
+std::pair< int, int > geo_prior::get_tile_coordinates( double east, double north ) const
+{
+  return std::make_pair( (int) floor( east / mTileSize ), (int) floor( north / mTileSize ) );
+}
+
+//---------------------------------------------------
+
+void geo_prior::gps_to_local( double latitude, double longitude, double &east, double &north ) const
+{
+  // equirectangular projection around the reference position, accurate enough at city scale
+  const double deg_to_rad = M_PI / 180.0;
+  east = earth_radius * cos( mReferenceLatitude * deg_to_rad ) * ( longitude - mReferenceLongitude ) * deg_to_rad;
+  north = earth_radius * ( latitude - mReferenceLatitude ) * deg_to_rad;
+}
+
+//---------------------------------------------------
+
+void geo_prior::model_to_local( double x, double y, double z, double &east, double &north ) const
+{
+  Eigen::Vector4d local = mGeoregistration * Eigen::Vector4d( x, y, z, 1.0 );
+  east = local[0] / local[3];
+  north = local[1] / local[3];
+}
@@ -0,0 +1,133 @@
+#ifndef GEO_PRIOR_HH
+#define GEO_PRIOR_HH
+
+/**
+ *    Restricts the search of a query with GPS information to the part of the
+ *    model close to its GPS position. The camera centers of the reconstruction
+ *    are transformed into a local metric frame (east, north, up) with a
+ *    georegistration and sorted into square tiles. For every tile, the inverted
+ *    lists are restricted to the (3D point id, code id) pairs of the points
+ *    seen by the cameras of the tile, such that a query only has to scan the
+ *    entries of the tiles around its GPS position.
+ *
+ *    The georegistration file is a text file containing the reference position
+ *    (latitude and longitude in degrees, height in meters) of the local frame
+ *    followed by a 4x4 matrix (row-major) mapping model coordinates to meters
+ *    east, north and up of the reference position.
+**/
+
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+#include <stdint.h>
+
+#include <Eigen/Dense>
+
+#include "bundler_camera.hh"
+#include "localization_model.hh"
+#include "../features/inverted_file.hh"
+
+
+class geo_prior
+{
+  public:
+    //! constructor
+    geo_prior( );
+
+    //! destructor
+    ~geo_prior( );
+
+    //! load the georegistration of the model, returns false if the file cannot be read
+    bool load_georegistration( const std::string &filename );
+
+    /**
+     * Computes the camera centers (stored in bundler_camera::pos_x/y/z in model coordinates) and
+     * sorts the cameras into tiles of tile_size x tile_size meters. Cameras without a focal length
+     * are not part of the reconstruction and are ignored. The points seen by the cameras are taken
+     * from the model (see localization_model::index_camera_points), which needs to stay valid while
+     * the prior is used.
+    **/
+    void index_cameras( std::vector< bundler_camera > &cameras, const localization_model &model, double tile_size );
+
+    //! build the inverted lists of the tiles from the inverted file of the whole model (call after index_cameras)
+    template< int nb_bits >
+    void index_inverted_lists( const basic_inverted_file< nb_bits > &lists, uint32_t nb_points );
+
+    /**
+     * Selects the cameras within radius meters (horizontal distance) of the GPS position and the
+     * points seen by them. Returns false if no camera is close enough, in which case the query
+     * should be matched against the whole model.
+    **/
+    bool select( double latitude, double longitude, double radius );
+
+    //! returns true if the camera was selected by the last call of select
+    bool is_camera_selected( uint32_t camera ) const;
+
+    //! returns true if the point is seen by a camera selected by the last call of select
+    bool is_point_selected( uint32_t point ) const;
+
+    //! get the (3D point id, code id) pairs of visual word vw that belong to selected points, every entry is returned once
+    void get_entries( uint32_t vw, std::vector< std::pair< uint32_t, uint32_t > > &entries );
+
+    //! get the number of tiles and the number of tiles selected by the last call of select
+    uint32_t get_nb_tiles( ) const;
+    uint32_t get_nb_selected_tiles( ) const;
+
+    //! get the number of cameras selected by the last call of select
+    uint32_t get_nb_selected_cameras( ) const;
+
+    //! convert a GPS position into the local frame
+    void gps_to_local( double latitude, double longitude, double &east, double &north ) const;
+
+    //! convert a position in model coordinates into the local frame
+    void model_to_local( double x, double y, double z, double &east, double &north ) const;
+
+  private:
+    //! the inverted lists of a tile, only visual words with entries are stored
+    struct tile
+    {
+      //! sorted ids of the visual words
+      std::vector< uint32_t > words;
+      //! the entries of words[i] are entries[offsets[i]] to entries[offsets[i+1]-1]
+      std::vector< uint32_t > offsets;
+      std::vector< std::pair< uint32_t, uint32_t > > entries;
+      //! the ids of the entries in the inverted file, to detect entries contained in several tiles
+      std::vector< uint32_t > entry_ids;
+    };
+
+    //! get the tile containing the local position (east, north)
+    std::pair< int, int > get_tile_coordinates( double east, double north ) const;
+
+    double mReferenceLatitude, mReferenceLongitude, mReferenceHeight;
+
+    //! maps model coordinates to the local frame
+    Eigen::Matrix4d mGeoregistration;
+
+    double mTileSize;
+
+    //! the points seen by every camera
+    const localization_model *mModel;
+
+    //! positions of the cameras in the local frame (east, north), only for cameras with mCameraTiles[i] >= 0
+    std::vector< std::pair< double, double > > mCameraPositions;
+    std::vector< int > mCameraTiles;
+
+    std::map< std::pair< int, int >, uint32_t > mTileIds;
+    std::vector< std::pair< int, int > > mTileCoordinates;
+    std::vector< std::vector< uint32_t > > mTileCameras;
+    std::vector< tile > mTiles;
+
+    // the selection of the last query is marked by mQueryStamp, such that no array has to be reset between queries
+    uint32_t mQueryStamp;
+    std::vector< uint32_t > mCameraStamps;
+    std::vector< uint32_t > mPointStamps;
+    std::vector< uint32_t > mSelectedTiles;
+    uint32_t mNbSelectedCameras;
+
+    // entries that are contained in several selected tiles are only returned once by get_entries
+    uint32_t mEntryStamp;
+    std::vector< uint32_t > mEntryStamps;
+};
+
+#endif
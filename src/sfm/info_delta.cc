@@ -0,0 +1,178 @@
+#include "info_delta.hh"
+
+#include <fstream>
+#include <string.h>
+
+// the magic numbers framing a block
+static const char block_magic[8] = { 'C', 'P', 'F', 'D', 'E', 'L', 'T', 'A' };
+static const char footer_magic[8] = { 'C', 'P', 'F', 'D', 'T', 'A', 'I', 'L' };
+
+uint64_t info_delta::get_camera_size( int format )
+{
+  // focal length, kappa 1 & 2, width, height, rotation, translation
+  return ( format == 1 ) ? 3 * sizeof( double ) + 2 * sizeof( int32_t ) + 12 * sizeof( double ) : 0;
+}
+
+//---------------------------------------------------
+
+uint64_t info_delta::get_view_size( )
+{
+  return sizeof( uint32_t ) + 4 * sizeof( float ) + 128;
+}
+
+//---------------------------------------------------
+
+uint64_t info_delta::get_footer_size( )
+{
+  return sizeof( footer_magic ) + sizeof( uint64_t ) + 2 * sizeof( uint32_t );
+}
+
+//---------------------------------------------------
+
+bool info_delta::next_block( std::istream &is, uint32_t &nb_cameras )
+{
+  char magic[8];
+  while ( true )
+  {
+    is.read( magic, sizeof( magic ) );
+    if ( is.gcount() == 0 && is.eof() )
+    {
+      is.clear();
+      return false;
+    }
+    if ( is && memcmp( magic, footer_magic, sizeof( magic ) ) == 0 )
+    {
+      is.ignore( get_footer_size() - sizeof( footer_magic ) );
+      continue;
+    }
+    if ( is && memcmp( magic, block_magic, sizeof( magic ) ) == 0 )
+    {
+      is.read( (char*) &nb_cameras, sizeof( uint32_t ) );
+      if ( is )
+        return true;
+    }
+    std::cerr << "[info_delta]: ERROR: Unexpected data after the points of the .info file" << std::endl;
+    is.setstate( std::ios::failbit );
+    return false;
+  }
+}
+
+//---------------------------------------------------
+
+bool info_delta::next_block( const unsigned char *data, uint64_t size, uint64_t &offset, uint32_t &nb_cameras )
+{
+  while ( offset + sizeof( block_magic ) <= size )
+  {
+    if ( memcmp( data + offset, footer_magic, sizeof( footer_magic ) ) == 0 && offset + get_footer_size() <= size )
+    {
+      offset += get_footer_size();
+      continue;
+    }
+    if ( memcmp( data + offset, block_magic, sizeof( block_magic ) ) == 0 && offset + sizeof( block_magic ) + sizeof( uint32_t ) <= size )
+    {
+      memcpy( &nb_cameras, data + offset + sizeof( block_magic ), sizeof( uint32_t ) );
+      offset += sizeof( block_magic ) + sizeof( uint32_t );
+      return true;
+    }
+    break;
+  }
+  return false;
+}
+
+//---------------------------------------------------
+
+bool info_delta::get_base_size( const std::string &filename, int format, uint32_t &nb_cameras, uint32_t &nb_points )
+{
+  std::ifstream ifs( filename.c_str(), std::ios::in | std::ios::binary );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[info_delta]: ERROR: Cannot read " << filename << std::endl;
+    return false;
+  }
+  ifs.read( (char*) &nb_cameras, sizeof( uint32_t ) );
+  ifs.seekg( sizeof( uint32_t ) + nb_cameras * get_camera_size( format ) );
+  ifs.read( (char*) &nb_points, sizeof( uint32_t ) );
+  if ( !ifs )
+  {
+    std::cerr << "[info_delta]: ERROR: " << filename << " is truncated" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------
+
+bool info_delta::get_size( const std::string &filename, int format, uint32_t &nb_cameras, uint32_t &nb_points )
+{
+  std::ifstream ifs( filename.c_str(), std::ios::in | std::ios::binary );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[info_delta]: ERROR: Cannot read " << filename << std::endl;
+    return false;
+  }
+  ifs.seekg( 0, std::ios::end );
+  uint64_t size = (uint64_t) ifs.tellg();
+
+  // the footer of the last block, if it is framed by a valid header
+  if ( size >= get_footer_size() )
+  {
+    char magic[8];
+    uint64_t block_offset = 0;
+    ifs.seekg( size - get_footer_size() );
+    ifs.read( magic, sizeof( magic ) );
+    ifs.read( (char*) &block_offset, sizeof( uint64_t ) );
+    if ( ifs && memcmp( magic, footer_magic, sizeof( magic ) ) == 0 && block_offset + sizeof( block_magic ) <= size )
+    {
+      ifs.read( (char*) &nb_cameras, sizeof( uint32_t ) );
+      ifs.read( (char*) &nb_points, sizeof( uint32_t ) );
+      ifs.seekg( block_offset );
+      ifs.read( magic, sizeof( magic ) );
+      if ( ifs && memcmp( magic, block_magic, sizeof( magic ) ) == 0 )
+        return true;
+    }
+  }
+  ifs.close();
+  return get_base_size( filename, format, nb_cameras, nb_points );
+}
+
+//---------------------------------------------------
+
+bool info_delta::append( const std::string &filename, int format, const std::string &cameras, uint32_t nb_new_cameras, const std::string &points, uint32_t nb_new_points )
+{
+  uint32_t nb_cameras = 0, nb_points = 0;
+  if ( !get_size( filename, format, nb_cameras, nb_points ) )
+    return false;
+  if ( cameras.size() != nb_new_cameras * get_camera_size( format ) )
+  {
+    std::cerr << "[info_delta]: ERROR: Invalid size of the cameras appended to " << filename << std::endl;
+    return false;
+  }
+
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::binary | std::ios::app );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[info_delta]: ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+  ofs.seekp( 0, std::ios::end );
+  uint64_t block_offset = (uint64_t) ofs.tellp();
+  nb_cameras += nb_new_cameras;
+  nb_points += nb_new_points;
+
+  ofs.write( block_magic, sizeof( block_magic ) );
+  ofs.write( (const char*) &nb_new_cameras, sizeof( uint32_t ) );
+  ofs.write( cameras.data(), cameras.size() );
+  ofs.write( (const char*) &nb_new_points, sizeof( uint32_t ) );
+  ofs.write( points.data(), points.size() );
+  ofs.write( footer_magic, sizeof( footer_magic ) );
+  ofs.write( (const char*) &block_offset, sizeof( uint64_t ) );
+  ofs.write( (const char*) &nb_cameras, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_points, sizeof( uint32_t ) );
+  ofs.close();
+  if ( !ofs )
+  {
+    std::cerr << "[info_delta]: ERROR: Could not append to " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
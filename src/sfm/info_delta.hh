@@ -0,0 +1,64 @@
+#ifndef INFO_DELTA_HH
+#define INFO_DELTA_HH
+
+/**
+ *    Blocks of cameras and points appended to a binary .info file by
+ *    update_localization_model, such that an update only writes the new data
+ *    instead of copying the whole file. A block has the layout of a .info file
+ *    itself, framed by a header and a footer:
+ *
+ *      "CPFDELTA", nb_cameras, cameras, nb_points, points,
+ *      "CPFDTAIL", uint64 offset of the block, uint32 total number of cameras,
+ *      uint32 total number of points
+ *
+ *    The cameras and points of a block are numbered after the ones of the
+ *    file and of the previous blocks, the camera ids of the views refer to the
+ *    merged numbering. The readers of .info files (parse_bundler,
+ *    localization_model and compress_localization_model) read the blocks
+ *    after the points of the file. The footer of the last block gives the size
+ *    of the merged model without reading the file.
+**/
+
+#include <string>
+#include <iostream>
+#include <stdint.h>
+
+
+class info_delta
+{
+  public:
+    //! the size of a camera in a .info file of the given format (0: Bundle2Info, 1: with camera information)
+    static uint64_t get_camera_size( int format );
+
+    //! the size of a view in a .info file (camera id, x, y, scale, orientation, descriptor)
+    static uint64_t get_view_size( );
+
+    //! the size of the footer of a block
+    static uint64_t get_footer_size( );
+
+    /**
+     * To be called after the points of the file or of a block were read: skips the footer of the block and
+     * reads the header of the next block. Returns true and the number of cameras of the block if one
+     * follows. Returns false at the end of the file, and sets the failbit of the stream if the data
+     * following the points is not a block.
+    **/
+    static bool next_block( std::istream &is, uint32_t &nb_cameras );
+
+    //! the same for a .info file mapped into memory, the offset is advanced to the cameras of the next block
+    static bool next_block( const unsigned char *data, uint64_t size, uint64_t &offset, uint32_t &nb_cameras );
+
+    //! get the number of cameras and points of a .info file without its blocks
+    static bool get_base_size( const std::string &filename, int format, uint32_t &nb_cameras, uint32_t &nb_points );
+
+    //! get the number of cameras and points of a .info file including its blocks
+    static bool get_size( const std::string &filename, int format, uint32_t &nb_cameras, uint32_t &nb_points );
+
+    /**
+     * Append a block to a .info file. cameras holds the nb_new_cameras cameras and points the nb_new_points
+     * points in the layout of a .info file of the given format, the camera ids of the views have to be
+     * ids in the merged model.
+    **/
+    static bool append( const std::string &filename, int format, const std::string &cameras, uint32_t nb_new_cameras, const std::string &points, uint32_t nb_new_points );
+};
+
+#endif
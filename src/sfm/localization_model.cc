@@ -0,0 +1,427 @@
+#include "localization_model.hh"
+#include "info_delta.hh"
+
+#include <iostream>
+#include <fstream>
+#include <string.h>
+#include <algorithm>
+
+// size of a view in a .info file (camera id, x, y, scale, orientation, descriptor)
+static const uint32_t info_view_size = sizeof( uint32_t ) + 4 * sizeof( float ) + 128;
+
+// marks points without matches in query_point_matches
+static const uint32_t no_slot = 0xFFFFFFFF;
+
+localization_model::localization_model( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+localization_model::~localization_model( )
+{
+}
+
+//---------------------------------------------------
+
+bool localization_model::load( const std::string &filename, std::vector< bundler_camera > &cameras, bool load_view_details )
+{
+  clear();
+  cameras.clear();
+
+  std::ifstream ifs( filename.c_str(), std::ios::in | std::ios::binary );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[localization_model]: ERROR: Cannot read " << filename << std::endl;
+    return false;
+  }
+
+  // every camera and point has a fixed size, the rest of the file are views (and the frames of the appended blocks)
+  uint32_t nb_file_cameras = 0, nb_file_points = 0;
+  if ( !info_delta::get_size( filename, 1, nb_file_cameras, nb_file_points ) )
+    return false;
+  ifs.seekg( 0, std::ios::end );
+  uint64_t fixed_size = 2 * sizeof( uint32_t ) + nb_file_cameras * info_delta::get_camera_size( 1 ) + (uint64_t) nb_file_points * ( 3 * sizeof( float ) + sizeof( uint32_t ) );
+  uint64_t file_size = (uint64_t) ifs.tellg();
+  ifs.seekg( 0 );
+  uint64_t nb_file_views = ( file_size > fixed_size ) ? ( file_size - fixed_size ) / info_view_size : 0;
+  cameras.reserve( nb_file_cameras );
+  mX.reserve( nb_file_points );
+  mY.reserve( nb_file_points );
+  mZ.reserve( nb_file_points );
+  mViewOffsets.reserve( nb_file_points + 1 );
+  mViewCameras.reserve( nb_file_views );
+  if ( load_view_details )
+  {
+    mViewScales.reserve( nb_file_views );
+    mViewOrientations.reserve( nb_file_views );
+  }
+
+  // the cameras and points of the file, followed by the blocks appended by update_localization_model
+  uint32_t nb_block_cameras = 0;
+  ifs.read( (char*) &nb_block_cameras, sizeof( uint32_t ) );
+  std::vector< char > buffer;
+  do
+  {
+    uint32_t first_camera = (uint32_t) cameras.size();
+    uint32_t nb_cameras = first_camera + nb_block_cameras;
+    cameras.resize( nb_cameras );
+    for ( uint32_t i = first_camera; i < nb_cameras && ifs; ++i )
+    {
+      double focal_length, kappa_1, kappa_2, rotation[9], translation[3];
+      int32_t width, height;
+      ifs.read( (char*) &focal_length, sizeof( double ) );
+      ifs.read( (char*) &kappa_1, sizeof( double ) );
+      ifs.read( (char*) &kappa_2, sizeof( double ) );
+      ifs.read( (char*) &width, sizeof( int32_t ) );
+      ifs.read( (char*) &height, sizeof( int32_t ) );
+      ifs.read( (char*) rotation, 9 * sizeof( double ) );
+      ifs.read( (char*) translation, 3 * sizeof( double ) );
+
+      cameras[i].focal_length = focal_length;
+      cameras[i].kappa_1 = kappa_1;
+      cameras[i].kappa_2 = kappa_2;
+      cameras[i].width = width;
+      cameras[i].height = height;
+      cameras[i].id = i;
+      for ( int j = 0; j < 3; ++j )
+      {
+        for ( int k = 0; k < 3; ++k )
+          cameras[i].rotation( j, k ) = rotation[3 * j + k];
+        cameras[i].translation[j] = translation[j];
+      }
+    }
+
+    // the points, the views of a point are read at once
+    uint32_t nb_block_points = 0;
+    ifs.read( (char*) &nb_block_points, sizeof( uint32_t ) );
+    if ( !ifs )
+    {
+      std::cerr << "[localization_model]: ERROR: " << filename << " is truncated" << std::endl;
+      clear();
+      return false;
+    }
+    uint32_t first_point = get_nb_points();
+    uint32_t nb_points = first_point + nb_block_points;
+    mX.resize( nb_points );
+    mY.resize( nb_points );
+    mZ.resize( nb_points );
+    mViewOffsets.resize( nb_points + 1 );
+
+    for ( uint32_t i = first_point; i < nb_points; ++i )
+    {
+      float position[3];
+      uint32_t nb_views = 0;
+      ifs.read( (char*) position, 3 * sizeof( float ) );
+      ifs.read( (char*) &nb_views, sizeof( uint32_t ) );
+      buffer.resize( (size_t) nb_views * info_view_size );
+      if ( nb_views > 0 )
+        ifs.read( &buffer[0], buffer.size() );
+      if ( !ifs )
+      {
+        std::cerr << "[localization_model]: ERROR: " << filename << " is truncated" << std::endl;
+        clear();
+        return false;
+      }
+
+      mX[i] = position[0];
+      mY[i] = position[1];
+      mZ[i] = position[2];
+      for ( uint32_t j = 0; j < nb_views; ++j )
+      {
+        const char *data = &buffer[(size_t) j * info_view_size];
+        uint32_t camera;
+        memcpy( &camera, data, sizeof( uint32_t ) );
+        if ( camera >= nb_cameras )
+        {
+          std::cerr << "[localization_model]: ERROR: Point " << i << " in " << filename << " is seen by the unknown camera " << camera << std::endl;
+          clear();
+          return false;
+        }
+        mViewCameras.push_back( camera );
+        if ( load_view_details )
+        {
+          float scale, orientation;
+          memcpy( &scale, data + sizeof( uint32_t ) + 2 * sizeof( float ), sizeof( float ) );
+          memcpy( &orientation, data + sizeof( uint32_t ) + 3 * sizeof( float ), sizeof( float ) );
+          mViewScales.push_back( scale );
+          mViewOrientations.push_back( orientation );
+        }
+      }
+      mViewOffsets[i + 1] = (uint32_t) mViewCameras.size();
+    }
+  }
+  while ( info_delta::next_block( ifs, nb_block_cameras ) );
+
+  if ( !ifs )
+  {
+    clear();
+    return false;
+  }
+  ifs.close();
+
+  // the number of points seen by every camera
+  mCameraOffsets.assign( cameras.size() + 1, 0 );
+  for ( size_t i = 0; i < mViewCameras.size(); ++i )
+    ++mCameraOffsets[mViewCameras[i] + 1];
+  for ( size_t i = 0; i < cameras.size(); ++i )
+    mCameraOffsets[i + 1] += mCameraOffsets[i];
+  return true;
+}
+
+//---------------------------------------------------
+
+void localization_model::clear( )
+{
+  mX.clear();
+  mY.clear();
+  mZ.clear();
+  mViewOffsets.assign( 1, 0 );
+  mViewCameras.clear();
+  mCameraOffsets.assign( 1, 0 );
+  mCameraPoints.clear();
+  mViewScales.clear();
+  mViewOrientations.clear();
+}
+
+//---------------------------------------------------
+
+void localization_model::add_point( float x, float y, float z, const uint32_t *cameras, uint32_t nb_views )
+{
+  mX.push_back( x );
+  mY.push_back( y );
+  mZ.push_back( z );
+  mViewCameras.insert( mViewCameras.end(), cameras, cameras + nb_views );
+  mViewOffsets.push_back( (uint32_t) mViewCameras.size() );
+}
+
+//---------------------------------------------------
+
+uint32_t localization_model::get_nb_points( ) const
+{
+  return (uint32_t) mX.size();
+}
+
+//---------------------------------------------------
+
+uint64_t localization_model::get_nb_views( ) const
+{
+  return mViewOffsets.back();
+}
+
+//---------------------------------------------------
+
+float localization_model::get_x( uint32_t point ) const
+{
+  return mX[point];
+}
+
+//---------------------------------------------------
+
+float localization_model::get_y( uint32_t point ) const
+{
+  return mY[point];
+}
+
+//---------------------------------------------------
+
+float localization_model::get_z( uint32_t point ) const
+{
+  return mZ[point];
+}
+
+//---------------------------------------------------
+
+uint32_t localization_model::get_nb_views( uint32_t point ) const
+{
+  return mViewCameras.empty() ? 0 : mViewOffsets[point + 1] - mViewOffsets[point];
+}
+
+//---------------------------------------------------
+
+const uint32_t* localization_model::get_cameras( uint32_t point ) const
+{
+  return mViewCameras.empty() ? 0 : &mViewCameras[0] + mViewOffsets[point];
+}
+
+//---------------------------------------------------
+
+void localization_model::release_cameras( )
+{
+  std::vector< uint32_t >().swap( mViewCameras );
+}
+
+//---------------------------------------------------
+
+uint32_t localization_model::get_nb_camera_points( uint32_t camera ) const
+{
+  return ( camera + 1 < mCameraOffsets.size() ) ? mCameraOffsets[camera + 1] - mCameraOffsets[camera] : 0;
+}
+
+//---------------------------------------------------
+
+void localization_model::index_camera_points( )
+{
+  if ( mViewCameras.empty() )
+  {
+    mCameraPoints.clear();
+    return;
+  }
+
+  // counting sort of the views by camera, the points of a camera are visited in increasing order
+  mCameraPoints.resize( mCameraOffsets.back() );
+  std::vector< uint32_t > fill_positions( mCameraOffsets.begin(), mCameraOffsets.end() - 1 );
+  for ( uint32_t i = 0; i < get_nb_points(); ++i )
+    for ( uint32_t j = mViewOffsets[i]; j < mViewOffsets[i + 1]; ++j )
+      mCameraPoints[fill_positions[mViewCameras[j]]++] = i;
+}
+
+//---------------------------------------------------
+
+const uint32_t* localization_model::get_camera_points( uint32_t camera ) const
+{
+  return mCameraPoints.empty() ? 0 : &mCameraPoints[0] + mCameraOffsets[camera];
+}
+
+//---------------------------------------------------
+
+bool localization_model::has_view_details( ) const
+{
+  return !mViewScales.empty() || get_nb_views() == 0;
+}
+
+//---------------------------------------------------
+
+const float* localization_model::get_scales( uint32_t point ) const
+{
+  return mViewScales.empty() ? 0 : &mViewScales[0] + mViewOffsets[point];
+}
+
+//---------------------------------------------------
+
+const float* localization_model::get_orientations( uint32_t point ) const
+{
+  return mViewOrientations.empty() ? 0 : &mViewOrientations[0] + mViewOffsets[point];
+}
+
+//---------------------------------------------------
+
+uint64_t localization_model::get_memory( ) const
+{
+  return sizeof( float ) * ( mX.capacity() + mY.capacity() + mZ.capacity() ) + sizeof( uint32_t ) * ( mViewOffsets.capacity() + mViewCameras.capacity()
+                                                                                             + mCameraOffsets.capacity() + mCameraPoints.capacity() );
+}
+
+//---------------------------------------------------
+
+uint64_t localization_model::get_view_details_memory( ) const
+{
+  return sizeof( float ) * ( mViewScales.capacity() + mViewOrientations.capacity() );
+}
+
+//---------------------------------------------------
+
+void localization_model::print_statistics( ) const
+{
+  uint32_t nb_points = get_nb_points();
+  std::cout << "[localization_model]: " << nb_points << " points with " << get_nb_views() << " views, " << get_memory() / ( 1024.0 * 1024.0 ) << " MB ("
+            << (double) get_memory() / (double) std::max( nb_points, (uint32_t) 1 ) << " bytes per point)";
+  if ( get_view_details_memory() > 0 )
+    std::cout << " and " << get_view_details_memory() / ( 1024.0 * 1024.0 ) << " MB of view details";
+  std::cout << std::endl;
+}
+
+//---------------------------------------------------
+//---------------------------------------------------
+
+query_point_matches::query_point_matches( )
+{
+  mMaxRatio = 0.0;
+  mNbQualifiedTotal = 0;
+}
+
+//---------------------------------------------------
+
+query_point_matches::~query_point_matches( )
+{
+}
+
+//---------------------------------------------------
+
+void query_point_matches::resize( uint32_t nb_points )
+{
+  if ( mSlots.size() < nb_points )
+    mSlots.resize( nb_points, no_slot );
+}
+
+//---------------------------------------------------
+
+void query_point_matches::set_ratio_test( double ratio_test_threshold )
+{
+  mMaxRatio = ( ratio_test_threshold > 0.0 ) ? 1.0 / ratio_test_threshold : 0.0;
+}
+
+//---------------------------------------------------
+
+void query_point_matches::add( uint32_t point, float distance )
+{
+  if ( mSlots[point] == no_slot )
+  {
+    mSlots[point] = (uint32_t) mMatchedPoints.size();
+    mMatchedPoints.push_back( point );
+    // the lists of earlier queries are reused
+    if ( mLists.size() < mMatchedPoints.size() )
+    {
+      mLists.push_back( std::vector< float >() );
+      mNbQualified.push_back( 0 );
+    }
+  }
+  uint32_t slot = mSlots[point];
+  std::vector< float > &list = mLists[slot];
+  list.push_back( distance );
+  if ( mMaxRatio == 0.0 )
+    return;
+
+  // the new match changes the number and the sum of the distances of the point, so all its matches are tested again
+  double nb_matches = (double) list.size();
+  double sum_distances = 0.0;
+  for ( size_t k = 0; k < list.size(); ++k )
+    sum_distances += (double) list[k];
+  uint32_t nb_qualified = 0;
+  for ( size_t k = 0; k < list.size(); ++k )
+  {
+    if ( (double) list[k] * nb_matches * nb_matches / sum_distances <= mMaxRatio )
+      ++nb_qualified;
+  }
+  mNbQualifiedTotal = mNbQualifiedTotal - mNbQualified[slot] + nb_qualified;
+  mNbQualified[slot] = nb_qualified;
+}
+
+//---------------------------------------------------
+
+const std::vector< float >& query_point_matches::get( uint32_t point ) const
+{
+  return ( mSlots[point] == no_slot ) ? mEmpty : mLists[mSlots[point]];
+}
+
+//---------------------------------------------------
+
+size_t query_point_matches::get_nb_qualified( ) const
+{
+  return mNbQualifiedTotal;
+}
+
+//---------------------------------------------------
+
+void query_point_matches::clear( )
+{
+  for ( size_t i = 0; i < mMatchedPoints.size(); ++i )
+  {
+    mSlots[mMatchedPoints[i]] = no_slot;
+    mLists[i].clear();
+    mNbQualified[i] = 0;
+  }
+  mMatchedPoints.clear();
+  mNbQualifiedTotal = 0;
+}
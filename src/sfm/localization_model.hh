@@ -0,0 +1,157 @@
+#ifndef LOCALIZATION_MODEL_HH
+#define LOCALIZATION_MODEL_HH
+
+/**
+ *    Slim point store of the localizer. parse_bundler keeps a feature_3D_info
+ *    per point (color, views with image positions, scales and orientations,
+ *    descriptors, neighbors and several per-point statistics), most of which
+ *    is never used online. localization_model only keeps what matching,
+ *    voting and pose estimation need:
+ *
+ *     - the positions of the points as structure of arrays (x, y, z)
+ *     - the cameras seeing the points in CSR layout: the cameras of point i
+ *       are get_cameras(i)[0] to get_cameras(i)[get_nb_views(i)-1], in the
+ *       order of the .info file
+ *     - the number of points seen by every camera, and on request the points
+ *       themselves (camera -> point CSR, for tracking and the GPS prior)
+ *
+ *    The scales and orientations of the views (used by the consistency
+ *    filter) form an optional cold store that is only loaded on request. The
+ *    descriptors of the .info file are skipped, the localizer uses the binary
+ *    signatures of the hamming file instead.
+ *
+ *    query_point_matches holds the hamming distances of the query features
+ *    matched to every point during a query. It only allocates lists for the
+ *    points matched so far and resets only these between queries.
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "bundler_camera.hh"
+
+
+class localization_model
+{
+  public:
+    //! constructor
+    localization_model( );
+
+    //! destructor
+    ~localization_model( );
+
+    /**
+     * Load the points of a .info file of format 1 (with camera information) and its cameras, including the
+     * blocks appended by update_localization_model (see info_delta). The number of points seen by every camera
+     * is counted, bundler_camera::point_list is not filled. With load_view_details, the scales and orientations
+     * of the views are loaded as well. Returns false if the file cannot be read or is truncated.
+    **/
+    bool load( const std::string &filename, std::vector< bundler_camera > &cameras, bool load_view_details );
+
+    //! remove all points
+    void clear( );
+
+    //! append a point seen by the given cameras (e.g., from a tile), without view details
+    void add_point( float x, float y, float z, const uint32_t *cameras, uint32_t nb_views );
+
+    uint32_t get_nb_points( ) const;
+    uint64_t get_nb_views( ) const;
+
+    //! the position of a point
+    float get_x( uint32_t point ) const;
+    float get_y( uint32_t point ) const;
+    float get_z( uint32_t point ) const;
+
+    //! the cameras seeing a point, 0 after release_cameras
+    uint32_t get_nb_views( uint32_t point ) const;
+    const uint32_t* get_cameras( uint32_t point ) const;
+
+    //! free the cameras of the points once another index (e.g., visibility_index) replaces them
+    void release_cameras( );
+
+    //! the number of points seen by a camera (counted by load, 0 for models built by add_point)
+    uint32_t get_nb_camera_points( uint32_t camera ) const;
+
+    //! build the lists of the points seen by every camera, needs the cameras of the points (call before release_cameras)
+    void index_camera_points( );
+
+    //! the points seen by a camera in increasing order, 0 before index_camera_points
+    const uint32_t* get_camera_points( uint32_t camera ) const;
+
+    //! returns true if the scales and orientations of the views were loaded
+    bool has_view_details( ) const;
+
+    //! the scales and orientations of the views of a point, in the order of get_cameras
+    const float* get_scales( uint32_t point ) const;
+    const float* get_orientations( uint32_t point ) const;
+
+    //! the memory used by the points, split into the hot store and the cold store of view details
+    uint64_t get_memory( ) const;
+    uint64_t get_view_details_memory( ) const;
+
+    //! print the number of points and views and the memory per point
+    void print_statistics( ) const;
+
+  private:
+    std::vector< float > mX, mY, mZ;
+
+    //! the views of point i are mViewCameras[mViewOffsets[i]] to mViewCameras[mViewOffsets[i+1]-1]
+    std::vector< uint32_t > mViewOffsets;
+    std::vector< uint32_t > mViewCameras;
+
+    //! the points of camera i are mCameraPoints[mCameraOffsets[i]] to mCameraPoints[mCameraOffsets[i+1]-1]
+    std::vector< uint32_t > mCameraOffsets;
+    std::vector< uint32_t > mCameraPoints;
+
+    //! cold store, parallel to mViewCameras
+    std::vector< float > mViewScales;
+    std::vector< float > mViewOrientations;
+};
+
+
+class query_point_matches
+{
+  public:
+    //! constructor
+    query_point_matches( );
+
+    //! destructor
+    ~query_point_matches( );
+
+    //! make room for the given number of points, keeps the matches of the current query
+    void resize( uint32_t nb_points );
+
+    /**
+     * Count the matches passing the bilateral ratio test of the voting while they are added (see
+     * get_nb_qualified): a match with distance d to a point with n matches and the sum s of their distances
+     * passes if d * n * n / s <= 1 / ratio_test_threshold. A threshold of 0 disables the count (default).
+    **/
+    void set_ratio_test( double ratio_test_threshold );
+
+    //! add the hamming distance of a query feature matched to the point, only the matches of this point are tested again
+    void add( uint32_t point, float distance );
+
+    //! the distances of the query features matched to the point, in the order they were added
+    const std::vector< float >& get( uint32_t point ) const;
+
+    //! the number of matches of all points passing the ratio test, 0 if the count is disabled
+    size_t get_nb_qualified( ) const;
+
+    //! remove the matches of all points
+    void clear( );
+
+  private:
+    //! the list of point i is mLists[mSlots[i]], no_slot if the point has no matches
+    std::vector< uint32_t > mSlots;
+    std::vector< std::vector< float > > mLists;
+    std::vector< uint32_t > mMatchedPoints;
+    std::vector< float > mEmpty;
+
+    //! the number of matches of list i passing the ratio test and their total, mMaxRatio is 0 if they are not counted
+    double mMaxRatio;
+    std::vector< uint32_t > mNbQualified;
+    size_t mNbQualifiedTotal;
+};
+
+#endif
@@ -24,6 +24,7 @@
 
 
 #include "parse_bundler.hh"
+#include "info_delta.hh"
 
 //------------------------------
 
@@ -500,96 +501,114 @@ bool parse_bundler::load_from_binary( const char *filename, const int format )
     }
 
     // read the number of cameras
-    ifs.read(( char *) &mNbCameras, sizeof( uint32_t ) );
+    uint32_t nb_block_cameras = 0;
+    ifs.read(( char *) &nb_block_cameras, sizeof( uint32_t ) );
 
-    // depending on the format, cameras will be loaded
-    if ( format == 1 )
+    // the cameras and points of the file, followed by the blocks appended by update_localization_model
+    do
     {
-        // load the cameras
-        mCameras.resize(mNbCameras);
-        for ( uint32_t i = 0; i < mNbCameras; ++i )
+        uint32_t first_camera = mNbCameras;
+        mNbCameras += nb_block_cameras;
+
+        // depending on the format, cameras will be loaded
+        if ( format == 1 )
         {
-            double focal_length, kappa_1, kappa_2;
-            int32_t width, height;
-            double *rotation = new double[9];
-            double *translation = new double[3];
-            ifs.read( (char *) &focal_length, sizeof( double ) );
-            ifs.read( (char *) &kappa_1, sizeof( double ) );
-            ifs.read( (char *) &kappa_2, sizeof( double ) );
-            ifs.read( (char *) &width, sizeof( int32_t ) );
-            ifs.read( (char *) &height, sizeof( int32_t ) );
-            ifs.read( (char *) rotation, 9 * sizeof( double ) );
-            ifs.read( (char *) translation, 3 * sizeof( double ) );
-
-            //clear the point list data
-            mCameras[i].point_list.clear();
-            mCameras[i].focal_length = focal_length;
-            mCameras[i].kappa_1 = kappa_1;
-            mCameras[i].kappa_2 = kappa_2;
-            mCameras[i].width = width;
-            mCameras[i].height = height;
-            mCameras[i].id = i;
-            for ( int j = 0; j < 3; ++j )
+            // load the cameras
+            mCameras.resize(mNbCameras);
+            for ( uint32_t i = first_camera; i < mNbCameras; ++i )
             {
-                for ( int k = 0; k < 3; ++k )
-                    mCameras[i].rotation( j, k ) = rotation[3 * j + k];
+                double focal_length, kappa_1, kappa_2;
+                int32_t width, height;
+                double *rotation = new double[9];
+                double *translation = new double[3];
+                ifs.read( (char *) &focal_length, sizeof( double ) );
+                ifs.read( (char *) &kappa_1, sizeof( double ) );
+                ifs.read( (char *) &kappa_2, sizeof( double ) );
+                ifs.read( (char *) &width, sizeof( int32_t ) );
+                ifs.read( (char *) &height, sizeof( int32_t ) );
+                ifs.read( (char *) rotation, 9 * sizeof( double ) );
+                ifs.read( (char *) translation, 3 * sizeof( double ) );
+
+                //clear the point list data
+                mCameras[i].point_list.clear();
+                mCameras[i].focal_length = focal_length;
+                mCameras[i].kappa_1 = kappa_1;
+                mCameras[i].kappa_2 = kappa_2;
+                mCameras[i].width = width;
+                mCameras[i].height = height;
+                mCameras[i].id = i;
+                for ( int j = 0; j < 3; ++j )
+                {
+                    for ( int k = 0; k < 3; ++k )
+                        mCameras[i].rotation( j, k ) = rotation[3 * j + k];
+                }
+                for ( int j = 0; j < 3; ++j )
+                    mCameras[i].translation[j] = translation[j];
+
+                delete [] rotation;
+                delete [] translation;
             }
-            for ( int j = 0; j < 3; ++j )
-                mCameras[i].translation[j] = translation[j];
-
-            delete [] rotation;
-            delete [] translation;
         }
-    }
 
-    // load the points
-    ifs.read(( char *) &mNbPoints, sizeof( uint32_t ) );
-    mFeatureInfos.resize(mNbPoints);
+        // load the points
+        uint32_t nb_block_points = 0;
+        ifs.read(( char *) &nb_block_points, sizeof( uint32_t ) );
+        uint32_t first_point = mNbPoints;
+        mNbPoints += nb_block_points;
+        mFeatureInfos.resize(mNbPoints);
 
-    for ( uint32_t i = 0; i < mNbPoints; ++i )
-    {
-        float *pos = new float[3];
-        ifs.read( (char *) pos, 3 * sizeof( float ) );
-        mFeatureInfos[i].point.x = pos[0];
-        mFeatureInfos[i].point.y = pos[1];
-        mFeatureInfos[i].point.z = pos[2];
-        delete [] pos;
-        pos = 0;
-
-        uint32_t size_view_list = 0;
-        ifs.read(( char *) &size_view_list, sizeof( uint32_t ) );
-        mFeatureInfos[i].view_list.resize(size_view_list);
-        mFeatureInfos[i].descriptors.resize( 128 * size_view_list, 0 );
-
-        unsigned char *desc = new unsigned char[128];
-        for ( uint32_t j = 0; j < size_view_list; ++j )
+        for ( uint32_t i = first_point; i < mNbPoints; ++i )
         {
-            float x, y, scale, orientation;
-            uint32_t cam_id;
-            ifs.read( (char *) &cam_id, sizeof( uint32_t ) );
-            ifs.read( (char *) &x, sizeof( float ) );
-            ifs.read( (char *) &y, sizeof( float ) );
-            ifs.read( (char *) &scale, sizeof( float ) );
-            ifs.read( (char *) &orientation, sizeof( float ) );
-            mFeatureInfos[i].view_list[j].camera = cam_id;
-            //added by cwt
-            //this step is only for the info data which contains cameras information
-            //for dubro and rome, it should be commented
-           // mCameras[cam_id].point_list.push_back(i);
+            float *pos = new float[3];
+            ifs.read( (char *) pos, 3 * sizeof( float ) );
+            mFeatureInfos[i].point.x = pos[0];
+            mFeatureInfos[i].point.y = pos[1];
+            mFeatureInfos[i].point.z = pos[2];
+            delete [] pos;
+            pos = 0;
+
+            uint32_t size_view_list = 0;
+            ifs.read(( char *) &size_view_list, sizeof( uint32_t ) );
+            mFeatureInfos[i].view_list.resize(size_view_list);
+            mFeatureInfos[i].descriptors.resize( 128 * size_view_list, 0 );
+
+            unsigned char *desc = new unsigned char[128];
+            for ( uint32_t j = 0; j < size_view_list; ++j )
+            {
+                float x, y, scale, orientation;
+                uint32_t cam_id;
+                ifs.read( (char *) &cam_id, sizeof( uint32_t ) );
+                ifs.read( (char *) &x, sizeof( float ) );
+                ifs.read( (char *) &y, sizeof( float ) );
+                ifs.read( (char *) &scale, sizeof( float ) );
+                ifs.read( (char *) &orientation, sizeof( float ) );
+                mFeatureInfos[i].view_list[j].camera = cam_id;
+                //added by cwt
+                //this step is only for the info data which contains cameras information
+                //for dubro and rome, it should be commented
+               // mCameras[cam_id].point_list.push_back(i);
 
             
-            mFeatureInfos[i].view_list[j].x = x;
-            mFeatureInfos[i].view_list[j].y = y;
-            mFeatureInfos[i].view_list[j].scale = scale;
-            mFeatureInfos[i].view_list[j].orientation = orientation;
+                mFeatureInfos[i].view_list[j].x = x;
+                mFeatureInfos[i].view_list[j].y = y;
+                mFeatureInfos[i].view_list[j].scale = scale;
+                mFeatureInfos[i].view_list[j].orientation = orientation;
 
-            ifs.read( (char *) desc, 128 * sizeof( unsigned char ) );
+                ifs.read( (char *) desc, 128 * sizeof( unsigned char ) );
 
-            // store the descriptor
-            for ( uint32_t k = 0; k < 128; ++k )
-                mFeatureInfos[i].descriptors[ 128 * j + k] = desc[k];
+                // store the descriptor
+                for ( uint32_t k = 0; k < 128; ++k )
+                    mFeatureInfos[i].descriptors[ 128 * j + k] = desc[k];
+            }
+            delete [] desc;
         }
-        delete [] desc;
+    }
+    while ( ifs && info_delta::next_block( ifs, nb_block_cameras ) );
+
+    if ( !ifs )
+    {
+        std::cerr << "Cannot read the points of " << filename << std::endl;
+        return false;
     }
 
     ifs.close();
@@ -620,93 +639,111 @@ bool parse_bundler::load_from_binary_nokey( const char *filename, const int form
     }
 
     // read the number of cameras
-    ifs.read(( char *) &mNbCameras, sizeof( uint32_t ) );
+    uint32_t nb_block_cameras = 0;
+    ifs.read(( char *) &nb_block_cameras, sizeof( uint32_t ) );
 
-    // depending on the format, cameras will be loaded
-    if ( format == 1 )
+    // the cameras and points of the file, followed by the blocks appended by update_localization_model
+    do
     {
-        // load the cameras
-        mCameras.resize(mNbCameras);
-        for ( uint32_t i = 0; i < mNbCameras; ++i )
+        uint32_t first_camera = mNbCameras;
+        mNbCameras += nb_block_cameras;
+
+        // depending on the format, cameras will be loaded
+        if ( format == 1 )
         {
-            double focal_length, kappa_1, kappa_2;
-            int32_t width, height;
-            double *rotation = new double[9];
-            double *translation = new double[3];
-            ifs.read( (char *) &focal_length, sizeof( double ) );
-            ifs.read( (char *) &kappa_1, sizeof( double ) );
-            ifs.read( (char *) &kappa_2, sizeof( double ) );
-            ifs.read( (char *) &width, sizeof( int32_t ) );
-            ifs.read( (char *) &height, sizeof( int32_t ) );
-            ifs.read( (char *) rotation, 9 * sizeof( double ) );
-            ifs.read( (char *) translation, 3 * sizeof( double ) );
-
-            //clear the point list data
-            mCameras[i].point_list.clear();
-            mCameras[i].focal_length = focal_length;
-            mCameras[i].kappa_1 = kappa_1;
-            mCameras[i].kappa_2 = kappa_2;
-            mCameras[i].width = width;
-            mCameras[i].height = height;
-            mCameras[i].id = i;
-            for ( int j = 0; j < 3; ++j )
+            // load the cameras
+            mCameras.resize(mNbCameras);
+            for ( uint32_t i = first_camera; i < mNbCameras; ++i )
             {
-                for ( int k = 0; k < 3; ++k )
-                    mCameras[i].rotation( j, k ) = rotation[3 * j + k];
+                double focal_length, kappa_1, kappa_2;
+                int32_t width, height;
+                double *rotation = new double[9];
+                double *translation = new double[3];
+                ifs.read( (char *) &focal_length, sizeof( double ) );
+                ifs.read( (char *) &kappa_1, sizeof( double ) );
+                ifs.read( (char *) &kappa_2, sizeof( double ) );
+                ifs.read( (char *) &width, sizeof( int32_t ) );
+                ifs.read( (char *) &height, sizeof( int32_t ) );
+                ifs.read( (char *) rotation, 9 * sizeof( double ) );
+                ifs.read( (char *) translation, 3 * sizeof( double ) );
+
+                //clear the point list data
+                mCameras[i].point_list.clear();
+                mCameras[i].focal_length = focal_length;
+                mCameras[i].kappa_1 = kappa_1;
+                mCameras[i].kappa_2 = kappa_2;
+                mCameras[i].width = width;
+                mCameras[i].height = height;
+                mCameras[i].id = i;
+                for ( int j = 0; j < 3; ++j )
+                {
+                    for ( int k = 0; k < 3; ++k )
+                        mCameras[i].rotation( j, k ) = rotation[3 * j + k];
+                }
+                for ( int j = 0; j < 3; ++j )
+                    mCameras[i].translation[j] = translation[j];
+
+                delete [] rotation;
+                delete [] translation;
             }
-            for ( int j = 0; j < 3; ++j )
-                mCameras[i].translation[j] = translation[j];
-
-            delete [] rotation;
-            delete [] translation;
         }
-    }
 
-    // load the points
-    ifs.read(( char *) &mNbPoints, sizeof( uint32_t ) );
-    mFeatureInfos.resize(mNbPoints);
+        // load the points
+        uint32_t nb_block_points = 0;
+        ifs.read(( char *) &nb_block_points, sizeof( uint32_t ) );
+        uint32_t first_point = mNbPoints;
+        mNbPoints += nb_block_points;
+        mFeatureInfos.resize(mNbPoints);
 
-    for ( uint32_t i = 0; i < mNbPoints; ++i )
-    {
-        float *pos = new float[3];
-        ifs.read( (char *) pos, 3 * sizeof( float ) );
-        mFeatureInfos[i].point.x = pos[0];
-        mFeatureInfos[i].point.y = pos[1];
-        mFeatureInfos[i].point.z = pos[2];
-        delete [] pos;
-        pos = 0;
-
-        uint32_t size_view_list = 0;
-        ifs.read(( char *) &size_view_list, sizeof( uint32_t ) );
-        mFeatureInfos[i].view_list.resize(size_view_list);
-
-       // mFeatureInfos[i].descriptors.resize( 128 * size_view_list, 0 );
-
-        unsigned char *desc = new unsigned char[128];
-        for ( uint32_t j = 0; j < size_view_list; ++j )
+        for ( uint32_t i = first_point; i < mNbPoints; ++i )
         {
-            float x, y, scale, orientation;
-            uint32_t cam_id;
-            ifs.read( (char *) &cam_id, sizeof( uint32_t ) );
-            ifs.read( (char *) &x, sizeof( float ) );
-            ifs.read( (char *) &y, sizeof( float ) );
-            ifs.read( (char *) &scale, sizeof( float ) );
-            ifs.read( (char *) &orientation, sizeof( float ) );
-            mFeatureInfos[i].view_list[j].camera = cam_id;
-            //added by cwt
-            //this step is only for the info data which contains cameras information
-            if(format == 1)
-                mCameras[cam_id].point_list.push_back(i);
+            float *pos = new float[3];
+            ifs.read( (char *) pos, 3 * sizeof( float ) );
+            mFeatureInfos[i].point.x = pos[0];
+            mFeatureInfos[i].point.y = pos[1];
+            mFeatureInfos[i].point.z = pos[2];
+            delete [] pos;
+            pos = 0;
+
+            uint32_t size_view_list = 0;
+            ifs.read(( char *) &size_view_list, sizeof( uint32_t ) );
+            mFeatureInfos[i].view_list.resize(size_view_list);
+
+           // mFeatureInfos[i].descriptors.resize( 128 * size_view_list, 0 );
+
+            unsigned char *desc = new unsigned char[128];
+            for ( uint32_t j = 0; j < size_view_list; ++j )
+            {
+                float x, y, scale, orientation;
+                uint32_t cam_id;
+                ifs.read( (char *) &cam_id, sizeof( uint32_t ) );
+                ifs.read( (char *) &x, sizeof( float ) );
+                ifs.read( (char *) &y, sizeof( float ) );
+                ifs.read( (char *) &scale, sizeof( float ) );
+                ifs.read( (char *) &orientation, sizeof( float ) );
+                mFeatureInfos[i].view_list[j].camera = cam_id;
+                //added by cwt
+                //this step is only for the info data which contains cameras information
+                if(format == 1)
+                    mCameras[cam_id].point_list.push_back(i);
 
             
-            mFeatureInfos[i].view_list[j].x = x;
-            mFeatureInfos[i].view_list[j].y = y;
-            mFeatureInfos[i].view_list[j].scale = scale;
-            mFeatureInfos[i].view_list[j].orientation = orientation;
+                mFeatureInfos[i].view_list[j].x = x;
+                mFeatureInfos[i].view_list[j].y = y;
+                mFeatureInfos[i].view_list[j].scale = scale;
+                mFeatureInfos[i].view_list[j].orientation = orientation;
 
-            ifs.read( (char *) desc, 128 * sizeof( unsigned char ) );
+                ifs.read( (char *) desc, 128 * sizeof( unsigned char ) );
+            }
+            delete [] desc;
         }
-        delete [] desc;
+    }
+    while ( ifs && info_delta::next_block( ifs, nb_block_cameras ) );
+
+    if ( !ifs )
+    {
+        std::cerr << "Cannot read the points of " << filename << std::endl;
+        return false;
     }
 
     ifs.close();
@@ -0,0 +1,262 @@
+#include "place_index.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+// the representative of the set of a camera, with path halving
+static uint32_t find_root( std::vector< uint32_t > &parents, uint32_t camera )
+{
+  while ( parents[camera] != camera )
+  {
+    parents[camera] = parents[parents[camera]];
+    camera = parents[camera];
+  }
+  return camera;
+}
+
+place_index::place_index( )
+{
+  mPlaceOffsets.assign( 1, 0 );
+  mPointOffsets.assign( 1, 0 );
+  mPointCameraOffsets.assign( 1, 0 );
+  mSelectionStamp = 0;
+}
+
+//---------------------------------------------------
+
+place_index::~place_index( )
+{
+}
+
+//---------------------------------------------------
+
+void place_index::build( const localization_model &model, uint32_t nb_cameras, const covisibility_graph &graph, uint32_t max_place_size )
+{
+  // the edges in the order of decreasing weight, ties are broken by the camera ids. The graph only keeps the
+  // strongest edges of every camera, so an edge may be stored by one of its cameras only: the edges of both
+  // directions are collected and the ones stored by both cameras are merged
+  std::vector< std::pair< uint32_t, std::pair< uint32_t, uint32_t > > > edges;
+  for ( uint32_t i = 0; i < nb_cameras && i < graph.get_nb_cameras(); ++i )
+  {
+    const uint32_t *neighbors = graph.get_neighbors( i );
+    const uint32_t *weights = graph.get_weights( i );
+    for ( uint32_t j = 0; j < graph.get_degree( i ); ++j )
+    {
+      if ( neighbors[j] < nb_cameras && neighbors[j] != i )
+        edges.push_back( std::make_pair( weights[j], std::make_pair( std::min( i, neighbors[j] ), std::max( i, neighbors[j] ) ) ) );
+    }
+  }
+  std::sort( edges.begin(), edges.end(), std::greater< std::pair< uint32_t, std::pair< uint32_t, uint32_t > > >() );
+  edges.erase( std::unique( edges.begin(), edges.end() ), edges.end() );
+
+  // merge the places of the cameras of an edge unless the place gets too large
+  std::vector< uint32_t > parents( nb_cameras ), sizes( nb_cameras, 1 );
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+    parents[i] = i;
+  for ( size_t i = 0; i < edges.size(); ++i )
+  {
+    uint32_t a = find_root( parents, edges[i].second.first );
+    uint32_t b = find_root( parents, edges[i].second.second );
+    if ( a == b || sizes[a] + sizes[b] > max_place_size )
+      continue;
+    if ( sizes[a] < sizes[b] )
+      std::swap( a, b );
+    parents[b] = a;
+    sizes[a] += sizes[b];
+  }
+
+  // number the places in the order of their first camera
+  std::vector< uint32_t > place_ids( nb_cameras, nb_cameras );
+  mCameraPlaces.resize( nb_cameras );
+  uint32_t nb_places = 0;
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+  {
+    uint32_t root = find_root( parents, i );
+    if ( place_ids[root] == nb_cameras )
+      place_ids[root] = nb_places++;
+    mCameraPlaces[i] = place_ids[root];
+  }
+
+  mPlaceOffsets.assign( nb_places + 1, 0 );
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+    ++mPlaceOffsets[mCameraPlaces[i] + 1];
+  for ( uint32_t i = 0; i < nb_places; ++i )
+    mPlaceOffsets[i + 1] += mPlaceOffsets[i];
+  mPlaceCameras.resize( nb_cameras );
+  std::vector< uint32_t > fill_positions( mPlaceOffsets.begin(), mPlaceOffsets.end() - 1 );
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+    mPlaceCameras[fill_positions[mCameraPlaces[i]]++] = i;
+
+  // the views of every point grouped by place, a point seen by several cameras of a place lists the place once
+  uint32_t nb_points = model.get_nb_points();
+  mPointOffsets.assign( nb_points + 1, 0 );
+  mPointPlaces.clear();
+  mPointCameraOffsets.clear();
+  mPointCameras.clear();
+  mPointCameras.reserve( model.get_nb_views() );
+  mPlacePointCounts.assign( nb_places, 0 );
+  std::vector< std::pair< uint32_t, uint32_t > > views;
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    const uint32_t *cameras = model.get_cameras( i );
+    views.clear();
+    for ( uint32_t k = 0; k < model.get_nb_views( i ); ++k )
+    {
+      if ( cameras[k] < nb_cameras )
+        views.push_back( std::make_pair( mCameraPlaces[cameras[k]], k ) );
+    }
+    std::sort( views.begin(), views.end() );
+    for ( size_t k = 0; k < views.size(); ++k )
+    {
+      if ( k == 0 || views[k].first != views[k - 1].first )
+      {
+        mPointPlaces.push_back( views[k].first );
+        mPointCameraOffsets.push_back( (uint32_t) mPointCameras.size() );
+        ++mPlacePointCounts[views[k].first];
+      }
+      mPointCameras.push_back( cameras[views[k].second] );
+    }
+    mPointOffsets[i + 1] = (uint32_t) mPointPlaces.size();
+  }
+  mPointCameraOffsets.push_back( (uint32_t) mPointCameras.size() );
+
+  mSelectionStamp = 0;
+  mPlaceStamps.assign( nb_places, 0 );
+}
+
+//---------------------------------------------------
+
+uint32_t place_index::get_nb_places( ) const
+{
+  return (uint32_t) mPlaceOffsets.size() - 1;
+}
+
+//---------------------------------------------------
+
+uint32_t place_index::get_place( uint32_t camera ) const
+{
+  return mCameraPlaces[camera];
+}
+
+//---------------------------------------------------
+
+uint32_t place_index::get_nb_cameras( uint32_t place ) const
+{
+  return mPlaceOffsets[place + 1] - mPlaceOffsets[place];
+}
+
+//---------------------------------------------------
+
+const uint32_t* place_index::get_cameras( uint32_t place ) const
+{
+  return &mPlaceCameras[mPlaceOffsets[place]];
+}
+
+//---------------------------------------------------
+
+uint32_t place_index::get_nb_points( uint32_t place ) const
+{
+  return mPlacePointCounts[place];
+}
+
+//---------------------------------------------------
+
+uint32_t place_index::get_nb_point_places( uint32_t point ) const
+{
+  return mPointOffsets[point + 1] - mPointOffsets[point];
+}
+
+//---------------------------------------------------
+
+const uint32_t* place_index::get_point_places( uint32_t point ) const
+{
+  return mPointPlaces.empty() ? 0 : &mPointPlaces[0] + mPointOffsets[point];
+}
+
+//---------------------------------------------------
+
+uint32_t place_index::get_nb_point_place_cameras( uint32_t point, uint32_t k ) const
+{
+  uint32_t entry = mPointOffsets[point] + k;
+  return mPointCameraOffsets[entry + 1] - mPointCameraOffsets[entry];
+}
+
+//---------------------------------------------------
+
+const uint32_t* place_index::get_point_place_cameras( uint32_t point, uint32_t k ) const
+{
+  return mPointCameras.empty() ? 0 : &mPointCameras[0] + mPointCameraOffsets[mPointOffsets[point] + k];
+}
+
+//---------------------------------------------------
+
+uint32_t place_index::get_nb_point_views( uint32_t point ) const
+{
+  return mPointCameraOffsets[mPointOffsets[point + 1]] - mPointCameraOffsets[mPointOffsets[point]];
+}
+
+//---------------------------------------------------
+
+void place_index::select( const std::vector< uint32_t > &places )
+{
+  ++mSelectionStamp;
+  if ( mSelectionStamp == 0 )
+  {
+    std::fill( mPlaceStamps.begin(), mPlaceStamps.end(), 0 );
+    mSelectionStamp = 1;
+  }
+  for ( size_t i = 0; i < places.size(); ++i )
+    mPlaceStamps[places[i]] = mSelectionStamp;
+}
+
+//---------------------------------------------------
+
+bool place_index::is_place_selected( uint32_t place ) const
+{
+  return mPlaceStamps[place] == mSelectionStamp;
+}
+
+//---------------------------------------------------
+
+bool place_index::is_camera_selected( uint32_t camera ) const
+{
+  return mPlaceStamps[mCameraPlaces[camera]] == mSelectionStamp;
+}
+
+//---------------------------------------------------
+
+bool place_index::is_point_selected( uint32_t point ) const
+{
+  for ( uint32_t i = mPointOffsets[point]; i < mPointOffsets[point + 1]; ++i )
+  {
+    if ( mPlaceStamps[mPointPlaces[i]] == mSelectionStamp )
+      return true;
+  }
+  return false;
+}
+
+//---------------------------------------------------
+
+uint64_t place_index::get_memory( ) const
+{
+  return sizeof( uint32_t ) * ( mCameraPlaces.size() + mPlaceOffsets.size() + mPlaceCameras.size() + mPlacePointCounts.size()
+                                + mPointOffsets.size() + mPointPlaces.size() + mPointCameraOffsets.size() + mPointCameras.size() + mPlaceStamps.size() );
+}
+
+//---------------------------------------------------
+
+void place_index::print_statistics( ) const
+{
+  uint32_t nb_places = get_nb_places(), nb_cameras = (uint32_t) mCameraPlaces.size(), nb_points = (uint32_t) mPointOffsets.size() - 1;
+  uint32_t max_size = 0, nb_single = 0;
+  for ( uint32_t i = 0; i < nb_places; ++i )
+  {
+    max_size = std::max( max_size, get_nb_cameras( i ) );
+    if ( get_nb_cameras( i ) == 1 )
+      ++nb_single;
+  }
+  std::cout << "[place_index]: " << nb_cameras << " cameras in " << nb_places << " places (" << (double) nb_cameras / (double) std::max( nb_places, (uint32_t) 1 )
+            << " cameras on average, at most " << max_size << ", " << nb_single << " single cameras), " << (double) mPointPlaces.size() / (double) std::max( nb_points, (uint32_t) 1 )
+            << " places per point, " << get_memory() / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+}
@@ -0,0 +1,105 @@
+#ifndef PLACE_INDEX_HH
+#define PLACE_INDEX_HH
+
+/**
+ *    Clustering of the cameras of a model into places for hierarchical voting.
+ *    The edges of the covisibility graph are merged in the order of decreasing
+ *    weight (number of shared points) as long as the resulting place does not
+ *    exceed a maximal number of cameras, such that cameras seeing the same
+ *    part of the scene end up in the same place.
+ *
+ *    Every point gets the list of the places seeing it, which is much shorter
+ *    than its visibility list, and its views are split by these places. A
+ *    match then votes for the few places of its point first, and only the
+ *    matches of the top ranked places take part in the voting for individual
+ *    cameras, iterating only the cameras of the selected places of their
+ *    points. The cameras of a place, the places of a point and the cameras of
+ *    a point within each of its places are stored in CSR layout.
+**/
+
+#include <vector>
+#include <stdint.h>
+
+#include "localization_model.hh"
+#include "covisibility_graph.hh"
+
+
+class place_index
+{
+  public:
+    //! constructor
+    place_index( );
+
+    //! destructor
+    ~place_index( );
+
+    /**
+     * Cluster the nb_cameras cameras into places of at most max_place_size cameras and split the views of every
+     * point of the model by place. The cameras of the points have to be loaded (see localization_model::release_cameras).
+    **/
+    void build( const localization_model &model, uint32_t nb_cameras, const covisibility_graph &graph, uint32_t max_place_size );
+
+    uint32_t get_nb_places( ) const;
+
+    //! the place of a camera
+    uint32_t get_place( uint32_t camera ) const;
+
+    //! the cameras of a place
+    uint32_t get_nb_cameras( uint32_t place ) const;
+    const uint32_t* get_cameras( uint32_t place ) const;
+
+    //! the number of distinct points seen by the cameras of a place
+    uint32_t get_nb_points( uint32_t place ) const;
+
+    //! the places seeing a point, sorted by place id
+    uint32_t get_nb_point_places( uint32_t point ) const;
+    const uint32_t* get_point_places( uint32_t point ) const;
+
+    //! the cameras of the k-th place of a point (see get_point_places) seeing the point, in the order of its views
+    uint32_t get_nb_point_place_cameras( uint32_t point, uint32_t k ) const;
+    const uint32_t* get_point_place_cameras( uint32_t point, uint32_t k ) const;
+
+    //! the number of views of a point, summed over its places
+    uint32_t get_nb_point_views( uint32_t point ) const;
+
+    //! select the places taking part in the camera-level voting
+    void select( const std::vector< uint32_t > &places );
+
+    //! returns true if the place was selected by the last call of select
+    bool is_place_selected( uint32_t place ) const;
+
+    //! returns true if the camera belongs to a place selected by the last call of select
+    bool is_camera_selected( uint32_t camera ) const;
+
+    //! returns true if the point is seen by a place selected by the last call of select
+    bool is_point_selected( uint32_t point ) const;
+
+    //! the memory used by the index in bytes
+    uint64_t get_memory( ) const;
+
+    //! print the number of places, their sizes and the lengths of the place lists of the points
+    void print_statistics( ) const;
+
+  private:
+    //! the place of every camera
+    std::vector< uint32_t > mCameraPlaces;
+
+    //! the cameras of place i are mPlaceCameras[mPlaceOffsets[i]] to mPlaceCameras[mPlaceOffsets[i+1]-1]
+    std::vector< uint32_t > mPlaceOffsets;
+    std::vector< uint32_t > mPlaceCameras;
+    std::vector< uint32_t > mPlacePointCounts;
+
+    //! the places of point i are mPointPlaces[mPointOffsets[i]] to mPointPlaces[mPointOffsets[i+1]-1]
+    std::vector< uint32_t > mPointOffsets;
+    std::vector< uint32_t > mPointPlaces;
+
+    //! the cameras of place mPointPlaces[e] seeing its point are mPointCameras[mPointCameraOffsets[e]] to mPointCameras[mPointCameraOffsets[e+1]-1]
+    std::vector< uint32_t > mPointCameraOffsets;
+    std::vector< uint32_t > mPointCameras;
+
+    // the places selected for the current query, marked by mSelectionStamp
+    uint32_t mSelectionStamp;
+    std::vector< uint32_t > mPlaceStamps;
+};
+
+#endif
@@ -0,0 +1,686 @@
+#include "pose_estimator.hh"
+
+#include <cmath>
+#include <cfloat>
+#include <complex>
+#include <algorithm>
+#include <sys/time.h>
+
+#include <Eigen/Geometry>
+
+
+static inline double get_time( )
+{
+  timeval time;
+  gettimeofday( &time, 0 );
+  return (double) time.tv_sec + 1e-6 * (double) time.tv_usec;
+}
+
+static inline uint64_t xorshift( uint64_t &state )
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+//---------------------------------------------------
+
+// the coefficients of the polynomials below are stored from the constant term upwards
+static void multiply_polynomials( const double *a, int degree_a, const double *b, int degree_b, double *product )
+{
+  for ( int i = 0; i <= degree_a + degree_b; ++i )
+    product[i] = 0.0;
+  for ( int i = 0; i <= degree_a; ++i )
+    for ( int j = 0; j <= degree_b; ++j )
+      product[i + j] += a[i] * b[j];
+}
+
+// the real roots of a polynomial of degree up to 4, computed as the eigenvalues of the companion matrix and polished with Newton steps
+static int solve_quartic( const double *coefficients, double *roots )
+{
+  double scale = 0.0;
+  for ( int i = 0; i <= 4; ++i )
+    scale = std::max( scale, fabs( coefficients[i] ) );
+  if ( scale == 0.0 )
+    return 0;
+  int degree = 4;
+  while ( degree > 0 && fabs( coefficients[degree] ) <= 1e-12 * scale )
+    --degree;
+  if ( degree == 0 )
+    return 0;
+
+  Eigen::MatrixXd companion = Eigen::MatrixXd::Zero( degree, degree );
+  for ( int i = 0; i < degree; ++i )
+    companion( 0, i ) = -coefficients[degree - 1 - i] / coefficients[degree];
+  for ( int i = 1; i < degree; ++i )
+    companion( i, i - 1 ) = 1.0;
+  Eigen::EigenSolver< Eigen::MatrixXd > solver( companion, false );
+
+  int nb_roots = 0;
+  for ( int i = 0; i < degree; ++i )
+  {
+    std::complex< double > root = solver.eigenvalues()[i];
+    if ( fabs( root.imag() ) > 1e-6 * ( 1.0 + fabs( root.real() ) ) )
+      continue;
+    double x = root.real();
+    for ( int k = 0; k < 2; ++k )
+    {
+      double value = 0.0, derivative = 0.0;
+      for ( int j = degree; j >= 0; --j )
+      {
+        derivative = derivative * x + value;
+        value = value * x + coefficients[j];
+      }
+      if ( derivative == 0.0 )
+        break;
+      x -= value / derivative;
+    }
+    roots[nb_roots++] = x;
+  }
+  return nb_roots;
+}
+
+//---------------------------------------------------
+
+uint32_t solve_p3p( const Eigen::Vector3d *bearings, const Eigen::Vector3d *points, std::vector< camera_pose > &poses )
+{
+  // the squared distances between the points, relative to the distance b of the first and the third point
+  double b2 = ( points[0] - points[2] ).squaredNorm();
+  if ( b2 < 1e-24 )
+    return 0;
+  double a2 = ( points[1] - points[2] ).squaredNorm() / b2;
+  double c2 = ( points[0] - points[1] ).squaredNorm() / b2;
+  double cos_alpha = bearings[1].dot( bearings[2] );
+  double cos_beta = bearings[0].dot( bearings[2] );
+  double cos_gamma = bearings[0].dot( bearings[1] );
+
+  // with the distances s1 = u * s0 and s2 = v * s0 along the rays, the law of cosines for the three
+  // pairs of points gives u = N(v) / D(v) and the quartic (D^2 + N^2 - 2 cos_gamma N D) - c^2 B D^2 = 0
+  double B[3] = { 1.0, -2.0 * cos_beta, 1.0 };
+  double N[3] = { ( a2 - c2 ) + 1.0, -2.0 * cos_beta * ( a2 - c2 ), ( a2 - c2 ) - 1.0 };
+  double D[2] = { 2.0 * cos_gamma, -2.0 * cos_alpha };
+  double DD[3], NN[5], ND[4], BDD[5];
+  multiply_polynomials( D, 1, D, 1, DD );
+  multiply_polynomials( N, 2, N, 2, NN );
+  multiply_polynomials( N, 2, D, 1, ND );
+  multiply_polynomials( B, 2, DD, 2, BDD );
+  double quartic[5];
+  for ( int i = 0; i <= 4; ++i )
+    quartic[i] = NN[i] - c2 * BDD[i] + ( i <= 2 ? DD[i] : 0.0 ) - ( i <= 3 ? 2.0 * cos_gamma * ND[i] : 0.0 );
+
+  double roots[4];
+  int nb_roots = solve_quartic( quartic, roots );
+
+  Eigen::Matrix3d world, camera;
+  for ( int k = 0; k < 3; ++k )
+    world.col( k ) = points[k];
+
+  uint32_t nb_poses = 0;
+  for ( int i = 0; i < nb_roots; ++i )
+  {
+    double v = roots[i];
+    double d = D[0] + D[1] * v;
+    double b = B[0] + B[1] * v + B[2] * v * v;
+    if ( v <= 0.0 || fabs( d ) < 1e-12 || b <= 0.0 )
+      continue;
+    double u = ( N[0] + N[1] * v + N[2] * v * v ) / d;
+    if ( u <= 0.0 )
+      continue;
+    double s0 = sqrt( b2 / b );
+    camera.col( 0 ) = s0 * bearings[0];
+    camera.col( 1 ) = u * s0 * bearings[1];
+    camera.col( 2 ) = v * s0 * bearings[2];
+
+    // the rigid transformation aligning the points with their positions along the rays
+    Eigen::Matrix4d transformation = Eigen::umeyama( world, camera, false );
+    camera_pose pose;
+    pose.rotation = transformation.block< 3, 3 >( 0, 0 );
+    pose.translation = transformation.block< 3, 1 >( 0, 3 );
+    poses.push_back( pose );
+    ++nb_poses;
+  }
+  return nb_poses;
+}
+
+//---------------------------------------------------
+
+double get_reprojection_error( const camera_pose &pose, const Eigen::Vector2d &image_point, const Eigen::Vector3d &point )
+{
+  Eigen::Vector3d p = pose.rotation * point + pose.translation;
+  if ( p[2] >= 0.0 )
+    return DBL_MAX;
+  Eigen::Vector2d projection( -pose.focal_length * p[0] / p[2], -pose.focal_length * p[1] / p[2] );
+  return ( projection - image_point ).norm();
+}
+
+//---------------------------------------------------
+
+// the smallest reprojection error of the fourth match, relative to the focal length, over the P3P poses of the first three matches
+static double get_focal_search_error( const Eigen::Vector2d *image_points, const Eigen::Vector3d *points, double focal_length, std::vector< camera_pose > &poses, camera_pose *best_pose )
+{
+  Eigen::Vector3d bearings[3];
+  for ( int k = 0; k < 3; ++k )
+    bearings[k] = Eigen::Vector3d( image_points[k][0], image_points[k][1], -focal_length ).normalized();
+  poses.clear();
+  solve_p3p( bearings, points, poses );
+
+  double min_error = DBL_MAX;
+  for ( size_t i = 0; i < poses.size(); ++i )
+  {
+    poses[i].focal_length = focal_length;
+    double error = get_reprojection_error( poses[i], image_points[3], points[3] );
+    if ( error < min_error )
+    {
+      min_error = error;
+      if ( best_pose != 0 )
+        *best_pose = poses[i];
+    }
+  }
+  return ( min_error == DBL_MAX ) ? DBL_MAX : min_error / focal_length;
+}
+
+uint32_t solve_p4pf_approximate( const Eigen::Vector2d *image_points, const Eigen::Vector3d *points, double min_focal, double max_focal, std::vector< camera_pose > &poses )
+{
+  const int nb_samples = 20;
+  const int nb_refinements = 12;
+  const uint32_t max_nb_poses = 3;
+  const double golden_ratio = 0.5 * ( sqrt( 5.0 ) - 1.0 );
+
+  std::vector< camera_pose > p3p_poses;
+  double log_min = log( min_focal ), log_max = log( max_focal );
+  double step = ( log_max - log_min ) / (double) ( nb_samples - 1 );
+  double errors[nb_samples];
+  for ( int i = 0; i < nb_samples; ++i )
+    errors[i] = get_focal_search_error( image_points, points, exp( log_min + step * (double) i ), p3p_poses, 0 );
+
+  // refine the local minima of the sampled errors with a golden section search, best minima first
+  std::vector< std::pair< double, int > > minima;
+  for ( int i = 0; i < nb_samples; ++i )
+  {
+    if ( errors[i] == DBL_MAX )
+      continue;
+    if ( ( i == 0 || errors[i] <= errors[i - 1] ) && ( i + 1 == nb_samples || errors[i] < errors[i + 1] ) )
+      minima.push_back( std::make_pair( errors[i], i ) );
+  }
+  std::sort( minima.begin(), minima.end() );
+
+  uint32_t nb_poses = 0;
+  for ( size_t m = 0; m < minima.size() && nb_poses < max_nb_poses; ++m )
+  {
+    int i = minima[m].second;
+    double low = log_min + step * (double) std::max( i - 1, 0 );
+    double high = log_min + step * (double) std::min( i + 1, nb_samples - 1 );
+    double x1 = high - golden_ratio * ( high - low ), x2 = low + golden_ratio * ( high - low );
+    double e1 = get_focal_search_error( image_points, points, exp( x1 ), p3p_poses, 0 );
+    double e2 = get_focal_search_error( image_points, points, exp( x2 ), p3p_poses, 0 );
+    for ( int k = 0; k < nb_refinements; ++k )
+    {
+      if ( e1 < e2 )
+      {
+        high = x2; x2 = x1; e2 = e1;
+        x1 = high - golden_ratio * ( high - low );
+        e1 = get_focal_search_error( image_points, points, exp( x1 ), p3p_poses, 0 );
+      }
+      else
+      {
+        low = x1; x1 = x2; e1 = e2;
+        x2 = low + golden_ratio * ( high - low );
+        e2 = get_focal_search_error( image_points, points, exp( x2 ), p3p_poses, 0 );
+      }
+    }
+    camera_pose pose;
+    if ( get_focal_search_error( image_points, points, exp( 0.5 * ( low + high ) ), p3p_poses, &pose ) == DBL_MAX )
+      continue;
+    poses.push_back( pose );
+    ++nb_poses;
+  }
+  return nb_poses;
+}
+
+//---------------------------------------------------
+
+pose_estimator::pose_estimator( )
+{
+  mConfidence = 0.99;
+  mMinIterations = 10;
+  mMaxIterations = 10000;
+  mMinFocal = 200.0;
+  mMaxFocal = 10000.0;
+  mImagePoints = 0;
+  mPoints = 0;
+  mRandomState = 0x9e3779b97f4a7c15ull;
+  mProgressiveSampling = false;
+  mMeasureUniform = false;
+  mUniformMeasured = false;
+  mNbIterations = mNbUniformIterations = 0;
+  mSolverTime = mOptimizationTime = mTotalTime = mUniformTime = 0.0;
+}
+
+//---------------------------------------------------
+
+pose_estimator::~pose_estimator( )
+{
+  mImagePoints = 0;
+  mPoints = 0;
+}
+
+//---------------------------------------------------
+
+void pose_estimator::set_confidence( double confidence )
+{
+  mConfidence = confidence;
+}
+
+//---------------------------------------------------
+
+void pose_estimator::set_iteration_bounds( uint32_t min_iterations, uint32_t max_iterations )
+{
+  mMinIterations = min_iterations;
+  mMaxIterations = std::max( min_iterations, max_iterations );
+}
+
+//---------------------------------------------------
+
+void pose_estimator::set_focal_range( double min_focal, double max_focal )
+{
+  mMinFocal = min_focal;
+  mMaxFocal = max_focal;
+}
+
+//---------------------------------------------------
+
+void pose_estimator::set_progressive_sampling( bool progressive )
+{
+  mProgressiveSampling = progressive;
+}
+
+//---------------------------------------------------
+
+void pose_estimator::set_uniform_measurement( bool measure )
+{
+  mMeasureUniform = measure;
+}
+
+//---------------------------------------------------
+
+uint32_t pose_estimator::get_required_iterations( uint32_t nb_inliers, uint32_t nb_matches, uint32_t sample_size ) const
+{
+  double all_inlier_probability = pow( (double) nb_inliers / (double) nb_matches, (double) sample_size );
+  uint32_t nb_iterations = mMaxIterations;
+  if ( all_inlier_probability >= 1.0 - 1e-12 )
+    nb_iterations = mMinIterations;
+  else if ( all_inlier_probability > 0.0 )
+  {
+    double nb_samples = log( 1.0 - mConfidence ) / log( 1.0 - all_inlier_probability );
+    if ( nb_samples < (double) mMaxIterations )
+      nb_iterations = (uint32_t) ceil( nb_samples );
+  }
+  return std::max( nb_iterations, mMinIterations );
+}
+
+//---------------------------------------------------
+
+uint32_t pose_estimator::find_inliers( const camera_pose &pose, double threshold, std::vector< uint32_t > &inliers ) const
+{
+  inliers.clear();
+  for ( size_t i = 0; i < mPoints->size(); ++i )
+  {
+    if ( get_reprojection_error( pose, ( *mImagePoints )[i], ( *mPoints )[i] ) <= threshold )
+      inliers.push_back( (uint32_t) i );
+  }
+  return (uint32_t) inliers.size();
+}
+
+//---------------------------------------------------
+
+void pose_estimator::refine( const std::vector< uint32_t > &matches, bool refine_focal, camera_pose &pose ) const
+{
+  const int max_nb_steps = 10;
+  int nb_parameters = refine_focal ? 7 : 6;
+  double lambda = 1e-3;
+
+  // the sum of the squared reprojection errors, matches behind the camera are ignored
+  double cost = 0.0;
+  for ( size_t i = 0; i < matches.size(); ++i )
+  {
+    double error = get_reprojection_error( pose, ( *mImagePoints )[matches[i]], ( *mPoints )[matches[i]] );
+    if ( error != DBL_MAX )
+      cost += error * error;
+  }
+
+  for ( int step = 0; step < max_nb_steps; ++step )
+  {
+    // the parameters are a rotation (axis-angle, applied after the current rotation), a translation and the logarithm of the focal length
+    Eigen::Matrix< double, 7, 7 > JtJ = Eigen::Matrix< double, 7, 7 >::Zero();
+    Eigen::Matrix< double, 7, 1 > Jtr = Eigen::Matrix< double, 7, 1 >::Zero();
+    for ( size_t i = 0; i < matches.size(); ++i )
+    {
+      Eigen::Vector3d q = pose.rotation * ( *mPoints )[matches[i]];
+      Eigen::Vector3d p = q + pose.translation;
+      if ( p[2] >= 0.0 )
+        continue;
+      double f = pose.focal_length;
+      Eigen::Vector2d projection( -f * p[0] / p[2], -f * p[1] / p[2] );
+      Eigen::Vector2d residual = projection - ( *mImagePoints )[matches[i]];
+
+      Eigen::Matrix< double, 2, 3 > dprojection_dp;
+      dprojection_dp << -f / p[2], 0.0, f * p[0] / ( p[2] * p[2] ),
+                        0.0, -f / p[2], f * p[1] / ( p[2] * p[2] );
+      Eigen::Matrix3d dp_drotation;
+      dp_drotation << 0.0, q[2], -q[1],
+                      -q[2], 0.0, q[0],
+                      q[1], -q[0], 0.0;
+      Eigen::Matrix< double, 2, 7 > J;
+      J.block< 2, 3 >( 0, 0 ) = dprojection_dp * dp_drotation;
+      J.block< 2, 3 >( 0, 3 ) = dprojection_dp;
+      J.col( 6 ) = projection;
+      JtJ += J.transpose() * J;
+      Jtr += J.transpose() * residual;
+    }
+
+    // Levenberg-Marquardt step, the damping is increased until the cost decreases
+    bool improved = false;
+    while ( !improved && lambda < 1e8 )
+    {
+      Eigen::MatrixXd A = JtJ.topLeftCorner( nb_parameters, nb_parameters );
+      for ( int k = 0; k < nb_parameters; ++k )
+        A( k, k ) += lambda * std::max( A( k, k ), 1e-9 );
+      Eigen::VectorXd delta = -A.ldlt().solve( Jtr.head( nb_parameters ) );
+
+      camera_pose candidate = pose;
+      Eigen::Vector3d omega = delta.head( 3 );
+      if ( omega.norm() > 0.0 )
+        candidate.rotation = Eigen::AngleAxisd( omega.norm(), omega.normalized() ).toRotationMatrix() * pose.rotation;
+      candidate.translation += delta.segment( 3, 3 );
+      if ( refine_focal )
+        candidate.focal_length *= exp( delta[6] );
+
+      double candidate_cost = 0.0;
+      for ( size_t i = 0; i < matches.size(); ++i )
+      {
+        double error = get_reprojection_error( candidate, ( *mImagePoints )[matches[i]], ( *mPoints )[matches[i]] );
+        if ( error != DBL_MAX )
+          candidate_cost += error * error;
+      }
+      if ( candidate_cost < cost )
+      {
+        improved = true;
+        pose = candidate;
+        if ( cost - candidate_cost < 1e-10 * cost )
+          step = max_nb_steps;
+        cost = candidate_cost;
+        lambda = std::max( lambda * 0.1, 1e-9 );
+      }
+      else
+        lambda *= 10.0;
+    }
+    if ( !improved )
+      break;
+  }
+}
+
+//---------------------------------------------------
+
+bool pose_estimator::estimate( const std::vector< Eigen::Vector2d > &image_points, const std::vector< Eigen::Vector3d > &points, double focal_length,
+                               double threshold, camera_pose &pose, std::vector< uint32_t > &inliers )
+{
+  double start_time = get_time();
+  mNbIterations = mNbUniformIterations = 0;
+  mSolverTime = mOptimizationTime = mTotalTime = mUniformTime = 0.0;
+  mUniformMeasured = false;
+  inliers.clear();
+
+  bool known_focal = ( focal_length > 0.0 );
+  uint32_t sample_size = known_focal ? 3 : 4;
+  uint32_t nb_matches = (uint32_t) std::min( image_points.size(), points.size() );
+  if ( nb_matches <= sample_size )
+  {
+    mTotalTime = get_time() - start_time;
+    return false;
+  }
+  mImagePoints = &image_points;
+  mPoints = &points;
+
+  uint32_t nb_best_inliers = sample_consensus( focal_length, threshold, mProgressiveSampling, pose, inliers );
+  mTotalTime = get_time() - start_time;
+
+  if ( !mProgressiveSampling )
+  {
+    mNbUniformIterations = mNbIterations;
+    mUniformMeasured = true;
+  }
+  else if ( mMeasureUniform )
+  {
+    // benchmark mode: run uniform LO-RANSAC on the same matches, its result is discarded, and restore the
+    // state of the progressive run such that the results do not depend on the measurement
+    uint32_t nb_iterations = mNbIterations;
+    double solver_time = mSolverTime, optimization_time = mOptimizationTime;
+    uint64_t random_state = mRandomState;
+    camera_pose uniform_pose;
+    std::vector< uint32_t > uniform_inliers;
+    double uniform_start = get_time();
+    sample_consensus( focal_length, threshold, false, uniform_pose, uniform_inliers );
+    mUniformTime = get_time() - uniform_start;
+    mNbUniformIterations = mNbIterations;
+    mUniformMeasured = true;
+    mNbIterations = nb_iterations;
+    mSolverTime = solver_time;
+    mOptimizationTime = optimization_time;
+    mRandomState = random_state;
+  }
+  else
+    mNbUniformIterations = std::max( mNbIterations, get_required_iterations( nb_best_inliers, nb_matches, sample_size ) );
+
+  mImagePoints = 0;
+  mPoints = 0;
+  return nb_best_inliers > sample_size;
+}
+
+//---------------------------------------------------
+
+uint32_t pose_estimator::sample_consensus( double focal_length, double threshold, bool progressive, camera_pose &pose, std::vector< uint32_t > &inliers )
+{
+  const std::vector< Eigen::Vector2d > &image_points = *mImagePoints;
+  const std::vector< Eigen::Vector3d > &points = *mPoints;
+  mNbIterations = 0;
+  mSolverTime = mOptimizationTime = 0.0;
+  inliers.clear();
+
+  bool known_focal = ( focal_length > 0.0 );
+  uint32_t sample_size = known_focal ? 3 : 4;
+  uint32_t nb_matches = (uint32_t) std::min( image_points.size(), points.size() );
+
+  std::vector< camera_pose > hypotheses;
+  std::vector< uint32_t > hypothesis_inliers, refined_inliers;
+  camera_pose best_pose;
+  uint32_t nb_best_inliers = 0;
+  uint32_t nb_required_iterations = mMaxIterations;
+  uint32_t sample[4];
+  Eigen::Vector3d sample_bearings[3];
+  Eigen::Vector2d sample_image_points[4];
+  Eigen::Vector3d sample_points[4];
+
+  // PROSAC: the samples are drawn from the first nb_sampled matches, which grows such that the
+  // schedule of the samples drawn from the first n matches matches the one of uniform sampling
+  uint32_t nb_sampled = nb_matches, max_nb_sampled = nb_matches;
+  double nb_expected_samples = 0.0;
+  // the iteration (counted from 1) at which the sampled set grows next
+  uint32_t last_growth = 1;
+  if ( progressive )
+  {
+    nb_sampled = sample_size;
+    nb_expected_samples = (double) mMaxIterations;
+    for ( uint32_t k = 0; k < sample_size; ++k )
+      nb_expected_samples *= (double) ( sample_size - k ) / (double) ( nb_matches - k );
+  }
+
+  // the probability that an outlier is consistent with a wrong pose, for the non-randomness test of PROSAC
+  Eigen::Vector2d image_min = image_points[0], image_max = image_points[0];
+  for ( uint32_t i = 1; i < nb_matches; ++i )
+  {
+    image_min = image_min.cwiseMin( image_points[i] );
+    image_max = image_max.cwiseMax( image_points[i] );
+  }
+  double image_area = std::max( ( image_max - image_min ).prod(), 1.0 );
+  double random_inlier_probability = std::min( 1.0, M_PI * threshold * threshold / image_area );
+
+  for ( mNbIterations = 0; mNbIterations < nb_required_iterations; ++mNbIterations )
+  {
+    // draw a minimal sample of distinct matches, in PROSAC either from the first nb_sampled matches
+    // or from the first nb_sampled - 1 ones together with the last of them
+    uint32_t nb_random = sample_size, nb_candidates = nb_sampled;
+    if ( progressive )
+    {
+      // once the growth was held back by max_nb_sampled, the set grows as soon as this allows it again
+      if ( mNbIterations + 1 >= last_growth && nb_sampled < max_nb_sampled )
+      {
+        double nb_next_expected_samples = nb_expected_samples * (double) ( nb_sampled + 1 ) / (double) ( nb_sampled + 1 - sample_size );
+        last_growth += (uint32_t) std::max( ceil( nb_next_expected_samples - nb_expected_samples ), 1.0 );
+        nb_expected_samples = nb_next_expected_samples;
+        ++nb_sampled;
+      }
+      nb_candidates = nb_sampled;
+      if ( last_growth >= mNbIterations + 1 )
+      {
+        nb_random = sample_size - 1;
+        nb_candidates = nb_sampled - 1;
+        sample[sample_size - 1] = nb_sampled - 1;
+      }
+    }
+    for ( uint32_t k = 0; k < nb_random; ++k )
+    {
+      bool drawn = true;
+      while ( drawn )
+      {
+        sample[k] = (uint32_t) ( xorshift( mRandomState ) % nb_candidates );
+        drawn = false;
+        for ( uint32_t l = 0; l < k; ++l )
+          drawn = drawn || ( sample[l] == sample[k] );
+      }
+    }
+    for ( uint32_t k = 0; k < sample_size; ++k )
+    {
+      sample_image_points[k] = image_points[sample[k]];
+      sample_points[k] = points[sample[k]];
+    }
+
+    double solver_start = get_time();
+    hypotheses.clear();
+    if ( known_focal )
+    {
+      for ( uint32_t k = 0; k < 3; ++k )
+        sample_bearings[k] = Eigen::Vector3d( sample_image_points[k][0], sample_image_points[k][1], -focal_length ).normalized();
+      solve_p3p( sample_bearings, sample_points, hypotheses );
+      for ( size_t h = 0; h < hypotheses.size(); ++h )
+        hypotheses[h].focal_length = focal_length;
+    }
+    else
+      solve_p4pf_approximate( sample_image_points, sample_points, mMinFocal, mMaxFocal, hypotheses );
+    mSolverTime += get_time() - solver_start;
+
+    for ( size_t h = 0; h < hypotheses.size(); ++h )
+    {
+      if ( find_inliers( hypotheses[h], threshold, hypothesis_inliers ) <= nb_best_inliers )
+        continue;
+      best_pose = hypotheses[h];
+      nb_best_inliers = (uint32_t) hypothesis_inliers.size();
+      inliers.swap( hypothesis_inliers );
+
+      // local optimization: refine on the inliers as long as their number grows
+      double optimization_start = get_time();
+      for ( int k = 0; k < 4 && nb_best_inliers > sample_size; ++k )
+      {
+        camera_pose refined_pose = best_pose;
+        refine( inliers, !known_focal, refined_pose );
+        uint32_t nb_refined_inliers = find_inliers( refined_pose, threshold, refined_inliers );
+        if ( nb_refined_inliers < nb_best_inliers )
+          break;
+        bool grown = ( nb_refined_inliers > nb_best_inliers );
+        best_pose = refined_pose;
+        nb_best_inliers = nb_refined_inliers;
+        inliers.swap( refined_inliers );
+        if ( !grown )
+          break;
+      }
+      mOptimizationTime += get_time() - optimization_start;
+
+      // adaptive termination: the number of samples needed to draw an all-inlier sample with the given confidence
+      nb_required_iterations = get_required_iterations( nb_best_inliers, nb_matches, sample_size );
+      if ( progressive )
+      {
+        max_nb_sampled = nb_matches;
+        // PROSAC: the number of samples needed for the inlier ratio of the first n matches, minimized over all
+        // n for which the number of inliers among them is unlikely to be random (binomial, normal approximation)
+        for ( size_t j = 0; j < inliers.size(); ++j )
+        {
+          uint32_t n = inliers[j] + 1;
+          if ( n <= sample_size )
+            continue;
+          double nb_random_inliers = (double) ( n - sample_size ) * random_inlier_probability;
+          double min_inliers = (double) sample_size + nb_random_inliers + 1.645 * sqrt( nb_random_inliers * ( 1.0 - random_inlier_probability ) );
+          if ( (double) ( j + 1 ) < min_inliers )
+            continue;
+          uint32_t nb_prefix_iterations = get_required_iterations( (uint32_t) ( j + 1 ), n, sample_size );
+          if ( nb_prefix_iterations < nb_required_iterations )
+          {
+            nb_required_iterations = nb_prefix_iterations;
+            max_nb_sampled = std::max( n, nb_sampled );
+          }
+        }
+      }
+    }
+  }
+
+  pose = best_pose;
+  return nb_best_inliers;
+}
+
+//---------------------------------------------------
+
+uint32_t pose_estimator::get_nb_iterations( ) const
+{
+  return mNbIterations;
+}
+
+//---------------------------------------------------
+
+uint32_t pose_estimator::get_nb_uniform_iterations( ) const
+{
+  return mNbUniformIterations;
+}
+
+//---------------------------------------------------
+
+bool pose_estimator::is_uniform_measured( ) const
+{
+  return mUniformMeasured;
+}
+
+//---------------------------------------------------
+
+double pose_estimator::get_uniform_time( ) const
+{
+  return mUniformTime;
+}
+
+//---------------------------------------------------
+
+double pose_estimator::get_solver_time( ) const
+{
+  return mSolverTime;
+}
+
+//---------------------------------------------------
+
+double pose_estimator::get_optimization_time( ) const
+{
+  return mOptimizationTime;
+}
+
+//---------------------------------------------------
+
+double pose_estimator::get_total_time( ) const
+{
+  return mTotalTime;
+}
@@ -0,0 +1,166 @@
+#ifndef POSE_ESTIMATOR_HH
+#define POSE_ESTIMATOR_HH
+
+/**
+ *    Absolute pose estimation from 2D-3D matches with LO-RANSAC (Chum et al.,
+ *    Locally Optimized RANSAC, DAGM 2003). Poses follow the Bundler convention:
+ *    a point X is mapped into the camera by p = R * X + t and projects to
+ *    ( -f * p_x / p_z, -f * p_y / p_z ), i.e., the image coordinates are
+ *    centered at the principal point with x pointing right and y pointing up
+ *    (the keypoint coordinates used by the localizer).
+ *
+ *    If the focal length is known, the hypotheses are computed from 3 matches
+ *    with P3P (Grunert's formulation: the distances of the points along the
+ *    viewing rays follow from the roots of a quartic, the pose from aligning
+ *    the points). Otherwise, they are computed from 4 matches with an
+ *    approximate P4Pf, which is not a minimal solver: P3P is solved for the
+ *    first 3 matches, with the focal length chosen to minimize the reprojection
+ *    error of the fourth match (1D search over the logarithm of the focal length
+ *    within a given range). Unlike the minimal solvers of Bujnak et al. or
+ *    Larsson et al., it only returns the best local minima of the search, so it
+ *    can miss solutions, and its hypotheses fit the fourth match only
+ *    approximately. The local optimization refines the focal length of the
+ *    best hypotheses on all their inliers.
+ *
+ *    Whenever a hypothesis has more inliers than the best one so far, it is
+ *    optimized locally: the pose (and the focal length if it is unknown) is
+ *    refined on the inliers with Levenberg-Marquardt and the inliers are
+ *    recomputed, as long as their number grows. The number of iterations is
+ *    adapted to the inlier ratio of the best hypothesis (adaptive termination).
+ *
+ *    With progressive sampling (PROSAC, Chum and Matas, Matching with PROSAC -
+ *    Progressive Sample Consensus, CVPR 2005), the matches have to be sorted by
+ *    decreasing quality. The samples are drawn from a growing set of the best
+ *    matches, and the estimation terminates once the inlier ratio among the
+ *    first n matches (for any n where the inliers are unlikely to be random)
+ *    requires no more samples. If good matches score high, far fewer hypotheses
+ *    are needed than with uniform sampling.
+**/
+
+#include <vector>
+#include <stdint.h>
+
+#include <Eigen/Dense>
+
+
+//! a camera pose in the Bundler convention
+struct camera_pose
+{
+  Eigen::Matrix3d rotation;
+  Eigen::Vector3d translation;
+  double focal_length;
+
+  camera_pose( ) : rotation( Eigen::Matrix3d::Identity() ), translation( Eigen::Vector3d::Zero() ), focal_length( 0.0 ) {}
+};
+
+/**
+ * P3P: computes the poses mapping the 3 points onto the 3 viewing rays (unit vectors in camera coordinates,
+ * pointing to the points, i.e., with negative z for points in front of the camera). Appends up to 4 poses
+ * (without focal length) and returns their number.
+**/
+uint32_t solve_p3p( const Eigen::Vector3d *bearings, const Eigen::Vector3d *points, std::vector< camera_pose > &poses );
+
+/**
+ * Approximate P4Pf: computes poses and focal lengths in [min_focal, max_focal] from 4 matches of image points
+ * (centered at the principal point) and 3D points, with a search over the focal length of P3P on the first
+ * 3 matches (see above). Appends up to 3 poses and returns their number.
+**/
+uint32_t solve_p4pf_approximate( const Eigen::Vector2d *image_points, const Eigen::Vector3d *points, double min_focal, double max_focal, std::vector< camera_pose > &poses );
+
+//! the reprojection error of a match in pixels, the maximal double value if the point lies behind the camera
+double get_reprojection_error( const camera_pose &pose, const Eigen::Vector2d &image_point, const Eigen::Vector3d &point );
+
+
+class pose_estimator
+{
+  public:
+    //! constructor
+    pose_estimator( );
+
+    //! destructor
+    ~pose_estimator( );
+
+    //! set the probability of sampling at least one all-inlier set, used for the adaptive termination (default 0.99)
+    void set_confidence( double confidence );
+
+    //! set the minimal and maximal number of iterations (default 10 and 10000)
+    void set_iteration_bounds( uint32_t min_iterations, uint32_t max_iterations );
+
+    //! set the range of the focal length searched by the approximate P4Pf in pixels (default 200 to 10000)
+    void set_focal_range( double min_focal, double max_focal );
+
+    //! use PROSAC instead of uniform sampling, the matches passed to estimate have to be sorted by decreasing quality (default false)
+    void set_progressive_sampling( bool progressive );
+
+    /**
+     * Benchmark mode: after every estimation with PROSAC, run LO-RANSAC with uniform sampling on the same
+     * matches and report its number of iterations and time (see get_nb_uniform_iterations). The pose and
+     * the inliers are the ones of PROSAC, the uniform run does not change the results (default false).
+    **/
+    void set_uniform_measurement( bool measure );
+
+    /**
+     * Estimate the pose from the matches image_points[i] <-> points[i]. If focal_length is positive, it is
+     * known and P3P is used, otherwise the approximate P4Pf. threshold is the maximal reprojection error of an inlier in
+     * pixels. The ids of the inliers of the estimated pose are stored in inliers. Returns false if there
+     * are not more matches than needed for a hypothesis or no pose has more inliers than that.
+    **/
+    bool estimate( const std::vector< Eigen::Vector2d > &image_points, const std::vector< Eigen::Vector3d > &points, double focal_length,
+                   double threshold, camera_pose &pose, std::vector< uint32_t > &inliers );
+
+    //! the number of iterations of the last estimation
+    uint32_t get_nb_iterations( ) const;
+
+    /**
+     * The number of iterations of uniform sampling for the last estimation. It is measured if uniform
+     * sampling was used or by the uniform run of the benchmark mode (see is_uniform_measured). Otherwise, it
+     * is an estimate: the number of samples the adaptive termination requires for the inlier ratio of the
+     * pose found by PROSAC (at least get_nb_iterations).
+    **/
+    uint32_t get_nb_uniform_iterations( ) const;
+
+    //! true if get_nb_uniform_iterations was measured by a run with uniform sampling, false if it is an estimate
+    bool is_uniform_measured( ) const;
+
+    //! the time (in seconds) of the uniform run of the benchmark mode in the last estimation, 0 without it
+    double get_uniform_time( ) const;
+
+    //! the time (in seconds) the last estimation spent computing hypotheses (P3P or the approximate P4Pf), in the local optimization and in total
+    double get_solver_time( ) const;
+    double get_optimization_time( ) const;
+    double get_total_time( ) const;
+
+  private:
+    /**
+     * LO-RANSAC on the matches mImagePoints and mPoints, with PROSAC if progressive is true. Sets
+     * mNbIterations, mSolverTime and mOptimizationTime and returns the number of inliers of the pose.
+    **/
+    uint32_t sample_consensus( double focal_length, double threshold, bool progressive, camera_pose &pose, std::vector< uint32_t > &inliers );
+
+    //! store the ids of the matches within the threshold in inliers, returns their number
+    uint32_t find_inliers( const camera_pose &pose, double threshold, std::vector< uint32_t > &inliers ) const;
+
+    //! the number of samples needed to draw an all-inlier sample with the given confidence, within the iteration bounds
+    uint32_t get_required_iterations( uint32_t nb_inliers, uint32_t nb_matches, uint32_t sample_size ) const;
+
+    //! refine the pose (and the focal length if refine_focal is true) on the given matches with Levenberg-Marquardt
+    void refine( const std::vector< uint32_t > &matches, bool refine_focal, camera_pose &pose ) const;
+
+    double mConfidence;
+    uint32_t mMinIterations, mMaxIterations;
+    double mMinFocal, mMaxFocal;
+    bool mProgressiveSampling;
+    bool mMeasureUniform;
+
+    // the matches of the current estimation
+    const std::vector< Eigen::Vector2d > *mImagePoints;
+    const std::vector< Eigen::Vector3d > *mPoints;
+
+    uint64_t mRandomState;
+
+    uint32_t mNbIterations, mNbUniformIterations;
+    bool mUniformMeasured;
+    double mSolverTime, mOptimizationTime, mTotalTime, mUniformTime;
+};
+
+#endif
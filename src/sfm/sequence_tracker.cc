@@ -0,0 +1,223 @@
+#include "sequence_tracker.hh"
+
+#include <iostream>
+#include <algorithm>
+
+
+sequence_tracker::sequence_tracker( )
+{
+  mModel = 0;
+  mGraph = 0;
+  mMaxNeighbors = 0;
+  mFrameStamp = 0;
+  mNbSelectedCameras = mNbSelectedPoints = 0;
+}
+
+//---------------------------------------------------
+
+sequence_tracker::~sequence_tracker( )
+{
+  mModel = 0;
+  mGraph = 0;
+}
+
+//---------------------------------------------------
+
+template< int nb_bits >
+void sequence_tracker::index( const localization_model &model, uint32_t nb_cameras, const covisibility_graph &graph, const basic_inverted_file< nb_bits > &lists,
+                              uint32_t max_neighbors )
+{
+  mModel = &model;
+  mGraph = &graph;
+  mMaxNeighbors = max_neighbors;
+  uint32_t nb_points = model.get_nb_points();
+
+  size_t nb_neighbors = 0;
+  for ( uint32_t i = 0; i < nb_cameras; ++i )
+    nb_neighbors += std::min( graph.get_degree( i ), max_neighbors );
+
+  // the entries of every point
+  mPointOffsets.assign( nb_points + 1, 0 );
+  std::vector< std::pair< uint32_t, uint32_t > > list;
+  for ( uint32_t vw = 0; vw < lists.get_nb_clusters(); ++vw )
+  {
+    lists.get_entries( vw, list );
+    for ( size_t j = 0; j < list.size(); ++j )
+      ++mPointOffsets[list[j].first + 1];
+  }
+  for ( uint32_t i = 0; i < nb_points; ++i )
+    mPointOffsets[i + 1] += mPointOffsets[i];
+  mPointEntries.resize( mPointOffsets[nb_points] );
+  std::vector< uint32_t > fill_positions( mPointOffsets.begin(), mPointOffsets.end() - 1 );
+  for ( uint32_t vw = 0; vw < lists.get_nb_clusters(); ++vw )
+  {
+    lists.get_entries( vw, list );
+    for ( size_t j = 0; j < list.size(); ++j )
+      mPointEntries[fill_positions[list[j].first]++] = std::make_pair( vw, list[j].second );
+  }
+
+  mFrameStamp = 0;
+  mCameraStamps.assign( nb_cameras, 0 );
+  mPointStamps.assign( nb_points, 0 );
+  mNbSelectedCameras = mNbSelectedPoints = 0;
+  mSessions.clear();
+
+  std::cout << "[sequence_tracker]: " << nb_cameras << " cameras with " << (double) nb_neighbors / (double) std::max( nb_cameras, (uint32_t) 1 )
+            << " covisible neighbors on average, " << mPointEntries.size() << " entries of " << nb_points << " points" << std::endl;
+}
+
+template void sequence_tracker::index( const localization_model &model, uint32_t nb_cameras, const covisibility_graph &graph,
+                                       const basic_inverted_file< 32 > &lists, uint32_t max_neighbors );
+template void sequence_tracker::index( const localization_model &model, uint32_t nb_cameras, const covisibility_graph &graph,
+                                       const basic_inverted_file< 64 > &lists, uint32_t max_neighbors );
+template void sequence_tracker::index( const localization_model &model, uint32_t nb_cameras, const covisibility_graph &graph,
+                                       const basic_inverted_file< 128 > &lists, uint32_t max_neighbors );
+
+//---------------------------------------------------
+
+bool sequence_tracker::select( const std::string &session )
+{
+  ++mFrameStamp;
+  if ( mFrameStamp == 0 )
+  {
+    std::fill( mCameraStamps.begin(), mCameraStamps.end(), 0 );
+    std::fill( mPointStamps.begin(), mPointStamps.end(), 0 );
+    mFrameStamp = 1;
+  }
+  mNbSelectedCameras = mNbSelectedPoints = 0;
+  mWords.clear();
+  mOffsets.clear();
+  mEntries.clear();
+
+  std::map< std::string, std::vector< uint32_t > >::const_iterator it = mSessions.find( session );
+  if ( session.empty() || it == mSessions.end() || it->second.empty() )
+    return false;
+
+  // the top cameras of the last frame and their neighbors
+  const std::vector< uint32_t > &top_cameras = it->second;
+  for ( size_t i = 0; i < top_cameras.size(); ++i )
+  {
+    if ( mCameraStamps[top_cameras[i]] != mFrameStamp )
+    {
+      mCameraStamps[top_cameras[i]] = mFrameStamp;
+      ++mNbSelectedCameras;
+    }
+    const uint32_t *neighbors = mGraph->get_neighbors( top_cameras[i] );
+    uint32_t nb_neighbors = std::min( mGraph->get_degree( top_cameras[i] ), mMaxNeighbors );
+    for ( uint32_t j = 0; j < nb_neighbors; ++j )
+    {
+      if ( mCameraStamps[neighbors[j]] != mFrameStamp )
+      {
+        mCameraStamps[neighbors[j]] = mFrameStamp;
+        ++mNbSelectedCameras;
+      }
+    }
+  }
+
+  // the entries of the points seen by the selected cameras, sorted into inverted lists
+  mSelectedEntries.clear();
+  for ( uint32_t i = 0; i < (uint32_t) mCameraStamps.size(); ++i )
+  {
+    if ( mCameraStamps[i] != mFrameStamp )
+      continue;
+    const uint32_t *points = mModel->get_camera_points( i );
+    for ( uint32_t j = 0; j < mModel->get_nb_camera_points( i ); ++j )
+    {
+      uint32_t point = points[j];
+      if ( mPointStamps[point] == mFrameStamp )
+        continue;
+      mPointStamps[point] = mFrameStamp;
+      ++mNbSelectedPoints;
+      for ( uint32_t k = mPointOffsets[point]; k < mPointOffsets[point + 1]; ++k )
+        mSelectedEntries.push_back( std::make_pair( mPointEntries[k].first, std::make_pair( point, mPointEntries[k].second ) ) );
+    }
+  }
+  std::sort( mSelectedEntries.begin(), mSelectedEntries.end() );
+
+  mEntries.resize( mSelectedEntries.size() );
+  for ( size_t i = 0; i < mSelectedEntries.size(); ++i )
+  {
+    if ( mWords.empty() || mWords.back() != mSelectedEntries[i].first )
+    {
+      mWords.push_back( mSelectedEntries[i].first );
+      mOffsets.push_back( (uint32_t) i );
+    }
+    mEntries[i] = mSelectedEntries[i].second;
+  }
+  mOffsets.push_back( (uint32_t) mEntries.size() );
+
+  return true;
+}
+
+//---------------------------------------------------
+
+bool sequence_tracker::is_camera_selected( uint32_t camera ) const
+{
+  return mCameraStamps[camera] == mFrameStamp;
+}
+
+//---------------------------------------------------
+
+void sequence_tracker::get_entries( uint32_t vw, std::vector< std::pair< uint32_t, uint32_t > > &entries ) const
+{
+  entries.clear();
+  std::vector< uint32_t >::const_iterator it = std::lower_bound( mWords.begin(), mWords.end(), vw );
+  if ( it == mWords.end() || *it != vw )
+    return;
+  size_t index = it - mWords.begin();
+  entries.assign( mEntries.begin() + mOffsets[index], mEntries.begin() + mOffsets[index + 1] );
+}
+
+//---------------------------------------------------
+
+void sequence_tracker::update( const std::string &session, const std::vector< uint32_t > &top_cameras )
+{
+  if ( session.empty() )
+    return;
+  if ( top_cameras.empty() )
+    mSessions.erase( session );
+  else
+    mSessions[session] = top_cameras;
+}
+
+//---------------------------------------------------
+
+void sequence_tracker::drop( const std::string &session )
+{
+  mSessions.erase( session );
+}
+
+//---------------------------------------------------
+
+uint32_t sequence_tracker::get_nb_selected_cameras( ) const
+{
+  return mNbSelectedCameras;
+}
+
+//---------------------------------------------------
+
+uint32_t sequence_tracker::get_nb_selected_points( ) const
+{
+  return mNbSelectedPoints;
+}
+
+//---------------------------------------------------
+
+uint32_t sequence_tracker::get_nb_selected_entries( ) const
+{
+  return (uint32_t) mEntries.size();
+}
+
+//---------------------------------------------------
+
+uint32_t sequence_tracker::get_nb_cameras( ) const
+{
+  return (uint32_t) mCameraStamps.size();
+}
+
+//---------------------------------------------------
+
+uint32_t sequence_tracker::get_nb_entries( ) const
+{
+  return (uint32_t) mPointEntries.size();
+}
@@ -0,0 +1,111 @@
+#ifndef SEQUENCE_TRACKER_HH
+#define SEQUENCE_TRACKER_HH
+
+/**
+ *    Tracking of query sequences (e.g., frames of a camera stream). The
+ *    queries of a sequence share a session id, and consecutive frames mostly
+ *    see the same database images. For every session, the top ranked cameras
+ *    of the last frame are kept. The next frame of the session is then only
+ *    matched against the points seen by these cameras and their covisible
+ *    neighbors (the strongest edges of the covisibility graph), and only these
+ *    cameras are voted for.
+ *
+ *    To make the restricted matching cheap, the entries of every point are
+ *    indexed once (CSR layout, point -> (visual word, code id)). When a frame
+ *    is tracked, the entries of the selected points are sorted into small
+ *    inverted lists, such that only they are scanned.
+ *
+ *    The caller decides whether a tracked frame succeeded. If not, it should
+ *    fall back to the search in the whole model and report its top cameras,
+ *    or drop the session if that fails as well.
+**/
+
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+#include <stdint.h>
+
+#include "localization_model.hh"
+#include "covisibility_graph.hh"
+#include "../features/inverted_file.hh"
+
+
+class sequence_tracker
+{
+  public:
+    //! constructor
+    sequence_tracker( );
+
+    //! destructor
+    ~sequence_tracker( );
+
+    /**
+     * Index the entries of the points of the model. The top cameras of a frame are expanded by (at most) their
+     * max_neighbors strongest neighbors in the covisibility graph. The points of the cameras are taken from the
+     * model (see localization_model::index_camera_points). The model and the graph need to stay valid while the
+     * tracker is used.
+    **/
+    template< int nb_bits >
+    void index( const localization_model &model, uint32_t nb_cameras, const covisibility_graph &graph, const basic_inverted_file< nb_bits > &lists,
+                uint32_t max_neighbors );
+
+    /**
+     * Select the cameras of the last frame of the session, their neighbors and the points seen by them.
+     * Returns false if the session has no tracked cameras, in which case the frame has to be matched
+     * against the whole model.
+    **/
+    bool select( const std::string &session );
+
+    //! returns true if the camera was selected by the last call of select
+    bool is_camera_selected( uint32_t camera ) const;
+
+    //! get the (3D point id, code id) pairs of visual word vw that belong to selected points
+    void get_entries( uint32_t vw, std::vector< std::pair< uint32_t, uint32_t > > &entries ) const;
+
+    //! keep the top ranked cameras of the current frame of the session for its next frame
+    void update( const std::string &session, const std::vector< uint32_t > &top_cameras );
+
+    //! forget the cameras of the session, its next frame is matched against the whole model
+    void drop( const std::string &session );
+
+    //! the number of cameras, points and entries selected by the last call of select
+    uint32_t get_nb_selected_cameras( ) const;
+    uint32_t get_nb_selected_points( ) const;
+    uint32_t get_nb_selected_entries( ) const;
+
+    //! the number of cameras and entries of the model
+    uint32_t get_nb_cameras( ) const;
+    uint32_t get_nb_entries( ) const;
+
+  private:
+    //! the points seen by every camera
+    const localization_model *mModel;
+
+    //! the covisible neighbors of every camera, the first mMaxNeighbors of them are selected
+    const covisibility_graph *mGraph;
+    uint32_t mMaxNeighbors;
+
+    //! the (visual word, code id) entries of point i are mPointEntries[mPointOffsets[i]] to mPointEntries[mPointOffsets[i+1]-1]
+    std::vector< uint32_t > mPointOffsets;
+    std::vector< std::pair< uint32_t, uint32_t > > mPointEntries;
+
+    //! the top cameras of the last frame of every session
+    std::map< std::string, std::vector< uint32_t > > mSessions;
+
+    // the selection of the current frame, marked by mFrameStamp such that no array has to be reset between frames
+    uint32_t mFrameStamp;
+    std::vector< uint32_t > mCameraStamps;
+    std::vector< uint32_t > mPointStamps;
+    uint32_t mNbSelectedCameras, mNbSelectedPoints;
+
+    //! the inverted lists of the selected points: the entries of mWords[i] are mEntries[mOffsets[i]] to mEntries[mOffsets[i+1]-1]
+    std::vector< uint32_t > mWords;
+    std::vector< uint32_t > mOffsets;
+    std::vector< std::pair< uint32_t, uint32_t > > mEntries;
+
+    //! (visual word, (point id, code id)) triplets of the selected points, sorted into the lists
+    std::vector< std::pair< uint32_t, std::pair< uint32_t, uint32_t > > > mSelectedEntries;
+};
+
+#endif
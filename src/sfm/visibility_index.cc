@@ -0,0 +1,159 @@
+#include "visibility_index.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <bitset>
+
+// the number of 16 bit words of a bitmap container
+static const uint32_t bitmap_words = 65536 / 16;
+
+visibility_index::visibility_index( )
+{
+  mOffsets.assign( 1, 0 );
+  mNbViews = 0;
+  mNbContainers = mNbBitmaps = 0;
+}
+
+//---------------------------------------------------
+
+visibility_index::~visibility_index( )
+{
+}
+
+//---------------------------------------------------
+
+void visibility_index::build( const localization_model &model )
+{
+  uint32_t nb_points = model.get_nb_points();
+  mOffsets.assign( nb_points + 1, 0 );
+  mData.clear();
+  mNbViews = 0;
+  mNbContainers = mNbBitmaps = 0;
+
+  std::vector< uint32_t > cameras;
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    cameras.assign( model.get_cameras( i ), model.get_cameras( i ) + model.get_nb_views( i ) );
+    std::sort( cameras.begin(), cameras.end() );
+    cameras.erase( std::unique( cameras.begin(), cameras.end() ), cameras.end() );
+    mNbViews += cameras.size();
+
+    // one container per value of the upper 16 bits
+    size_t begin = 0;
+    while ( begin < cameras.size() )
+    {
+      uint32_t key = cameras[begin] >> 16;
+      size_t end = begin;
+      while ( end < cameras.size() && ( cameras[end] >> 16 ) == key )
+        ++end;
+
+      mData.push_back( (uint16_t) key );
+      if ( end - begin <= max_array_size )
+      {
+        mData.push_back( (uint16_t) ( end - begin ) );
+        for ( size_t j = begin; j < end; ++j )
+          mData.push_back( (uint16_t) ( cameras[j] & 0xFFFF ) );
+      }
+      else
+      {
+        mData.push_back( 0 );
+        size_t bitmap = mData.size();
+        mData.resize( bitmap + bitmap_words, 0 );
+        for ( size_t j = begin; j < end; ++j )
+          mData[bitmap + ( ( cameras[j] & 0xFFFF ) >> 4 )] |= (uint16_t) ( 1 << ( cameras[j] & 15 ) );
+        ++mNbBitmaps;
+      }
+      ++mNbContainers;
+      begin = end;
+    }
+    mOffsets[i + 1] = (uint32_t) mData.size();
+  }
+}
+
+//---------------------------------------------------
+
+uint32_t visibility_index::get_nb_points( ) const
+{
+  return (uint32_t) mOffsets.size() - 1;
+}
+
+//---------------------------------------------------
+
+uint32_t visibility_index::get_nb_cameras( uint32_t point ) const
+{
+  uint32_t nb_cameras = 0;
+  for ( uint32_t i = mOffsets[point]; i < mOffsets[point + 1]; )
+  {
+    uint32_t size = mData[i + 1];
+    i += 2;
+    if ( size > 0 )
+    {
+      nb_cameras += size;
+      i += size;
+    }
+    else
+    {
+      for ( uint32_t w = 0; w < bitmap_words; ++w )
+        nb_cameras += (uint32_t) std::bitset< 16 >( mData[i + w] ).count();
+      i += bitmap_words;
+    }
+  }
+  return nb_cameras;
+}
+
+//---------------------------------------------------
+
+void visibility_index::get_cameras( uint32_t point, std::vector< uint32_t > &cameras ) const
+{
+  cameras.clear();
+  for ( uint32_t i = mOffsets[point]; i < mOffsets[point + 1]; )
+  {
+    uint32_t key = (uint32_t) mData[i] << 16, size = mData[i + 1];
+    i += 2;
+    if ( size > 0 )
+    {
+      for ( uint32_t j = 0; j < size; ++j )
+        cameras.push_back( key | mData[i + j] );
+      i += size;
+    }
+    else
+    {
+      for ( uint32_t w = 0; w < bitmap_words; ++w )
+      {
+        for ( uint32_t word = mData[i + w], b = 0; word != 0; word >>= 1, ++b )
+        {
+          if ( word & 1 )
+            cameras.push_back( key | ( w << 4 ) | b );
+        }
+      }
+      i += bitmap_words;
+    }
+  }
+}
+
+//---------------------------------------------------
+
+uint64_t visibility_index::get_nb_views( ) const
+{
+  return mNbViews;
+}
+
+//---------------------------------------------------
+
+uint64_t visibility_index::get_memory( ) const
+{
+  return sizeof( uint32_t ) * mOffsets.size() + sizeof( uint16_t ) * mData.size();
+}
+
+//---------------------------------------------------
+
+void visibility_index::print_statistics( ) const
+{
+  uint32_t nb_points = get_nb_points();
+  // the camera lists of localization_model cost one camera id per view and one offset per point
+  double list_memory = (double) mNbViews * sizeof( uint32_t ) + (double) ( nb_points + 1 ) * sizeof( uint32_t );
+  std::cout << "[visibility_index]: " << mNbViews << " views of " << nb_points << " points in " << mNbContainers << " containers (" << mNbBitmaps << " bitmaps), "
+            << get_memory() / ( 1024.0 * 1024.0 ) << " MB instead of " << list_memory / ( 1024.0 * 1024.0 ) << " MB of camera lists ("
+            << (double) get_memory() / (double) std::max( mNbViews, (uint64_t) 1 ) << " instead of " << list_memory / (double) std::max( mNbViews, (uint64_t) 1 )
+            << " bytes per view)" << std::endl;
+}
@@ -0,0 +1,67 @@
+#ifndef VISIBILITY_INDEX_HH
+#define VISIBILITY_INDEX_HH
+
+/**
+ *    Compressed visibility of the points of a model, i.e., the set of cameras
+ *    seeing every point, for the voting of the localizer. The camera lists of
+ *    localization_model store 4 bytes per view.
+ *
+ *    The camera sets are stored like Roaring bitmaps: the camera ids of a point
+ *    are split by their upper 16 bits into containers. A container stores its
+ *    key (the upper 16 bits) and its size followed by the sorted lower 16 bits
+ *    of its camera ids, or by a bitmap of 65536 bits if it holds more than
+ *    max_array_size cameras (marked by size 0). As models rarely have more
+ *    than 65536 cameras, a point typically has a single array container and
+ *    costs 2 bytes per view plus 4 bytes. The containers of all points are
+ *    stored in a single array of 16 bit values, with one offset per point.
+**/
+
+#include <vector>
+#include <stdint.h>
+
+#include "parse_bundler.hh"
+#include "localization_model.hh"
+
+
+class visibility_index
+{
+  public:
+    //! containers with more cameras are stored as bitmaps
+    enum { max_array_size = 4096 };
+
+    //! constructor
+    visibility_index( );
+
+    //! destructor
+    ~visibility_index( );
+
+    //! build the camera sets from the cameras of the points, a camera seeing a point several times is stored once
+    void build( const localization_model &model );
+
+    uint32_t get_nb_points( ) const;
+
+    //! the number of cameras seeing the point
+    uint32_t get_nb_cameras( uint32_t point ) const;
+
+    //! decode the cameras seeing the point, sorted by id
+    void get_cameras( uint32_t point, std::vector< uint32_t > &cameras ) const;
+
+    //! the number of (point, camera) pairs
+    uint64_t get_nb_views( ) const;
+
+    //! the memory used by the index in bytes
+    uint64_t get_memory( ) const;
+
+    //! print the number of views and containers and the memory compared to the camera lists
+    void print_statistics( ) const;
+
+  private:
+    //! the containers of point i are mData[mOffsets[i]] to mData[mOffsets[i+1]-1]
+    std::vector< uint32_t > mOffsets;
+    std::vector< uint16_t > mData;
+
+    uint64_t mNbViews;
+    uint32_t mNbContainers, mNbBitmaps;
+};
+
+#endif
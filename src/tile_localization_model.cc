@@ -0,0 +1,271 @@
+#define __STDC_LIMIT_MACROS
+
+// C++ includes
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+
+#include "features/hamming_embedding.hh"
+#include "features/hamming_model.hh"
+#include "sfm/parse_bundler.hh"
+#include "sfm/geo_prior.hh"
+
+// stopwatch
+#include "timer.hh"
+
+#include "tiled_model.hh"
+
+
+// the data of a tile while it is assembled
+struct tile_data
+{
+  int tile_x, tile_y;
+  std::vector< uint32_t > point_ids;
+  std::vector< float > positions;
+  std::vector< uint32_t > view_offsets;
+  std::vector< uint32_t > view_cameras;
+  std::vector< uint32_t > words;
+  std::vector< uint32_t > word_offsets;
+  std::vector< uint32_t > entries;
+  std::vector< uint64_t > signatures;
+
+  //! free the memory of the tile
+  void release( )
+  {
+    std::vector< uint32_t >().swap( point_ids );
+    std::vector< float >().swap( positions );
+    std::vector< uint32_t >().swap( view_offsets );
+    std::vector< uint32_t >().swap( view_cameras );
+    std::vector< uint32_t >().swap( words );
+    std::vector< uint32_t >().swap( word_offsets );
+    std::vector< uint32_t >().swap( entries );
+    std::vector< uint64_t >().swap( signatures );
+  }
+};
+
+// print minimum, median, mean and maximum of a set of values
+void print_distribution( const std::string &name, std::vector< double > values )
+{
+  if ( values.empty() )
+    return;
+  std::sort( values.begin(), values.end() );
+  double sum = 0.0;
+  for ( size_t i = 0; i < values.size(); ++i )
+    sum += values[i];
+  std::cout << "  " << name << ": min " << values.front() << ", median " << values[values.size() / 2] << ", mean " << sum / (double) values.size()
+            << ", max " << values.back() << ", total " << sum << std::endl;
+}
+
+
+int main (int argc, char **argv)
+{
+  if ( argc < 7 )
+  {
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " -    Partitions a model into square tiles by the position of its 3D points. Every tile is stored    - " << std::endl;
+    std::cout << " -    as a segment containing its points, their visibility lists, the inverted lists restricted to  - " << std::endl;
+    std::cout << " -    the points and their binary signatures. The localizer maps only the tiles around the GPS       - " << std::endl;
+    std::cout << " -    position of a query (option --tiled_model).                                                    - " << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " - usage: tile_localization_model bundle bundle_type hamming georegistration tile_size out_dir       - " << std::endl;
+    std::cout << " - Parameters:                                                                                       - " << std::endl;
+    std::cout << " -  argv[1]: The .info file                                                                          - " << std::endl;
+    std::cout << " -  argv[2]: The file format of the .info file (0: Bundle2Info, 1: with camera information)          - " << std::endl;
+    std::cout << " -  argv[3]: The model (output of compute_hamming_threshold or build_localization_model)             - " << std::endl;
+    std::cout << " -  argv[4]: The georegistration of the model (see the --georegistration option of the localizer)   - " << std::endl;
+    std::cout << " -  argv[5]: The size of the tiles in meters                                                         - " << std::endl;
+    std::cout << " -  argv[6]: An existing directory to which the segments, the index (tiles.idx) and a report of the - " << std::endl;
+    std::cout << " -           tile sizes (tile_stats.txt) are written                                                 - " << std::endl;
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    return -1;
+  }
+
+  std::string bundle( argv[1] );
+  int bundle_type = atoi( argv[2] );
+  std::string hamming_input( argv[3] );
+  std::string georegistration_file( argv[4] );
+  double tile_size = atof( argv[5] );
+  std::string out_dir( argv[6] );
+  while ( out_dir.size() > 1 && out_dir[out_dir.size() - 1] == '/' )
+    out_dir.erase( out_dir.size() - 1 );
+
+  if ( bundle_type < 0 || bundle_type > 1 )
+  {
+    std::cerr << " ERROR: Unknown file format for the binary .info file." << std::endl;
+    return -1;
+  }
+  if ( tile_size <= 0.0 )
+  {
+    std::cerr << " ERROR: The tile size has to be positive" << std::endl;
+    return -1;
+  }
+
+  Timer timer;
+  timer.Init();
+  timer.Start();
+
+  ////
+  // load the points (without descriptors) and the model
+  parse_bundler parser;
+  if ( !parser.load_from_binary_nokey( bundle.c_str(), bundle_type ) )
+    return -1;
+  std::vector< feature_3D_info >& feature_infos = parser.get_feature_infos();
+  uint32_t nb_points = (uint32_t) feature_infos.size();
+  uint32_t nb_cameras = parser.get_number_of_cameras();
+
+  hamming_embedding embedding;
+  hamming_model model;
+  if ( !model.load( hamming_input, embedding ) )
+    return -1;
+  if ( model.get_nb_points() != nb_points )
+  {
+    std::cerr << " ERROR: The model contains " << model.get_nb_points() << " points, but " << bundle << " contains " << nb_points << std::endl;
+    return -1;
+  }
+
+  geo_prior prior;
+  if ( !prior.load_georegistration( georegistration_file ) )
+    return -1;
+
+  timer.Stop();
+  std::cout << "-> loaded " << nb_points << " points and " << model.get_nb_descriptors() << " descriptors in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  ////
+  // sort the points into tiles
+  timer.Init();
+  timer.Start();
+  std::map< std::pair< int, int >, uint32_t > tile_ids;
+  std::vector< tile_data > tiles;
+  std::vector< uint32_t > point_tile( nb_points, 0 );
+  std::vector< uint32_t > point_local_id( nb_points, 0 );
+  std::vector< uint32_t > camera_point_counts( nb_cameras, 0 );
+
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    const feature_3D_info &info = feature_infos[i];
+    double east, north;
+    prior.model_to_local( info.point.x, info.point.y, info.point.z, east, north );
+    std::pair< int, int > coordinates( (int) floor( east / tile_size ), (int) floor( north / tile_size ) );
+
+    std::map< std::pair< int, int >, uint32_t >::iterator it = tile_ids.find( coordinates );
+    if ( it == tile_ids.end() )
+    {
+      it = tile_ids.insert( std::make_pair( coordinates, (uint32_t) tiles.size() ) ).first;
+      tiles.push_back( tile_data() );
+      tiles.back().tile_x = coordinates.first;
+      tiles.back().tile_y = coordinates.second;
+      tiles.back().view_offsets.push_back( 0 );
+    }
+
+    tile_data &t = tiles[it->second];
+    point_tile[i] = it->second;
+    point_local_id[i] = (uint32_t) t.point_ids.size();
+    t.point_ids.push_back( i );
+    t.positions.push_back( info.point.x );
+    t.positions.push_back( info.point.y );
+    t.positions.push_back( info.point.z );
+    for ( size_t j = 0; j < info.view_list.size(); ++j )
+    {
+      t.view_cameras.push_back( info.view_list[j].camera );
+      if ( info.view_list[j].camera < nb_cameras )
+        ++camera_point_counts[info.view_list[j].camera];
+    }
+    t.view_offsets.push_back( (uint32_t) t.view_cameras.size() );
+  }
+
+  ////
+  // split the inverted lists, a descriptor belongs to a single point and thus to a single tile
+  const std::vector< uint64_t > &signatures = model.get_signatures();
+  std::vector< uint32_t > descriptor_local_id( signatures.size(), UINT32_MAX );
+  uint32_t nb_clusters = model.get_nb_clusters();
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    uint32_t nb_pairs = model.get_nb_assignments( vw );
+    const uint32_t *pairs = model.get_assignments( vw );
+    for ( uint32_t j = 0; j < nb_pairs; ++j )
+    {
+      uint32_t point_id = pairs[2 * j];
+      uint32_t desc_id = pairs[2 * j + 1];
+      tile_data &t = tiles[point_tile[point_id]];
+      if ( t.words.empty() || t.words.back() != vw )
+      {
+        t.words.push_back( vw );
+        t.word_offsets.push_back( (uint32_t) ( t.entries.size() / 2 ) );
+      }
+      if ( descriptor_local_id[desc_id] == UINT32_MAX )
+      {
+        descriptor_local_id[desc_id] = (uint32_t) t.signatures.size();
+        t.signatures.push_back( signatures[desc_id] );
+      }
+      t.entries.push_back( point_local_id[point_id] );
+      t.entries.push_back( descriptor_local_id[desc_id] );
+    }
+  }
+  timer.Stop();
+  std::cout << "-> sorted the model into " << tiles.size() << " tiles of " << tile_size << "m in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  ////
+  // write the segments and the index
+  timer.Init();
+  timer.Start();
+  std::vector< tile_info > tile_table( tiles.size() );
+  for ( size_t i = 0; i < tiles.size(); ++i )
+  {
+    tile_data &t = tiles[i];
+    t.word_offsets.push_back( (uint32_t) ( t.entries.size() / 2 ) );
+
+    std::string filename = tiled_model::get_segment_filename( out_dir, t.tile_x, t.tile_y );
+    if ( !tile_segment::save( filename, t.tile_x, t.tile_y, t.point_ids, t.positions, t.view_offsets, t.view_cameras, t.words, t.word_offsets, t.entries, t.signatures ) )
+      return -1;
+
+    std::ifstream segment( filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate );
+    tile_table[i].tile_x = t.tile_x;
+    tile_table[i].tile_y = t.tile_y;
+    tile_table[i].nb_points = (uint32_t) t.point_ids.size();
+    tile_table[i].nb_entries = (uint32_t) ( t.entries.size() / 2 );
+    tile_table[i].size = (uint64_t) segment.tellg();
+
+    // the data of the tile is not needed anymore
+    t.release();
+  }
+
+  const Eigen::Matrix< float, 64, Eigen::Dynamic > &thresholds = embedding.get_thresholds();
+  std::vector< float > threshold_values( thresholds.data(), thresholds.data() + thresholds.size() );
+  const hamming_embedding::projection_matrix_t &projection = embedding.get_projection_matrix();
+  std::vector< float > projection_values( projection.data(), projection.data() + projection.size() );
+
+  std::string index_file = out_dir + "/tiles.idx";
+  if ( !tiled_model::save_index( index_file, nb_points, nb_clusters, model.get_nb_descriptors(), tile_size, camera_point_counts, tile_table, threshold_values, projection_values ) )
+    return -1;
+  timer.Stop();
+  std::cout << "-> wrote the tiles and the index " << index_file << " in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  ////
+  // report the tile sizes
+  std::string report_file = out_dir + "/tile_stats.txt";
+  std::ofstream ofs( report_file.c_str(), std::ios::out );
+  ofs << "# tile_x tile_y nb_points nb_entries bytes" << std::endl;
+  std::vector< double > tile_points, tile_entries, tile_megabytes;
+  for ( size_t i = 0; i < tile_table.size(); ++i )
+  {
+    ofs << tile_table[i].tile_x << " " << tile_table[i].tile_y << " " << tile_table[i].nb_points << " " << tile_table[i].nb_entries << " " << tile_table[i].size << std::endl;
+    tile_points.push_back( tile_table[i].nb_points );
+    tile_entries.push_back( tile_table[i].nb_entries );
+    tile_megabytes.push_back( tile_table[i].size / ( 1024.0 * 1024.0 ) );
+  }
+  ofs.close();
+
+  std::cout << "-> " << tile_table.size() << " tiles (per tile statistics in " << report_file << ")" << std::endl;
+  print_distribution( "points", tile_points );
+  print_distribution( "inverted list entries", tile_entries );
+  print_distribution( "size [MB]", tile_megabytes );
+
+  return 0;
+}
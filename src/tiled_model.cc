@@ -0,0 +1,566 @@
+#include "tiled_model.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// identify segment and index files
+static const char segment_magic[8] = { 'C', 'P', 'F', 'T', 'I', 'L', 'E', '1' };
+static const char index_magic[8] = { 'C', 'P', 'F', 'T', 'I', 'D', 'X', '1' };
+
+// header of a segment, followed by the arrays described in get_segment_layout
+struct tile_segment_header
+{
+  char magic[8];
+  int32_t tile_x;
+  int32_t tile_y;
+  uint32_t nb_points;
+  uint32_t nb_views;
+  uint32_t nb_words;
+  uint32_t nb_entries;
+  uint32_t nb_descriptors;
+  uint32_t reserved;
+};
+
+// byte offsets of the arrays of a segment
+struct tile_segment_layout
+{
+  uint64_t point_ids, positions, view_offsets, view_cameras, words, word_offsets, entries, signatures, size;
+};
+
+static tile_segment_layout get_segment_layout( const tile_segment_header &header )
+{
+  tile_segment_layout layout;
+  layout.point_ids = sizeof( tile_segment_header );
+  layout.positions = layout.point_ids + sizeof( uint32_t ) * (uint64_t) header.nb_points;
+  layout.view_offsets = layout.positions + 3 * sizeof( float ) * (uint64_t) header.nb_points;
+  layout.view_cameras = layout.view_offsets + sizeof( uint32_t ) * ( (uint64_t) header.nb_points + 1 );
+  layout.words = layout.view_cameras + sizeof( uint32_t ) * (uint64_t) header.nb_views;
+  layout.word_offsets = layout.words + sizeof( uint32_t ) * (uint64_t) header.nb_words;
+  layout.entries = layout.word_offsets + sizeof( uint32_t ) * ( (uint64_t) header.nb_words + 1 );
+  // the signatures are aligned to 8 bytes
+  layout.signatures = layout.entries + 2 * sizeof( uint32_t ) * (uint64_t) header.nb_entries;
+  layout.signatures = ( layout.signatures + 7 ) & ~uint64_t( 7 );
+  layout.size = layout.signatures + sizeof( uint64_t ) * (uint64_t) header.nb_descriptors;
+  return layout;
+}
+
+//-----------------------------------
+
+tile_segment::tile_segment( )
+{
+  close();
+}
+
+//-----------------------------------
+
+tile_segment::~tile_segment( )
+{
+  close();
+}
+
+//-----------------------------------
+
+bool tile_segment::open( const std::string &filename )
+{
+  close();
+
+  if ( !mFile.open( filename ) )
+    return false;
+
+  tile_segment_header header;
+  if ( mFile.size() < sizeof( tile_segment_header ) )
+  {
+    std::cerr << "[tile_segment]: ERROR: " << filename << " is not a tile segment" << std::endl;
+    close();
+    return false;
+  }
+  memcpy( &header, mFile.data(), sizeof( tile_segment_header ) );
+  tile_segment_layout layout = get_segment_layout( header );
+  if ( memcmp( header.magic, segment_magic, 8 ) != 0 || layout.size != mFile.size() )
+  {
+    std::cerr << "[tile_segment]: ERROR: " << filename << " is not a tile segment or is truncated" << std::endl;
+    close();
+    return false;
+  }
+
+  mTileX = header.tile_x;
+  mTileY = header.tile_y;
+  mNbPoints = header.nb_points;
+  mNbWords = header.nb_words;
+  mNbDescriptors = header.nb_descriptors;
+
+  const unsigned char *data = mFile.data();
+  mPointIds = (const uint32_t*) ( data + layout.point_ids );
+  mPositions = (const float*) ( data + layout.positions );
+  mViewOffsets = (const uint32_t*) ( data + layout.view_offsets );
+  mViewCameras = (const uint32_t*) ( data + layout.view_cameras );
+  mWords = (const uint32_t*) ( data + layout.words );
+  mWordOffsets = (const uint32_t*) ( data + layout.word_offsets );
+  mEntries = (const uint32_t*) ( data + layout.entries );
+  mSignatures = (const uint64_t*) ( data + layout.signatures );
+
+  return true;
+}
+
+//-----------------------------------
+
+void tile_segment::close( )
+{
+  mFile.close();
+  mTileX = mTileY = 0;
+  mNbPoints = mNbWords = mNbDescriptors = 0;
+  mPointIds = mViewOffsets = mViewCameras = mWords = mWordOffsets = mEntries = 0;
+  mPositions = 0;
+  mSignatures = 0;
+}
+
+//-----------------------------------
+
+uint64_t tile_segment::size( ) const
+{
+  return mFile.size();
+}
+
+//-----------------------------------
+
+int tile_segment::get_tile_x( ) const
+{
+  return mTileX;
+}
+
+//-----------------------------------
+
+int tile_segment::get_tile_y( ) const
+{
+  return mTileY;
+}
+
+//-----------------------------------
+
+uint32_t tile_segment::get_nb_points( ) const
+{
+  return mNbPoints;
+}
+
+//-----------------------------------
+
+uint32_t tile_segment::get_nb_descriptors( ) const
+{
+  return mNbDescriptors;
+}
+
+//-----------------------------------
+
+const uint32_t* tile_segment::get_point_ids( ) const
+{
+  return mPointIds;
+}
+
+//-----------------------------------
+
+const float* tile_segment::get_positions( ) const
+{
+  return mPositions;
+}
+
+//-----------------------------------
+
+const uint32_t* tile_segment::get_view_offsets( ) const
+{
+  return mViewOffsets;
+}
+
+//-----------------------------------
+
+const uint32_t* tile_segment::get_view_cameras( ) const
+{
+  return mViewCameras;
+}
+
+//-----------------------------------
+
+const uint64_t* tile_segment::get_signatures( ) const
+{
+  return mSignatures;
+}
+
+//-----------------------------------
+
+uint32_t tile_segment::get_entries( uint32_t vw, const uint32_t* &entries ) const
+{
+  const uint32_t *it = std::lower_bound( mWords, mWords + mNbWords, vw );
+  if ( it == mWords + mNbWords || *it != vw )
+  {
+    entries = 0;
+    return 0;
+  }
+  size_t index = it - mWords;
+  entries = mEntries + 2 * (size_t) mWordOffsets[index];
+  return mWordOffsets[index + 1] - mWordOffsets[index];
+}
+
+//-----------------------------------
+
+bool tile_segment::save( const std::string &filename, int tile_x, int tile_y, const std::vector< uint32_t > &point_ids, const std::vector< float > &positions,
+                         const std::vector< uint32_t > &view_offsets, const std::vector< uint32_t > &view_cameras, const std::vector< uint32_t > &words,
+                         const std::vector< uint32_t > &word_offsets, const std::vector< uint32_t > &entries, const std::vector< uint64_t > &signatures )
+{
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::binary );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[tile_segment]: ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+
+  tile_segment_header header;
+  memcpy( header.magic, segment_magic, 8 );
+  header.tile_x = tile_x;
+  header.tile_y = tile_y;
+  header.nb_points = (uint32_t) point_ids.size();
+  header.nb_views = (uint32_t) view_cameras.size();
+  header.nb_words = (uint32_t) words.size();
+  header.nb_entries = (uint32_t) ( entries.size() / 2 );
+  header.nb_descriptors = (uint32_t) signatures.size();
+  header.reserved = 0;
+  tile_segment_layout layout = get_segment_layout( header );
+
+  ofs.write( (const char*) &header, sizeof( tile_segment_header ) );
+  if ( !point_ids.empty() )
+  {
+    ofs.write( (const char*) &point_ids[0], sizeof( uint32_t ) * point_ids.size() );
+    ofs.write( (const char*) &positions[0], sizeof( float ) * positions.size() );
+  }
+  ofs.write( (const char*) &view_offsets[0], sizeof( uint32_t ) * view_offsets.size() );
+  if ( !view_cameras.empty() )
+    ofs.write( (const char*) &view_cameras[0], sizeof( uint32_t ) * view_cameras.size() );
+  if ( !words.empty() )
+    ofs.write( (const char*) &words[0], sizeof( uint32_t ) * words.size() );
+  ofs.write( (const char*) &word_offsets[0], sizeof( uint32_t ) * word_offsets.size() );
+  if ( !entries.empty() )
+    ofs.write( (const char*) &entries[0], sizeof( uint32_t ) * entries.size() );
+  uint64_t padding = layout.signatures - ( layout.entries + sizeof( uint32_t ) * entries.size() );
+  const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  ofs.write( zeros, padding );
+  if ( !signatures.empty() )
+    ofs.write( (const char*) &signatures[0], sizeof( uint64_t ) * signatures.size() );
+
+  if ( !ofs )
+  {
+    std::cerr << "[tile_segment]: ERROR: Could not write " << filename << std::endl;
+    return false;
+  }
+  ofs.close();
+  return true;
+}
+
+//-----------------------------------
+//-----------------------------------
+
+tiled_model::tiled_model( )
+{
+  mMemoryBudget = uint64_t( 1 ) << 30;
+  clear();
+}
+
+//-----------------------------------
+
+tiled_model::~tiled_model( )
+{
+  clear();
+}
+
+//-----------------------------------
+
+bool tiled_model::open( const std::string &index_file )
+{
+  clear();
+
+  std::ifstream ifs( index_file.c_str(), std::ios::in | std::ios::binary );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[tiled_model]: ERROR: Cannot read " << index_file << std::endl;
+    return false;
+  }
+
+  char magic[8];
+  uint32_t nb_cameras = 0, nb_tiles = 0;
+  ifs.read( magic, 8 );
+  ifs.read( (char*) &mNbPoints, sizeof( uint32_t ) );
+  ifs.read( (char*) &nb_cameras, sizeof( uint32_t ) );
+  ifs.read( (char*) &mNbClusters, sizeof( uint32_t ) );
+  ifs.read( (char*) &mNbDescriptors, sizeof( uint32_t ) );
+  ifs.read( (char*) &nb_tiles, sizeof( uint32_t ) );
+  ifs.read( (char*) &mTileSize, sizeof( double ) );
+  if ( !ifs || memcmp( magic, index_magic, 8 ) != 0 )
+  {
+    std::cerr << "[tiled_model]: ERROR: " << index_file << " is not a tile index" << std::endl;
+    clear();
+    return false;
+  }
+
+  mCameraPointCounts.resize( nb_cameras );
+  mTiles.resize( nb_tiles );
+  mThresholds.resize( 64 * (size_t) mNbClusters );
+  mProjection.resize( 64 * 128 );
+  if ( nb_cameras > 0 )
+    ifs.read( (char*) &mCameraPointCounts[0], sizeof( uint32_t ) * nb_cameras );
+  if ( nb_tiles > 0 )
+    ifs.read( (char*) &mTiles[0], sizeof( tile_info ) * nb_tiles );
+  if ( mNbClusters > 0 )
+    ifs.read( (char*) &mThresholds[0], sizeof( float ) * mThresholds.size() );
+  ifs.read( (char*) &mProjection[0], sizeof( float ) * mProjection.size() );
+  if ( !ifs )
+  {
+    std::cerr << "[tiled_model]: ERROR: " << index_file << " is truncated" << std::endl;
+    clear();
+    return false;
+  }
+  ifs.close();
+
+  size_t slash = index_file.find_last_of( '/' );
+  mDirectory = ( slash == std::string::npos ) ? std::string( "." ) : index_file.substr( 0, slash );
+
+  mSegments.assign( nb_tiles, (tile_segment*) 0 );
+  mLRUPositions.assign( nb_tiles, mLRU.end() );
+  mTileStamps.assign( nb_tiles, 0 );
+  return true;
+}
+
+//-----------------------------------
+
+void tiled_model::clear( )
+{
+  for ( size_t i = 0; i < mSegments.size(); ++i )
+  {
+    if ( mSegments[i] != 0 )
+      delete mSegments[i];
+  }
+  mSegments.clear();
+  mLRU.clear();
+  mLRUPositions.clear();
+  mTileStamps.clear();
+  mQueryStamp = 1;
+  mResidentBytes = 0;
+  mNbLoads = mNbHits = mNbEvictions = 0;
+
+  mDirectory = "";
+  mNbPoints = mNbClusters = mNbDescriptors = 0;
+  mTileSize = 1.0;
+  mCameraPointCounts.clear();
+  mTiles.clear();
+  mThresholds.clear();
+  mProjection.clear();
+}
+
+//-----------------------------------
+
+void tiled_model::set_memory_budget( uint64_t budget )
+{
+  mMemoryBudget = budget;
+}
+
+//-----------------------------------
+
+uint32_t tiled_model::get_nb_points( ) const
+{
+  return mNbPoints;
+}
+
+//-----------------------------------
+
+uint32_t tiled_model::get_nb_cameras( ) const
+{
+  return (uint32_t) mCameraPointCounts.size();
+}
+
+//-----------------------------------
+
+uint32_t tiled_model::get_nb_clusters( ) const
+{
+  return mNbClusters;
+}
+
+//-----------------------------------
+
+uint32_t tiled_model::get_nb_descriptors( ) const
+{
+  return mNbDescriptors;
+}
+
+//-----------------------------------
+
+double tiled_model::get_tile_size( ) const
+{
+  return mTileSize;
+}
+
+//-----------------------------------
+
+const std::vector< tile_info >& tiled_model::get_tiles( ) const
+{
+  return mTiles;
+}
+
+//-----------------------------------
+
+const std::vector< uint32_t >& tiled_model::get_camera_point_counts( ) const
+{
+  return mCameraPointCounts;
+}
+
+//-----------------------------------
+
+const std::vector< float >& tiled_model::get_thresholds( ) const
+{
+  return mThresholds;
+}
+
+//-----------------------------------
+
+const std::vector< float >& tiled_model::get_projection( ) const
+{
+  return mProjection;
+}
+
+//-----------------------------------
+
+void tiled_model::select_tiles( double east, double north, double radius, std::vector< uint32_t > &tiles ) const
+{
+  tiles.clear();
+  for ( uint32_t i = 0; i < (uint32_t) mTiles.size(); ++i )
+  {
+    // distance of the center to the closest point of the tile
+    double min_east = mTiles[i].tile_x * mTileSize;
+    double min_north = mTiles[i].tile_y * mTileSize;
+    double d_east = std::max( 0.0, std::max( min_east - east, east - ( min_east + mTileSize ) ) );
+    double d_north = std::max( 0.0, std::max( min_north - north, north - ( min_north + mTileSize ) ) );
+    if ( d_east * d_east + d_north * d_north <= radius * radius )
+      tiles.push_back( i );
+  }
+}
+
+//-----------------------------------
+
+void tiled_model::begin_query( )
+{
+  ++mQueryStamp;
+  if ( mQueryStamp == 0 )
+  {
+    std::fill( mTileStamps.begin(), mTileStamps.end(), 0 );
+    mQueryStamp = 1;
+  }
+}
+
+//-----------------------------------
+
+const tile_segment* tiled_model::acquire( uint32_t tile )
+{
+  mTileStamps[tile] = mQueryStamp;
+
+  if ( mSegments[tile] != 0 )
+  {
+    ++mNbHits;
+    mLRU.erase( mLRUPositions[tile] );
+    mLRU.push_front( tile );
+    mLRUPositions[tile] = mLRU.begin();
+    return mSegments[tile];
+  }
+
+  tile_segment *segment = new tile_segment();
+  if ( !segment->open( get_segment_filename( mDirectory, mTiles[tile].tile_x, mTiles[tile].tile_y ) ) )
+  {
+    delete segment;
+    return 0;
+  }
+
+  ++mNbLoads;
+  mSegments[tile] = segment;
+  mResidentBytes += segment->size();
+  mLRU.push_front( tile );
+  mLRUPositions[tile] = mLRU.begin();
+
+  evict();
+  return segment;
+}
+
+//-----------------------------------
+
+void tiled_model::evict( )
+{
+  std::list< uint32_t >::iterator it = mLRU.end();
+  while ( mResidentBytes > mMemoryBudget && it != mLRU.begin() )
+  {
+    --it;
+    uint32_t tile = *it;
+    // tiles of the current query have to stay valid
+    if ( mTileStamps[tile] == mQueryStamp )
+      continue;
+
+    mResidentBytes -= mSegments[tile]->size();
+    delete mSegments[tile];
+    mSegments[tile] = 0;
+    mLRUPositions[tile] = mLRU.end();
+    it = mLRU.erase( it );
+    ++mNbEvictions;
+  }
+}
+
+//-----------------------------------
+
+void tiled_model::print_statistics( ) const
+{
+  std::cout << "[tiled_model]: " << mLRU.size() << " of " << mTiles.size() << " tiles resident (" << mResidentBytes / ( 1024.0 * 1024.0 ) << " MB of "
+            << mMemoryBudget / ( 1024.0 * 1024.0 ) << " MB), " << mNbLoads << " loads, " << mNbHits << " reuses, " << mNbEvictions << " evictions" << std::endl;
+}
+
+//-----------------------------------
+
+std::string tiled_model::get_segment_filename( const std::string &directory, int tile_x, int tile_y )
+{
+  std::ostringstream s;
+  s << directory << "/tile_" << tile_x << "_" << tile_y << ".seg";
+  return s.str();
+}
+
+//-----------------------------------
+
+bool tiled_model::save_index( const std::string &filename, uint32_t nb_points, uint32_t nb_clusters, uint32_t nb_descriptors, double tile_size,
+                              const std::vector< uint32_t > &camera_point_counts, const std::vector< tile_info > &tiles,
+                              const std::vector< float > &thresholds, const std::vector< float > &projection )
+{
+  std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::binary );
+  if ( !ofs.is_open() )
+  {
+    std::cerr << "[tiled_model]: ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+
+  uint32_t nb_cameras = (uint32_t) camera_point_counts.size();
+  uint32_t nb_tiles = (uint32_t) tiles.size();
+  ofs.write( index_magic, 8 );
+  ofs.write( (const char*) &nb_points, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_cameras, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_clusters, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_descriptors, sizeof( uint32_t ) );
+  ofs.write( (const char*) &nb_tiles, sizeof( uint32_t ) );
+  ofs.write( (const char*) &tile_size, sizeof( double ) );
+  if ( nb_cameras > 0 )
+    ofs.write( (const char*) &camera_point_counts[0], sizeof( uint32_t ) * nb_cameras );
+  if ( nb_tiles > 0 )
+    ofs.write( (const char*) &tiles[0], sizeof( tile_info ) * nb_tiles );
+  if ( !thresholds.empty() )
+    ofs.write( (const char*) &thresholds[0], sizeof( float ) * thresholds.size() );
+  ofs.write( (const char*) &projection[0], sizeof( float ) * projection.size() );
+
+  if ( !ofs )
+  {
+    std::cerr << "[tiled_model]: ERROR: Could not write " << filename << std::endl;
+    return false;
+  }
+  ofs.close();
+  return true;
+}
@@ -0,0 +1,191 @@
+#ifndef TILED_MODEL_HH
+#define TILED_MODEL_HH
+
+/**
+ *    Classes for a model that is partitioned into square spatial tiles by the
+ *    position of its 3D points (in the local metric frame of a georegistration,
+ *    see geo_prior). Every tile is stored as its own binary segment containing
+ *    the points of the tile (global ids, positions, visibility lists), the
+ *    inverted lists restricted to these points and their binary signatures.
+ *    A small index file stores the tile table, the number of points seen by
+ *    every camera and the hamming thresholds and projection matrix.
+ *
+ *    Segments are mapped into memory when a query needs them. tiled_model keeps
+ *    the mapped segments in a least-recently-used list and unmaps segments
+ *    that are not needed by the current query once a memory budget is exceeded.
+ *
+ *    The files are written by tile_localization_model.
+**/
+
+#include <vector>
+#include <list>
+#include <string>
+#include <stdint.h>
+
+#include "mapped_file.hh"
+
+
+/**
+ * Segment of a single tile. Within a tile, points and descriptors are numbered
+ * locally, the entries of the inverted lists are (local point id, local
+ * descriptor id) pairs.
+**/
+class tile_segment
+{
+  public:
+    //! constructor
+    tile_segment( );
+
+    //! destructor
+    ~tile_segment( );
+
+    //! map a segment into memory, returns false if the file is not a valid segment
+    bool open( const std::string &filename );
+
+    //! unmap the segment
+    void close( );
+
+    //! the size of the segment in bytes
+    uint64_t size( ) const;
+
+    int get_tile_x( ) const;
+    int get_tile_y( ) const;
+
+    uint32_t get_nb_points( ) const;
+    uint32_t get_nb_descriptors( ) const;
+
+    //! the global ids of the points
+    const uint32_t* get_point_ids( ) const;
+
+    //! the positions of the points, 3 floats per point
+    const float* get_positions( ) const;
+
+    //! the cameras seeing local point i are get_view_cameras()[get_view_offsets()[i]] to get_view_cameras()[get_view_offsets()[i+1]-1]
+    const uint32_t* get_view_offsets( ) const;
+    const uint32_t* get_view_cameras( ) const;
+
+    //! the signatures of the descriptors, indexed by local descriptor id
+    const uint64_t* get_signatures( ) const;
+
+    //! get the (local point id, local descriptor id) pairs of visual word vw (stored as consecutive uint32_t), returns the number of pairs
+    uint32_t get_entries( uint32_t vw, const uint32_t* &entries ) const;
+
+    //! write a segment
+    static bool save( const std::string &filename, int tile_x, int tile_y, const std::vector< uint32_t > &point_ids, const std::vector< float > &positions,
+                      const std::vector< uint32_t > &view_offsets, const std::vector< uint32_t > &view_cameras, const std::vector< uint32_t > &words,
+                      const std::vector< uint32_t > &word_offsets, const std::vector< uint32_t > &entries, const std::vector< uint64_t > &signatures );
+
+  private:
+    mapped_file mFile;
+
+    int mTileX, mTileY;
+    uint32_t mNbPoints, mNbWords, mNbDescriptors;
+
+    const uint32_t *mPointIds;
+    const float *mPositions;
+    const uint32_t *mViewOffsets;
+    const uint32_t *mViewCameras;
+    const uint32_t *mWords;
+    const uint32_t *mWordOffsets;
+    const uint32_t *mEntries;
+    const uint64_t *mSignatures;
+};
+
+
+/**
+ * Entry of the tile table stored in the index file.
+**/
+struct tile_info
+{
+  int32_t tile_x;
+  int32_t tile_y;
+  uint32_t nb_points;
+  uint32_t nb_entries;
+  uint64_t size;
+};
+
+
+class tiled_model
+{
+  public:
+    //! constructor, the default memory budget for resident tiles is 1GB
+    tiled_model( );
+
+    //! destructor
+    ~tiled_model( );
+
+    //! load the index file, the segments are expected in the same directory
+    bool open( const std::string &index_file );
+
+    //! unmap all segments and clear the index
+    void clear( );
+
+    //! set the maximal number of bytes of mapped segments
+    void set_memory_budget( uint64_t budget );
+
+    uint32_t get_nb_points( ) const;
+    uint32_t get_nb_cameras( ) const;
+    uint32_t get_nb_clusters( ) const;
+    uint32_t get_nb_descriptors( ) const;
+    double get_tile_size( ) const;
+    const std::vector< tile_info >& get_tiles( ) const;
+
+    //! the number of points seen by every camera
+    const std::vector< uint32_t >& get_camera_point_counts( ) const;
+
+    //! the hamming thresholds (64 values per visual word) and the projection matrix (64 x 128, row-major)
+    const std::vector< float >& get_thresholds( ) const;
+    const std::vector< float >& get_projection( ) const;
+
+    //! get the tiles overlapping the circle with the given center and radius (in the local frame)
+    void select_tiles( double east, double north, double radius, std::vector< uint32_t > &tiles ) const;
+
+    //! start a new query, tiles acquired for the previous query may be unmapped from now on
+    void begin_query( );
+
+    //! get a tile, mapping it if necessary. The tile stays valid until the next call of begin_query. Returns 0 if the tile cannot be loaded.
+    const tile_segment* acquire( uint32_t tile );
+
+    //! print the number of loaded, reused and unmapped tiles and the resident memory
+    void print_statistics( ) const;
+
+    //! get the filename of the segment of a tile
+    static std::string get_segment_filename( const std::string &directory, int tile_x, int tile_y );
+
+    //! write an index file
+    static bool save_index( const std::string &filename, uint32_t nb_points, uint32_t nb_clusters, uint32_t nb_descriptors, double tile_size,
+                            const std::vector< uint32_t > &camera_point_counts, const std::vector< tile_info > &tiles,
+                            const std::vector< float > &thresholds, const std::vector< float > &projection );
+
+  private:
+    //! unmap least recently used tiles not needed by the current query until the budget is met
+    void evict( );
+
+    std::string mDirectory;
+
+    uint32_t mNbPoints, mNbClusters, mNbDescriptors;
+    double mTileSize;
+    std::vector< uint32_t > mCameraPointCounts;
+    std::vector< tile_info > mTiles;
+    std::vector< float > mThresholds;
+    std::vector< float > mProjection;
+
+    //! the mapped segments (0 if not resident)
+    std::vector< tile_segment* > mSegments;
+
+    //! resident tiles, most recently used first
+    std::list< uint32_t > mLRU;
+    std::vector< std::list< uint32_t >::iterator > mLRUPositions;
+
+    //! tiles acquired for the current query are marked with mQueryStamp
+    uint32_t mQueryStamp;
+    std::vector< uint32_t > mTileStamps;
+
+    uint64_t mMemoryBudget;
+    uint64_t mResidentBytes;
+
+    // statistics
+    uint64_t mNbLoads, mNbHits, mNbEvictions;
+};
+
+#endif
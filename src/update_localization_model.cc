@@ -0,0 +1,340 @@
+#define __STDC_LIMIT_MACROS
+
+// C++ includes
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// includes for classes dealing with SIFT-features
+#include "features/visual_words_handler.hh"
+#include "features/desc_assignments.hh"
+#include "features/hamming_embedding.hh"
+#include "features/hamming_model.hh"
+#include "features/hamming_delta.hh"
+#include "sfm/parse_bundler.hh"
+#include "sfm/info_delta.hh"
+
+// stopwatch
+#include "timer.hh"
+
+#include "mapped_file.hh"
+
+// words with less new entries are not checked for drift
+const uint32_t min_drift_word_size = 10;
+
+
+////
+// Reads the cameras and points of the .info file delta, the camera ids of the views are changed to
+// ids after the nb_cameras_existing cameras of the model. The data is not parsed otherwise.
+bool read_delta_info( const std::string &delta, int format, uint32_t nb_cameras_existing, std::string &cameras, uint32_t &nb_cameras, std::string &points, uint32_t &nb_points )
+{
+  mapped_file delta_file;
+  if ( !delta_file.open( delta ) )
+    return false;
+
+  const unsigned char *data = delta_file.data();
+  const uint64_t camera_size = info_delta::get_camera_size( format );
+  const uint64_t view_size = info_delta::get_view_size();
+  uint64_t offset = 0;
+  if ( delta_file.size() >= sizeof( uint32_t ) )
+  {
+    memcpy( &nb_cameras, data, sizeof( uint32_t ) );
+    offset = sizeof( uint32_t ) + nb_cameras * camera_size;
+  }
+  if ( offset == 0 || offset + sizeof( uint32_t ) > delta_file.size() )
+  {
+    std::cerr << " ERROR: " << delta << " is truncated" << std::endl;
+    return false;
+  }
+  cameras.assign( (const char*) data + sizeof( uint32_t ), nb_cameras * camera_size );
+  memcpy( &nb_points, data + offset, sizeof( uint32_t ) );
+  offset += sizeof( uint32_t );
+
+  points.clear();
+  points.reserve( delta_file.size() - offset );
+  for ( uint32_t i = 0; i < nb_points; ++i )
+  {
+    uint32_t size_view_list = 0;
+    if ( offset + 3 * sizeof( float ) + sizeof( uint32_t ) > delta_file.size() )
+      break;
+    memcpy( &size_view_list, data + offset + 3 * sizeof( float ), sizeof( uint32_t ) );
+    points.append( (const char*) data + offset, 3 * sizeof( float ) + sizeof( uint32_t ) );
+    offset += 3 * sizeof( float ) + sizeof( uint32_t );
+
+    if ( offset + size_view_list * view_size > delta_file.size() )
+      break;
+    for ( uint32_t j = 0; j < size_view_list; ++j, offset += view_size )
+    {
+      uint32_t cam_id;
+      memcpy( &cam_id, data + offset, sizeof( uint32_t ) );
+      cam_id += nb_cameras_existing;
+      points.append( (const char*) &cam_id, sizeof( uint32_t ) );
+      points.append( (const char*) data + offset + sizeof( uint32_t ), view_size - sizeof( uint32_t ) );
+    }
+  }
+
+  if ( offset != delta_file.size() )
+  {
+    std::cerr << " ERROR: Could not read the points of " << delta << std::endl;
+    return false;
+  }
+  return true;
+}
+
+////
+// The size of a file, -1 if it does not exist.
+int64_t get_file_size( const std::string &filename )
+{
+  struct stat file_stat;
+  if ( stat( filename.c_str(), &file_stat ) != 0 )
+    return -1;
+  return (int64_t) file_stat.st_size;
+}
+
+////
+// Cuts a file back to the size it had before an append, removes it if it did not exist.
+void restore_file( const std::string &filename, int64_t size )
+{
+  bool restored = ( size < 0 ) ? ( remove( filename.c_str() ) == 0 || errno == ENOENT ) : ( truncate( filename.c_str(), (off_t) size ) == 0 );
+  if ( !restored )
+    std::cerr << " ERROR: Could not restore " << filename << ", the model has to be rebuilt" << std::endl;
+}
+
+
+int main (int argc, char **argv)
+{
+  if ( argc < 11 )
+  {
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " -    Appends new 3D points and cameras to an existing model without rebuilding it. Only the         - " << std::endl;
+    std::cout << " -    descriptors of the new points are assigned to visual words and binarized, using the hamming    - " << std::endl;
+    std::cout << " -    thresholds and the projection matrix of the existing model. The model is updated in place:     - " << std::endl;
+    std::cout << " -    the new entries are appended to the file hamming.delta and the new cameras and points as a     - " << std::endl;
+    std::cout << " -    block to the .info file, the readers of both files merge them. Visual words whose thresholds   - " << std::endl;
+    std::cout << " -    do not split the new entries evenly are reported, they can be fixed by a rebuild with          - " << std::endl;
+    std::cout << " -    build_localization_model.                                                                      - " << std::endl;
+    std::cout << " -                                                                                                   - " << std::endl;
+    std::cout << " - usage: update_localization_model hamming bundle bundle_type delta nb_cluster clusters mode        - " << std::endl;
+    std::cout << " -        assignment_type branching paths [drift_threshold] [vocabulary_index]                       - " << std::endl;
+    std::cout << " - Parameters:                                                                                       - " << std::endl;
+    std::cout << " -  argv[1]: The existing model (output of compute_hamming_threshold or build_localization_model)   - " << std::endl;
+    std::cout << " -  argv[2]: The .info file of the existing model, the new cameras and points are appended to it     - " << std::endl;
+    std::cout << " -  argv[3]: The file format of the .info files (0: Bundle2Info, 1: with camera information)         - " << std::endl;
+    std::cout << " -  argv[4]: The .info file containing the new cameras and 3D points. Camera ids refer to the new    - " << std::endl;
+    std::cout << " -           cameras only.                                                                           - " << std::endl;
+    std::cout << " -  argv[5]: The number of visual words                                                              - " << std::endl;
+    std::cout << " -  argv[6]: The visual vocabulary. Each row stores one visual word (as 128 floats)                  - " << std::endl;
+    std::cout << " -  argv[7]: The representative mode (0, 3, 5, 6, 7, see compute_desc_assignments)                   - " << std::endl;
+    std::cout << " -  argv[8]: 0 to use a single kd-tree, 1 to use a vocabulary tree (hkmeans) for the assignments     - " << std::endl;
+    std::cout << " -  argv[9]: The branching factor of the vocabulary tree                                             - " << std::endl;
+    std::cout << " -  argv[10]: The number of paths checked when assigning descriptors to visual words                 - " << std::endl;
+    std::cout << " -  argv[11]: (optional) A visual word is reported if the fraction of its new entries having a bit   - " << std::endl;
+    std::cout << " -            set differs from 0.5 by more than this value for one of the 64 bits (default 0.1)      - " << std::endl;
+    std::cout << " -  argv[12]: (optional) Binary file storing the vocabulary and its search tree, created if needed   - " << std::endl;
+    std::cout << "_______________________________________________________________________________________________________" << std::endl;
+    return -1;
+  }
+
+  ////
+  // get the parameters
+  std::string hamming_file( argv[1] );
+  std::string bundle( argv[2] );
+  int bundle_type = atoi( argv[3] );
+  std::string delta_bundle( argv[4] );
+  uint32_t nb_cluster = (uint32_t) atoi( argv[5] );
+  std::string cluster_file( argv[6] );
+  int mode = atoi( argv[7] );
+  int assignment_type = atoi( argv[8] );
+  int nb_branching = atoi( argv[9] );
+  int nb_paths = atoi( argv[10] );
+  float drift_threshold = 0.1f;
+  if ( argc > 11 )
+    drift_threshold = (float) atof( argv[11] );
+  std::string vocabulary_index_file( "" );
+  if ( argc > 12 )
+    vocabulary_index_file = argv[12];
+
+  if ( !( mode == 0 || mode == 3 || mode == 5 || mode == 6 || mode == 7 ) )
+  {
+    std::cerr << " ERROR: Mode " << mode << " does not store unsigned char descriptors, aborting " << std::endl;
+    return -1;
+  }
+  if ( assignment_type < 0 || assignment_type > 1 )
+  {
+    std::cerr << " ERROR: Unknown type to compute the visual word assignments." << std::endl;
+    return -1;
+  }
+  if ( bundle_type < 0 || bundle_type > 1 )
+  {
+    std::cerr << " ERROR: Unknown file format for the binary .info file." << std::endl;
+    return -1;
+  }
+
+  Timer timer;
+
+  ////
+  // the thresholds and the projection matrix of the existing model, the lists are not needed
+  hamming_embedding embedding;
+  hamming_model model;
+  if ( !model.load_header( hamming_file, embedding ) )
+    return -1;
+  if ( model.get_nb_clusters() != nb_cluster )
+  {
+    std::cerr << " ERROR: The model uses " << model.get_nb_clusters() << " visual words, but " << nb_cluster << " are given" << std::endl;
+    return -1;
+  }
+
+  // the number of cameras and points including earlier updates, read from the end of the .info file
+  uint32_t nb_cameras_base = 0, nb_points_base = 0, nb_cameras_existing = 0, nb_points_existing = 0;
+  if ( !info_delta::get_base_size( bundle, bundle_type, nb_cameras_base, nb_points_base ) || !info_delta::get_size( bundle, bundle_type, nb_cameras_existing, nb_points_existing ) )
+    return -1;
+  if ( nb_points_base != model.get_nb_points() )
+  {
+    std::cerr << " ERROR: The model contains " << model.get_nb_points() << " points, but " << bundle << " contains " << nb_points_base << std::endl;
+    return -1;
+  }
+  std::cout << "-> the model contains " << nb_cameras_existing << " cameras and " << nb_points_existing << " points" << std::endl;
+
+  ////
+  // load the new points
+  std::cout << "-> parsing the new points from " << delta_bundle << std::endl;
+  timer.Init();
+  timer.Start();
+  std::string new_cameras, new_points;
+  uint32_t nb_new_cameras = 0, nb_new_points = 0;
+  if ( !read_delta_info( delta_bundle, bundle_type, nb_cameras_existing, new_cameras, nb_new_cameras, new_points, nb_new_points ) )
+    return -1;
+  parse_bundler parser;
+  if ( !parser.load_from_binary( delta_bundle.c_str(), bundle_type ) )
+    return -1;
+  std::vector< feature_3D_info >& feature_infos = parser.get_feature_infos();
+  timer.Stop();
+  std::cout << "--> parsed " << feature_infos.size() << " points in " << timer.GetElapsedTime() << "s" << std::endl;
+  if ( feature_infos.size() != nb_new_points )
+  {
+    std::cerr << " ERROR: Could not parse the points of " << delta_bundle << std::endl;
+    return -1;
+  }
+
+  ////
+  // assign the new descriptors to visual words
+  visual_words_handler vw_handler;
+  vw_handler.set_nb_trees( 1 );
+  vw_handler.set_nb_visual_words( nb_cluster );
+  vw_handler.set_branching( nb_branching );
+  vw_handler.set_method( std::string( "flann" ) );
+  if ( assignment_type == 0 )
+    vw_handler.set_flann_type( std::string( "randomkd" ) );
+  else
+    vw_handler.set_flann_type( std::string( "hkmeans" ) );
+
+  timer.Init();
+  timer.Start();
+  bool vocabulary_loaded = vocabulary_index_file.empty() ? vw_handler.create_flann_search_index( cluster_file ) : vw_handler.load_trees_flann( cluster_file, vocabulary_index_file );
+  if ( !vocabulary_loaded )
+  {
+    std::cout << " ERROR: Could not load the cluster centers from " << cluster_file << std::endl;;
+    return -1;
+  }
+  timer.Stop();
+  std::cout << "-> built the vocabulary tree in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  timer.Init();
+  timer.Start();
+  std::vector< uint32_t > descriptor_2_vw_assignments;
+  desc_assignments::quantize( feature_infos, vw_handler, assignment_type, nb_paths, nb_cluster, descriptor_2_vw_assignments );
+
+  desc_assignments assignments;
+  if ( !assignments.compute_representatives( feature_infos, descriptor_2_vw_assignments, vw_handler, mode, nb_cluster ) )
+    return -1;
+  timer.Stop();
+  std::cout << "-> assigned the new descriptors to visual words in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  parser.clear();
+
+  ////
+  // binarize the new descriptors with the existing thresholds
+  timer.Init();
+  timer.Start();
+  const unsigned char *descriptors = assignments.get_descriptors();
+  std::vector< uint32_t > entry_words, entry_points;
+  std::vector< uint64_t > entry_signatures;
+
+  // Find the visual words whose thresholds have drifted. The thresholds are the medians of the
+  // projected descriptors, i.e., every bit should be set for half of the new entries of a word.
+  std::vector< std::pair< float, uint32_t > > drifted_words;
+  uint32_t nb_updated_words = 0;
+  for ( uint32_t i = 0; i < nb_cluster; ++i )
+  {
+    uint32_t nb_pairs = assignments.get_nb_assignments( i );
+    if ( nb_pairs == 0 )
+      continue;
+    ++nb_updated_words;
+    const uint32_t *pairs = assignments.get_assignments( i );
+    uint32_t bit_counts[64];
+    for ( int k = 0; k < 64; ++k )
+      bit_counts[k] = 0;
+    for ( uint32_t j = 0; j < nb_pairs; ++j )
+    {
+      uint64_t signature = embedding.compute_signature( descriptors + 128 * (size_t) pairs[2 * j + 1], i );
+      entry_words.push_back( i );
+      entry_points.push_back( nb_points_existing + pairs[2 * j] );
+      entry_signatures.push_back( signature );
+      for ( int k = 0; k < 64; ++k )
+        bit_counts[k] += ( signature >> k ) & 1;
+    }
+    if ( nb_pairs < min_drift_word_size )
+      continue;
+
+    float drift = 0.0f;
+    for ( int k = 0; k < 64; ++k )
+      drift = std::max( drift, fabsf( (float) bit_counts[k] / (float) nb_pairs - 0.5f ) );
+    if ( drift > drift_threshold )
+      drifted_words.push_back( std::make_pair( drift, i ) );
+  }
+  std::sort( drifted_words.rbegin(), drifted_words.rend() );
+  timer.Stop();
+  std::cout << "-> binarized " << entry_signatures.size() << " entries in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  std::cout << "-> " << nb_updated_words << " visual words received new entries, the thresholds of " << drifted_words.size() << " of them have drifted by more than " << drift_threshold << std::endl;
+  for ( size_t i = 0; i < drifted_words.size(); ++i )
+  {
+    uint32_t vw = drifted_words[i].second;
+    std::cout << "  visual word " << vw << ": " << assignments.get_nb_assignments( vw ) << " new entries, drift " << drifted_words[i].first << std::endl;
+  }
+
+  ////
+  // append the new entries and the new cameras and points, both files are restored if one of the appends fails
+  timer.Init();
+  timer.Start();
+  std::string delta_file = hamming_delta::get_filename( hamming_file );
+  int64_t delta_size = get_file_size( delta_file );
+  int64_t bundle_size = get_file_size( bundle );
+  if ( !hamming_delta::append( hamming_file, nb_points_existing, nb_points_existing + nb_new_points, entry_words, entry_points, entry_signatures ) )
+  {
+    restore_file( delta_file, delta_size );
+    return -1;
+  }
+  if ( !info_delta::append( bundle, bundle_type, new_cameras, nb_new_cameras, new_points, nb_new_points ) )
+  {
+    restore_file( delta_file, delta_size );
+    restore_file( bundle, bundle_size );
+    return -1;
+  }
+  timer.Stop();
+  std::cout << "-> appended " << nb_new_cameras << " cameras and " << nb_new_points << " points to " << bundle << " and " << entry_signatures.size()
+            << " entries to " << delta_file << " in " << timer.GetElapsedTime() << "s" << std::endl;
+
+  return 0;
+}
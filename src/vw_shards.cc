@@ -0,0 +1,751 @@
+#define __STDC_LIMIT_MACROS
+
+#include "vw_shards.hh"
+#include "features/hamming_embedding.hh"
+#include "features/hamming_delta.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// types of the messages exchanged between coordinator and shards
+enum shard_message_type
+{
+  SHARD_INFO = 1,
+  SHARD_EMBEDDING = 2,
+  SHARD_MATCH = 3,
+  SHARD_SHUTDOWN = 4,
+  SHARD_ERROR = 5
+};
+
+// every message starts with its type and the number of bytes following the header
+struct shard_message_header
+{
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t size;
+};
+
+// the answer to SHARD_INFO
+struct shard_info_message
+{
+  uint32_t nb_shards;
+  uint32_t shard_id;
+  uint32_t nb_points;
+  uint32_t nb_clusters;
+  uint32_t nb_descriptors;
+  uint32_t nb_entries;
+  uint32_t nb_signatures;
+  uint32_t reserved;
+};
+
+// the header of SHARD_MATCH, followed by nb_queries shard_query
+struct shard_match_request
+{
+  uint32_t threshold;
+  uint32_t nb_queries;
+};
+
+// the header of the answer to SHARD_MATCH, followed by nb_hits shard_hit
+struct shard_match_answer
+{
+  uint64_t nb_scanned;
+  uint32_t nb_hits;
+  uint32_t reserved;
+};
+
+static bool write_all( int fd, const void *data, uint64_t size )
+{
+  const char *ptr = (const char*) data;
+  while ( size > 0 )
+  {
+    ssize_t written = send( fd, ptr, (size_t) size, MSG_NOSIGNAL );
+    if ( written < 0 && errno == EINTR )
+      continue;
+    if ( written <= 0 )
+      return false;
+    ptr += written;
+    size -= (uint64_t) written;
+  }
+  return true;
+}
+
+static bool read_all( int fd, void *data, uint64_t size )
+{
+  char *ptr = (char*) data;
+  while ( size > 0 )
+  {
+    ssize_t nb_read = recv( fd, ptr, (size_t) size, 0 );
+    if ( nb_read < 0 && errno == EINTR )
+      continue;
+    if ( nb_read <= 0 )
+      return false;
+    ptr += nb_read;
+    size -= (uint64_t) nb_read;
+  }
+  return true;
+}
+
+static bool write_message( int fd, uint32_t type, const std::vector< char > &payload )
+{
+  shard_message_header header;
+  header.type = type;
+  header.reserved = 0;
+  header.size = (uint64_t) payload.size();
+  if ( !write_all( fd, &header, sizeof( shard_message_header ) ) )
+    return false;
+  return payload.empty() || write_all( fd, &payload[0], header.size );
+}
+
+static bool read_message( int fd, uint32_t &type, std::vector< char > &payload )
+{
+  shard_message_header header;
+  if ( !read_all( fd, &header, sizeof( shard_message_header ) ) )
+    return false;
+  type = header.type;
+  payload.resize( (size_t) header.size );
+  return payload.empty() || read_all( fd, &payload[0], header.size );
+}
+
+// append the bytes of an object or an array to a message
+static void append( std::vector< char > &payload, const void *data, size_t size )
+{
+  const char *ptr = (const char*) data;
+  payload.insert( payload.end(), ptr, ptr + size );
+}
+
+// fill a sockaddr_un, returns false if the path is too long
+static bool get_socket_address( const std::string &filename, sockaddr_un &address )
+{
+  memset( &address, 0, sizeof( sockaddr_un ) );
+  address.sun_family = AF_UNIX;
+  if ( filename.size() >= sizeof( address.sun_path ) )
+    return false;
+  strncpy( address.sun_path, filename.c_str(), sizeof( address.sun_path ) - 1 );
+  return true;
+}
+
+//---------------------------------------------------
+
+vw_shard::vw_shard( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+vw_shard::~vw_shard( )
+{
+  clear();
+}
+
+//---------------------------------------------------
+
+bool vw_shard::load( const std::string &filename, uint32_t nb_shards, uint32_t shard_id )
+{
+  clear();
+  if ( nb_shards == 0 || shard_id >= nb_shards )
+  {
+    std::cerr << "[vw_shard]: ERROR: Invalid shard " << shard_id << " of " << nb_shards << std::endl;
+    return false;
+  }
+  mNbShards = nb_shards;
+  mShardId = shard_id;
+
+  std::ifstream ifs( filename.c_str(), std::ios::in );
+  if ( !ifs.is_open() )
+  {
+    std::cerr << "[vw_shard]: ERROR: Cannot read " << filename << std::endl;
+    return false;
+  }
+
+  // files in visual word order store the signatures with the entries of the words
+  bool word_order = hamming_embedding::read_word_order_keyword( ifs );
+
+  uint32_t nb_non_empty_vw;
+  ifs >> mNbPoints >> mNbClusters >> nb_non_empty_vw >> mNbDescriptors;
+
+  int num_words, num_dimensions, num_bits;
+  ifs >> num_words >> num_dimensions >> num_bits;
+  if ( num_dimensions != 128 || num_bits != 64 || num_words != (int) mNbClusters )
+  {
+    std::cerr << "[vw_shard]: ERROR: Unsupported hamming file " << filename << " ( " << num_words << " words, " << num_dimensions << " dimensions, " << num_bits << " bits )" << std::endl;
+    clear();
+    return false;
+  }
+
+  // the thresholds and the projection matrix are needed by the coordinator
+  mThresholds.resize( 64 * (size_t) mNbClusters );
+  for ( size_t i = 0; i < mThresholds.size(); ++i )
+    ifs >> mThresholds[i];
+  mProjection.resize( 64 * 128 );
+  for ( size_t i = 0; i < mProjection.size(); ++i )
+    ifs >> mProjection[i];
+
+  // skip the signatures, they are read in a second pass once we know which of them are needed
+  // (their position in signatures is their local descriptor id)
+  std::vector< uint64_t > signatures;
+  std::streampos signatures_start = ifs.tellg();
+  uint64_t signature;
+  for ( uint32_t i = 0; i < mNbDescriptors && !word_order; ++i )
+    ifs >> signature;
+
+  // read the assignments of the visual words of this shard, the descriptor ids are global for now
+  // (in visual word order, the signatures are read directly and the ids are local)
+  uint32_t nb_local_words = ( mNbClusters + mNbShards - 1 - mShardId ) / mNbShards;
+  std::vector< std::vector< uint32_t > > word_entries( nb_local_words );
+  uint32_t pair[2];
+  for ( uint32_t i = 0; i < mNbClusters; ++i )
+  {
+    uint32_t id, nb_pairs;
+    ifs >> id >> nb_pairs;
+    if ( !ifs || id >= mNbClusters )
+    {
+      std::cerr << "[vw_shard]: ERROR: Invalid assignments in " << filename << std::endl;
+      clear();
+      return false;
+    }
+    bool is_local = ( id % mNbShards == mShardId );
+    if ( is_local )
+      word_entries[id / mNbShards].reserve( 2 * nb_pairs );
+    for ( uint32_t j = 0; j < nb_pairs; ++j )
+    {
+      if ( word_order )
+      {
+        ifs >> pair[0] >> signature;
+        pair[1] = (uint32_t) signatures.size();
+        if ( is_local )
+          signatures.push_back( signature );
+      }
+      else
+        ifs >> pair[0] >> pair[1];
+      if ( is_local )
+      {
+        word_entries[id / mNbShards].push_back( pair[0] );
+        word_entries[id / mNbShards].push_back( pair[1] );
+      }
+    }
+  }
+  if ( !ifs )
+  {
+    std::cerr << "[vw_shard]: ERROR: " << filename << " is truncated" << std::endl;
+    clear();
+    return false;
+  }
+
+  if ( !word_order )
+  {
+    // the descriptors referenced by the shard, their position in this list is their local id
+    std::vector< uint32_t > descriptor_ids;
+    for ( uint32_t i = 0; i < nb_local_words; ++i )
+    {
+      for ( size_t j = 1; j < word_entries[i].size(); j += 2 )
+        descriptor_ids.push_back( word_entries[i][j] );
+    }
+    std::sort( descriptor_ids.begin(), descriptor_ids.end() );
+    descriptor_ids.erase( std::unique( descriptor_ids.begin(), descriptor_ids.end() ), descriptor_ids.end() );
+
+    // second pass over the signatures
+    ifs.clear();
+    ifs.seekg( signatures_start );
+    signatures.resize( descriptor_ids.size() );
+    size_t next = 0;
+    for ( uint32_t i = 0; i < mNbDescriptors && next < descriptor_ids.size(); ++i )
+    {
+      ifs >> signature;
+      if ( descriptor_ids[next] == i )
+        signatures[next++] = signature;
+    }
+    if ( !ifs || next != descriptor_ids.size() )
+    {
+      std::cerr << "[vw_shard]: ERROR: Invalid descriptor ids in " << filename << std::endl;
+      clear();
+      return false;
+    }
+
+    // switch to local descriptor ids
+    for ( uint32_t i = 0; i < nb_local_words; ++i )
+    {
+      for ( size_t j = 1; j < word_entries[i].size(); j += 2 )
+        word_entries[i][j] = (uint32_t) ( std::lower_bound( descriptor_ids.begin(), descriptor_ids.end(), word_entries[i][j] ) - descriptor_ids.begin() );
+    }
+  }
+  ifs.close();
+
+  // the entries appended by updates follow the entries of the file, their signatures get new local ids
+  hamming_delta delta;
+  if ( !delta.load( filename, mNbClusters, mNbPoints ) )
+  {
+    clear();
+    return false;
+  }
+  for ( uint32_t i = 0; i < nb_local_words; ++i )
+  {
+    uint32_t vw = i * mNbShards + mShardId;
+    const uint32_t *points = delta.get_points( vw );
+    const uint64_t *delta_signatures = delta.get_signatures( vw );
+    for ( uint32_t j = 0; j < delta.get_nb_entries( vw ); ++j )
+    {
+      word_entries[i].push_back( points[j] );
+      word_entries[i].push_back( (uint32_t) signatures.size() );
+      signatures.push_back( delta_signatures[j] );
+    }
+  }
+  mNbPoints = delta.get_nb_points();
+  mNbDescriptors += delta.get_nb_entries();
+
+  // store the lists in an inverted file, such that the entries of a word are scanned in the same order as by
+  // the inverted file of a single process (grouped by signature, sorted by point id)
+  mLists.init( nb_local_words );
+  std::vector< std::pair< uint32_t, uint32_t > > pairs;
+  for ( uint32_t i = 0; i < nb_local_words; ++i )
+  {
+    pairs.resize( word_entries[i].size() / 2 );
+    for ( size_t j = 0; j < pairs.size(); ++j )
+      pairs[j] = std::make_pair( word_entries[i][2 * j], word_entries[i][2 * j + 1] );
+    std::vector< uint32_t >().swap( word_entries[i] );
+    if ( !mLists.add_list( i, pairs, signatures ) )
+    {
+      clear();
+      return false;
+    }
+  }
+  mLists.finalize();
+
+  return true;
+}
+
+//---------------------------------------------------
+
+void vw_shard::clear( )
+{
+  mNbShards = 1;
+  mShardId = 0;
+  mNbPoints = mNbClusters = mNbDescriptors = 0;
+  mThresholds.clear();
+  mProjection.clear();
+  mLists.clear();
+}
+
+//---------------------------------------------------
+
+uint64_t vw_shard::match( const std::vector< shard_query > &queries, uint32_t threshold, std::vector< shard_hit > &hits ) const
+{
+  uint64_t nb_scanned = 0;
+  shard_hit hit;
+  std::vector< std::pair< uint32_t, uint32_t > > list_hits;
+  for ( size_t i = 0; i < queries.size(); ++i )
+  {
+    uint32_t local_vw = queries[i].vw / mNbShards;
+    if ( queries[i].vw % mNbShards != mShardId || local_vw >= mLists.get_nb_clusters() )
+      continue;
+
+    list_hits.clear();
+    nb_scanned += mLists.scan( local_vw, queries[i].signature, threshold, list_hits );
+    hit.keypoint = queries[i].keypoint;
+    for ( size_t j = 0; j < list_hits.size(); ++j )
+    {
+      hit.point = list_hits[j].first;
+      hit.distance = list_hits[j].second;
+      hits.push_back( hit );
+    }
+  }
+  return nb_scanned;
+}
+
+//---------------------------------------------------
+
+bool vw_shard::serve( const std::string &socket_filename )
+{
+  sockaddr_un address;
+  if ( !get_socket_address( socket_filename, address ) )
+  {
+    std::cerr << "[vw_shard]: ERROR: The socket name " << socket_filename << " is too long" << std::endl;
+    return false;
+  }
+
+  int server = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( server < 0 )
+  {
+    std::cerr << "[vw_shard]: ERROR: Cannot create a socket" << std::endl;
+    return false;
+  }
+  // remove the socket of a previous run
+  unlink( socket_filename.c_str() );
+  if ( bind( server, (sockaddr*) &address, sizeof( sockaddr_un ) ) != 0 || listen( server, 4 ) != 0 )
+  {
+    std::cerr << "[vw_shard]: ERROR: Cannot listen on " << socket_filename << std::endl;
+    ::close( server );
+    return false;
+  }
+  std::cout << "[vw_shard]: shard " << mShardId << " of " << mNbShards << " listening on " << socket_filename << std::endl;
+
+  bool running = true;
+  while ( running )
+  {
+    int fd = accept( server, 0, 0 );
+    if ( fd < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+      std::cerr << "[vw_shard]: ERROR: accept failed on " << socket_filename << std::endl;
+      break;
+    }
+    running = serve_connection( fd );
+    ::close( fd );
+  }
+
+  ::close( server );
+  unlink( socket_filename.c_str() );
+  return !running;
+}
+
+//---------------------------------------------------
+
+bool vw_shard::serve_connection( int fd )
+{
+  uint32_t type;
+  std::vector< char > request, answer;
+  std::vector< shard_query > queries;
+  std::vector< shard_hit > hits;
+
+  while ( read_message( fd, type, request ) )
+  {
+    answer.clear();
+    if ( type == SHARD_INFO )
+    {
+      shard_info_message info;
+      info.nb_shards = mNbShards;
+      info.shard_id = mShardId;
+      info.nb_points = mNbPoints;
+      info.nb_clusters = mNbClusters;
+      info.nb_descriptors = mNbDescriptors;
+      info.nb_entries = get_nb_entries();
+      info.nb_signatures = get_nb_signatures();
+      info.reserved = 0;
+      append( answer, &info, sizeof( shard_info_message ) );
+    }
+    else if ( type == SHARD_EMBEDDING )
+    {
+      append( answer, &mThresholds[0], sizeof( float ) * mThresholds.size() );
+      append( answer, &mProjection[0], sizeof( float ) * mProjection.size() );
+    }
+    else if ( type == SHARD_MATCH && request.size() >= sizeof( shard_match_request ) )
+    {
+      shard_match_request header;
+      memcpy( &header, &request[0], sizeof( shard_match_request ) );
+      if ( request.size() != sizeof( shard_match_request ) + sizeof( shard_query ) * (size_t) header.nb_queries )
+      {
+        write_message( fd, SHARD_ERROR, answer );
+        return true;
+      }
+      queries.resize( header.nb_queries );
+      if ( header.nb_queries > 0 )
+        memcpy( &queries[0], &request[sizeof( shard_match_request )], sizeof( shard_query ) * queries.size() );
+
+      hits.clear();
+      shard_match_answer result;
+      result.nb_scanned = match( queries, header.threshold, hits );
+      result.nb_hits = (uint32_t) hits.size();
+      result.reserved = 0;
+      append( answer, &result, sizeof( shard_match_answer ) );
+      if ( !hits.empty() )
+        append( answer, &hits[0], sizeof( shard_hit ) * hits.size() );
+    }
+    else if ( type == SHARD_SHUTDOWN )
+    {
+      write_message( fd, SHARD_SHUTDOWN, answer );
+      return false;
+    }
+    else
+    {
+      write_message( fd, SHARD_ERROR, answer );
+      return true;
+    }
+
+    if ( !write_message( fd, type, answer ) )
+      return true;
+  }
+  return true;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_shard::get_nb_shards( ) const
+{
+  return mNbShards;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_shard::get_shard_id( ) const
+{
+  return mShardId;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_shard::get_nb_entries( ) const
+{
+  return mLists.get_nb_entries();
+}
+
+//---------------------------------------------------
+
+uint32_t vw_shard::get_nb_signatures( ) const
+{
+  return mLists.get_nb_codes();
+}
+
+//---------------------------------------------------
+
+std::string vw_shard::get_socket_filename( const std::string &prefix, uint32_t shard_id )
+{
+  std::stringstream s;
+  s << prefix << "_" << shard_id << ".sock";
+  return s.str();
+}
+
+//---------------------------------------------------
+
+vw_shard_coordinator::vw_shard_coordinator( )
+{
+  mNbPoints = mNbClusters = mNbDescriptors = 0;
+}
+
+//---------------------------------------------------
+
+vw_shard_coordinator::~vw_shard_coordinator( )
+{
+  disconnect();
+}
+
+//---------------------------------------------------
+
+bool vw_shard_coordinator::connect( const std::string &prefix, uint32_t nb_shards )
+{
+  disconnect();
+
+  std::vector< char > request, answer;
+  uint32_t type;
+  for ( uint32_t i = 0; i < nb_shards; ++i )
+  {
+    std::string filename = vw_shard::get_socket_filename( prefix, i );
+    sockaddr_un address;
+    int fd = -1;
+    if ( get_socket_address( filename, address ) )
+      fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 || ::connect( fd, (sockaddr*) &address, sizeof( sockaddr_un ) ) != 0 )
+    {
+      std::cerr << "[vw_shard_coordinator]: ERROR: Cannot connect to shard " << i << " at " << filename << std::endl;
+      if ( fd >= 0 )
+        ::close( fd );
+      disconnect();
+      return false;
+    }
+    mSockets.push_back( fd );
+
+    // check that all shards belong to the same model and partition
+    shard_info_message info;
+    if ( !write_message( fd, SHARD_INFO, request ) || !read_message( fd, type, answer ) || type != SHARD_INFO || answer.size() != sizeof( shard_info_message ) )
+    {
+      std::cerr << "[vw_shard_coordinator]: ERROR: Shard " << i << " does not answer" << std::endl;
+      disconnect();
+      return false;
+    }
+    memcpy( &info, &answer[0], sizeof( shard_info_message ) );
+    if ( info.nb_shards != nb_shards || info.shard_id != i )
+    {
+      std::cerr << "[vw_shard_coordinator]: ERROR: " << filename << " serves shard " << info.shard_id << " of " << info.nb_shards << ", expected shard " << i << " of " << nb_shards << std::endl;
+      disconnect();
+      return false;
+    }
+    if ( i > 0 && ( info.nb_points != mNbPoints || info.nb_clusters != mNbClusters || info.nb_descriptors != mNbDescriptors ) )
+    {
+      std::cerr << "[vw_shard_coordinator]: ERROR: Shard " << i << " was loaded from a different model than shard 0" << std::endl;
+      disconnect();
+      return false;
+    }
+    mNbPoints = info.nb_points;
+    mNbClusters = info.nb_clusters;
+    mNbDescriptors = info.nb_descriptors;
+    mShardEntries.push_back( info.nb_entries );
+    mShardSignatures.push_back( info.nb_signatures );
+  }
+
+  // every shard holds the thresholds and the projection matrix, get them from the first one
+  size_t nb_thresholds = 64 * (size_t) mNbClusters;
+  if ( !write_message( mSockets[0], SHARD_EMBEDDING, request ) || !read_message( mSockets[0], type, answer ) || type != SHARD_EMBEDDING
+       || answer.size() != sizeof( float ) * ( nb_thresholds + 64 * 128 ) )
+  {
+    std::cerr << "[vw_shard_coordinator]: ERROR: Cannot get the hamming thresholds from shard 0" << std::endl;
+    disconnect();
+    return false;
+  }
+  mThresholds.resize( nb_thresholds );
+  mProjection.resize( 64 * 128 );
+  memcpy( &mThresholds[0], &answer[0], sizeof( float ) * nb_thresholds );
+  memcpy( &mProjection[0], &answer[sizeof( float ) * nb_thresholds], sizeof( float ) * 64 * 128 );
+
+  mShardQueries.resize( nb_shards );
+  mScannedEntries.assign( nb_shards, 0 );
+  return true;
+}
+
+//---------------------------------------------------
+
+void vw_shard_coordinator::disconnect( )
+{
+  for ( size_t i = 0; i < mSockets.size(); ++i )
+    ::close( mSockets[i] );
+  mSockets.clear();
+  mShardEntries.clear();
+  mShardSignatures.clear();
+  mShardQueries.clear();
+  mScannedEntries.clear();
+}
+
+//---------------------------------------------------
+
+void vw_shard_coordinator::shutdown( )
+{
+  std::vector< char > request, answer;
+  uint32_t type;
+  for ( size_t i = 0; i < mSockets.size(); ++i )
+  {
+    if ( write_message( mSockets[i], SHARD_SHUTDOWN, request ) )
+      read_message( mSockets[i], type, answer );
+  }
+  disconnect();
+}
+
+//---------------------------------------------------
+
+uint32_t vw_shard_coordinator::get_nb_points( ) const
+{
+  return mNbPoints;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_shard_coordinator::get_nb_clusters( ) const
+{
+  return mNbClusters;
+}
+
+//---------------------------------------------------
+
+uint32_t vw_shard_coordinator::get_nb_descriptors( ) const
+{
+  return mNbDescriptors;
+}
+
+//---------------------------------------------------
+
+const std::vector< float >& vw_shard_coordinator::get_thresholds( ) const
+{
+  return mThresholds;
+}
+
+//---------------------------------------------------
+
+const std::vector< float >& vw_shard_coordinator::get_projection( ) const
+{
+  return mProjection;
+}
+
+//---------------------------------------------------
+
+// sort the queries sent to a shard by visual word, such that every list is accessed in one go
+static bool compare_query_word( const shard_query &a, const shard_query &b )
+{
+  return ( a.vw < b.vw ) || ( a.vw == b.vw && a.keypoint < b.keypoint );
+}
+
+static bool compare_hit_keypoint( const shard_hit &a, const shard_hit &b )
+{
+  return a.keypoint < b.keypoint;
+}
+
+bool vw_shard_coordinator::match( const std::vector< shard_query > &queries, uint32_t threshold, std::vector< shard_hit > &hits )
+{
+  hits.clear();
+  uint32_t nb_shards = (uint32_t) mSockets.size();
+  if ( nb_shards == 0 )
+    return false;
+
+  // scatter: all requests are sent before any answer is read, such that the shards work in parallel
+  for ( uint32_t i = 0; i < nb_shards; ++i )
+    mShardQueries[i].clear();
+  for ( size_t i = 0; i < queries.size(); ++i )
+    mShardQueries[queries[i].vw % nb_shards].push_back( queries[i] );
+
+  std::vector< char > payload;
+  for ( uint32_t i = 0; i < nb_shards; ++i )
+  {
+    std::sort( mShardQueries[i].begin(), mShardQueries[i].end(), compare_query_word );
+    shard_match_request header;
+    header.threshold = threshold;
+    header.nb_queries = (uint32_t) mShardQueries[i].size();
+    payload.clear();
+    append( payload, &header, sizeof( shard_match_request ) );
+    if ( !mShardQueries[i].empty() )
+      append( payload, &mShardQueries[i][0], sizeof( shard_query ) * mShardQueries[i].size() );
+    if ( !write_message( mSockets[i], SHARD_MATCH, payload ) )
+    {
+      std::cerr << "[vw_shard_coordinator]: ERROR: Cannot send the queries to shard " << i << std::endl;
+      return false;
+    }
+  }
+
+  // gather
+  uint32_t type;
+  for ( uint32_t i = 0; i < nb_shards; ++i )
+  {
+    if ( !read_message( mSockets[i], type, payload ) || type != SHARD_MATCH || payload.size() < sizeof( shard_match_answer ) )
+    {
+      std::cerr << "[vw_shard_coordinator]: ERROR: Shard " << i << " did not answer the queries" << std::endl;
+      return false;
+    }
+    shard_match_answer result;
+    memcpy( &result, &payload[0], sizeof( shard_match_answer ) );
+    if ( payload.size() != sizeof( shard_match_answer ) + sizeof( shard_hit ) * (size_t) result.nb_hits )
+    {
+      std::cerr << "[vw_shard_coordinator]: ERROR: Invalid answer of shard " << i << std::endl;
+      return false;
+    }
+    mScannedEntries[i] = result.nb_scanned;
+    size_t offset = hits.size();
+    hits.resize( offset + result.nb_hits );
+    if ( result.nb_hits > 0 )
+      memcpy( &hits[offset], &payload[sizeof( shard_match_answer )], sizeof( shard_hit ) * (size_t) result.nb_hits );
+  }
+
+  // every keypoint is assigned to a single word and thus answered by a single shard, sorting stably by
+  // keypoint restores the order of a single process
+  std::stable_sort( hits.begin(), hits.end(), compare_hit_keypoint );
+  return true;
+}
+
+//---------------------------------------------------
+
+const std::vector< uint64_t >& vw_shard_coordinator::get_scanned_entries( ) const
+{
+  return mScannedEntries;
+}
+
+//---------------------------------------------------
+
+void vw_shard_coordinator::print_statistics( ) const
+{
+  for ( size_t i = 0; i < mSockets.size(); ++i )
+    std::cout << "[vw_shard_coordinator]: shard " << i << " holds " << mShardEntries[i] << " entries and " << mShardSignatures[i] << " signatures" << std::endl;
+}
@@ -0,0 +1,162 @@
+#ifndef VW_SHARDS_HH
+#define VW_SHARDS_HH
+
+/**
+ *    Classes to distribute the inverted lists and the binary signatures of a
+ *    model over several processes. The visual words are partitioned by their
+ *    id (word vw belongs to shard vw % nb_shards), every shard process only
+ *    keeps the lists of its words and the signatures referenced by them.
+ *
+ *    A coordinator sends the signatures of the query features, sorted by
+ *    visual word, to the shards holding their words and gathers the
+ *    (keypoint, 3D point, hamming distance) pairs within the distance
+ *    threshold. The shards are reached over Unix domain sockets, shard i of a
+ *    deployment listens on <prefix>_<i>.sock. Messages are written in the
+ *    native byte order, i.e., the shards have to run on machines with the same
+ *    architecture as the coordinator.
+ *
+ *    The shard processes are started by match_shard_server.
+**/
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "features/inverted_file.hh"
+
+
+//! the signature of a query feature and the visual word it is assigned to
+struct shard_query
+{
+  uint32_t keypoint;
+  uint32_t vw;
+  uint64_t signature;
+};
+
+//! a database entry within the hamming distance threshold of a query feature
+struct shard_hit
+{
+  uint32_t keypoint;
+  uint32_t point;
+  uint32_t distance;
+};
+
+
+/**
+ * A single shard, holding the inverted lists of the visual words vw with vw % nb_shards == shard_id.
+**/
+class vw_shard
+{
+  public:
+    //! constructor
+    vw_shard( );
+
+    //! destructor
+    ~vw_shard( );
+
+    /**
+     * Load the part of a model written by compute_hamming_threshold that belongs to the shard.
+     * The file is read twice such that the signatures of the other shards are never kept in memory.
+    **/
+    bool load( const std::string &filename, uint32_t nb_shards, uint32_t shard_id );
+
+    //! clears all data
+    void clear( );
+
+    /**
+     * Find the entries within the hamming distance threshold of the queries (all of them have to belong
+     * to the shard). For every query, the hits are appended in the order of the inverted list, which
+     * is the order of basic_inverted_file::scan in a single process.
+     * Returns the number of scanned entries.
+    **/
+    uint64_t match( const std::vector< shard_query > &queries, uint32_t threshold, std::vector< shard_hit > &hits ) const;
+
+    /**
+     * Listen on the given socket and answer the requests of coordinators until a shutdown
+     * request is received. Connections are served one after the other.
+    **/
+    bool serve( const std::string &socket_filename );
+
+    uint32_t get_nb_shards( ) const;
+    uint32_t get_shard_id( ) const;
+    uint32_t get_nb_entries( ) const;
+    //! the number of distinct signatures per list, summed over the lists of the shard
+    uint32_t get_nb_signatures( ) const;
+
+    //! get the name of the socket of a shard
+    static std::string get_socket_filename( const std::string &prefix, uint32_t shard_id );
+
+  private:
+    //! answer the requests of a single connection, returns false if a shutdown was requested
+    bool serve_connection( int fd );
+
+    uint32_t mNbShards, mShardId;
+
+    // the header of the model
+    uint32_t mNbPoints, mNbClusters, mNbDescriptors;
+    std::vector< float > mThresholds;
+    std::vector< float > mProjection;
+
+    //! the lists of the shard, the list of visual word vw is the list vw / mNbShards, storing global 3D point ids
+    basic_inverted_file< 64 > mLists;
+};
+
+
+/**
+ * Coordinator connected to all shards of a deployment.
+**/
+class vw_shard_coordinator
+{
+  public:
+    //! constructor
+    vw_shard_coordinator( );
+
+    //! destructor, closes the connections
+    ~vw_shard_coordinator( );
+
+    //! connect to the shards <prefix>_0.sock to <prefix>_<nb_shards-1>.sock and check that they belong to the same model
+    bool connect( const std::string &prefix, uint32_t nb_shards );
+
+    //! close the connections
+    void disconnect( );
+
+    //! ask the shards to terminate
+    void shutdown( );
+
+    uint32_t get_nb_points( ) const;
+    uint32_t get_nb_clusters( ) const;
+    uint32_t get_nb_descriptors( ) const;
+
+    //! the hamming thresholds (64 values per visual word) and the projection matrix (64 x 128, row-major)
+    const std::vector< float >& get_thresholds( ) const;
+    const std::vector< float >& get_projection( ) const;
+
+    /**
+     * Send the queries to the shards holding their visual words and gather the hits. The hits are
+     * returned in the order of the keypoints and, for each keypoint, in the order of the inverted list,
+     * i.e., in the same order in which a single process scanning the whole model would find them.
+    **/
+    bool match( const std::vector< shard_query > &queries, uint32_t threshold, std::vector< shard_hit > &hits );
+
+    //! the number of entries scanned by each shard during the last call of match
+    const std::vector< uint64_t >& get_scanned_entries( ) const;
+
+    //! print the number of entries and signatures held by every shard
+    void print_statistics( ) const;
+
+  private:
+    std::vector< int > mSockets;
+
+    uint32_t mNbPoints, mNbClusters, mNbDescriptors;
+    std::vector< float > mThresholds;
+    std::vector< float > mProjection;
+
+    std::vector< uint32_t > mShardEntries;
+    std::vector< uint32_t > mShardSignatures;
+
+    // buffers reused between queries
+    std::vector< std::vector< shard_query > > mShardQueries;
+    std::vector< uint64_t > mScannedEntries;
+};
+
+#endif
@@ -0,0 +1,168 @@
+// C++ includes
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "features/hamming_signature.hh"
+#include "features/inverted_file.hh"
+
+/**
+ *    Checks that the linear scan and the multi-index of basic_inverted_file
+ *    find the same entries as a brute force comparison of the query to every
+ *    (3D point id, signature) pair of a visual word, for 32, 64 and 128 bit
+ *    signatures. The words are empty, hold a single entry, share one code
+ *    between all entries or draw their codes from pools of duplicates around a
+ *    few centers, and are queried with hamming thresholds from 0 upwards.
+**/
+
+typedef std::vector< std::pair< uint32_t, uint32_t > > hit_list;
+
+////
+// A random signature.
+template< int nb_bits >
+typename hamming_signature< nb_bits >::type random_signature( )
+{
+  typename hamming_signature< nb_bits >::type signature = typename hamming_signature< nb_bits >::type();
+  for ( uint32_t k = 0; k < (uint32_t) nb_bits; ++k )
+    if ( rand() & 1 )
+      set_signature_bit( signature, k );
+  return signature;
+}
+
+////
+// A signature that differs from the given one in at most nb_flips bits.
+template< int nb_bits >
+typename hamming_signature< nb_bits >::type perturb_signature( typename hamming_signature< nb_bits >::type signature, int nb_flips )
+{
+  for ( int i = 0; i < nb_flips; ++i )
+  {
+    typename hamming_signature< nb_bits >::type bit = typename hamming_signature< nb_bits >::type();
+    set_signature_bit( bit, (uint32_t) ( rand() % nb_bits ) );
+    signature = signature ^ bit;
+  }
+  return signature;
+}
+
+////
+// Runs the comparison for one number of bits, returns false on the first difference.
+template< int nb_bits >
+bool test_scans( )
+{
+  typedef typename hamming_signature< nb_bits >::type signature_t;
+
+  // word 0 is empty, word 1 holds a single entry, all entries of word 2 share one code, words 3 to 5 draw
+  // their codes from pools around a few centers, such that codes are shared by several entries
+  const uint32_t nb_clusters = 6;
+  const uint32_t nb_entries[nb_clusters] = { 0, 1, 300, 40, 2000, 20000 };
+  std::vector< signature_t > signatures;
+  std::vector< std::vector< std::pair< uint32_t, uint32_t > > > pairs( nb_clusters );
+  std::vector< std::vector< signature_t > > centers( nb_clusters );
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    centers[vw].push_back( random_signature< nb_bits >() );
+    for ( uint32_t i = 1; i < 4 && vw >= 3; ++i )
+      centers[vw].push_back( random_signature< nb_bits >() );
+    std::vector< signature_t > pool;
+    for ( uint32_t i = 0; i < ( vw >= 3 ? nb_entries[vw] / 3 : 1 ); ++i )
+      pool.push_back( perturb_signature< nb_bits >( centers[vw][rand() % centers[vw].size()], rand() % ( nb_bits / 4 ) ) );
+    for ( uint32_t i = 0; i < nb_entries[vw]; ++i )
+    {
+      // points may have several entries in a word
+      uint32_t point = (uint32_t) ( rand() % 5000 );
+      pairs[vw].push_back( std::make_pair( point, (uint32_t) signatures.size() ) );
+      signatures.push_back( pool[rand() % pool.size()] );
+    }
+  }
+
+  basic_inverted_file< nb_bits > lists;
+  lists.init( nb_clusters );
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+    if ( !lists.add_list( vw, pairs[vw], signatures ) )
+      return false;
+  lists.finalize();
+
+  const uint32_t thresholds[5] = { 0, 2, nb_bits / 16, nb_bits / 8, nb_bits / 4 };
+  uint32_t nb_indexed_scans = 0;
+  for ( int t = 0; t < 5; ++t )
+  {
+    lists.build_multi_index( thresholds[t], 1 );
+    for ( uint32_t q = 0; q < 300; ++q )
+    {
+      uint32_t vw = (uint32_t) ( rand() % nb_clusters );
+      signature_t query = random_signature< nb_bits >();
+      if ( vw > 0 && q % 3 != 0 )
+      {
+        // queries close to or at an entry of the word
+        const signature_t &entry = signatures[pairs[vw][rand() % pairs[vw].size()].second];
+        query = perturb_signature< nb_bits >( entry, ( q % 3 == 1 ) ? 0 : (int) ( rand() % ( thresholds[t] + 2 ) ) );
+      }
+
+      hit_list expected;
+      for ( size_t i = 0; i < pairs[vw].size(); ++i )
+      {
+        uint32_t distance = hamming_distance( query, signatures[pairs[vw][i].second] );
+        if ( distance <= thresholds[t] )
+          expected.push_back( std::make_pair( pairs[vw][i].first, distance ) );
+      }
+      std::sort( expected.begin(), expected.end() );
+
+      hit_list linear;
+      uint32_t nb_scanned = lists.scan_linear( vw, query, thresholds[t], linear );
+      hit_list sorted_linear( linear );
+      std::sort( sorted_linear.begin(), sorted_linear.end() );
+      if ( sorted_linear != expected || nb_scanned != pairs[vw].size() )
+      {
+        std::cerr << " ERROR: " << nb_bits << " bits: the linear scan of visual word " << vw << " with threshold " << thresholds[t]
+                  << " finds " << linear.size() << " instead of " << expected.size() << " entries" << std::endl;
+        return false;
+      }
+
+      hit_list hits;
+      lists.scan( vw, query, thresholds[t], hits );
+      if ( hits != linear )
+      {
+        std::cerr << " ERROR: " << nb_bits << " bits: scan and the linear scan of visual word " << vw << " differ" << std::endl;
+        return false;
+      }
+      if ( !lists.has_multi_index( vw ) )
+        continue;
+
+      // the multi-index reports the entries in the same order as the linear scan
+      hits.clear();
+      lists.scan_multi_index( vw, query, hits );
+      ++nb_indexed_scans;
+      if ( hits != linear )
+      {
+        std::cerr << " ERROR: " << nb_bits << " bits: the multi-index of visual word " << vw << " with threshold " << thresholds[t]
+                  << " finds " << hits.size() << " instead of " << linear.size() << " entries" << std::endl;
+        return false;
+      }
+    }
+  }
+  if ( nb_indexed_scans == 0 )
+  {
+    std::cerr << " ERROR: " << nb_bits << " bits: no visual word was indexed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+int main( )
+{
+  srand( 42 );
+  bool passed = true;
+  bool result = test_scans< 32 >();
+  std::cout << "32 bits: " << ( result ? "passed" : "FAILED" ) << std::endl;
+  passed = passed && result;
+  result = test_scans< 64 >();
+  std::cout << "64 bits: " << ( result ? "passed" : "FAILED" ) << std::endl;
+  passed = passed && result;
+  result = test_scans< 128 >();
+  std::cout << "128 bits: " << ( result ? "passed" : "FAILED" ) << std::endl;
+  passed = passed && result;
+  return passed ? 0 : 1;
+}
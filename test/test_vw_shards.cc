@@ -0,0 +1,178 @@
+// C++ includes
+#include <vector>
+#include <iostream>
+#include <string>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "features/hamming_embedding.hh"
+#include "features/hamming_model.hh"
+#include "features/hamming_delta.hh"
+#include "features/inverted_file.hh"
+#include "vw_shards.hh"
+
+/**
+ *    Checks that sharded matching finds the same correspondences in the same
+ *    order as a single process: a random model with duplicate signatures,
+ *    points with several entries per word and entries appended by an update
+ *    is written in both file layouts, loaded into the inverted file of the
+ *    localizer and into 1 to 4 shards, and the hits of random queries are
+ *    compared for several hamming thresholds.
+**/
+
+const uint32_t nb_clusters = 13;
+const uint32_t nb_points = 400;
+const uint32_t nb_new_points = 50;
+
+////
+// A random 64 bit signature.
+uint64_t random_signature( )
+{
+  uint64_t signature = 0;
+  for ( int i = 0; i < 4; ++i )
+    signature = ( signature << 16 ) | (uint64_t) ( rand() & 0xFFFF );
+  return signature;
+}
+
+////
+// A signature that differs from the given one in a random number of bits.
+uint64_t perturb_signature( uint64_t signature )
+{
+  int nb_flips = rand() % 20;
+  for ( int i = 0; i < nb_flips; ++i )
+    signature ^= (uint64_t) 1 << ( rand() % 64 );
+  return signature;
+}
+
+////
+// Writes a random model with a delta file to filename, in visual word or descriptor order, and returns the
+// signatures drawn for every word (to derive queries from).
+bool write_model( const std::string &filename, bool word_order, std::vector< std::vector< uint64_t > > &word_signatures )
+{
+  hamming_model model;
+  model.set_nb_clusters( nb_clusters );
+  model.set_nb_points( nb_points );
+  word_signatures.assign( nb_clusters, std::vector< uint64_t >() );
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    // every word draws its signatures from a small pool, such that codes are shared by several entries
+    uint32_t nb_entries = ( vw == 3 ) ? 0 : (uint32_t) ( rand() % 120 );
+    uint32_t pool_size = 1 + (uint32_t) ( rand() % 30 );
+    for ( uint32_t i = 0; i < pool_size; ++i )
+      word_signatures[vw].push_back( random_signature() );
+    for ( uint32_t i = 0; i < nb_entries; ++i )
+    {
+      uint32_t point = (uint32_t) ( rand() % nb_points );
+      model.add_assignment( vw, point, model.add_descriptor( word_signatures[vw][rand() % pool_size] ) );
+    }
+  }
+
+  hamming_embedding embedding;
+  embedding.set_thresholds( hamming_embedding::threshold_matrix_t::Zero( 64, nb_clusters ) );
+  embedding.set_projection_matrix( hamming_embedding::projection_matrix_t::Zero() );
+  unlink( hamming_delta::get_filename( filename ).c_str() );
+  if ( !embedding.save( filename, model, model.get_signatures(), word_order ) )
+    return false;
+
+  // an update appending entries of new points
+  std::vector< uint32_t > words, points;
+  std::vector< uint64_t > signatures;
+  for ( uint32_t i = 0; i < 200; ++i )
+  {
+    uint32_t vw = (uint32_t) ( rand() % nb_clusters );
+    words.push_back( vw );
+    points.push_back( nb_points + (uint32_t) ( rand() % nb_new_points ) );
+    signatures.push_back( word_signatures[vw][rand() % word_signatures[vw].size()] );
+  }
+  return hamming_delta::append( filename, nb_points, nb_points + nb_new_points, words, points, signatures );
+}
+
+////
+// Compares the hits of the shards to those of the inverted file built like in the localizer.
+bool compare( const std::string &filename, const std::vector< std::vector< uint64_t > > &word_signatures )
+{
+  hamming_embedding embedding;
+  hamming_model model;
+  if ( !model.load( filename, embedding ) )
+    return false;
+  if ( model.get_nb_points() != nb_points + nb_new_points )
+  {
+    std::cerr << " ERROR: The entries of the delta file were not merged" << std::endl;
+    return false;
+  }
+  inverted_file lists;
+  lists.init( nb_clusters );
+  std::vector< std::pair< uint32_t, uint32_t > > pairs;
+  for ( uint32_t vw = 0; vw < nb_clusters; ++vw )
+  {
+    const uint32_t *assignments = model.get_assignments( vw );
+    pairs.resize( model.get_nb_assignments( vw ) );
+    for ( size_t j = 0; j < pairs.size(); ++j )
+      pairs[j] = std::make_pair( assignments[2 * j], assignments[2 * j + 1] );
+    if ( !lists.add_list( vw, pairs, model.get_signatures() ) )
+      return false;
+  }
+  lists.finalize();
+
+  const uint32_t thresholds[4] = { 0, 8, 24, 64 };
+  for ( uint32_t nb_shards = 1; nb_shards <= 4; ++nb_shards )
+  {
+    std::vector< vw_shard > shards( nb_shards );
+    uint32_t nb_entries = 0;
+    for ( uint32_t s = 0; s < nb_shards; ++s )
+    {
+      if ( !shards[s].load( filename, nb_shards, s ) )
+        return false;
+      nb_entries += shards[s].get_nb_entries();
+    }
+    if ( nb_entries != lists.get_nb_entries() )
+    {
+      std::cerr << " ERROR: " << nb_shards << " shards hold " << nb_entries << " entries instead of " << lists.get_nb_entries() << std::endl;
+      return false;
+    }
+
+    for ( uint32_t q = 0; q < 200; ++q )
+    {
+      shard_query query;
+      query.keypoint = q;
+      query.vw = (uint32_t) ( rand() % nb_clusters );
+      query.signature = perturb_signature( word_signatures[query.vw][rand() % word_signatures[query.vw].size()] );
+      for ( int t = 0; t < 4; ++t )
+      {
+        std::vector< std::pair< uint32_t, uint32_t > > expected;
+        uint64_t nb_expected_scanned = lists.scan( query.vw, query.signature, thresholds[t], expected );
+        std::vector< shard_hit > hits;
+        uint64_t nb_scanned = shards[query.vw % nb_shards].match( std::vector< shard_query >( 1, query ), thresholds[t], hits );
+        bool same = ( hits.size() == expected.size() && nb_scanned == nb_expected_scanned );
+        for ( size_t j = 0; j < hits.size() && same; ++j )
+          same = ( hits[j].keypoint == q && hits[j].point == expected[j].first && hits[j].distance == expected[j].second );
+        if ( !same )
+        {
+          std::cerr << " ERROR: " << nb_shards << " shards: the hits of visual word " << query.vw << " with threshold " << thresholds[t]
+                    << " differ from the single process (" << hits.size() << " instead of " << expected.size() << " hits)" << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+
+int main( )
+{
+  srand( 42 );
+  std::string filename( "test_vw_shards_model.txt" );
+  bool passed = true;
+  for ( int word_order = 1; word_order >= 0 && passed; --word_order )
+  {
+    std::vector< std::vector< uint64_t > > word_signatures;
+    passed = write_model( filename, word_order == 1, word_signatures ) && compare( filename, word_signatures );
+    std::cout << ( word_order == 1 ? "visual word order: " : "descriptor order: " ) << ( passed ? "passed" : "FAILED" ) << std::endl;
+  }
+  unlink( filename.c_str() );
+  unlink( hamming_delta::get_filename( filename ).c_str() );
+  return passed ? 0 : 1;
+}